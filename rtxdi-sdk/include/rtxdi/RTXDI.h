@@ -88,9 +88,15 @@ namespace rtxdi
         uint32_t NeighborOffsetCount = 8192;
         uint32_t RenderWidth = 0;
         uint32_t RenderHeight = 0;
+        // With FrameParameters::environmentStratifiedSampling, tiles of half this size give the same quality
         uint32_t EnvironmentTileSize = 1024;
         uint32_t EnvironmentTileCount = 128;
 
+        // Splits the environment map tiles into two sets, one sampling the upper half of the
+        // environment map and another sampling the lower half. Surfaces facing up or down
+        // favor the set that covers their visible hemisphere. Requires EnvironmentTileCount >= 2.
+        bool EnvironmentHemisphereSplit = false;
+
         CheckerboardMode CheckerboardSamplingMode = CheckerboardMode::Off;
         
         ReGIRContextParameters ReGIR;
@@ -120,9 +126,35 @@ namespace rtxdi
         // Index of the importance environment light in the light buffer.
         uint32_t environmentLightIndex = RTXDI_INVALID_LIGHT_INDEX;
 
+        // Assigns strata of the environment map CDF to the slots within each environment tile
+        // instead of sampling every slot independently.
+        bool environmentStratifiedSampling = false;
+
         // Use image-based importance sampling for local lights
         bool enableLocalLightImportanceSampling = false;
 
+        // Number of local light RIS tiles that are re-presampled on this frame.
+        // The remaining tiles are carried over from the previous frame and their light indices
+        // are translated through RAB_TranslateLightIndex, see RTXDI_RemapPresampledLocalLight.
+        // The refreshed window rotates through the RIS buffer with frameIndex.
+        // Zero or any value >= TileCount means that all tiles are refreshed.
+        uint32_t numLocalLightTilesToRefresh = 0;
+
+        // Draws every initial candidate in RTXDI_SampleLightsForSurface from a light type that is selected
+        // at random, with probabilities proportional to the power of each type, instead of taking
+        // a fixed number of candidates from each type.
+        bool enableAdaptiveLightTypeSelection = false;
+
+        // Estimated total power of the local lights, infinite lights and the importance sampled environment map.
+        // Only the ratios between the three values matter.
+        float localLightPower = 0.f;
+        float infiniteLightPower = 0.f;
+        float environmentLightPower = 0.f;
+
+        // Lower bound for the selection probability of every light type that is present on this frame.
+        // Keeps the adaptive selection unbiased when the power estimates miss some contribution.
+        float minLightTypeProbability = 0.05f;
+
         // Size of the smallest ReGIR cell, in world units.
         float regirCellSize = 1.f;
 
@@ -365,6 +365,144 @@ void RTXDI_SamplePdfMipmap(
     }
 }
 
+// Performs the same mipmap descent as RTXDI_SamplePdfMipmap, starting from 'position' in 'startMipLevel',
+// but uses a single random number for all levels, rescaling it into the selected texel's interval after
+// every decision. This makes the mapping from 'rnd' to texels monotonic, so stratified values of 'rnd'
+// produce samples that are stratified over the CDF of the PDF texture.
+void RTXDI_DescendPdfMipmapWithRandom(
+    float rnd,
+    RTXDI_TEX2D pdfTexture,
+    int startMipLevel,
+    inout uint2 position,
+    inout float pdf)
+{
+    for (int mipLevel = startMipLevel; mipLevel >= 0; mipLevel--)
+    {
+        position *= 2;
+
+        float4 samples;
+        samples.x = max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(position.x + 0, position.y + 0), mipLevel).x);
+        samples.y = max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(position.x + 0, position.y + 1), mipLevel).x);
+        samples.z = max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(position.x + 1, position.y + 0), mipLevel).x);
+        samples.w = max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(position.x + 1, position.y + 1), mipLevel).x);
+
+        float weightSum = samples.x + samples.y + samples.z + samples.w;
+        if (weightSum <= 0)
+        {
+            pdf = 0;
+            return;
+        }
+
+        samples /= weightSum;
+
+        float intervalStart = 0;
+        float selectedWeight;
+
+        if (rnd < samples.x)
+        {
+            selectedWeight = samples.x;
+        }
+        else if (rnd < samples.x + samples.y)
+        {
+            position += uint2(0, 1);
+            intervalStart = samples.x;
+            selectedWeight = samples.y;
+        }
+        else if (rnd < samples.x + samples.y + samples.z)
+        {
+            position += uint2(1, 0);
+            intervalStart = samples.x + samples.y;
+            selectedWeight = samples.z;
+        }
+        else
+        {
+            position += uint2(1, 1);
+            intervalStart = samples.x + samples.y + samples.z;
+            selectedWeight = samples.w;
+        }
+
+        pdf *= selectedWeight;
+
+        if (selectedWeight <= 0)
+            return;
+
+        rnd = min(saturate((rnd - intervalStart) / selectedWeight), 0.99999994);
+    }
+}
+
+// Returns the mip level of a PDF texture that has exactly 2 rows of texels.
+// At that level, the first row covers the upper half of mip 0 and the second row covers the lower half.
+int RTXDI_GetPdfMipmapHalfLevel(uint2 pdfTextureSize)
+{
+    return max(0, int(floor(log2(float(pdfTextureSize.y)))) - 1);
+}
+
+// Returns the total PDF weights of the upper (x) and lower (y) halves of a PDF texture.
+float2 RTXDI_GetPdfMipmapHalfWeights(
+    RTXDI_TEX2D pdfTexture,
+    uint2 pdfTextureSize)
+{
+    int halfMipLevel = RTXDI_GetPdfMipmapHalfLevel(pdfTextureSize);
+    uint rowWidth = max(1u, pdfTextureSize.x >> uint(halfMipLevel));
+
+    float2 weights = float2(0, 0);
+    for (uint x = 0; x < rowWidth; x++)
+    {
+        weights.x += max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(x, 0), halfMipLevel).x);
+        weights.y += max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(x, 1), halfMipLevel).x);
+    }
+
+    return weights;
+}
+
+// Samples a texel from one half of a PDF texture (0 = upper, 1 = lower) using a single random number,
+// see RTXDI_DescendPdfMipmapWithRandom. The returned PDF is normalized over the selected half only.
+void RTXDI_SamplePdfMipmapHalfWithRandom(
+    float rnd,
+    RTXDI_TEX2D pdfTexture,
+    uint2 pdfTextureSize,
+    uint hemisphere,
+    out uint2 position,
+    out float pdf)
+{
+    int halfMipLevel = RTXDI_GetPdfMipmapHalfLevel(pdfTextureSize);
+    uint rowWidth = max(1u, pdfTextureSize.x >> uint(halfMipLevel));
+
+    position = uint2(0, hemisphere);
+    pdf = 0;
+
+    float rowSum = 0;
+    for (uint x = 0; x < rowWidth; x++)
+        rowSum += max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(x, hemisphere), halfMipLevel).x);
+
+    if (rowSum <= 0)
+        return;
+
+    // Walk the CDF of the row to select a texel in the half mip level
+    float target = rnd * rowSum;
+    float intervalStart = 0;
+    float selectedWeight = 0;
+    for (uint x = 0; x < rowWidth; x++)
+    {
+        selectedWeight = max(0, RTXDI_TEX2D_LOAD(pdfTexture, int2(x, hemisphere), halfMipLevel).x);
+        position.x = x;
+
+        if (target < intervalStart + selectedWeight)
+            break;
+
+        intervalStart += selectedWeight;
+    }
+
+    pdf = selectedWeight / rowSum;
+
+    if (selectedWeight <= 0)
+        return;
+
+    rnd = min(saturate((target - intervalStart) / selectedWeight), 0.99999994);
+
+    RTXDI_DescendPdfMipmapWithRandom(rnd, pdfTexture, halfMipLevel - 1, position, pdf);
+}
+
 #if RTXDI_ENABLE_PRESAMPLING
 
 void RTXDI_PresampleLocalLights(
@@ -405,6 +543,44 @@ void RTXDI_PresampleLocalLights(
     RTXDI_RIS_BUFFER[risBufferPtr] = uint2(lightIndex, asuint(invSourcePdf));
 }
 
+// Returns true if the given local light RIS tile should be re-presampled on this frame,
+// false if it should be carried over from the previous frame with RTXDI_RemapPresampledLocalLight.
+bool RTXDI_IsLocalLightTileRefreshed(
+    uint tileIndex,
+    RTXDI_RISBufferRuntimeParameters params)
+{
+    uint relativeTile = (tileIndex + params.tileCount - params.refreshTileOffset) % params.tileCount;
+    return relativeTile < params.refreshTileCount;
+}
+
+// Carries over one RIS buffer entry written by RTXDI_PresampleLocalLights on a previous frame.
+// The light index is translated from the previous frame into the current frame,
+// and the entry is invalidated if the light no longer exists.
+// The compact light info stored next to the entry is kept as is.
+void RTXDI_RemapPresampledLocalLight(
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_ResamplingRuntimeParameters params)
+{
+    uint risBufferPtr = sampleInTile + tileIndex * params.risBufferParams.tileSize;
+
+    uint2 tileData = RTXDI_RIS_BUFFER[risBufferPtr];
+    if (asfloat(tileData.y) == 0)
+        return;
+
+    int mappedLightIndex = RAB_TranslateLightIndex(tileData.x & RTXDI_LIGHT_INDEX_MASK, false);
+
+    if (mappedLightIndex < int(params.localLightParams.firstLocalLight) ||
+        mappedLightIndex >= int(params.localLightParams.firstLocalLight + params.localLightParams.numLocalLights))
+    {
+        RTXDI_RIS_BUFFER[risBufferPtr] = uint2(0, 0);
+        return;
+    }
+
+    tileData.x = uint(mappedLightIndex) | (tileData.x & RTXDI_LIGHT_COMPACT_BIT);
+    RTXDI_RIS_BUFFER[risBufferPtr] = tileData;
+}
+
 void RTXDI_PresampleEnvironmentMap(
     inout RAB_RandomSamplerState rng, 
     RTXDI_TEX2D pdfTexture,
@@ -415,7 +591,46 @@ void RTXDI_PresampleEnvironmentMap(
 {
     uint2 texelPosition;
     float pdf;
-    RTXDI_SamplePdfMipmap(rng, pdfTexture, pdfTextureSize, texelPosition, pdf);
+
+    if (params.environmentHemisphereSplit != 0 || params.environmentStratifiedSampling != 0)
+    {
+        // Use one random number for the whole descent so that it can be stratified within the tile
+        float rnd = RAB_GetNextRandom(rng);
+        if (params.environmentStratifiedSampling != 0)
+            rnd = (float(sampleInTile) + rnd) / float(params.environmentTileSize);
+
+        if (params.environmentHemisphereSplit != 0)
+        {
+            // The first half of the tiles samples the upper hemisphere, the second half samples the lower one.
+            // Store the inverse PDF relative to the full sphere; the hemisphere selection probability
+            // is applied when the samples are used, see RTXDI_GetEnvironmentHemisphereSelectionFactors.
+            uint hemisphere = (tileIndex >= params.environmentTileCount / 2) ? 1 : 0;
+            RTXDI_SamplePdfMipmapHalfWithRandom(rnd, pdfTexture, pdfTextureSize, hemisphere, texelPosition, pdf);
+
+            float2 halfWeights = RTXDI_GetPdfMipmapHalfWeights(pdfTexture, pdfTextureSize);
+            float totalWeight = halfWeights.x + halfWeights.y;
+            pdf *= (totalWeight > 0) ? ((hemisphere == 0 ? halfWeights.x : halfWeights.y) / totalWeight) : 0.0;
+
+            // Publish the probabilities of both halves for the shading passes
+            if (tileIndex == 0 && sampleInTile == 0)
+            {
+                float2 halfProbabilities = (totalWeight > 0) ? (halfWeights / totalWeight) : float2(0, 0);
+                uint headerPtr = params.environmentRisBufferOffset + params.environmentTileCount * params.environmentTileSize;
+                RTXDI_RIS_BUFFER[headerPtr] = uint2(asuint(halfProbabilities.x), asuint(halfProbabilities.y));
+            }
+        }
+        else
+        {
+            int lastMipLevel = max(0, int(floor(log2(max(pdfTextureSize.x, pdfTextureSize.y)))) - 1);
+            texelPosition = uint2(0, 0);
+            pdf = 1.0;
+            RTXDI_DescendPdfMipmapWithRandom(rnd, pdfTexture, lastMipLevel, texelPosition, pdf);
+        }
+    }
+    else
+    {
+        RTXDI_SamplePdfMipmap(rng, pdfTexture, pdfTextureSize, texelPosition, pdf);
+    }
 
     // Uniform sampling inside the pixels
     float2 fPos = float2(texelPosition);
@@ -677,12 +892,51 @@ void RTXDI_ComputeRISBufferBaseAndCount(
     out uint risBufferBase,
     out uint risBufferCount)
 {
+    // With the hemisphere split, select a tile from the upper half of the tiles;
+    // the matching lower hemisphere tile is located at the same offset in the second half.
+    uint tileCount = (params.environmentHemisphereSplit != 0) ? (params.environmentTileCount / 2) : params.environmentTileCount;
+
     float tileRnd = RAB_GetNextRandom(coherentRng);
-    uint tileIndex = uint(tileRnd * params.environmentTileCount);
+    uint tileIndex = uint(tileRnd * tileCount);
     risBufferBase = tileIndex * params.environmentTileSize + params.environmentRisBufferOffset;
     risBufferCount = params.environmentTileSize;
 }
 
+// Computes the factors that convert the full-sphere environment map sampling PDF into the PDF of
+// the hemisphere split sampling technique for the given surface, for the upper (x) and lower (y) halves.
+// The upper half is selected with probability that goes from 1 for surfaces facing straight up,
+// through the upper half's share of the environment map power for vertical surfaces, to 0 for
+// surfaces facing straight down, so the half that is invisible to the surface is skipped.
+float2 RTXDI_GetEnvironmentHemisphereSelectionFactors(
+    RAB_Surface surface,
+    RTXDI_EnvironmentLightRuntimeParameters params)
+{
+    if (params.environmentHemisphereSplit == 0)
+        return float2(1, 1);
+
+    uint headerPtr = params.environmentRisBufferOffset + params.environmentTileCount * params.environmentTileSize;
+    uint2 headerData = RTXDI_RIS_BUFFER[headerPtr];
+    float2 halfProbabilities = float2(asfloat(headerData.x), asfloat(headerData.y));
+
+    float upWeight = 1.0 - RAB_GetEnvironmentMapRandXYFromDir(RAB_GetSurfaceNormal(surface)).y;
+    float2 weights = float2(upWeight, 1.0 - upWeight);
+
+    float normalization = dot(weights, halfProbabilities);
+    if (normalization <= 0)
+        return float2(0, 0);
+
+    return weights / normalization;
+}
+
+// Returns the probability of selecting the upper half of the environment map tiles from the selection factors.
+float RTXDI_GetEnvironmentUpperHemisphereProbability(
+    float2 selectionFactors,
+    RTXDI_EnvironmentLightRuntimeParameters params)
+{
+    uint headerPtr = params.environmentRisBufferOffset + params.environmentTileCount * params.environmentTileSize;
+    return selectionFactors.x * asfloat(RTXDI_RIS_BUFFER[headerPtr].x);
+}
+
 void RTXDI_SelectEnvironmentLightUV(
     inout RAB_RandomSamplerState rng,
     uint risBufferCount,
@@ -751,11 +1005,28 @@ RTXDI_Reservoir RTXDI_SampleEnvironmentMap(
 
     RAB_LightInfo lightInfo = RAB_LoadLightInfo(params.environmentLightIndex, false);
 
+    float2 hemisphereFactors = RTXDI_GetEnvironmentHemisphereSelectionFactors(surface, params);
+    float upperHemisphereProbability = 1.0;
+    if (params.environmentHemisphereSplit != 0)
+        upperHemisphereProbability = RTXDI_GetEnvironmentUpperHemisphereProbability(hemisphereFactors, params);
+
     for (uint i = 0; i < sampleParams.numEnvironmentMapSamples; i++)
     {
+        uint candidateBufferBase = risBufferBase;
+        float hemisphereFactor = hemisphereFactors.x;
+        if (params.environmentHemisphereSplit != 0 && RAB_GetNextRandom(rng) >= upperHemisphereProbability)
+        {
+            candidateBufferBase += (params.environmentTileCount / 2) * params.environmentTileSize;
+            hemisphereFactor = hemisphereFactors.y;
+        }
+
+        if (hemisphereFactor <= 0)
+            continue;
+
         float2 uv;
         float invSourcePdf;
-        RTXDI_SelectEnvironmentLightUV(rng, risBufferCount, risBufferBase, uv, invSourcePdf);        
+        RTXDI_SelectEnvironmentLightUV(rng, risBufferCount, candidateBufferBase, uv, invSourcePdf);
+        invSourcePdf /= hemisphereFactor;
         RTXDI_StreamEnvironmentLightAtUVIntoReservoir(rng, sampleParams, surface, lightInfo, params.environmentLightIndex, uv, invSourcePdf, state, o_selectedSample);
     }
 
@@ -938,15 +1209,38 @@ RTXDI_Reservoir RTXDI_SampleLocalLightsFromReGIR(
 
 #endif // (RTXDI_REGIR_MODE != RTXDI_REGIR_DISABLED)
 
-// Samples from the BRDF defined by the given surface
-RTXDI_Reservoir RTXDI_SampleBrdf(
+// Returns the normalized probabilities of drawing a candidate from the local lights (x), infinite lights (y)
+// and the environment map (z) in the adaptive light type selection mode.
+// All zeros mean that the mode is disabled.
+float3 RTXDI_GetLightTypeProbabilities(RTXDI_ResamplingRuntimeParameters params)
+{
+    float3 probabilities = float3(
+        params.localLightSelectionProbability,
+        params.infiniteLightSelectionProbability,
+        params.environmentLightSelectionProbability);
+
+#if !RTXDI_ENABLE_PRESAMPLING
+    // The environment map can only be sampled from the presampled tiles
+    probabilities.z = 0;
+#endif
+
+    float sum = probabilities.x + probabilities.y + probabilities.z;
+    return (sum > 0) ? probabilities / sum : float3(0, 0, 0);
+}
+
+// SDK internal function that samples the BRDF. The light source PDFs of local lights and the environment map
+// are scaled by the given factors to match the light type selection probabilities of the light sampling technique.
+RTXDI_Reservoir RTXDI_SampleBrdfInternal(
     inout RAB_RandomSamplerState rng,
     RAB_Surface surface,
     RTXDI_SampleParameters sampleParams,
     RTXDI_ResamplingRuntimeParameters params,
+    float localLightPdfScale,
+    float environmentPdfScale,
     out RAB_LightSample o_selectedSample)
 {
     RTXDI_Reservoir state = RTXDI_EmptyReservoir();
+    o_selectedSample = RAB_EmptyLightSample();
     
     for (uint i = 0; i < sampleParams.numBrdfSamples; ++i)
     {
@@ -985,7 +1279,7 @@ RTXDI_Reservoir RTXDI_SampleBrdf(
 
                 if (lightIndex != RTXDI_InvalidLightIndex)
                 {
-                    lightSourcePdf = RAB_EvaluateLocalLightSourcePdf(params, lightIndex);
+                    lightSourcePdf = RAB_EvaluateLocalLightSourcePdf(params, lightIndex) * localLightPdfScale;
                 }
             }
             else if (!hitAnything && params.environmentLightParams.environmentLightPresent != 0)
@@ -995,7 +1289,16 @@ RTXDI_Reservoir RTXDI_SampleBrdf(
                 RAB_LightInfo lightInfo = RAB_LoadLightInfo(lightIndex, false);
                 randXY = RAB_GetEnvironmentMapRandXYFromDir(sampleDir);
                 candidateSample = RAB_SamplePolymorphicLight(lightInfo, surface, randXY);
-                lightSourcePdf = RAB_EvaluateEnvironmentMapSamplingPdf(sampleDir);
+                lightSourcePdf = RAB_EvaluateEnvironmentMapSamplingPdf(sampleDir) * environmentPdfScale;
+
+#if RTXDI_ENABLE_PRESAMPLING
+                // Account for the hemisphere split in the environment light sampling technique
+                if (params.environmentLightParams.environmentHemisphereSplit != 0)
+                {
+                    float2 hemisphereFactors = RTXDI_GetEnvironmentHemisphereSelectionFactors(surface, params.environmentLightParams);
+                    lightSourcePdf *= (randXY.y < 0.5) ? hemisphereFactors.x : hemisphereFactors.y;
+                }
+#endif
             }
         }
 
@@ -1025,7 +1328,183 @@ RTXDI_Reservoir RTXDI_SampleBrdf(
     return state;
 }
 
+// Samples from the BRDF defined by the given surface
+RTXDI_Reservoir RTXDI_SampleBrdf(
+    inout RAB_RandomSamplerState rng,
+    RAB_Surface surface,
+    RTXDI_SampleParameters sampleParams,
+    RTXDI_ResamplingRuntimeParameters params,
+    out RAB_LightSample o_selectedSample)
+{
+    return RTXDI_SampleBrdfInternal(rng, surface, sampleParams, params, 1.0, 1.0, o_selectedSample);
+}
+
+// Adaptive light type selection version of RTXDI_SampleLightsForSurface.
+// The per-type sample counts are pooled into one budget, and each candidate is drawn from a light type
+// selected with the given probabilities. The type probability is a part of the candidate's source PDF,
+// which makes the pooled candidates one sampling technique that is MIS-combined with BRDF sampling.
+RTXDI_Reservoir RTXDI_SampleLightsForSurfaceAdaptive(
+    inout RAB_RandomSamplerState rng,
+    inout RAB_RandomSamplerState coherentRng,
+    RAB_Surface surface,
+    RTXDI_SampleParameters sampleParams,
+    RTXDI_ResamplingRuntimeParameters params,
+    float3 lightTypeProbabilities,
+    out RAB_LightSample o_lightSample)
+{
+    o_lightSample = RAB_EmptyLightSample();
+
+    // Local light source: the ReGIR cell if the surface is inside the grid, a RIS tile or the whole pool otherwise
+    uint numLocalLightSamples = sampleParams.numLocalLightSamples;
+    int cellIndex = -1;
+
+#if RTXDI_REGIR_MODE != RTXDI_REGIR_DISABLED
+    if (params.regirCommon.enable != 0 && sampleParams.numRegirSamples > 0)
+    {
+        float3 cellJitter = float3(
+            RAB_GetNextRandom(coherentRng),
+            RAB_GetNextRandom(coherentRng),
+            RAB_GetNextRandom(coherentRng));
+        cellJitter -= 0.5;
+
+        float3 samplingPos = RAB_GetSurfaceWorldPos(surface);
+        float jitterScale = RTXDI_ReGIR_GetJitterScale(params, samplingPos);
+        samplingPos += cellJitter * jitterScale;
+
+        cellIndex = RTXDI_ReGIR_WorldPosToCellIndex(params, samplingPos);
+    }
+#endif
+
+    uint localRisBufferBase;
+    uint localRisBufferCount;
+    bool useLocalRisBuffer;
+
+    if (cellIndex < 0)
+    {
+        float tileRnd = RAB_GetNextRandom(coherentRng);
+        uint tileIndex = uint(tileRnd * params.risBufferParams.tileCount);
+
+        localRisBufferBase = tileIndex * params.risBufferParams.tileSize;
+        localRisBufferCount = params.risBufferParams.tileSize;
+        useLocalRisBuffer = params.localLightParams.enableLocalLightImportanceSampling != 0;
+    }
+    else
+    {
+        localRisBufferBase = uint(cellIndex) * params.regirCommon.lightsPerCell + params.regirCommon.risBufferOffset;
+        localRisBufferCount = params.regirCommon.lightsPerCell;
+        useLocalRisBuffer = true;
+        numLocalLightSamples = sampleParams.numRegirSamples;
+    }
+
+#if RTXDI_ENABLE_PRESAMPLING
+    uint environmentRisBufferBase = 0;
+    uint environmentRisBufferCount = 0;
+    float2 hemisphereFactors = float2(1, 1);
+    float upperHemisphereProbability = 1.0;
+    RAB_LightInfo environmentLightInfo = RAB_EmptyLightInfo();
+
+    if (lightTypeProbabilities.z > 0)
+    {
+        RTXDI_ComputeRISBufferBaseAndCount(coherentRng, params.environmentLightParams, environmentRisBufferBase, environmentRisBufferCount);
+        environmentLightInfo = RAB_LoadLightInfo(params.environmentLightParams.environmentLightIndex, false);
+
+        hemisphereFactors = RTXDI_GetEnvironmentHemisphereSelectionFactors(surface, params.environmentLightParams);
+        if (params.environmentLightParams.environmentHemisphereSplit != 0)
+            upperHemisphereProbability = RTXDI_GetEnvironmentUpperHemisphereProbability(hemisphereFactors, params.environmentLightParams);
+    }
+#endif
+
+    // All light candidates form one technique, so they share the MIS weight against BRDF samples
+    uint numLightSamples = numLocalLightSamples + sampleParams.numInfiniteLightSamples + sampleParams.numEnvironmentMapSamples;
+    RTXDI_SampleParameters pooledSampleParams = sampleParams;
+    pooledSampleParams.numMisSamples = numLightSamples + sampleParams.numBrdfSamples;
+    pooledSampleParams.localLightMisWeight = float(numLightSamples) / pooledSampleParams.numMisSamples;
+    pooledSampleParams.environmentMapMisWeight = pooledSampleParams.localLightMisWeight;
+    pooledSampleParams.brdfMisWeight = float(sampleParams.numBrdfSamples) / pooledSampleParams.numMisSamples;
+
+    RTXDI_Reservoir lightReservoir = RTXDI_EmptyReservoir();
+    RAB_LightSample lightSample = RAB_EmptyLightSample();
+
+    for (uint i = 0; i < numLightSamples; i++)
+    {
+        float typeRnd = RAB_GetNextRandom(rng);
+
+        if (typeRnd < lightTypeProbabilities.x || (lightTypeProbabilities.y <= 0 && lightTypeProbabilities.z <= 0))
+        {
+            uint lightIndex;
+            RAB_LightInfo lightInfo;
+            float invSourcePdf;
+
+            RTXDI_RandomlySelectLocalLight(rng, params.localLightParams.firstLocalLight, params.localLightParams.numLocalLights,
+#if RTXDI_ENABLE_PRESAMPLING
+                useLocalRisBuffer, localRisBufferBase, localRisBufferCount,
+#endif
+                lightInfo, lightIndex, invSourcePdf);
+
+            float2 uv = RTXDI_RandomlySelectLocalLightUV(rng);
+            RTXDI_StreamLocalLightAtUVIntoReservoir(rng, pooledSampleParams, surface, lightIndex, uv,
+                invSourcePdf / lightTypeProbabilities.x, lightInfo, lightReservoir, lightSample);
+        }
+        else if (typeRnd < lightTypeProbabilities.x + lightTypeProbabilities.y || lightTypeProbabilities.z <= 0)
+        {
+            uint lightIndex;
+            RAB_LightInfo lightInfo;
+            float invSourcePdf;
+
+            RTXDI_RandomlySelectInfiniteLight(rng, params.infiniteLightParams, lightInfo, lightIndex, invSourcePdf);
+            float2 uv = RTXDI_RandomlySelectInfiniteLightUV(rng);
+
+            // Infinite lights are analytic and never MIS-blended with BRDF samples, but they are normalized
+            // together with the other candidates, so apply the light technique weight directly
+            invSourcePdf /= lightTypeProbabilities.y * pooledSampleParams.localLightMisWeight;
+            RTXDI_StreamInfiniteLightAtUVIntoReservoir(rng, lightInfo, surface, lightIndex, uv, invSourcePdf, lightReservoir, lightSample);
+        }
+#if RTXDI_ENABLE_PRESAMPLING
+        else
+        {
+            uint candidateBufferBase = environmentRisBufferBase;
+            float hemisphereFactor = hemisphereFactors.x;
+            if (params.environmentLightParams.environmentHemisphereSplit != 0 && RAB_GetNextRandom(rng) >= upperHemisphereProbability)
+            {
+                candidateBufferBase += (params.environmentLightParams.environmentTileCount / 2) * params.environmentLightParams.environmentTileSize;
+                hemisphereFactor = hemisphereFactors.y;
+            }
+
+            if (hemisphereFactor <= 0)
+                continue;
+
+            float2 uv;
+            float invSourcePdf;
+            RTXDI_SelectEnvironmentLightUV(rng, environmentRisBufferCount, candidateBufferBase, uv, invSourcePdf);
+            invSourcePdf /= hemisphereFactor * lightTypeProbabilities.z;
+            RTXDI_StreamEnvironmentLightAtUVIntoReservoir(rng, pooledSampleParams, surface, environmentLightInfo,
+                params.environmentLightParams.environmentLightIndex, uv, invSourcePdf, lightReservoir, lightSample);
+        }
+#endif
+    }
+
+    RTXDI_FinalizeResampling(lightReservoir, 1.0, pooledSampleParams.numMisSamples);
+    lightReservoir.M = 1;
+
+    RAB_LightSample brdfSample = RAB_EmptyLightSample();
+    RTXDI_Reservoir brdfReservoir = RTXDI_SampleBrdfInternal(rng, surface, pooledSampleParams, params,
+        lightTypeProbabilities.x, lightTypeProbabilities.z, brdfSample);
+
+    RTXDI_Reservoir state = RTXDI_EmptyReservoir();
+    RTXDI_CombineReservoirs(state, lightReservoir, 0.5, lightReservoir.targetPdf);
+    bool selectBrdf = RTXDI_CombineReservoirs(state, brdfReservoir, RAB_GetNextRandom(rng), brdfReservoir.targetPdf);
+
+    RTXDI_FinalizeResampling(state, 1.0, 1.0);
+    state.M = 1;
+
+    o_lightSample = selectBrdf ? brdfSample : lightSample;
+
+    return state;
+}
+
 // Samples ReGIR and the local and infinite light pools for a given surface.
+// If adaptive light type selection is enabled in the runtime parameters, the light sample counts
+// are pooled and distributed between the light types stochastically, see RTXDI_SampleLightsForSurfaceAdaptive.
 RTXDI_Reservoir RTXDI_SampleLightsForSurface(
     inout RAB_RandomSamplerState rng,
     inout RAB_RandomSamplerState coherentRng,
@@ -1034,6 +1513,13 @@ RTXDI_Reservoir RTXDI_SampleLightsForSurface(
     RTXDI_ResamplingRuntimeParameters params, 
     out RAB_LightSample o_lightSample)
 {
+    float3 lightTypeProbabilities = RTXDI_GetLightTypeProbabilities(params);
+    if (lightTypeProbabilities.x + lightTypeProbabilities.y + lightTypeProbabilities.z > 0)
+    {
+        return RTXDI_SampleLightsForSurfaceAdaptive(rng, coherentRng, surface, sampleParams, params,
+            lightTypeProbabilities, o_lightSample);
+    }
+
     o_lightSample = RAB_EmptyLightSample();
 
     RTXDI_Reservoir localReservoir;
@@ -134,17 +134,17 @@ struct RTXDI_EnvironmentLightRuntimeParameters
     uint32_t environmentTileSize;
 
     uint32_t environmentTileCount;
+    uint32_t environmentStratifiedSampling;
+    uint32_t environmentHemisphereSplit;
     uint32_t pad1;
-    uint32_t pad2;
-    uint32_t pad3;
 };
 
 struct RTXDI_RISBufferRuntimeParameters
 {
     uint32_t tileSize;
     uint32_t tileCount;
-    uint32_t pad1;
-    uint32_t pad2;
+    uint32_t refreshTileOffset;
+    uint32_t refreshTileCount;
 };
 
 struct RTXDI_ResamplingRuntimeParameters
@@ -160,9 +160,11 @@ struct RTXDI_ResamplingRuntimeParameters
     uint32_t reservoirBlockRowPitch;
     
     uint32_t reservoirArrayPitch;
-    uint32_t pad1;
-    uint32_t pad2;
-    uint32_t pad3;
+    // Probabilities of drawing a candidate from each light type in the adaptive light type selection mode,
+    // all zero when the mode is disabled. See RTXDI_SampleLightsForSurface.
+    float localLightSelectionProbability;
+    float infiniteLightSelectionProbability;
+    float environmentLightSelectionProbability;
 
     RTXDI_ReGIRCommonParameters regirCommon;
     RTXDI_ReGIRGridParameters regirGrid;
@@ -38,6 +38,7 @@ rtxdi::Context::Context(const ContextParameters& params)
     assert(IsNonzeroPowerOf2(params.TileCount));
     assert(params.RenderWidth > 0);
     assert(params.RenderHeight > 0);
+    assert(!params.EnvironmentHemisphereSplit || params.EnvironmentTileCount >= 2);
 
     uint32_t renderWidth = (params.CheckerboardSamplingMode == CheckerboardMode::Off)
         ? params.RenderWidth
@@ -211,6 +212,8 @@ uint32_t rtxdi::Context::GetRisBufferElementCount() const
     uint32_t size = 0;
     size += m_Params.TileCount * m_Params.TileSize;
     size += m_Params.EnvironmentTileCount * m_Params.EnvironmentTileSize;
+    if (m_Params.EnvironmentHemisphereSplit)
+        size += 1; // Probabilities of the two environment map halves
     size += GetReGIRLightSlotCount();
 
     return size;
@@ -254,6 +257,53 @@ static uint32_t JenkinsHash(uint32_t a)
     return a;
 }
 
+// Distributes the initial candidates between the light types in proportion to their power,
+// giving every type that is present at least the minimum probability.
+static void ComputeLightTypeProbabilities(const FrameParameters& frame, float outProbabilities[3])
+{
+    const bool present[3] = {
+        frame.numLocalLights > 0,
+        frame.numInfiniteLights > 0,
+        frame.environmentLightPresent
+    };
+    const float power[3] = {
+        std::max(frame.localLightPower, 0.f),
+        std::max(frame.infiniteLightPower, 0.f),
+        std::max(frame.environmentLightPower, 0.f)
+    };
+
+    float totalPower = 0.f;
+    uint32_t numPresentTypes = 0;
+    for (int type = 0; type < 3; type++)
+    {
+        outProbabilities[type] = 0.f;
+        if (present[type])
+        {
+            totalPower += power[type];
+            numPresentTypes++;
+        }
+    }
+
+    if (!frame.enableAdaptiveLightTypeSelection || numPresentTypes == 0)
+        return;
+
+    const float minProbability = std::min(std::max(frame.minLightTypeProbability, 0.f), 1.f / float(numPresentTypes));
+
+    float sum = 0.f;
+    for (int type = 0; type < 3; type++)
+    {
+        if (!present[type])
+            continue;
+
+        float probability = (totalPower > 0.f) ? power[type] / totalPower : 1.f / float(numPresentTypes);
+        outProbabilities[type] = std::max(probability, minProbability);
+        sum += outProbabilities[type];
+    }
+
+    for (int type = 0; type < 3; type++)
+        outProbabilities[type] /= sum;
+}
+
 void rtxdi::Context::FillRuntimeParameters(
     RTXDI_ResamplingRuntimeParameters& runtimeParams,
     const FrameParameters& frame) const
@@ -267,12 +317,29 @@ void rtxdi::Context::FillRuntimeParameters(
     runtimeParams.neighborOffsetMask = m_Params.NeighborOffsetCount - 1;
     runtimeParams.risBufferParams.tileSize = m_Params.TileSize;
     runtimeParams.risBufferParams.tileCount = m_Params.TileCount;
+    if (frame.numLocalLightTilesToRefresh == 0 || frame.numLocalLightTilesToRefresh >= m_Params.TileCount)
+    {
+        runtimeParams.risBufferParams.refreshTileOffset = 0;
+        runtimeParams.risBufferParams.refreshTileCount = m_Params.TileCount;
+    }
+    else
+    {
+        runtimeParams.risBufferParams.refreshTileOffset = uint32_t((uint64_t(frame.frameIndex) * frame.numLocalLightTilesToRefresh) % m_Params.TileCount);
+        runtimeParams.risBufferParams.refreshTileCount = frame.numLocalLightTilesToRefresh;
+    }
     runtimeParams.localLightParams.enableLocalLightImportanceSampling = frame.enableLocalLightImportanceSampling;
     runtimeParams.reservoirBlockRowPitch = m_ReservoirBlockRowPitch;
     runtimeParams.reservoirArrayPitch = m_ReservoirArrayPitch;
+    float lightTypeProbabilities[3];
+    ComputeLightTypeProbabilities(frame, lightTypeProbabilities);
+    runtimeParams.localLightSelectionProbability = lightTypeProbabilities[0];
+    runtimeParams.infiniteLightSelectionProbability = lightTypeProbabilities[1];
+    runtimeParams.environmentLightSelectionProbability = lightTypeProbabilities[2];
     runtimeParams.environmentLightParams.environmentRisBufferOffset = m_RegirCellOffset + GetReGIRLightSlotCount();
     runtimeParams.environmentLightParams.environmentTileCount = m_Params.EnvironmentTileCount;
     runtimeParams.environmentLightParams.environmentTileSize = m_Params.EnvironmentTileSize;
+    runtimeParams.environmentLightParams.environmentStratifiedSampling = frame.environmentStratifiedSampling;
+    runtimeParams.environmentLightParams.environmentHemisphereSplit = m_Params.EnvironmentHemisphereSplit;
     runtimeParams.regirGrid.cellsX = m_Params.ReGIR.GridSize.x;
     runtimeParams.regirGrid.cellsY = m_Params.ReGIR.GridSize.y;
     runtimeParams.regirGrid.cellsZ = m_Params.ReGIR.GridSize.z;
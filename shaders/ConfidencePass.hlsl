@@ -60,11 +60,14 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     if (g_Const.blendFactor < 1.0)
     {
         // Find the previous input position using the motion vector.
+        // The motion vectors are measured in current pixels, scale them to the previous viewport
+        // in case the resolution has changed.
         float2 motionVector = t_MotionVectors[globalIdx].xy;
+        float2 prevPixelCenter = (float2(globalIdx) + 0.5 + motionVector) * float2(g_Const.prevViewportSize) / float2(g_Const.viewportSize);
         
-        int2 prevInputPos = int2(float2(globalIdx) + 0.5 + motionVector);
+        int2 prevInputPos = int2(prevPixelCenter);
 
-        if (all(prevInputPos >= 0) && all(prevInputPos < g_Const.viewportSize))
+        if (all(prevInputPos >= 0) && all(prevInputPos < g_Const.prevViewportSize))
         {
             // Blend the history in a non-linear space to make the result
             // hold on to lower confidence values longer than to high confidence.
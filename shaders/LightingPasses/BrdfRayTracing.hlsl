@@ -35,6 +35,7 @@ void RayGen()
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams);
+    SetRayCountPixel(pixelPosition);
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
@@ -167,10 +168,7 @@ void RayGen()
     TraceRay(SceneBVH, RAY_FLAG_NONE, instanceMask, 0, 0, 0, ray, payload);
 #endif
 
-    if (g_PerPassConstants.rayCountBufferIndex >= 0)
-    {
-        InterlockedAdd(u_RayCountBuffer[RAY_COUNT_TRACED(g_PerPassConstants.rayCountBufferIndex)], 1);
-    }
+    ReportRay(payload.instanceID != ~0u);
 
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
     uint gbufferIndex = RTXDI_ReservoirPositionToPointer(params, GlobalIndex, 0);
@@ -192,11 +190,6 @@ void RayGen()
 
     if (payload.instanceID != ~0u)
     {
-        if (g_PerPassConstants.rayCountBufferIndex >= 0)
-        {
-            InterlockedAdd(u_RayCountBuffer[RAY_COUNT_HITS(g_PerPassConstants.rayCountBufferIndex)], 1);
-        }
-
         GeometrySample gs = getGeometryFromHit(
             payload.instanceID,
             payload.geometryIndex,
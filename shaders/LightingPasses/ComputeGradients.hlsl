@@ -34,6 +34,8 @@ void RayGen()
 
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
 
+    SetRayCountPixel(RTXDI_ReservoirPosToPixelPos(GlobalIndex * RTXDI_GRAD_FACTOR, params));
+
     // This shader runs one thread per image stratum, i.e. a square of pixels
     // (RTXDI_GRAD_FACTOR x RTXDI_GRAD_FACTOR) in size. One pixel is selected to
     // produce a gradient.
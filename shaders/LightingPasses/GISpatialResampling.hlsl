@@ -27,6 +27,7 @@ void RayGen()
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams);
+    SetRayCountPixel(pixelPosition);
 
     if (any(pixelPosition > int2(g_Const.view.viewportSize)))
         return;
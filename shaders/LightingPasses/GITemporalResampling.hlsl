@@ -31,6 +31,7 @@ void RayGen()
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams);
+    SetRayCountPixel(pixelPosition);
 
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex, 7);
     
@@ -29,6 +29,7 @@ void RayGen()
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
 
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, params);
+    SetRayCountPixel(pixelPosition);
 
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, 1);
     RAB_RandomSamplerState tileRng = RAB_InitRandomSampler(pixelPosition / RTXDI_TILE_SIZE_IN_PIXELS, 1);
@@ -15,6 +15,12 @@
 [numthreads(RTXDI_PRESAMPLING_GROUP_SIZE, 1, 1)] 
 void main(uint2 GlobalIndex : SV_DispatchThreadID) 
 {
+    if (!RTXDI_IsLocalLightTileRefreshed(GlobalIndex.y, g_Const.runtimeParams.risBufferParams))
+    {
+        RTXDI_RemapPresampledLocalLight(GlobalIndex.y, GlobalIndex.x, g_Const.runtimeParams);
+        return;
+    }
+
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex.xy, 0);
 
     RTXDI_PresampleLocalLights(
@@ -80,6 +80,7 @@ RWBuffer<uint2> u_RisBuffer : register(u10);
 RWBuffer<uint4> u_RisLightDataBuffer : register(u11);
 RWBuffer<uint> u_RayCountBuffer : register(u12);
 RWStructuredBuffer<SecondaryGBufferData> u_SecondaryGBuffer : register(u13);
+RWBuffer<uint> u_RayCountTileBuffer : register(u14);
 
 // Other
 ConstantBuffer<ResamplingConstants> g_Const : register(b0);
@@ -87,6 +88,10 @@ VK_PUSH_CONSTANT ConstantBuffer<PerPassConstants> g_PerPassConstants : register(
 SamplerState s_MaterialSampler : register(s0);
 SamplerState s_EnvironmentSampler : register(s1);
 
+#ifndef EXTENDED_COMPACT_LIGHT_INFO
+#define EXTENDED_COMPACT_LIGHT_INFO 0
+#endif
+
 #define RTXDI_RIS_BUFFER u_RisBuffer
 #define RTXDI_LIGHT_RESERVOIR_BUFFER u_LightReservoirs
 #define RTXDI_NEIGHBOR_OFFSETS_BUFFER t_NeighborOffsets
@@ -266,6 +271,29 @@ void AnyHit(inout RayPayload payload : SV_RayPayload, in RayAttributes attrib :
 }
 #endif
 
+// Pixel that the rays traced by the current thread are attributed to in the per-tile ray counters
+static uint2 g_RayCountPixel = 0;
+
+void SetRayCountPixel(uint2 pixelPosition)
+{
+    g_RayCountPixel = pixelPosition;
+}
+
+// Counts a traced ray for the current pass, globally and in the screen tile containing g_RayCountPixel.
+// The tile counters are stored per pass: [rayCountBufferIndex][tileY][tileX].
+void ReportRay(bool hit)
+{
+    REPORT_RAY(hit);
+
+    if (g_Const.enableRayCountTiles && g_PerPassConstants.rayCountBufferIndex >= 0)
+    {
+        const uint2 tileCount = uint2(g_Const.rayCountTilesX, g_Const.rayCountTilesY);
+        const uint2 tile = min(g_RayCountPixel / RAY_COUNT_TILE_SIZE, tileCount - 1);
+        const uint tileIndex = (g_PerPassConstants.rayCountBufferIndex * tileCount.y + tile.y) * tileCount.x + tile.x;
+        InterlockedAdd(u_RayCountTileBuffer[tileIndex], 1);
+    }
+}
+
 bool GetConservativeVisibility(RaytracingAccelerationStructure accelStruct, RAB_Surface surface, float3 samplePosition)
 {
     RayDesc ray = setupVisibilityRay(surface, samplePosition);
@@ -288,7 +316,7 @@ bool GetConservativeVisibility(RaytracingAccelerationStructure accelStruct, RAB_
     bool visible = (payload.instanceID == ~0u);
 #endif
 
-    REPORT_RAY(!visible);
+    ReportRay(!visible);
 
     return visible;
 }
@@ -370,7 +398,7 @@ float3 GetFinalVisibility(RaytracingAccelerationStructure accelStruct, RAB_Surfa
     TraceRay(accelStruct, rayFlags, instanceMask, 0, 0, 0, ray, payload);
 #endif
 
-    REPORT_RAY(payload.instanceID != ~0u);
+    ReportRay(payload.instanceID != ~0u);
 
     if(payload.instanceID == ~0u)
         return payload.throughput.rgb;
@@ -384,8 +412,10 @@ float3 GetFinalVisibility(RaytracingAccelerationStructure accelStruct, RAB_Surfa
 // The simplest implementation will just return the input pixelPosition.
 int2 RAB_ClampSamplePositionIntoView(int2 pixelPosition, bool previousFrame)
 {
-    int width = int(g_Const.view.viewportSize.x);
-    int height = int(g_Const.view.viewportSize.y);
+    // The viewports are different after a resolution scale change
+    const float2 viewportSize = previousFrame ? g_Const.prevView.viewportSize : g_Const.view.viewportSize;
+    int width = int(viewportSize.x);
+    int height = int(viewportSize.y);
 
     // Reflect the position across the screen edges.
     // Compared to simple clamping, this prevents the spread of colorful blobs from screen edges.
@@ -703,10 +733,30 @@ RAB_LightInfo RAB_LoadLightInfo(uint index, bool previousFrame)
 // Loads triangle light data from a tile produced by the presampling pass.
 RAB_LightInfo RAB_LoadCompactLightInfo(uint linearIndex)
 {
+#if EXTENDED_COMPACT_LIGHT_INFO
+    uint4 packedData1, packedData2, packedData3;
+    packedData1 = u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 0];
+    packedData2 = u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 1];
+    packedData3 = u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 2];
+    return unpackExtendedCompactLightInfo(packedData1, packedData2, packedData3);
+#else
     uint4 packedData1, packedData2;
-    packedData1 = u_RisLightDataBuffer[linearIndex * 2 + 0];
-    packedData2 = u_RisLightDataBuffer[linearIndex * 2 + 1];
+    packedData1 = u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE + 0];
+    packedData2 = u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE + 1];
     return unpackCompactLightInfo(packedData1, packedData2);
+#endif
+}
+
+// Counts the presampled lights and how many of them were compacted, per light type.
+void ReportCompactLight(RAB_LightInfo lightInfo, bool stored)
+{
+    if (g_Const.compactLightCounterOffset == 0)
+        return;
+
+    uint lightType = uint(getLightType(lightInfo));
+    InterlockedAdd(u_RayCountBuffer[COMPACT_LIGHT_COUNT_TOTAL(g_Const.compactLightCounterOffset, lightType)], 1);
+    if (stored)
+        InterlockedAdd(u_RayCountBuffer[COMPACT_LIGHT_COUNT_STORED(g_Const.compactLightCounterOffset, lightType)], 1);
 }
 
 // Stores triangle light data into a tile.
@@ -715,13 +765,26 @@ RAB_LightInfo RAB_LoadCompactLightInfo(uint linearIndex)
 // A basic implementation can ignore this feature and always return false, which is just slower.
 bool RAB_StoreCompactLightInfo(uint linearIndex, RAB_LightInfo lightInfo)
 {
+#if EXTENDED_COMPACT_LIGHT_INFO
+    uint4 data1, data2, data3;
+    packExtendedCompactLightInfo(lightInfo, data1, data2, data3);
+
+    u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 0] = data1;
+    u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 1] = data2;
+    u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE_EXTENDED + 2] = data3;
+#else
     uint4 data1, data2;
     if (!packCompactLightInfo(lightInfo, data1, data2))
+    {
+        ReportCompactLight(lightInfo, false);
         return false;
+    }
 
-    u_RisLightDataBuffer[linearIndex * 2 + 0] = data1;
-    u_RisLightDataBuffer[linearIndex * 2 + 1] = data2;
+    u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE + 0] = data1;
+    u_RisLightDataBuffer[linearIndex * RIS_LIGHT_DATA_STRIDE + 1] = data2;
+#endif
 
+    ReportCompactLight(lightInfo, true);
     return true;
 }
 
@@ -846,6 +909,8 @@ bool RAB_TraceRayForLocalLight(float3 origin, float3 direction, float tMin, floa
     }
 #endif
 
+    ReportRay(hitAnything);
+
     if (o_lightIndex != RTXDI_InvalidLightIndex)
     {
         o_randXY = randomFromBarycentric(hitUVToBarycentric(hitUV));
@@ -36,6 +36,7 @@ void RayGen()
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
 
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams);
+    SetRayCountPixel(pixelPosition);
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
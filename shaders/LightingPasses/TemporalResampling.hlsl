@@ -35,6 +35,7 @@ void RayGen()
     const RTXDI_ResamplingRuntimeParameters params = g_Const.runtimeParams;
 
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, params);
+    SetRayCountPixel(pixelPosition);
 
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(pixelPosition, 2);
 
@@ -99,6 +99,33 @@ PolymorphicLightInfo unpackCompactLightInfo(const uint4 data1, const uint4 data2
     return lightInfo;
 }
 
+// The extended compact format stores the complete light info including the shaping data and IES profile index,
+// so unlike the basic format, it can represent spot lights.
+void packExtendedCompactLightInfo(PolymorphicLightInfo lightInfo, out uint4 res1, out uint4 res2, out uint4 res3)
+{
+    res1.xyz = asuint(lightInfo.center.xyz);
+    res1.w = lightInfo.colorTypeAndFlags;
+
+    res2.x = lightInfo.direction1;
+    res2.y = lightInfo.direction2;
+    res2.z = lightInfo.scalars;
+    res2.w = lightInfo.logRadiance;
+
+    res3.x = lightInfo.iesProfileIndex;
+    res3.y = lightInfo.primaryAxis;
+    res3.z = lightInfo.cosConeAngleAndSoftness;
+    res3.w = 0;
+}
+
+PolymorphicLightInfo unpackExtendedCompactLightInfo(const uint4 data1, const uint4 data2, const uint4 data3)
+{
+    PolymorphicLightInfo lightInfo = unpackCompactLightInfo(data1, data2);
+    lightInfo.iesProfileIndex = data3.x;
+    lightInfo.primaryAxis = data3.y;
+    lightInfo.cosConeAngleAndSoftness = data3.z;
+    return lightInfo;
+}
+
 // Computes estimated distance between a given point in space and a random point inside
 // a spherical volume. Since the geometry of this solution is spherically symmetric,
 // only the distance from the volume center to the point and the volume radius matter here.
@@ -115,8 +142,8 @@ float getAverageDistanceToVolume(float distanceToCenter, float volumeRadius)
 }
 
 
-// Note: Sphere lights always assume an interaction point is not going to be inside of the sphere, so special logic handling this case
-// can be avoided in sampling logic (for PDF/radiance calculation), as well as individual PDF calculation and radiance evaluation.
+// Note: Interaction points inside of the sphere, which happen with the emissive LOD proxies that enclose their emitters,
+// see the inner side of the sphere in all directions and use area sampling instead of the solid angle sampling.
 struct SphereLight
 {
     float3 position;
@@ -126,6 +153,38 @@ struct SphereLight
 
     // Interface methods
 
+    PolymorphicLightSample calcSampleInside(in const float2 random, in const float3 viewerPosition)
+    {
+        // Uniform sampling of the sphere area, the inner side faces the viewer
+
+        float unusedSolidAnglePdf;
+        const float3 radiusVector = sampleSphere(random, unusedSolidAnglePdf);
+        const float3 spherePositionSample = position + radius * radiusVector;
+
+        const float areaPdf = 1.0f / getSurfaceArea();
+        const float3 sampleVector = spherePositionSample - viewerPosition;
+        const float sampleDistance = length(sampleVector);
+        const float sampleCosTheta = (sampleDistance > 0.0f) ? dot(sampleVector, radiusVector) / sampleDistance : 0.0f;
+
+        PolymorphicLightSample lightSample;
+
+        lightSample.position = spherePositionSample;
+        lightSample.normal = -radiusVector;
+
+        if (sampleCosTheta <= 0.0f)
+        {
+            lightSample.radiance = float3(0.0f, 0.0f, 0.0f);
+            lightSample.solidAnglePdf = 0.0f;
+        }
+        else
+        {
+            lightSample.radiance = radiance;
+            lightSample.solidAnglePdf = pdfAtoW(areaPdf, sampleDistance, sampleCosTheta);
+        }
+
+        return lightSample;
+    }
+
     PolymorphicLightSample calcSample(in const float2 random, in const float3 viewerPosition)
     {
         const float3 lightVector = position - viewerPosition;
@@ -133,9 +192,10 @@ struct SphereLight
         const float lightDistance = sqrt(lightDistance2);
         const float radius2 = square(radius);
 
-        // Note: Sampling based on PBRT's solid angle sphere sampling, resulting in fewer rays occluded by the light itself,
-        // ignoring special case for when viewing inside the light (which should just use normal spherical area sampling)
-        // for performance. Similarly condition ignored in PDF calculation as well.
+        if (lightDistance2 <= radius2)
+            return calcSampleInside(random, viewerPosition);
+
+        // Note: Sampling based on PBRT's solid angle sphere sampling, resulting in fewer rays occluded by the light itself.
 
         // Compute theta and phi for cone sampling
 
@@ -209,7 +269,8 @@ struct SphereLight
         float distance = length(volumeCenter - position);
         distance = getAverageDistanceToVolume(distance, volumeRadius);
 
-        float sinHalfAngle = radius / distance;
+        // The volume may be inside the sphere, where the light covers the whole hemisphere
+        float sinHalfAngle = min(radius / distance, 1.0);
         float solidAngle = 2 * c_pi * (1.0 - sqrt(1.0 - square(sinHalfAngle)));
 
         return solidAngle * calcLuminance(radiance);
@@ -55,6 +55,21 @@
 #define RAY_COUNT_TRACED(index) ((index) * 2)
 #define RAY_COUNT_HITS(index) ((index) * 2 + 1)
 
+// Counters of the lights stored in the RIS buffers, located in the ray count buffer at
+// ResamplingConstants::compactLightCounterOffset. For each PolymorphicLightType, there is the number of
+// presampled RIS buffer slots and the number of those slots that were stored in the compact form.
+#define COMPACT_LIGHT_COUNTER_TYPES 8
+#define COMPACT_LIGHT_COUNT_TOTAL(offset, type) ((offset) + (type) * 2)
+#define COMPACT_LIGHT_COUNT_STORED(offset, type) ((offset) + (type) * 2 + 1)
+
+// Number of uint4 elements per RIS buffer slot in the RIS light data buffer.
+// The extended format also stores the shaping data, so that spot lights can be compacted.
+#define RIS_LIGHT_DATA_STRIDE 2
+#define RIS_LIGHT_DATA_STRIDE_EXTENDED 3
+
+// Size of the screen tiles with separate ray counters, see ResamplingConstants::enableRayCountTiles
+#define RAY_COUNT_TILE_SIZE 16
+
 #define REPORT_RAY(hit) if (g_PerPassConstants.rayCountBufferIndex >= 0) { \
     InterlockedAdd(u_RayCountBuffer[RAY_COUNT_TRACED(g_PerPassConstants.rayCountBufferIndex)], 1); \
     if (hit) InterlockedAdd(u_RayCountBuffer[RAY_COUNT_HITS(g_PerPassConstants.rayCountBufferIndex)], 1); }
@@ -165,6 +180,8 @@ struct FilterGradientsConstants
 struct ConfidenceConstants
 {
     uint2 viewportSize;
+    uint2 prevViewportSize;
+
     float2 invGradientTextureSize;
 
     float darknessBias;
@@ -281,6 +298,14 @@ struct ResamplingConstants
 
     uint giEnableFinalVisibility;
     uint giEnableFinalMIS;
+    uint compactLightCounterOffset; // 0 means that the compact light counters are disabled
+    uint enableRayCountTiles;
+
+    // Size of the per-tile ray counter grid of every pass. It covers the render targets, not the viewport,
+    // so that it doesn't change with the resolution scale.
+    uint rayCountTilesX;
+    uint rayCountTilesY;
+    uint2 rayCountTilesPadding;
 };
 
 struct PerPassConstants
@@ -0,0 +1,338 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BenchmarkResults.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+void BenchmarkResults::AddRunValue(const std::string& section, double value)
+{
+    for (auto& sectionResults : sections)
+    {
+        if (sectionResults.name == section)
+        {
+            sectionResults.runs.push_back(value);
+            return;
+        }
+    }
+
+    BenchmarkSectionResults& sectionResults = sections.emplace_back();
+    sectionResults.name = section;
+    sectionResults.runs.push_back(value);
+}
+
+const BenchmarkSectionResults* BenchmarkResults::FindSection(const std::string& name) const
+{
+    for (const auto& sectionResults : sections)
+    {
+        if (sectionResults.name == name)
+            return &sectionResults;
+    }
+
+    return nullptr;
+}
+
+BenchmarkTolerance BenchmarkResults::GetTolerance(const std::string& section) const
+{
+    auto it = tolerances.find(section);
+    return (it != tolerances.end()) ? it->second : defaultTolerance;
+}
+
+static std::vector<std::string> splitTabs(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t'))
+        fields.push_back(field);
+    return fields;
+}
+
+static bool parseDouble(const std::string& text, double& outValue)
+{
+    char* end = nullptr;
+    outValue = strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == 0;
+}
+
+bool LoadBenchmarkResults(const std::string& fileName, BenchmarkResults& outResults, std::string& outError)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+    {
+        outError = "Cannot open file '" + fileName + "'";
+        return false;
+    }
+
+    outResults = BenchmarkResults();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        const std::vector<std::string> fields = splitTabs(line);
+        const std::string location = fileName + "(" + std::to_string(lineNumber) + ")";
+
+        if (fields[0] == "renderer" && fields.size() <= 2)
+        {
+            outResults.renderer = (fields.size() == 2) ? fields[1] : "";
+        }
+        else if (fields[0] == "tolerance" && fields.size() == 4)
+        {
+            BenchmarkTolerance tolerance;
+            if (!parseDouble(fields[2], tolerance.relative) || !parseDouble(fields[3], tolerance.absolute))
+            {
+                outError = location + ": invalid tolerance value";
+                return false;
+            }
+
+            if (fields[1] == "*")
+                outResults.defaultTolerance = tolerance;
+            else
+                outResults.tolerances[fields[1]] = tolerance;
+        }
+        else if (fields[0] == "section" && fields.size() >= 3)
+        {
+            BenchmarkSectionResults& section = outResults.sections.emplace_back();
+            section.name = fields[1];
+
+            for (size_t index = 2; index < fields.size(); index++)
+            {
+                double value;
+                if (!parseDouble(fields[index], value))
+                {
+                    outError = location + ": invalid time value '" + fields[index] + "'";
+                    return false;
+                }
+                section.runs.push_back(value);
+            }
+
+            outResults.runCount = std::max(outResults.runCount, uint32_t(section.runs.size()));
+        }
+        else
+        {
+            outError = location + ": unrecognized line";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SaveBenchmarkResults(const std::string& fileName, const BenchmarkResults& results)
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    file << "# RTXDI benchmark results, times in milliseconds" << std::endl;
+    file << "renderer\t" << results.renderer << std::endl;
+
+    file << "tolerance\t*\t" << results.defaultTolerance.relative << "\t" << results.defaultTolerance.absolute << std::endl;
+    for (const auto& [section, tolerance] : results.tolerances)
+        file << "tolerance\t" << section << "\t" << tolerance.relative << "\t" << tolerance.absolute << std::endl;
+
+    file.precision(4);
+    for (const auto& section : results.sections)
+    {
+        file << "section\t" << section.name;
+        for (double value : section.runs)
+            file << "\t" << std::fixed << value;
+        file << std::endl;
+    }
+
+    return file.good();
+}
+
+static void computeMeanAndVariance(const std::vector<double>& values, double& outMean, double& outVariance)
+{
+    outMean = 0.0;
+    for (double value : values)
+        outMean += value;
+    outMean /= double(values.size());
+
+    outVariance = 0.0;
+    for (double value : values)
+        outVariance += (value - outMean) * (value - outMean);
+    outVariance = (values.size() > 1) ? outVariance / double(values.size() - 1) : 0.0;
+}
+
+// Continued fraction for the incomplete beta function, evaluated with the modified Lentz method
+static double incompleteBetaContinuedFraction(double a, double b, double x)
+{
+    const int maxIterations = 200;
+    const double epsilon = 1e-12;
+    const double tiny = 1e-300;
+
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    if (std::abs(d) < tiny) d = tiny;
+    d = 1.0 / d;
+    double result = d;
+
+    for (int m = 1; m <= maxIterations; m++)
+    {
+        const double m2 = 2.0 * m;
+
+        double coefficient = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+        d = 1.0 + coefficient * d;
+        if (std::abs(d) < tiny) d = tiny;
+        c = 1.0 + coefficient / c;
+        if (std::abs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        result *= d * c;
+
+        coefficient = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+        d = 1.0 + coefficient * d;
+        if (std::abs(d) < tiny) d = tiny;
+        c = 1.0 + coefficient / c;
+        if (std::abs(c) < tiny) c = tiny;
+        d = 1.0 / d;
+        const double delta = d * c;
+        result *= delta;
+
+        if (std::abs(delta - 1.0) < epsilon)
+            break;
+    }
+
+    return result;
+}
+
+// Regularized incomplete beta function I_x(a, b)
+static double regularizedIncompleteBeta(double a, double b, double x)
+{
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+
+    const double logFront = std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1.0 - x);
+    const double front = std::exp(logFront);
+
+    // The continued fraction converges quickly only on one side of the mean
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return front * incompleteBetaContinuedFraction(a, b, x) / a;
+
+    return 1.0 - front * incompleteBetaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// Probability that a Student's t variable with the given degrees of freedom exceeds t
+static double studentTUpperTail(double t, double degreesOfFreedom)
+{
+    const double tail = 0.5 * regularizedIncompleteBeta(0.5 * degreesOfFreedom, 0.5, degreesOfFreedom / (degreesOfFreedom + t * t));
+    return (t > 0.0) ? tail : 1.0 - tail;
+}
+
+std::vector<BenchmarkSectionComparison> CompareBenchmarkResults(
+    const BenchmarkResults& baseline,
+    const BenchmarkResults& current,
+    double significanceLevel)
+{
+    std::vector<BenchmarkSectionComparison> comparison;
+
+    for (const auto& baselineSection : baseline.sections)
+    {
+        const BenchmarkSectionResults* currentSection = current.FindSection(baselineSection.name);
+        if (!currentSection || baselineSection.runs.empty() || currentSection->runs.empty())
+            continue;
+
+        BenchmarkSectionComparison& result = comparison.emplace_back();
+        result.name = baselineSection.name;
+        result.baselineRuns = baselineSection.runs.size();
+        result.currentRuns = currentSection->runs.size();
+
+        double baselineVariance, currentVariance;
+        computeMeanAndVariance(baselineSection.runs, result.baselineMean, baselineVariance);
+        computeMeanAndVariance(currentSection->runs, result.currentMean, currentVariance);
+
+        const BenchmarkTolerance tolerance = baseline.GetTolerance(baselineSection.name);
+        result.threshold = result.baselineMean * (1.0 + tolerance.relative) + tolerance.absolute;
+
+        const bool exceedsThreshold = result.currentMean > result.threshold;
+
+        if (result.baselineRuns >= 2 && result.currentRuns >= 2)
+        {
+            // Welch's t-test, which doesn't assume equal variances of the two sets of runs
+            const double baselineError = baselineVariance / double(result.baselineRuns);
+            const double currentError = currentVariance / double(result.currentRuns);
+            const double standardError = std::sqrt(baselineError + currentError);
+
+            if (standardError > 0.0)
+            {
+                const double t = (result.currentMean - result.baselineMean) / standardError;
+                const double degreesOfFreedom = (baselineError + currentError) * (baselineError + currentError) /
+                    (baselineError * baselineError / double(result.baselineRuns - 1) +
+                     currentError * currentError / double(result.currentRuns - 1));
+
+                result.pValue = studentTUpperTail(t, degreesOfFreedom);
+            }
+            else
+            {
+                result.pValue = (result.currentMean > result.baselineMean) ? 0.0 : 1.0;
+            }
+
+            result.significanceTested = true;
+            result.regression = exceedsThreshold && result.pValue < significanceLevel;
+        }
+        else
+        {
+            result.regression = exceedsThreshold;
+        }
+    }
+
+    return comparison;
+}
+
+std::string FormatBenchmarkComparison(const std::vector<BenchmarkSectionComparison>& comparison)
+{
+    std::stringstream text;
+    text.precision(3);
+
+    int regressions = 0;
+    for (const auto& result : comparison)
+    {
+        const double change = (result.baselineMean > 0.0)
+            ? 100.0 * (result.currentMean - result.baselineMean) / result.baselineMean
+            : 0.0;
+
+        text << (result.regression ? "REGRESSION " : "           ") << result.name << ": " << std::fixed
+            << result.baselineMean << " ms -> " << result.currentMean << " ms (";
+        text.precision(1);
+        text << std::showpos << change << std::noshowpos << "%, threshold ";
+        text.precision(3);
+        text << result.threshold << " ms";
+
+        if (result.significanceTested)
+            text << ", p = " << result.pValue;
+        else
+            text << ", not enough runs for a significance test";
+
+        text << ")" << std::endl;
+
+        if (result.regression)
+            regressions++;
+    }
+
+    text << regressions << " of " << comparison.size() << " sections regressed" << std::endl;
+
+    return text.str();
+}
@@ -0,0 +1,88 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Results of one or more runs of the benchmark animation, and their comparison against a baseline.
+// This file only depends on the standard library so that the results can be compared on machines
+// without a GPU, see tools/benchmark-compare.
+//
+// The results are stored in a tab-separated text file:
+//
+//   renderer    <renderer string>
+//   tolerance   <section name or *>    <relative tolerance>    <absolute tolerance, ms>
+//   section     <section name>    <mean time of run 1, ms>    <mean time of run 2, ms>    ...
+//
+// Lines starting with '#' are comments. Tolerance lines are only meaningful in baseline files,
+// and the '*' tolerance applies to all sections that don't have their own.
+
+struct BenchmarkTolerance
+{
+    // A section regresses when its mean time exceeds baseline * (1 + relative) + absolute
+    double relative = 0.05;
+    double absolute = 0.02;
+};
+
+struct BenchmarkSectionResults
+{
+    std::string name;
+
+    // Mean time of the section in every run, in milliseconds
+    std::vector<double> runs;
+};
+
+struct BenchmarkResults
+{
+    std::string renderer;
+    uint32_t runCount = 0;
+    std::vector<BenchmarkSectionResults> sections;
+
+    BenchmarkTolerance defaultTolerance;
+    std::map<std::string, BenchmarkTolerance> tolerances;
+
+    void AddRunValue(const std::string& section, double value);
+    [[nodiscard]] const BenchmarkSectionResults* FindSection(const std::string& name) const;
+    [[nodiscard]] BenchmarkTolerance GetTolerance(const std::string& section) const;
+};
+
+struct BenchmarkSectionComparison
+{
+    std::string name;
+    double baselineMean = 0.0;
+    double currentMean = 0.0;
+    size_t baselineRuns = 0;
+    size_t currentRuns = 0;
+    double threshold = 0.0;
+
+    // One-sided p-value of Welch's t-test for the hypothesis that the current runs are slower.
+    // Only valid when both sides have at least two runs.
+    double pValue = 1.0;
+    bool significanceTested = false;
+
+    bool regression = false;
+};
+
+bool LoadBenchmarkResults(const std::string& fileName, BenchmarkResults& outResults, std::string& outError);
+bool SaveBenchmarkResults(const std::string& fileName, const BenchmarkResults& results);
+
+// Compares every section present in both result sets. A section is reported as a regression when
+// its mean exceeds the tolerance of the baseline and, if there are enough runs to test it,
+// the slowdown is statistically significant at the given level.
+std::vector<BenchmarkSectionComparison> CompareBenchmarkResults(
+    const BenchmarkResults& baseline,
+    const BenchmarkResults& current,
+    double significanceLevel);
+
+std::string FormatBenchmarkComparison(const std::vector<BenchmarkSectionComparison>& comparison);
@@ -94,6 +94,7 @@ void ConfidencePass::CreateBindingSet(const RenderTargets& renderTargets)
 void ConfidencePass::Render(
     nvrhi::ICommandList* commandList, 
     const donut::engine::IView& view,
+    const donut::engine::IView& previousView,
     float logDarknessBias,
     float sensitivity,
     float historyLength,
@@ -105,6 +106,7 @@ void ConfidencePass::Render(
 
     ConfidenceConstants constants = {};
     constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
+    constants.prevViewportSize = dm::uint2(previousView.GetViewExtent().width(), previousView.GetViewExtent().height());
     constants.invGradientTextureSize.x = 1.f / float(gradientsDesc.width);
     constants.invGradientTextureSize.y = 1.f / float(gradientsDesc.height);
     constants.darknessBias = ::exp2f(logDarknessBias);
@@ -48,6 +48,7 @@ public:
     void Render(
         nvrhi::ICommandList* commandList,
         const donut::engine::IView& view,
+        const donut::engine::IView& previousView,
         float logDarknessBias,
         float sensitivity,
         float historyLength,
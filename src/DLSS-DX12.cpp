@@ -175,6 +175,15 @@ public:
         }
     }
 
+    uint64_t GetFeatureMemorySize() const override
+    {
+        unsigned long long vramAllocatedBytes = 0;
+        if (NGX_DLSS_GET_STATS(m_Parameters, &vramAllocatedBytes) != NVSDK_NGX_Result_Success)
+            return 0;
+
+        return uint64_t(vramAllocatedBytes);
+    }
+
     ~DLSS_DX12() override
     {
         if (m_DlssHandle)
@@ -12,6 +12,7 @@
 
 #include "DLSS.h"
 #include "RenderTargets.h"
+#include "GpuMemoryRegistry.h"
 #include <donut/engine/ShaderFactory.h>
 
 using namespace donut;
@@ -50,6 +51,17 @@ DLSS::DLSS(nvrhi::IDevice* device, donut::engine::ShaderFactory& shaderFactory)
     m_FeatureCommandList = device->createCommandList();
 }
 
+void DLSS::RegisterMemory(GpuMemoryRegistry& registry) const
+{
+    const char* owner = "DLSS";
+    registry.RemoveOwner(owner);
+
+    registry.AddTexture(owner, m_ExposureTexture);
+
+    if (IsAvailable())
+        registry.AddOpaque(owner, "DLSS Feature", GetFeatureMemorySize());
+}
+
 void DLSS::ComputeExposure(nvrhi::ICommandList* commandList, nvrhi::IBuffer* toneMapperExposureBuffer, float exposureScale)
 {
     if (m_ExposureSourceBuffer != toneMapperExposureBuffer)
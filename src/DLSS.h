@@ -16,6 +16,7 @@
 #include <nvrhi/nvrhi.h>
 
 class RenderTargets;
+class GpuMemoryRegistry;
 
 namespace donut::engine
 {
@@ -76,6 +77,11 @@ public:
         const donut::engine::PlanarView& view,
         const donut::engine::PlanarView& viewPrev) = 0;
 
+    // Video memory allocated by the DLSS feature itself, if the runtime reports it
+    [[nodiscard]] virtual uint64_t GetFeatureMemorySize() const { return 0; }
+
+    void RegisterMemory(GpuMemoryRegistry& registry) const;
+
     virtual ~DLSS() = default;
 
 #if defined(USE_DX12)
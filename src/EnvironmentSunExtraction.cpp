@@ -0,0 +1,283 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentSunExtraction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace donut::math;
+
+static float fp16ToFp32(uint16_t value)
+{
+    uint32_t sign = (value >> 15) & 1;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    float result;
+    if (exponent == 0)
+        result = ldexpf(float(mantissa), -24);
+    else if (exponent == 0x1f)
+        result = mantissa ? NAN : INFINITY;
+    else
+        result = ldexpf(float(mantissa | 0x400), int(exponent) - 25);
+
+    return sign ? -result : result;
+}
+
+static float calcLuminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Same mapping as equirectUVToDirection in HelperFunctions.hlsli
+static float3 equirectUVToDirection(float2 uv)
+{
+    float azimuth = (uv.x + 0.25f) * (2.f * PI_f);
+    float elevation = (0.5f - uv.y) * PI_f;
+    float cosElevation = cosf(elevation);
+
+    return float3(
+        cosf(azimuth) * cosElevation,
+        sinf(elevation),
+        sinf(azimuth) * cosElevation);
+}
+
+// Same mapping as directionToEquirectUV in HelperFunctions.hlsli
+static float2 directionToEquirectUV(float3 direction)
+{
+    float elevation = asinf(clamp(direction.y, -1.f, 1.f));
+    float azimuth = 0.f;
+    if (fabsf(direction.y) < 1.f)
+        azimuth = atan2f(direction.z, direction.x);
+
+    float2 uv;
+    uv.x = azimuth / (2.f * PI_f) - 0.25f;
+    uv.y = 0.5f - elevation / PI_f;
+    uv.x -= floorf(uv.x);
+
+    return uv;
+}
+
+// Solid angle of one pixel in the given row of an equirectangular map
+static float pixelSolidAngle(uint32_t y, uint32_t width, uint32_t height)
+{
+    float elevation = (0.5f - (float(y) + 0.5f) / float(height)) * PI_f;
+    return (2.f * PI_f / float(width)) * (PI_f / float(height)) * cosf(elevation);
+}
+
+static float3 pixelDirection(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    return equirectUVToDirection(float2((float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height)));
+}
+
+static bool isValidColor(float3 color)
+{
+    return std::isfinite(color.x) && std::isfinite(color.y) && std::isfinite(color.z);
+}
+
+bool UnpackEnvironmentMapPixels(
+    const void* data,
+    size_t rowPitch,
+    nvrhi::Format format,
+    uint32_t width,
+    uint32_t height,
+    std::vector<float4>& outPixels)
+{
+    outPixels.resize(size_t(width) * height);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = static_cast<const uint8_t*>(data) + y * rowPitch;
+        float4* dest = outPixels.data() + size_t(y) * width;
+
+        switch (format)
+        {
+        case nvrhi::Format::RGBA32_FLOAT:
+            memcpy(dest, row, width * sizeof(float4));
+            break;
+
+        case nvrhi::Format::RGBA16_FLOAT: {
+            const uint16_t* src = reinterpret_cast<const uint16_t*>(row);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                dest[x] = float4(
+                    fp16ToFp32(src[x * 4 + 0]),
+                    fp16ToFp32(src[x * 4 + 1]),
+                    fp16ToFp32(src[x * 4 + 2]),
+                    fp16ToFp32(src[x * 4 + 3]));
+            }
+            break;
+        }
+
+        default:
+            outPixels.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ExtractSunFromEnvironmentMap(
+    std::vector<float4>& pixels,
+    uint32_t width,
+    uint32_t height,
+    const SunExtractionParameters& params,
+    ExtractedSun& outSun)
+{
+    if (width == 0 || height == 0 || pixels.size() != size_t(width) * height)
+        return false;
+
+    // Find the peak and the average luminance of the map
+    float peakLuminance = 0.f;
+    uint32_t peakX = 0;
+    uint32_t peakY = 0;
+    double luminanceIntegral = 0.0;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        float solidAngle = pixelSolidAngle(y, width, height);
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float3 color = pixels[size_t(y) * width + x].xyz();
+            if (!isValidColor(color))
+                continue;
+
+            float luminance = calcLuminance(color);
+            luminanceIntegral += double(luminance) * solidAngle;
+
+            if (luminance > peakLuminance)
+            {
+                peakLuminance = luminance;
+                peakX = x;
+                peakY = y;
+            }
+        }
+    }
+
+    float averageLuminance = float(luminanceIntegral / (4.0 * PI_d));
+    if (peakLuminance <= 0.f || peakLuminance < averageLuminance * params.minPeakToAverageRatio)
+        return false;
+
+    const float3 peakDirection = pixelDirection(peakX, peakY, width, height);
+    const float maxRadius = radians(params.maxAngularRadius);
+    const float cosSunRadius = cosf(maxRadius);
+    const float cosBackgroundRadius = cosf(std::min(maxRadius * 2.f, PI_f));
+    const float sunThreshold = peakLuminance * params.peakLuminanceFraction;
+
+    // Only the rows that intersect the background ring around the peak need to be visited
+    const float peakElevation = (0.5f - (float(peakY) + 0.5f) / float(height)) * PI_f;
+    const float minElevation = std::max(peakElevation - maxRadius * 2.f, -0.5f * PI_f);
+    const float maxElevation = std::min(peakElevation + maxRadius * 2.f, 0.5f * PI_f);
+    const uint32_t firstRow = uint32_t(clamp(floorf((0.5f - maxElevation / PI_f) * float(height)), 0.f, float(height - 1)));
+    const uint32_t lastRow = uint32_t(clamp(ceilf((0.5f - minElevation / PI_f) * float(height)), 0.f, float(height - 1)));
+
+    // Estimate the sky radiance behind the sun from a ring around the sun disk
+    double3 backgroundSum = 0.0;
+    double backgroundSolidAngle = 0.0;
+
+    for (uint32_t y = firstRow; y <= lastRow; y++)
+    {
+        float solidAngle = pixelSolidAngle(y, width, height);
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float cosAngle = dot(pixelDirection(x, y, width, height), peakDirection);
+            if (cosAngle > cosSunRadius || cosAngle < cosBackgroundRadius)
+                continue;
+
+            float3 color = pixels[size_t(y) * width + x].xyz();
+            if (!isValidColor(color) || calcLuminance(color) >= sunThreshold)
+                continue;
+
+            backgroundSum += double3(color) * double(solidAngle);
+            backgroundSolidAngle += solidAngle;
+        }
+    }
+
+    const float3 background = (backgroundSolidAngle > 0.0)
+        ? float3(backgroundSum / backgroundSolidAngle)
+        : float3(0.f);
+
+    // Move the energy above the background out of the sun pixels
+    double3 sunIrradiance = 0.0;
+    double3 weightedDirection = 0.0;
+    double sunSolidAngle = 0.0;
+
+    for (uint32_t y = firstRow; y <= lastRow; y++)
+    {
+        float solidAngle = pixelSolidAngle(y, width, height);
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float3 direction = pixelDirection(x, y, width, height);
+            if (dot(direction, peakDirection) < cosSunRadius)
+                continue;
+
+            float4& pixel = pixels[size_t(y) * width + x];
+            float3 color = pixel.xyz();
+            if (!isValidColor(color) || calcLuminance(color) < sunThreshold)
+                continue;
+
+            float3 excess = max(color - background, float3(0.f));
+            float3 residual = color - excess;
+            pixel = float4(residual, pixel.w);
+
+            sunIrradiance += double3(excess) * double(solidAngle);
+            weightedDirection += double3(direction) * (double(calcLuminance(excess)) * double(solidAngle));
+            sunSolidAngle += solidAngle;
+        }
+    }
+
+    const float sunLuminance = calcLuminance(float3(sunIrradiance));
+    if (sunLuminance <= 0.f || sunSolidAngle <= 0.0)
+        return false;
+
+    float3 sunDirection = normalize(float3(weightedDirection));
+    float halfAngle = acosf(clamp(1.f - float(sunSolidAngle / (2.0 * PI_d)), -1.f, 1.f));
+
+    outSun.uv = directionToEquirectUV(sunDirection);
+    outSun.color = float3(sunIrradiance) / sunLuminance;
+    outSun.irradiance = sunLuminance;
+    outSun.angularSize = degrees(halfAngle * 2.f);
+    outSun.solidAngle = float(sunSolidAngle);
+
+    return true;
+}
+
+double3 ComputeEnvironmentMapRadianceIntegral(
+    const std::vector<float4>& pixels,
+    uint32_t width,
+    uint32_t height)
+{
+    double3 integral = 0.0;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        float solidAngle = pixelSolidAngle(y, width, height);
+
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float3 color = pixels[size_t(y) * width + x].xyz();
+            if (isValidColor(color))
+                integral += double3(color) * double(solidAngle);
+        }
+    }
+
+    return integral;
+}
+
+float3 GetExtractedSunDirection(const ExtractedSun& sun, float rotation)
+{
+    return equirectUVToDirection(float2(sun.uv.x + rotation, sun.uv.y));
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <vector>
+
+// Separates a dominant sun from an equirectangular environment map on the CPU.
+// The sun is replaced in the map by the sky around it, and its energy is returned
+// as an analytic directional light, so that the sum of the two matches the original map.
+
+struct SunExtractionParameters
+{
+    // The brightest pixel must be at least this many times brighter than the average
+    // luminance of the map for it to be considered a sun.
+    float minPeakToAverageRatio = 100.f;
+
+    // Pixels with luminance above this fraction of the peak luminance belong to the sun.
+    float peakLuminanceFraction = 0.02f;
+
+    // Maximum angular radius of the sun disk around the peak, in degrees.
+    float maxAngularRadius = 4.f;
+};
+
+struct ExtractedSun
+{
+    // Position of the sun center in the texture, in UV space.
+    dm::float2 uv = 0.f;
+
+    // Color of the sun, normalized to unit luminance.
+    dm::float3 color = 0.f;
+
+    // Luminance of the sun irradiance at normal incidence, same units as DirectionalLight::irradiance.
+    float irradiance = 0.f;
+
+    // Full angular size of the sun disk, in degrees.
+    float angularSize = 0.f;
+
+    // Solid angle covered by the extracted pixels, in steradians.
+    float solidAngle = 0.f;
+};
+
+// Converts the mapped contents of an RGBA16_FLOAT or RGBA32_FLOAT texture into float4 pixels.
+// Returns false if the format is not supported.
+bool UnpackEnvironmentMapPixels(
+    const void* data,
+    size_t rowPitch,
+    nvrhi::Format format,
+    uint32_t width,
+    uint32_t height,
+    std::vector<dm::float4>& outPixels);
+
+// Finds the sun in the environment map and moves its energy out of 'pixels' into 'outSun'.
+// Returns false and leaves 'pixels' unchanged if the map has no dominant peak.
+bool ExtractSunFromEnvironmentMap(
+    std::vector<dm::float4>& pixels,
+    uint32_t width,
+    uint32_t height,
+    const SunExtractionParameters& params,
+    ExtractedSun& outSun);
+
+// Computes the integral of radiance over the sphere, i.e. the irradiance that the map would
+// deliver to a sphere of unit cross-section. Used to verify that extraction preserves energy:
+// the integral of the original map equals the integral of the residual map plus the sun irradiance,
+// which tools/checks/SunExtractionCheck.cpp verifies on synthetic maps.
+dm::double3 ComputeEnvironmentMapRadianceIntegral(
+    const std::vector<dm::float4>& pixels,
+    uint32_t width,
+    uint32_t height);
+
+// Returns the world-space direction towards the sun, taking the environment map rotation into account.
+// The rotation is measured in full turns, same as EnvironmentLight::rotation.
+dm::float3 GetExtractedSunDirection(const ExtractedSun& sun, float rotation);
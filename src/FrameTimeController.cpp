@@ -0,0 +1,224 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameTimeController.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool FrameTimeControllerSettings::operator==(const FrameTimeControllerSettings& other) const
+{
+    return numPrimaryLocalLightSamples == other.numPrimaryLocalLightSamples
+        && numPrimaryRegirSamples == other.numPrimaryRegirSamples
+        && numSpatialSamples == other.numSpatialSamples
+        && numDisocclusionBoostSamples == other.numDisocclusionBoostSamples
+        && resolutionScale == other.resolutionScale;
+}
+
+// The settings in the order in which they are reduced, the cheapest quality loss first
+enum class ControlledSetting
+{
+    DisocclusionBoostSamples,
+    SpatialSamples,
+    LocalLightSamples,
+    RegirSamples,
+    ResolutionScale,
+
+    Count
+};
+
+// Removes about a quarter of the samples, but at least one
+static bool ReduceSampleCount(uint32_t& count, uint32_t minCount)
+{
+    if (count <= minCount)
+        return false;
+
+    count = std::max(minCount, count - std::max(1u, count / 4));
+    return true;
+}
+
+static bool ReduceSetting(FrameTimeControllerSettings& settings, ControlledSetting setting, const FrameTimeControllerParameters& params)
+{
+    switch (setting)
+    {
+    case ControlledSetting::DisocclusionBoostSamples:
+        if (settings.numDisocclusionBoostSamples <= params.minDisocclusionBoostSamples)
+            return false;
+        settings.numDisocclusionBoostSamples = std::max(params.minDisocclusionBoostSamples, settings.numDisocclusionBoostSamples / 2);
+        return true;
+
+    case ControlledSetting::SpatialSamples:
+        if (settings.numSpatialSamples <= params.minSpatialSamples)
+            return false;
+        settings.numSpatialSamples--;
+        return true;
+
+    case ControlledSetting::LocalLightSamples:
+        return ReduceSampleCount(settings.numPrimaryLocalLightSamples, params.minLocalLightSamples);
+
+    case ControlledSetting::RegirSamples:
+        return ReduceSampleCount(settings.numPrimaryRegirSamples, params.minRegirSamples);
+
+    case ControlledSetting::ResolutionScale: {
+        if (params.resolutionScaleStep <= 0.f || settings.resolutionScale <= params.minResolutionScale + 1e-4f)
+            return false;
+        // Round to avoid accumulating the error of the decimal step
+        const float scale = std::round((settings.resolutionScale - params.resolutionScaleStep) * 1000.f) * 0.001f;
+        settings.resolutionScale = std::max(params.minResolutionScale, scale);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+FrameTimeController::FrameTimeController()
+{
+    Reset(FrameTimeControllerSettings());
+}
+
+void FrameTimeController::SetParameters(const FrameTimeControllerParameters& parameters)
+{
+    m_Parameters = parameters;
+
+    // The limits might have changed, keep the state but rebuild the ladder
+    const FrameTimeControllerSettings baseSettings = m_Levels[0];
+    BuildLevels(baseSettings);
+    m_Level = std::min(m_Level, GetLevelCount() - 1);
+}
+
+void FrameTimeController::BuildLevels(const FrameTimeControllerSettings& baseSettings)
+{
+    m_Levels.clear();
+    m_Levels.push_back(baseSettings);
+
+    FrameTimeControllerSettings settings = baseSettings;
+    uint32_t nextSetting = 0;
+    constexpr uint32_t settingCount = uint32_t(ControlledSetting::Count);
+
+    while (true)
+    {
+        bool reduced = false;
+        for (uint32_t attempt = 0; attempt < settingCount && !reduced; attempt++)
+        {
+            const uint32_t setting = (nextSetting + attempt) % settingCount;
+            if (ReduceSetting(settings, ControlledSetting(setting), m_Parameters))
+            {
+                nextSetting = setting + 1;
+                reduced = true;
+            }
+        }
+
+        if (!reduced)
+            break;
+
+        m_Levels.push_back(settings);
+    }
+}
+
+void FrameTimeController::Reset(const FrameTimeControllerSettings& baseSettings)
+{
+    BuildLevels(baseSettings);
+
+    m_Level = 0;
+    m_SmoothedFrameTimeMs = 0.0;
+    m_SmoothedFrameTimeValid = false;
+    m_FramesSinceChange = 0;
+    m_FramesBelowTarget = 0;
+    m_FramesSinceUpgrade = ~0u;
+    m_UpgradeBackoff = 1;
+    m_ChangeCount = 0;
+}
+
+void FrameTimeController::SetLevel(uint32_t level)
+{
+    m_Level = level;
+    m_FramesSinceChange = 0;
+    m_FramesBelowTarget = 0;
+    m_SmoothedFrameTimeValid = false;
+    m_ChangeCount++;
+}
+
+// Number of levels to move for a relative distance from the dead band, one step per twice the hysteresis
+uint32_t FrameTimeController::GetStepCount(double distance) const
+{
+    const double stepSize = std::max(0.01, 2.0 * double(m_Parameters.hysteresis));
+    return 1 + uint32_t(std::clamp(distance / stepSize, 0.0, double(c_MaxStepsPerChange - 1)));
+}
+
+bool FrameTimeController::Update(double frameTimeMs)
+{
+    const FrameTimeControllerParameters& params = m_Parameters;
+
+    if (m_FramesSinceUpgrade != ~0u)
+    {
+        m_FramesSinceUpgrade++;
+
+        // The last upgrade has held for as long as it took to try it, allow the next ones to happen sooner
+        if (m_FramesSinceUpgrade == params.settleFrames + params.upgradeFrames * m_UpgradeBackoff)
+            m_UpgradeBackoff = std::max(1u, m_UpgradeBackoff / 2);
+    }
+
+    // Ignore the frames that were rendered or measured with the previous settings
+    if (m_FramesSinceChange < params.settleFrames)
+    {
+        m_FramesSinceChange++;
+        return false;
+    }
+
+    if (m_SmoothedFrameTimeValid)
+        m_SmoothedFrameTimeMs += (frameTimeMs - m_SmoothedFrameTimeMs) * double(params.smoothingFactor);
+    else
+        m_SmoothedFrameTimeMs = frameTimeMs;
+    m_SmoothedFrameTimeValid = true;
+
+    const double target = double(params.targetFrameTimeMs);
+    const double upperLimit = target * (1.0 + params.hysteresis);
+    const double lowerLimit = target * (1.0 - params.hysteresis);
+
+    if (m_SmoothedFrameTimeMs > upperLimit)
+    {
+        m_FramesBelowTarget = 0;
+
+        if (m_Level + 1 >= GetLevelCount())
+            return false;
+
+        // Going down right after going up means that the upgrade didn't fit into the budget,
+        // so wait longer before trying it again. This is what prevents oscillation between two levels.
+        if (m_FramesSinceUpgrade < params.settleFrames + params.upgradeFrames * m_UpgradeBackoff)
+            m_UpgradeBackoff = std::min(params.maxUpgradeBackoff, m_UpgradeBackoff * 2);
+        m_FramesSinceUpgrade = ~0u;
+
+        // Take larger steps when far over budget, e.g. after a camera cut
+        const uint32_t steps = GetStepCount(m_SmoothedFrameTimeMs / upperLimit - 1.0);
+        SetLevel(std::min(m_Level + steps, GetLevelCount() - 1));
+        return true;
+    }
+
+    if (m_SmoothedFrameTimeMs < lowerLimit && m_Level > 0)
+    {
+        m_FramesBelowTarget++;
+
+        if (m_FramesBelowTarget >= params.upgradeFrames * m_UpgradeBackoff)
+        {
+            // Recover faster when far under budget, but only while the upgrades don't fail
+            const uint32_t steps = (m_UpgradeBackoff == 1) ? GetStepCount(1.0 - m_SmoothedFrameTimeMs / lowerLimit) : 1;
+            SetLevel(m_Level - std::min(m_Level, steps));
+            m_FramesSinceUpgrade = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    m_FramesBelowTarget = 0;
+    return false;
+}
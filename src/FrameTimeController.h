@@ -0,0 +1,104 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Quality settings adjusted by the frame time controller,
+// mirrors the fields of LightingPasses::RenderSettings and UIData with the same names.
+struct FrameTimeControllerSettings
+{
+    uint32_t numPrimaryLocalLightSamples = 8;
+    uint32_t numPrimaryRegirSamples = 8;
+    uint32_t numSpatialSamples = 1;
+    uint32_t numDisocclusionBoostSamples = 8;
+    float resolutionScale = 1.f;
+
+    bool operator==(const FrameTimeControllerSettings& other) const;
+    bool operator!=(const FrameTimeControllerSettings& other) const { return !(*this == other); }
+};
+
+struct FrameTimeControllerParameters
+{
+    float targetFrameTimeMs = 16.667f;
+
+    // Relative dead band around the target: the settings don't change while the smoothed
+    // frame time is within [target * (1 - hysteresis), target * (1 + hysteresis)].
+    float hysteresis = 0.08f;
+
+    // Weight of the newest frame in the exponential moving average of the frame time
+    float smoothingFactor = 0.1f;
+
+    // Frames that are ignored after every change, they cover the profiler readback latency
+    // and let the temporal passes settle with the new settings.
+    uint32_t settleFrames = 8;
+
+    // Frames the smoothed time must stay below the dead band before the quality is increased.
+    // This is doubled every time an increase has to be reverted right away, up to maxUpgradeBackoff times.
+    uint32_t upgradeFrames = 30;
+    uint32_t maxUpgradeBackoff = 16;
+
+    // Lower limits of the settings, the upper limits are the base settings passed to Reset
+    uint32_t minLocalLightSamples = 1;
+    uint32_t minRegirSamples = 1;
+    uint32_t minSpatialSamples = 1;
+    uint32_t minDisocclusionBoostSamples = 0;
+    float minResolutionScale = 0.5f;
+    float resolutionScaleStep = 0.05f;
+};
+
+// A closed-loop controller that holds a target GPU frame time by walking a ladder of quality levels.
+// Level 0 holds the base settings, and every following level reduces one of the settings by one step,
+// round-robin, so that the quality degrades evenly. The controller only depends on the measured frame times,
+// which makes it possible to replay recorded traces through it, see tools/checks/FrameTimeCheck.cpp.
+class FrameTimeController
+{
+private:
+    static constexpr uint32_t c_MaxStepsPerChange = 4;
+
+    FrameTimeControllerParameters m_Parameters;
+    std::vector<FrameTimeControllerSettings> m_Levels;
+    uint32_t m_Level = 0;
+
+    double m_SmoothedFrameTimeMs = 0.0;
+    bool m_SmoothedFrameTimeValid = false;
+    uint32_t m_FramesSinceChange = 0;
+    uint32_t m_FramesBelowTarget = 0;
+
+    // Number of frames after an upgrade during which a downgrade counts as a failed upgrade
+    uint32_t m_FramesSinceUpgrade = ~0u;
+    uint32_t m_UpgradeBackoff = 1;
+    uint32_t m_ChangeCount = 0;
+
+    void BuildLevels(const FrameTimeControllerSettings& baseSettings);
+    void SetLevel(uint32_t level);
+    [[nodiscard]] uint32_t GetStepCount(double distance) const;
+
+public:
+    FrameTimeController();
+
+    void SetParameters(const FrameTimeControllerParameters& parameters);
+    [[nodiscard]] const FrameTimeControllerParameters& GetParameters() const { return m_Parameters; }
+
+    // Builds the quality ladder with the base settings as the highest quality and restarts at level 0
+    void Reset(const FrameTimeControllerSettings& baseSettings);
+
+    // Feeds the measured GPU time of one frame. Returns true when the settings have changed.
+    bool Update(double frameTimeMs);
+
+    [[nodiscard]] const FrameTimeControllerSettings& GetSettings() const { return m_Levels[m_Level]; }
+    [[nodiscard]] uint32_t GetLevel() const { return m_Level; }
+    [[nodiscard]] uint32_t GetLevelCount() const { return uint32_t(m_Levels.size()); }
+    [[nodiscard]] const FrameTimeControllerSettings& GetLevelSettings(uint32_t level) const { return m_Levels[level]; }
+    [[nodiscard]] double GetSmoothedFrameTime() const { return m_SmoothedFrameTimeMs; }
+    [[nodiscard]] uint32_t GetChangeCount() const { return m_ChangeCount; }
+};
@@ -0,0 +1,250 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "GpuMemoryRegistry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+void GpuMemoryRegistry::RemoveOwner(const std::string& owner)
+{
+    m_Allocations.erase(std::remove_if(m_Allocations.begin(), m_Allocations.end(),
+        [&owner](const GpuMemoryAllocation& allocation) { return allocation.owner == owner; }),
+        m_Allocations.end());
+}
+
+void GpuMemoryRegistry::AddBuffer(const std::string& owner, const nvrhi::BufferDesc& desc)
+{
+    GpuMemoryAllocation allocation;
+    allocation.owner = owner;
+    allocation.name = desc.debugName;
+    allocation.format = desc.format;
+    allocation.structStride = desc.structStride;
+    allocation.byteSize = GetBufferSize(desc);
+    m_Allocations.push_back(std::move(allocation));
+}
+
+void GpuMemoryRegistry::AddTexture(const std::string& owner, const nvrhi::TextureDesc& desc)
+{
+    GpuMemoryAllocation allocation;
+    allocation.owner = owner;
+    allocation.name = desc.debugName;
+    allocation.isTexture = true;
+    allocation.format = desc.format;
+    allocation.width = desc.width;
+    allocation.height = desc.height;
+    allocation.depthOrArraySize = (desc.dimension == nvrhi::TextureDimension::Texture3D) ? desc.depth : desc.arraySize;
+    allocation.mipLevels = desc.mipLevels;
+    allocation.byteSize = GetTextureSize(desc);
+    m_Allocations.push_back(std::move(allocation));
+}
+
+void GpuMemoryRegistry::AddBuffer(const std::string& owner, nvrhi::IBuffer* buffer)
+{
+    if (buffer)
+        AddBuffer(owner, buffer->getDesc());
+}
+
+void GpuMemoryRegistry::AddTexture(const std::string& owner, nvrhi::ITexture* texture)
+{
+    if (texture)
+        AddTexture(owner, texture->getDesc());
+}
+
+void GpuMemoryRegistry::AddOpaque(const std::string& owner, const std::string& name, uint64_t byteSize)
+{
+    GpuMemoryAllocation allocation;
+    allocation.owner = owner;
+    allocation.name = name;
+    allocation.byteSize = byteSize;
+    m_Allocations.push_back(std::move(allocation));
+}
+
+uint64_t GpuMemoryRegistry::GetTotalSize() const
+{
+    uint64_t total = 0;
+    for (const GpuMemoryAllocation& allocation : m_Allocations)
+        total += allocation.byteSize;
+    return total;
+}
+
+uint64_t GpuMemoryRegistry::GetOwnerSize(const std::string& owner) const
+{
+    uint64_t total = 0;
+    for (const GpuMemoryAllocation& allocation : m_Allocations)
+    {
+        if (allocation.owner == owner)
+            total += allocation.byteSize;
+    }
+    return total;
+}
+
+std::vector<std::pair<std::string, uint64_t>> GpuMemoryRegistry::GetOwnerSizes() const
+{
+    std::vector<std::pair<std::string, uint64_t>> owners;
+    for (const GpuMemoryAllocation& allocation : m_Allocations)
+    {
+        auto it = std::find_if(owners.begin(), owners.end(),
+            [&allocation](const auto& owner) { return owner.first == allocation.owner; });
+
+        if (it == owners.end())
+            owners.push_back({ allocation.owner, allocation.byteSize });
+        else
+            it->second += allocation.byteSize;
+    }
+    return owners;
+}
+
+static std::string GetFormatName(const GpuMemoryAllocation& allocation)
+{
+    if (allocation.format != nvrhi::Format::UNKNOWN)
+        return nvrhi::getFormatInfo(allocation.format).name;
+
+    if (allocation.structStride != 0)
+        return "stride " + std::to_string(allocation.structStride);
+
+    return "-";
+}
+
+static std::string GetDimensions(const GpuMemoryAllocation& allocation)
+{
+    if (!allocation.isTexture)
+        return "-";
+
+    std::string dimensions = std::to_string(allocation.width) + "x" + std::to_string(allocation.height);
+    if (allocation.depthOrArraySize > 1)
+        dimensions += "x" + std::to_string(allocation.depthOrArraySize);
+    if (allocation.mipLevels > 1)
+        dimensions += " (" + std::to_string(allocation.mipLevels) + " mips)";
+    return dimensions;
+}
+
+static double ToMegabytes(uint64_t byteSize)
+{
+    return double(byteSize) / (1024.0 * 1024.0);
+}
+
+std::string GpuMemoryRegistry::FormatReport() const
+{
+    std::string report;
+    char line[256];
+
+    for (const auto& [owner, ownerSize] : GetOwnerSizes())
+    {
+        snprintf(line, sizeof(line), "%s: %.2f MB\n", owner.c_str(), ToMegabytes(ownerSize));
+        report += line;
+
+        for (const GpuMemoryAllocation& allocation : m_Allocations)
+        {
+            if (allocation.owner != owner)
+                continue;
+
+            snprintf(line, sizeof(line), "  %-32s %-16s %-24s %10.3f MB\n", allocation.name.c_str(),
+                GetFormatName(allocation).c_str(), GetDimensions(allocation).c_str(), ToMegabytes(allocation.byteSize));
+            report += line;
+        }
+    }
+
+    snprintf(line, sizeof(line), "Total: %.2f MB\n", ToMegabytes(GetTotalSize()));
+    report += line;
+
+    return report;
+}
+
+static std::string EscapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped.push_back('\\');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+bool GpuMemoryRegistry::SaveReport(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+        return false;
+
+    const bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+    if (!json)
+    {
+        file << FormatReport();
+        return file.good();
+    }
+
+    file << "{\n  \"totalBytes\": " << GetTotalSize() << ",\n  \"owners\": [";
+
+    bool firstOwner = true;
+    for (const auto& [owner, ownerSize] : GetOwnerSizes())
+    {
+        file << (firstOwner ? "" : ",") << "\n    { \"name\": \"" << EscapeJson(owner) << "\", \"bytes\": " << ownerSize << ", \"resources\": [";
+        firstOwner = false;
+
+        bool firstAllocation = true;
+        for (const GpuMemoryAllocation& allocation : m_Allocations)
+        {
+            if (allocation.owner != owner)
+                continue;
+
+            file << (firstAllocation ? "" : ",") << "\n      { \"name\": \"" << EscapeJson(allocation.name) << "\""
+                << ", \"type\": \"" << (allocation.isTexture ? "texture" : "buffer") << "\""
+                << ", \"format\": \"" << GetFormatName(allocation) << "\"";
+
+            if (allocation.isTexture)
+            {
+                file << ", \"width\": " << allocation.width << ", \"height\": " << allocation.height
+                    << ", \"depthOrArraySize\": " << allocation.depthOrArraySize << ", \"mipLevels\": " << allocation.mipLevels;
+            }
+
+            file << ", \"bytes\": " << allocation.byteSize << " }";
+            firstAllocation = false;
+        }
+
+        file << "\n    ] }";
+    }
+
+    file << "\n  ]\n}\n";
+
+    return file.good();
+}
+
+uint64_t GpuMemoryRegistry::GetBufferSize(const nvrhi::BufferDesc& desc)
+{
+    return desc.byteSize;
+}
+
+uint64_t GpuMemoryRegistry::GetTextureSize(const nvrhi::TextureDesc& desc)
+{
+    const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+    const uint32_t blockSize = std::max<uint32_t>(formatInfo.blockSize, 1);
+
+    const bool is3D = desc.dimension == nvrhi::TextureDimension::Texture3D;
+    const uint64_t layers = is3D ? 1 : std::max(desc.arraySize, 1u);
+
+    uint64_t size = 0;
+    for (uint32_t mipLevel = 0; mipLevel < std::max(desc.mipLevels, 1u); mipLevel++)
+    {
+        const uint64_t width = std::max(desc.width >> mipLevel, 1u);
+        const uint64_t height = std::max(desc.height >> mipLevel, 1u);
+        const uint64_t depth = is3D ? std::max(desc.depth >> mipLevel, 1u) : 1;
+
+        const uint64_t blocksX = (width + blockSize - 1) / blockSize;
+        const uint64_t blocksY = (height + blockSize - 1) / blockSize;
+
+        size += blocksX * blocksY * depth * formatInfo.bytesPerBlock;
+    }
+
+    return size * layers * std::max(desc.sampleCount, 1u);
+}
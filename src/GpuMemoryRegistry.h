@@ -0,0 +1,69 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct GpuMemoryAllocation
+{
+    std::string owner;
+    std::string name;
+    bool isTexture = false;
+    nvrhi::Format format = nvrhi::Format::UNKNOWN;
+    uint32_t structStride = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t depthOrArraySize = 0;
+    uint32_t mipLevels = 0;
+    uint64_t byteSize = 0;
+};
+
+// Records the buffers and textures created by the renderer's resource owners, such as RenderTargets or RtxdiResources,
+// and reports their sizes per owner. The sizes are computed from the resource descriptions, so they don't include
+// the alignment and padding added by the driver, but they are exact and portable, which makes them suitable for
+// catching memory regressions. The owners add their resources through their RegisterMemory functions.
+class GpuMemoryRegistry
+{
+private:
+    std::vector<GpuMemoryAllocation> m_Allocations;
+
+public:
+    void Clear() { m_Allocations.clear(); }
+    void RemoveOwner(const std::string& owner);
+
+    void AddBuffer(const std::string& owner, const nvrhi::BufferDesc& desc);
+    void AddTexture(const std::string& owner, const nvrhi::TextureDesc& desc);
+
+    // Null resources are ignored, so that optional resources can be passed without checks
+    void AddBuffer(const std::string& owner, nvrhi::IBuffer* buffer);
+    void AddTexture(const std::string& owner, nvrhi::ITexture* texture);
+
+    // Memory that is allocated by a library and only known by its size, e.g. the DLSS feature
+    void AddOpaque(const std::string& owner, const std::string& name, uint64_t byteSize);
+
+    [[nodiscard]] const std::vector<GpuMemoryAllocation>& GetAllocations() const { return m_Allocations; }
+    [[nodiscard]] uint64_t GetTotalSize() const;
+    [[nodiscard]] uint64_t GetOwnerSize(const std::string& owner) const;
+
+    // Total size of every owner, in the order in which the owners were first added
+    [[nodiscard]] std::vector<std::pair<std::string, uint64_t>> GetOwnerSizes() const;
+
+    [[nodiscard]] std::string FormatReport() const;
+
+    // Writes a JSON report if the file name ends with .json, and a text report otherwise
+    bool SaveReport(const std::string& fileName) const;
+
+    static uint64_t GetBufferSize(const nvrhi::BufferDesc& desc);
+    static uint64_t GetTextureSize(const nvrhi::TextureDesc& desc);
+};
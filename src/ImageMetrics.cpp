@@ -0,0 +1,503 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+MetricImage::MetricImage(uint32_t width, uint32_t height)
+    : width(width)
+    , height(height)
+    , pixels(size_t(width) * height * 4, 0.f)
+{
+}
+
+static bool SizesMatch(const MetricImage& test, const MetricImage& reference)
+{
+    return test.width == reference.width && test.height == reference.height && test.width > 0 && test.height > 0
+        && test.pixels.size() == size_t(test.width) * test.height * 4 && reference.pixels.size() == test.pixels.size();
+}
+
+double ComputeMse(const MetricImage& test, const MetricImage& reference)
+{
+    if (!SizesMatch(test, reference))
+        return 0.0;
+
+    double sum = 0.0;
+    for (size_t pixel = 0; pixel < test.pixels.size(); pixel += 4)
+    {
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            const double difference = double(test.pixels[pixel + channel]) - double(reference.pixels[pixel + channel]);
+            sum += difference * difference;
+        }
+    }
+
+    return sum / double(size_t(test.width) * test.height * 3);
+}
+
+double ComputeRelMse(const MetricImage& test, const MetricImage& reference)
+{
+    if (!SizesMatch(test, reference))
+        return 0.0;
+
+    constexpr double epsilon = 0.01;
+
+    double sum = 0.0;
+    for (size_t pixel = 0; pixel < test.pixels.size(); pixel += 4)
+    {
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            const double value = double(reference.pixels[pixel + channel]);
+            const double difference = double(test.pixels[pixel + channel]) - value;
+            sum += difference * difference / (value * value + epsilon);
+        }
+    }
+
+    return sum / double(size_t(test.width) * test.height * 3);
+}
+
+// Tone mapping used by PSNR and FLIP, linear in [0, 1]. NaN and negative values map to 0.
+static float ToneMap(float value)
+{
+    if (!(value > 0.f))
+        return 0.f;
+    if (std::isinf(value))
+        return 1.f;
+    return value / (1.f + value);
+}
+
+double ComputePsnr(const MetricImage& test, const MetricImage& reference)
+{
+    if (!SizesMatch(test, reference))
+        return 0.0;
+
+    double sum = 0.0;
+    for (size_t pixel = 0; pixel < test.pixels.size(); pixel += 4)
+    {
+        for (size_t channel = 0; channel < 3; channel++)
+        {
+            const double difference = double(ToneMap(test.pixels[pixel + channel])) - double(ToneMap(reference.pixels[pixel + channel]));
+            sum += difference * difference;
+        }
+    }
+
+    const double mse = sum / double(size_t(test.width) * test.height * 3);
+    if (mse <= 0.0)
+        return std::numeric_limits<double>::infinity();
+
+    return 10.0 * std::log10(1.0 / mse);
+}
+
+// The FLIP implementation below follows the paper and the reference implementation:
+// the color pipeline filters the images with the contrast sensitivity functions in the YCxCz opponent space
+// and computes the Hunt-adjusted HyAB distance in L*a*b*, the feature pipeline compares the edges and points
+// detected in the luminance, and the feature difference sharpens the color difference.
+
+namespace
+{
+    constexpr float c_FlipQc = 0.7f;    // color difference exponent
+    constexpr float c_FlipPc = 0.4f;    // color difference compression breakpoint
+    constexpr float c_FlipPt = 0.95f;   // value of the compressed difference at the breakpoint
+    constexpr float c_FlipGw = 0.082f;  // feature detection filter width, in degrees
+    constexpr float c_FlipQf = 0.5f;    // feature difference exponent
+    constexpr float c_Pi = 3.14159265358979f;
+
+    // D65 reference white
+    constexpr float c_WhiteX = 0.950428545f;
+    constexpr float c_WhiteY = 1.f;
+    constexpr float c_WhiteZ = 1.088900371f;
+
+    struct Float3
+    {
+        float x = 0.f, y = 0.f, z = 0.f;
+    };
+
+    // Planar image with a few float channels
+    struct Planes
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<float> data[3];
+
+        Planes(uint32_t width, uint32_t height, uint32_t channels)
+            : width(width), height(height)
+        {
+            for (uint32_t channel = 0; channel < channels; channel++)
+                data[channel].resize(size_t(width) * height);
+        }
+    };
+
+    float SrgbToLinear(float value)
+    {
+        return (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float LinearToSrgb(float value)
+    {
+        return (value <= 0.0031308f) ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+    }
+
+    Float3 LinearRgbToXyz(const Float3& rgb)
+    {
+        return {
+            0.4124564f * rgb.x + 0.3575761f * rgb.y + 0.1804375f * rgb.z,
+            0.2126729f * rgb.x + 0.7151522f * rgb.y + 0.0721750f * rgb.z,
+            0.0193339f * rgb.x + 0.1191920f * rgb.y + 0.9503041f * rgb.z };
+    }
+
+    Float3 XyzToLinearRgb(const Float3& xyz)
+    {
+        return {
+            3.2404542f * xyz.x - 1.5371385f * xyz.y - 0.4985314f * xyz.z,
+            -0.9692660f * xyz.x + 1.8760108f * xyz.y + 0.0415560f * xyz.z,
+            0.0556434f * xyz.x - 0.2040259f * xyz.y + 1.0572252f * xyz.z };
+    }
+
+    Float3 XyzToYCxCz(const Float3& xyz)
+    {
+        const float y = xyz.y / c_WhiteY;
+        return { 116.f * y - 16.f, 500.f * (xyz.x / c_WhiteX - y), 200.f * (y - xyz.z / c_WhiteZ) };
+    }
+
+    Float3 YCxCzToXyz(const Float3& ycxcz)
+    {
+        const float y = (ycxcz.x + 16.f) / 116.f;
+        return { c_WhiteX * (ycxcz.y / 500.f + y), c_WhiteY * y, c_WhiteZ * (y - ycxcz.z / 200.f) };
+    }
+
+    float LabCurve(float value)
+    {
+        constexpr float delta = 6.f / 29.f;
+        return (value > delta * delta * delta) ? std::cbrt(value) : value / (3.f * delta * delta) + 4.f / 29.f;
+    }
+
+    Float3 XyzToLab(const Float3& xyz)
+    {
+        const float fx = LabCurve(xyz.x / c_WhiteX);
+        const float fy = LabCurve(xyz.y / c_WhiteY);
+        const float fz = LabCurve(xyz.z / c_WhiteZ);
+        return { 116.f * fy - 16.f, 500.f * (fx - fy), 200.f * (fy - fz) };
+    }
+
+    Float3 HuntAdjust(const Float3& lab)
+    {
+        return { lab.x, 0.01f * lab.x * lab.y, 0.01f * lab.x * lab.z };
+    }
+
+    float HyAB(const Float3& a, const Float3& b)
+    {
+        const float da = a.y - b.y;
+        const float db = a.z - b.z;
+        return std::abs(a.x - b.x) + std::sqrt(da * da + db * db);
+    }
+
+    std::vector<float> CreateGaussian(int radius, float variance)
+    {
+        std::vector<float> kernel(2 * radius + 1);
+        for (int x = -radius; x <= radius; x++)
+            kernel[x + radius] = std::exp(-float(x * x) / (2.f * variance));
+        return kernel;
+    }
+
+    float Sum(const std::vector<float>& kernel)
+    {
+        float sum = 0.f;
+        for (float value : kernel)
+            sum += value;
+        return sum;
+    }
+
+    void Normalize(std::vector<float>& kernel)
+    {
+        const float sum = Sum(kernel);
+        for (float& value : kernel)
+            value /= sum;
+    }
+
+    // Scales the positive weights to sum to 1 and the negative weights to sum to -1
+    void NormalizeSigned(std::vector<float>& kernel)
+    {
+        float positive = 0.f, negative = 0.f;
+        for (float value : kernel)
+            (value > 0.f ? positive : negative) += value;
+
+        for (float& value : kernel)
+            value /= (value > 0.f) ? positive : -negative;
+    }
+
+    // Separable convolution with clamped borders
+    void Convolve(const std::vector<float>& source, std::vector<float>& destination, uint32_t width, uint32_t height,
+        const std::vector<float>& kernelX, const std::vector<float>& kernelY)
+    {
+        const int radiusX = int(kernelX.size() / 2);
+        const int radiusY = int(kernelY.size() / 2);
+        std::vector<float> temp(source.size());
+
+        for (int y = 0; y < int(height); y++)
+        {
+            for (int x = 0; x < int(width); x++)
+            {
+                float sum = 0.f;
+                for (int k = -radiusX; k <= radiusX; k++)
+                    sum += kernelX[k + radiusX] * source[size_t(y) * width + std::clamp(x + k, 0, int(width) - 1)];
+                temp[size_t(y) * width + x] = sum;
+            }
+        }
+
+        destination.resize(source.size());
+        for (int y = 0; y < int(height); y++)
+        {
+            for (int x = 0; x < int(width); x++)
+            {
+                float sum = 0.f;
+                for (int k = -radiusY; k <= radiusY; k++)
+                    sum += kernelY[k + radiusY] * temp[size_t(std::clamp(y + k, 0, int(height) - 1)) * width + x];
+                destination[size_t(y) * width + x] = sum;
+            }
+        }
+    }
+
+    // Contrast sensitivity function of one opponent channel: a sum of up to two Gaussians in the frequency domain,
+    // which is also a sum of two Gaussians in the spatial domain.
+    struct Csf
+    {
+        float a1, b1, a2, b2;
+    };
+
+    constexpr Csf c_CsfY = { 1.f, 0.0047f, 0.f, 1e-5f };
+    constexpr Csf c_CsfCx = { 1.f, 0.0053f, 0.f, 1e-5f };
+    constexpr Csf c_CsfCz = { 34.1f, 0.04f, 13.5f, 0.025f };
+
+    class FlipFilters
+    {
+    private:
+        float m_PixelsPerDegree;
+        int m_CsfRadius;
+
+        std::vector<float> m_Gaussian;
+        std::vector<float> m_Edge;
+        std::vector<float> m_Point;
+
+        // The 2D CSF kernel a * sqrt(pi / b) * exp(-pi^2 * r^2 / b) is separable, returns the normalized 1D kernel
+        // and the sum of the unnormalized 2D kernel, which is the weight of this Gaussian in the combined filter.
+        std::vector<float> CreateCsfGaussian(float a, float b, float& outWeight) const
+        {
+            const float degreesPerPixel = 1.f / m_PixelsPerDegree;
+            std::vector<float> kernel(2 * m_CsfRadius + 1);
+            for (int x = -m_CsfRadius; x <= m_CsfRadius; x++)
+            {
+                const float distance = float(x) * degreesPerPixel;
+                kernel[x + m_CsfRadius] = std::exp(-c_Pi * c_Pi * distance * distance / b);
+            }
+
+            const float sum = Sum(kernel);
+            outWeight = a * std::sqrt(c_Pi / b) * sum * sum;
+            Normalize(kernel);
+            return kernel;
+        }
+
+    public:
+        explicit FlipFilters(float pixelsPerDegree)
+            : m_PixelsPerDegree(pixelsPerDegree)
+        {
+            const float maxB = std::max({ c_CsfY.b1, c_CsfCx.b1, c_CsfCz.b1, c_CsfCz.b2 });
+            m_CsfRadius = int(std::ceil(3.f * std::sqrt(maxB / (2.f * c_Pi * c_Pi)) * pixelsPerDegree));
+
+            const float sigma = 0.5f * c_FlipGw * pixelsPerDegree;
+            const int featureRadius = int(std::ceil(3.f * sigma));
+            const float variance = sigma * sigma;
+
+            m_Gaussian = CreateGaussian(featureRadius, variance);
+            m_Edge = m_Gaussian;
+            m_Point = m_Gaussian;
+            for (int x = -featureRadius; x <= featureRadius; x++)
+            {
+                m_Edge[x + featureRadius] *= -float(x);
+                m_Point[x + featureRadius] *= float(x * x) / variance - 1.f;
+            }
+
+            Normalize(m_Gaussian);
+            NormalizeSigned(m_Edge);
+            NormalizeSigned(m_Point);
+        }
+
+        void FilterCsf(const std::vector<float>& source, std::vector<float>& destination, uint32_t width, uint32_t height, const Csf& csf) const
+        {
+            float weight1 = 0.f;
+            const std::vector<float> kernel1 = CreateCsfGaussian(csf.a1, csf.b1, weight1);
+            Convolve(source, destination, width, height, kernel1, kernel1);
+
+            if (csf.a2 == 0.f)
+                return;
+
+            float weight2 = 0.f;
+            const std::vector<float> kernel2 = CreateCsfGaussian(csf.a2, csf.b2, weight2);
+            std::vector<float> second;
+            Convolve(source, second, width, height, kernel2, kernel2);
+
+            const float total = weight1 + weight2;
+            for (size_t index = 0; index < destination.size(); index++)
+                destination[index] = (weight1 * destination[index] + weight2 * second[index]) / total;
+        }
+
+        // Magnitudes of the edge and point responses of the luminance
+        void DetectFeatures(const std::vector<float>& luminance, uint32_t width, uint32_t height,
+            std::vector<float>& outEdges, std::vector<float>& outPoints) const
+        {
+            std::vector<float> edgeX, edgeY, pointX, pointY;
+            Convolve(luminance, edgeX, width, height, m_Edge, m_Gaussian);
+            Convolve(luminance, edgeY, width, height, m_Gaussian, m_Edge);
+            Convolve(luminance, pointX, width, height, m_Point, m_Gaussian);
+            Convolve(luminance, pointY, width, height, m_Gaussian, m_Point);
+
+            outEdges.resize(luminance.size());
+            outPoints.resize(luminance.size());
+            for (size_t index = 0; index < luminance.size(); index++)
+            {
+                outEdges[index] = std::sqrt(edgeX[index] * edgeX[index] + edgeY[index] * edgeY[index]);
+                outPoints[index] = std::sqrt(pointX[index] * pointX[index] + pointY[index] * pointY[index]);
+            }
+        }
+    };
+
+    // Converts the image to tone mapped sRGB and then to the YCxCz opponent space, which is linear in XYZ
+    Planes ToYCxCz(const MetricImage& image)
+    {
+        Planes planes(image.width, image.height, 3);
+        for (size_t index = 0; index < size_t(image.width) * image.height; index++)
+        {
+            const float* pixel = image.pixels.data() + index * 4;
+
+            // Quantize like an 8-bit display would, then decode
+            Float3 rgb;
+            float* channels[3] = { &rgb.x, &rgb.y, &rgb.z };
+            for (int channel = 0; channel < 3; channel++)
+            {
+                const float srgb = std::round(LinearToSrgb(ToneMap(pixel[channel])) * 255.f) / 255.f;
+                *channels[channel] = SrgbToLinear(srgb);
+            }
+
+            const Float3 ycxcz = XyzToYCxCz(LinearRgbToXyz(rgb));
+            planes.data[0][index] = ycxcz.x;
+            planes.data[1][index] = ycxcz.y;
+            planes.data[2][index] = ycxcz.z;
+        }
+        return planes;
+    }
+
+    Float3 ToHuntLab(float y, float cx, float cz)
+    {
+        Float3 rgb = XyzToLinearRgb(YCxCzToXyz({ y, cx, cz }));
+        rgb.x = std::clamp(rgb.x, 0.f, 1.f);
+        rgb.y = std::clamp(rgb.y, 0.f, 1.f);
+        rgb.z = std::clamp(rgb.z, 0.f, 1.f);
+        return HuntAdjust(XyzToLab(LinearRgbToXyz(rgb)));
+    }
+}
+
+double ComputeFlip(const MetricImage& test, const MetricImage& reference, float pixelsPerDegree, std::vector<float>* errorMap)
+{
+    if (!SizesMatch(test, reference))
+        return 0.0;
+
+    const uint32_t width = test.width;
+    const uint32_t height = test.height;
+    const size_t pixelCount = size_t(width) * height;
+    const FlipFilters filters(pixelsPerDegree);
+
+    const Planes testPlanes = ToYCxCz(test);
+    const Planes referencePlanes = ToYCxCz(reference);
+
+    // Feature pipeline, on the normalized luminance of the unfiltered images
+    std::vector<float> featureDifference(pixelCount);
+    {
+        std::vector<float> testLuminance(pixelCount), referenceLuminance(pixelCount);
+        for (size_t index = 0; index < pixelCount; index++)
+        {
+            testLuminance[index] = (testPlanes.data[0][index] + 16.f) / 116.f;
+            referenceLuminance[index] = (referencePlanes.data[0][index] + 16.f) / 116.f;
+        }
+
+        std::vector<float> testEdges, testPoints, referenceEdges, referencePoints;
+        filters.DetectFeatures(testLuminance, width, height, testEdges, testPoints);
+        filters.DetectFeatures(referenceLuminance, width, height, referenceEdges, referencePoints);
+
+        for (size_t index = 0; index < pixelCount; index++)
+        {
+            const float edgeDifference = std::abs(testEdges[index] - referenceEdges[index]);
+            const float pointDifference = std::abs(testPoints[index] - referencePoints[index]);
+            featureDifference[index] = std::pow(std::max(edgeDifference, pointDifference) / std::sqrt(2.f), c_FlipQf);
+        }
+    }
+
+    // Color pipeline
+    Planes testFiltered(width, height, 3);
+    Planes referenceFiltered(width, height, 3);
+    const Csf* csfs[3] = { &c_CsfY, &c_CsfCx, &c_CsfCz };
+    for (int channel = 0; channel < 3; channel++)
+    {
+        filters.FilterCsf(testPlanes.data[channel], testFiltered.data[channel], width, height, *csfs[channel]);
+        filters.FilterCsf(referencePlanes.data[channel], referenceFiltered.data[channel], width, height, *csfs[channel]);
+    }
+
+    // The largest difference in the Hunt-adjusted space is between pure green and pure blue
+    const Float3 green = HuntAdjust(XyzToLab(LinearRgbToXyz({ 0.f, 1.f, 0.f })));
+    const Float3 blue = HuntAdjust(XyzToLab(LinearRgbToXyz({ 0.f, 0.f, 1.f })));
+    const float maxDifference = std::pow(HyAB(green, blue), c_FlipQc);
+    const float breakpoint = c_FlipPc * maxDifference;
+
+    if (errorMap)
+        errorMap->resize(pixelCount);
+
+    double sum = 0.0;
+    for (size_t index = 0; index < pixelCount; index++)
+    {
+        const Float3 testLab = ToHuntLab(testFiltered.data[0][index], testFiltered.data[1][index], testFiltered.data[2][index]);
+        const Float3 referenceLab = ToHuntLab(referenceFiltered.data[0][index], referenceFiltered.data[1][index], referenceFiltered.data[2][index]);
+
+        const float difference = std::pow(HyAB(testLab, referenceLab), c_FlipQc);
+        const float colorDifference = (difference < breakpoint)
+            ? difference * c_FlipPt / breakpoint
+            : c_FlipPt + (difference - breakpoint) / (maxDifference - breakpoint) * (1.f - c_FlipPt);
+
+        const float error = std::pow(std::min(colorDifference, 1.f), 1.f - featureDifference[index]);
+        sum += double(error);
+
+        if (errorMap)
+            (*errorMap)[index] = error;
+    }
+
+    return sum / double(pixelCount);
+}
+
+ImageMetrics ComputeImageMetrics(const MetricImage& test, const MetricImage& reference, float pixelsPerDegree)
+{
+    ImageMetrics metrics;
+    if (!SizesMatch(test, reference))
+        return metrics;
+
+    metrics.mse = ComputeMse(test, reference);
+    metrics.relMse = ComputeRelMse(test, reference);
+    metrics.psnr = ComputePsnr(test, reference);
+    metrics.flip = ComputeFlip(test, reference, pixelsPerDegree);
+    return metrics;
+}
+
+int GetFramesToQuality(const std::vector<double>& errors, double target)
+{
+    int frame = int(errors.size());
+    while (frame > 0 && errors[frame - 1] <= target)
+        frame--;
+
+    return (frame == int(errors.size())) ? -1 : frame;
+}
@@ -0,0 +1,60 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Error metrics of a rendered image against a converged reference, used by the quality part of the benchmark.
+// This file only depends on the standard library so that the metrics can be tested on the CPU, see tools/checks/ImageMetricsCheck.cpp.
+
+// Linear HDR image with 4 floats (RGBA) per pixel, the alpha channel is ignored
+struct MetricImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> pixels;
+
+    MetricImage() = default;
+    MetricImage(uint32_t width, uint32_t height);
+
+    [[nodiscard]] float* GetPixel(uint32_t x, uint32_t y) { return pixels.data() + (size_t(y) * width + x) * 4; }
+    [[nodiscard]] const float* GetPixel(uint32_t x, uint32_t y) const { return pixels.data() + (size_t(y) * width + x) * 4; }
+};
+
+struct ImageMetrics
+{
+    double mse = 0.0;       // mean squared error of the linear RGB values
+    double relMse = 0.0;    // mean of (test - reference)^2 / (reference^2 + 0.01), which weighs dark and bright regions equally
+    double psnr = 0.0;      // peak signal to noise ratio of the tone mapped images, in dB; infinite for identical images
+    double flip = 0.0;      // mean LDR-FLIP error of the tone mapped images, in [0, 1]
+};
+
+// Observer distance used for FLIP: a 0.7 m wide 4K monitor viewed from 0.7 m
+constexpr float c_DefaultPixelsPerDegree = 67.f;
+
+[[nodiscard]] double ComputeMse(const MetricImage& test, const MetricImage& reference);
+[[nodiscard]] double ComputeRelMse(const MetricImage& test, const MetricImage& reference);
+[[nodiscard]] double ComputePsnr(const MetricImage& test, const MetricImage& reference);
+
+// LDR-FLIP (Andersson et al. 2020) of the images tone mapped with x / (1 + x) and sRGB encoded.
+// If errorMap is not null, it receives the per-pixel error.
+[[nodiscard]] double ComputeFlip(const MetricImage& test, const MetricImage& reference,
+    float pixelsPerDegree = c_DefaultPixelsPerDegree, std::vector<float>* errorMap = nullptr);
+
+// Returns all metrics, or zeros if the image sizes don't match
+[[nodiscard]] ImageMetrics ComputeImageMetrics(const MetricImage& test, const MetricImage& reference,
+    float pixelsPerDegree = c_DefaultPixelsPerDegree);
+
+// Index of the first frame after which the error stays at or below the target until the end of the sequence,
+// or -1 if the last frame is above the target. This ignores single noisy frames that dip below the target early.
+[[nodiscard]] int GetFramesToQuality(const std::vector<double>& errors, double target);
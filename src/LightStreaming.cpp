@@ -0,0 +1,311 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "LightStreaming.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <unordered_map>
+
+uint32_t LightSlabAllocator::GetSlabsForLights(uint32_t lightCount, uint32_t slabSize)
+{
+    return (lightCount + slabSize - 1) / slabSize;
+}
+
+void LightSlabAllocator::Reset(uint32_t slabSize)
+{
+    m_SlabSize = std::max(slabSize, 1u);
+    m_SlabCount = 0;
+    m_AllocatedSlabs = 0;
+    m_FreeRanges.clear();
+}
+
+LightSlabRange LightSlabAllocator::Allocate(uint32_t lightCount)
+{
+    LightSlabRange range;
+    range.slabCount = GetSlabsForLights(lightCount, m_SlabSize);
+    if (range.slabCount == 0)
+        return range;
+
+    m_AllocatedSlabs += range.slabCount;
+
+    for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+    {
+        if (it->second < range.slabCount)
+            continue;
+
+        range.firstSlab = it->first;
+        const uint32_t remainingSlabs = it->second - range.slabCount;
+        m_FreeRanges.erase(it);
+        if (remainingSlabs != 0)
+            m_FreeRanges[range.firstSlab + range.slabCount] = remainingSlabs;
+
+        return range;
+    }
+
+    range.firstSlab = m_SlabCount;
+    m_SlabCount += range.slabCount;
+    return range;
+}
+
+void LightSlabAllocator::Free(const LightSlabRange& range)
+{
+    if (range.slabCount == 0)
+        return;
+
+    assert(range.firstSlab + range.slabCount <= m_SlabCount);
+    assert(m_AllocatedSlabs >= range.slabCount);
+    m_AllocatedSlabs -= range.slabCount;
+
+    uint32_t firstSlab = range.firstSlab;
+    uint32_t slabCount = range.slabCount;
+
+    // Merge with the free ranges before and after
+    auto next = m_FreeRanges.lower_bound(firstSlab);
+    if (next != m_FreeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == firstSlab)
+        {
+            firstSlab = previous->first;
+            slabCount += previous->second;
+            m_FreeRanges.erase(previous);
+        }
+    }
+
+    if (next != m_FreeRanges.end() && next->first == firstSlab + slabCount)
+    {
+        slabCount += next->second;
+        m_FreeRanges.erase(next);
+    }
+
+    // A free range at the end is not a range, it's the end
+    if (firstSlab + slabCount == m_SlabCount)
+        m_SlabCount = firstSlab;
+    else
+        m_FreeRanges[firstSlab] = slabCount;
+}
+
+static uint64_t packCellCoords(const int32_t coords[3])
+{
+    // 21 bits per axis, cells further than a million cells from the origin alias
+    const uint64_t mask = (1ull << 21) - 1;
+    return (uint64_t(coords[0]) & mask) | ((uint64_t(coords[1]) & mask) << 21) | ((uint64_t(coords[2]) & mask) << 42);
+}
+
+void LightStreamingManager::GetCellCoords(const float position[3], int32_t coords[3]) const
+{
+    for (int axis = 0; axis < 3; axis++)
+        coords[axis] = int32_t(std::floor(position[axis] / m_Parameters.cellSize));
+}
+
+float LightStreamingManager::GetCellDistance(const Cell& cell, const float viewPosition[3]) const
+{
+    // Distance to the nearest point of the cell box
+    float distanceSquared = 0.f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float cellMin = float(cell.coords[axis]) * m_Parameters.cellSize;
+        const float cellMax = cellMin + m_Parameters.cellSize;
+        const float d = std::max(std::max(cellMin - viewPosition[axis], viewPosition[axis] - cellMax), 0.f);
+        distanceSquared += d * d;
+    }
+    return std::sqrt(distanceSquared);
+}
+
+void LightStreamingManager::SetParameters(const LightStreamingParameters& parameters)
+{
+    const bool layoutChanged = parameters.cellSize != m_Parameters.cellSize || parameters.slabSize != m_Parameters.slabSize;
+
+    m_Parameters = parameters;
+    m_Parameters.cellSize = std::max(m_Parameters.cellSize, 1e-3f);
+    m_Parameters.evictDistance = std::max(m_Parameters.evictDistance, m_Parameters.loadDistance);
+
+    if (layoutChanged)
+        Reset();
+}
+
+void LightStreamingManager::Reset()
+{
+    m_Allocator.Reset(m_Parameters.slabSize);
+    m_Cells.clear();
+    m_Items.clear();
+    m_ResidencyRevision++;
+    UpdateStatistics();
+}
+
+bool LightStreamingManager::SetItems(const std::vector<LightStreamingItem>& items)
+{
+    std::unordered_map<uint64_t, uint32_t> cellIndices;
+    std::vector<Cell> cells;
+    std::vector<ItemRecord> records;
+    records.reserve(items.size());
+
+    for (const LightStreamingItem& item : items)
+    {
+        int32_t coords[3];
+        GetCellCoords(item.position, coords);
+
+        auto [cellIndex, inserted] = cellIndices.try_emplace(packCellCoords(coords), uint32_t(cells.size()));
+        if (inserted)
+        {
+            Cell& cell = cells.emplace_back();
+            std::copy(coords, coords + 3, cell.coords);
+        }
+
+        cells[cellIndex->second].lightCount += item.lightCount;
+        records.push_back({ item.key, item.lightCount, cellIndex->second });
+    }
+
+    // The cell indices follow the item order, so equal records and cell coordinates mean equal cells
+    const bool changed = records.size() != m_Items.size() || cells.size() != m_Cells.size()
+        || !std::equal(records.begin(), records.end(), m_Items.begin(),
+            [](const ItemRecord& a, const ItemRecord& b) { return a.key == b.key && a.lightCount == b.lightCount && a.cell == b.cell; })
+        || !std::equal(cells.begin(), cells.end(), m_Cells.begin(),
+            [](const Cell& a, const Cell& b) { return std::equal(a.coords, a.coords + 3, b.coords); });
+
+    if (!changed)
+        return false;
+
+    // Carry over the residency of the cells that still exist
+    std::vector<bool> oldCellsKept(m_Cells.size(), false);
+    for (uint32_t oldIndex = 0; oldIndex < uint32_t(m_Cells.size()); oldIndex++)
+    {
+        const Cell& oldCell = m_Cells[oldIndex];
+        auto it = cellIndices.find(packCellCoords(oldCell.coords));
+        if (it == cellIndices.end())
+            continue;
+
+        Cell& cell = cells[it->second];
+        cell.state = oldCell.state;
+        cell.framesUntilResident = oldCell.framesUntilResident;
+        cell.range = oldCell.range;
+        oldCellsKept[oldIndex] = true;
+
+        if (cell.state == LightStreamingCellState::Resident &&
+            cell.lightCount > cell.range.slabCount * m_Allocator.GetSlabSize())
+        {
+            // The cell has grown out of its range, it stays resident in a new one
+            m_Allocator.Free(cell.range);
+            cell.range = m_Allocator.Allocate(cell.lightCount);
+        }
+    }
+
+    for (uint32_t oldIndex = 0; oldIndex < uint32_t(m_Cells.size()); oldIndex++)
+    {
+        if (!oldCellsKept[oldIndex] && m_Cells[oldIndex].state == LightStreamingCellState::Resident)
+            m_Allocator.Free(m_Cells[oldIndex].range);
+    }
+
+    m_Cells = std::move(cells);
+    m_Items = std::move(records);
+    m_ResidencyRevision++;
+    UpdateStatistics();
+
+    return true;
+}
+
+void LightStreamingManager::Update(const float viewPosition[3])
+{
+    bool residencyChanged = false;
+
+    // Evict first, so that the loads completing on this frame can reuse the slabs
+    for (Cell& cell : m_Cells)
+    {
+        if (cell.state == LightStreamingCellState::Unloaded || GetCellDistance(cell, viewPosition) <= m_Parameters.evictDistance)
+            continue;
+
+        if (cell.state == LightStreamingCellState::Resident)
+        {
+            m_Allocator.Free(cell.range);
+            m_EvictionCount++;
+            residencyChanged = true;
+        }
+
+        // A pending load is cancelled
+        cell.state = LightStreamingCellState::Unloaded;
+        cell.range = LightSlabRange();
+    }
+
+    // Request the nearest cells that are not loaded yet
+    std::vector<std::pair<float, uint32_t>> requests;
+    for (uint32_t index = 0; index < uint32_t(m_Cells.size()); index++)
+    {
+        const Cell& cell = m_Cells[index];
+        if (cell.state != LightStreamingCellState::Unloaded)
+            continue;
+
+        const float distance = GetCellDistance(cell, viewPosition);
+        if (distance <= m_Parameters.loadDistance)
+            requests.push_back(std::make_pair(distance, index));
+    }
+
+    const size_t requestCount = std::min(requests.size(), size_t(m_Parameters.maxLoadsPerFrame));
+    std::partial_sort(requests.begin(), requests.begin() + requestCount, requests.end());
+    for (size_t request = 0; request < requestCount; request++)
+    {
+        Cell& cell = m_Cells[requests[request].second];
+        cell.state = LightStreamingCellState::Loading;
+        cell.framesUntilResident = m_Parameters.loadLatencyFrames;
+    }
+
+    // Complete the loads that have arrived
+    for (Cell& cell : m_Cells)
+    {
+        if (cell.state != LightStreamingCellState::Loading)
+            continue;
+
+        if (cell.framesUntilResident != 0)
+        {
+            cell.framesUntilResident--;
+            continue;
+        }
+
+        cell.range = m_Allocator.Allocate(cell.lightCount);
+        cell.state = LightStreamingCellState::Resident;
+        m_LoadCount++;
+        residencyChanged = true;
+    }
+
+    if (residencyChanged)
+        m_ResidencyRevision++;
+
+    UpdateStatistics();
+}
+
+bool LightStreamingManager::GetCellLightRange(uint32_t cell, uint32_t& firstLight, uint32_t& lightCapacity) const
+{
+    const Cell& streamingCell = m_Cells[cell];
+    if (streamingCell.state != LightStreamingCellState::Resident)
+        return false;
+
+    firstLight = streamingCell.range.firstSlab * m_Allocator.GetSlabSize();
+    lightCapacity = streamingCell.range.slabCount * m_Allocator.GetSlabSize();
+    return true;
+}
+
+void LightStreamingManager::UpdateStatistics()
+{
+    m_ResidentCells = 0;
+    m_LoadingCells = 0;
+    m_ResidentLights = 0;
+
+    for (const Cell& cell : m_Cells)
+    {
+        if (cell.state == LightStreamingCellState::Resident)
+        {
+            m_ResidentCells++;
+            m_ResidentLights += cell.lightCount;
+        }
+        else if (cell.state == LightStreamingCellState::Loading)
+            m_LoadingCells++;
+    }
+}
@@ -0,0 +1,162 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+struct LightStreamingParameters
+{
+    bool enable = false;
+
+    // Edge length of the cubic cells that the lights are grouped into, in world units
+    float cellSize = 32.f;
+
+    // Cells closer to the view than loadDistance are loaded, and cells farther than evictDistance are evicted.
+    // The gap between the two keeps the cells near the boundary from loading and evicting on every frame.
+    float loadDistance = 96.f;
+    float evictDistance = 128.f;
+
+    // Number of new load requests per frame, and the number of frames until a requested cell becomes resident
+    uint32_t maxLoadsPerFrame = 8;
+    uint32_t loadLatencyFrames = 2;
+
+    // Number of lights in one slab of the light buffer, the cells get whole slabs
+    uint32_t slabSize = 64;
+};
+
+struct LightSlabRange
+{
+    uint32_t firstSlab = 0;
+    uint32_t slabCount = 0;
+};
+
+// Allocates contiguous ranges of fixed-size slabs in the local light part of the light buffer.
+// An allocation takes the first free range of slabs that is large enough, or is appended at the end.
+// Allocated ranges never move, and freeing a range at the end lowers the number of used slabs.
+class LightSlabAllocator
+{
+private:
+    uint32_t m_SlabSize = 64;
+    uint32_t m_SlabCount = 0;
+    uint32_t m_AllocatedSlabs = 0;
+    std::map<uint32_t, uint32_t> m_FreeRanges; // firstSlab -> slabCount, all below m_SlabCount
+
+public:
+    // Frees all ranges
+    void Reset(uint32_t slabSize);
+
+    [[nodiscard]] LightSlabRange Allocate(uint32_t lightCount);
+    void Free(const LightSlabRange& range);
+
+    [[nodiscard]] uint32_t GetSlabSize() const { return m_SlabSize; }
+    // Number of slabs up to the end of the last allocated range, including the free ranges in between
+    [[nodiscard]] uint32_t GetSlabCount() const { return m_SlabCount; }
+    [[nodiscard]] uint32_t GetAllocatedSlabs() const { return m_AllocatedSlabs; }
+    [[nodiscard]] size_t GetFreeRangeCount() const { return m_FreeRanges.size(); }
+
+    [[nodiscard]] static uint32_t GetSlabsForLights(uint32_t lightCount, uint32_t slabSize);
+};
+
+// A group of lights at one position that is streamed as a whole: an emissive geometry or a primitive light.
+// The key identifies the item between frames.
+struct LightStreamingItem
+{
+    float position[3];
+    uint32_t lightCount;
+    size_t key;
+};
+
+enum class LightStreamingCellState : uint8_t
+{
+    Unloaded,
+    Loading,
+    Resident
+};
+
+// Decides which lights are resident in the light buffer. The items are grouped into cells of a uniform grid,
+// and the cells are loaded and evicted by their distance from the view. Loads are asynchronous: a requested cell
+// becomes resident after the load latency, and only then gets a slab range for its lights, which it keeps until
+// it is evicted. Evicted lights simply disappear from the light buffer, the temporal passes see them as lights
+// that have no mapping to the current frame.
+// The manager only works on plain positions and counts, so that it can be tested without a scene or a device,
+// see tools/checks/LightStreamingCheck.cpp.
+class LightStreamingManager
+{
+private:
+    struct Cell
+    {
+        int32_t coords[3] = {};
+        uint32_t lightCount = 0;
+        LightStreamingCellState state = LightStreamingCellState::Unloaded;
+        uint32_t framesUntilResident = 0;
+        LightSlabRange range;
+    };
+
+    struct ItemRecord
+    {
+        size_t key;
+        uint32_t lightCount;
+        uint32_t cell;
+    };
+
+    LightStreamingParameters m_Parameters;
+    LightSlabAllocator m_Allocator;
+    std::vector<Cell> m_Cells;
+    std::vector<ItemRecord> m_Items;
+    uint32_t m_ResidencyRevision = 0;
+    uint32_t m_LoadCount = 0;
+    uint32_t m_EvictionCount = 0;
+    uint32_t m_ResidentCells = 0;
+    uint32_t m_LoadingCells = 0;
+    uint32_t m_ResidentLights = 0;
+
+    void GetCellCoords(const float position[3], int32_t coords[3]) const;
+    [[nodiscard]] float GetCellDistance(const Cell& cell, const float viewPosition[3]) const;
+    void UpdateStatistics();
+
+public:
+    // Changing the cell size or the slab size unloads all cells
+    void SetParameters(const LightStreamingParameters& parameters);
+    [[nodiscard]] const LightStreamingParameters& GetParameters() const { return m_Parameters; }
+
+    // Unloads all cells and forgets the items
+    void Reset();
+
+    // Groups the items into cells. Cells that still exist keep their residency, and resident cells keep their
+    // slab range unless they need more slabs. Items are assigned to cells by their position at this call only.
+    // Returns true if the items have changed since the last call; the item indices of the queries refer to this list.
+    bool SetItems(const std::vector<LightStreamingItem>& items);
+
+    // Completes the loads that have arrived, evicts the distant cells and requests loads for the near ones
+    void Update(const float viewPosition[3]);
+
+    [[nodiscard]] size_t GetCellCount() const { return m_Cells.size(); }
+    [[nodiscard]] uint32_t GetItemCell(size_t item) const { return m_Items[item].cell; }
+    [[nodiscard]] LightStreamingCellState GetCellState(uint32_t cell) const { return m_Cells[cell].state; }
+
+    // Returns true if the cell is resident, and the first light and the number of lights of its slab range
+    bool GetCellLightRange(uint32_t cell, uint32_t& firstLight, uint32_t& lightCapacity) const;
+
+    // Size of the local light part of the light buffer that holds all slab ranges
+    [[nodiscard]] uint32_t GetLocalLightCapacity() const { return m_Allocator.GetSlabCount() * m_Allocator.GetSlabSize(); }
+    [[nodiscard]] const LightSlabAllocator& GetAllocator() const { return m_Allocator; }
+
+    // Advances whenever a cell becomes resident, is evicted or moves to another slab range
+    [[nodiscard]] uint32_t GetResidencyRevision() const { return m_ResidencyRevision; }
+    [[nodiscard]] uint32_t GetLoadCount() const { return m_LoadCount; }
+    [[nodiscard]] uint32_t GetEvictionCount() const { return m_EvictionCount; }
+    [[nodiscard]] uint32_t GetResidentCellCount() const { return m_ResidentCells; }
+    [[nodiscard]] uint32_t GetLoadingCellCount() const { return m_LoadingCells; }
+    [[nodiscard]] uint32_t GetResidentLightCount() const { return m_ResidentLights; }
+};
@@ -93,6 +93,7 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(11),
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(12),
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(13),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(14),
 
         nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
         nvrhi::BindingLayoutItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -159,6 +160,7 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::TypedBuffer_UAV(11, resources.RisLightDataBuffer),
             nvrhi::BindingSetItem::TypedBuffer_UAV(12, m_Profiler->GetRayCountBuffer()),
             nvrhi::BindingSetItem::StructuredBuffer_UAV(13, resources.SecondaryGBuffer),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(14, m_Profiler->GetRayCountTileBuffer()),
 
             nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
             nvrhi::BindingSetItem::PushConstants(1, sizeof(PerPassConstants)),
@@ -174,6 +176,9 @@ void LightingPasses::CreateBindingSet(
             m_PrevBindingSet = bindingSet;
     }
 
+    // The RIS buffer may have been recreated, so the next presampling pass has to refresh all tiles
+    m_LocalLightTilesValid = false;
+
     const auto& environmentPdfDesc = resources.EnvironmentPdfTexture->getDesc();
     m_EnvironmentPdfTextureSize.x = environmentPdfDesc.width;
     m_EnvironmentPdfTextureSize.y = environmentPdfDesc.height;
@@ -253,27 +258,39 @@ donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ContextPar
     return { "RTXDI_REGIR_MODE", regirMode };
 }
 
-void LightingPasses::CreatePipelines(const rtxdi::ContextParameters& contextParameters, bool useRayQuery)
+void LightingPasses::CreatePipelines(const rtxdi::ContextParameters& contextParameters, bool useRayQuery, bool extendedCompactLightInfo)
 {
     std::vector<donut::engine::ShaderMacro> regirMacros = {
         GetRegirMacro(contextParameters) 
     };
 
-    CreateComputePass(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", {});
+    // Passes that store or load presampled local lights must use the layout of the RIS light data buffer
+    const donut::engine::ShaderMacro compactLightMacro = { "EXTENDED_COMPACT_LIGHT_INFO", extendedCompactLightInfo ? "1" : "0" };
+
+    std::vector<donut::engine::ShaderMacro> compactLightMacros = {
+        compactLightMacro
+    };
+
+    std::vector<donut::engine::ShaderMacro> regirCompactLightMacros = {
+        GetRegirMacro(contextParameters),
+        compactLightMacro
+    };
+
+    CreateComputePass(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", compactLightMacros);
     CreateComputePass(m_PresampleEnvironmentMapPass, "app/LightingPasses/PresampleEnvironmentMap.hlsl", {});
 
     if (contextParameters.ReGIR.Mode != rtxdi::ReGIRMode::Disabled)
     {
-        CreateComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
+        CreateComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirCompactLightMacros);
     }
 
-    m_GenerateInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GenerateInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    m_GenerateInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GenerateInitialSamples.hlsl", regirCompactLightMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_TemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/TemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_SpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/SpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_ShadeSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ShadeSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_BrdfRayTracingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_ShadeSecondarySurfacesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_FusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/FusedResampling.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    m_ShadeSecondarySurfacesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirCompactLightMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    m_FusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/FusedResampling.hlsl", regirCompactLightMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_GradientsPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ComputeGradients.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_GITemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GITemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
     m_GISpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GISpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
@@ -297,6 +314,8 @@ void LightingPasses::FillResamplingConstants(
     const RenderSettings& lightingSettings,
     const rtxdi::FrameParameters& frameParameters)
 {
+    CpuProfilerScope scope(*m_Profiler, CpuProfilerSection::ResamplingConstants);
+
     const bool useTemporalResampling =
         lightingSettings.resamplingMode == ResamplingMode::Temporal ||
         lightingSettings.resamplingMode == ResamplingMode::TemporalAndSpatial ||
@@ -313,6 +332,11 @@ void LightingPasses::FillResamplingConstants(
     constants.enableTransparentGeometry = lightingSettings.enableTransparentGeometry;
     constants.enableDenoiserInputPacking = lightingSettings.enableDenoiserInputPacking;
     constants.visualizeRegirCells = lightingSettings.visualizeRegirCells;
+    constants.compactLightCounterOffset = (lightingSettings.enableRayCounts && m_Profiler->IsEnabled())
+        ? m_Profiler->GetCompactLightCounterOffset() : 0;
+    constants.enableRayCountTiles = lightingSettings.enableRayCounts && m_Profiler->IsRayCountTilesEnabled();
+    constants.rayCountTilesX = m_Profiler->GetRayCountTilesX();
+    constants.rayCountTilesY = m_Profiler->GetRayCountTilesY();
 #if WITH_NRD
     if (lightingSettings.denoiserMode != DENOISER_MODE_OFF)
     {
@@ -400,18 +424,32 @@ void LightingPasses::PrepareForLightSampling(
     const rtxdi::FrameParameters& frameParameters,
     bool enableAccumulation)
 {
+    const bool enableLocalLightPresampling = frameParameters.enableLocalLightImportanceSampling &&
+        frameParameters.numLocalLights > 0;
+
+    // Only refresh a part of the local light RIS tiles if the rest are still valid from the previous frame
+    rtxdi::FrameParameters presampleFrameParameters = frameParameters;
+    presampleFrameParameters.numLocalLightTilesToRefresh = 0;
+    if (m_LocalLightTilesValid && localSettings.localLightTileRefreshFraction < 1.f)
+    {
+        const uint32_t tileCount = context.GetParameters().TileCount;
+        presampleFrameParameters.numLocalLightTilesToRefresh = dm::clamp(
+            uint32_t(ceilf(localSettings.localLightTileRefreshFraction * float(tileCount))), 1u, tileCount);
+    }
+
     ResamplingConstants constants = {};
     constants.frameIndex = frameParameters.frameIndex;
     view.FillPlanarViewConstants(constants.view);
     previousView.FillPlanarViewConstants(constants.prevView);
-    context.FillRuntimeParameters(constants.runtimeParams, frameParameters);
+    context.FillRuntimeParameters(constants.runtimeParams, presampleFrameParameters);
     FillResamplingConstants(constants, localSettings, frameParameters);
     constants.enableAccumulation = enableAccumulation;
 
     commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
-    if (frameParameters.enableLocalLightImportanceSampling &&
-        frameParameters.numLocalLights > 0)
+    m_LocalLightTilesValid = enableLocalLightPresampling;
+
+    if (enableLocalLightPresampling)
     {
         dm::int2 presampleDispatchSize = {
             dm::div_ceil(context.GetParameters().TileSize, RTXDI_PRESAMPLING_GROUP_SIZE),
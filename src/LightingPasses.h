@@ -122,6 +122,8 @@ private:
     uint32_t m_CurrentFrameOutputReservoir = 0;
     uint32_t m_CurrentFrameGIOutputReservoir = 0;
 
+    bool m_LocalLightTilesValid = false;
+
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
     std::shared_ptr<donut::engine::Scene> m_Scene;
@@ -157,6 +159,15 @@ public:
         uint32_t numIndirectLocalLightSamples = 2;
         uint32_t numIndirectInfiniteLightSamples = 1;
         uint32_t numIndirectEnvironmentSamples = 1;
+
+        // Distribute the initial local, infinite and environment samples between the light types
+        // in proportion to their power, see rtxdi::FrameParameters::enableAdaptiveLightTypeSelection.
+        ibool enableAdaptiveLightTypeSelection = false;
+        float minLightTypeProbability = 0.05f;
+
+        // Fraction of the local light RIS tiles that are re-presampled on every frame,
+        // the rest are carried over from the previous frame.
+        float localLightTileRefreshFraction = 1.f;
         
         float temporalNormalThreshold = 0.5f;
         float temporalDepthThreshold = 0.1f;
@@ -218,7 +229,7 @@ public:
         std::shared_ptr<Profiler> profiler,
         nvrhi::IBindingLayout* bindlessLayout);
 
-    void CreatePipelines(const rtxdi::ContextParameters& contextParameters, bool useRayQuery);
+    void CreatePipelines(const rtxdi::ContextParameters& contextParameters, bool useRayQuery, bool extendedCompactLightInfo);
 
     void CreateBindingSet(
         nvrhi::rt::IAccelStruct* topLevelAS,
@@ -12,6 +12,7 @@
 
 #include "NrdIntegration.h"
 #include "RenderTargets.h"
+#include "GpuMemoryRegistry.h"
 #include <nvrhi/utils.h>
 #include <donut/core/math/math.h>
 #include <donut/engine/View.h>
@@ -490,4 +491,18 @@ void NrdIntegration::RunDenoiserPasses(
     }
 }
 
+void NrdIntegration::RegisterMemory(GpuMemoryRegistry& registry) const
+{
+    const char* owner = "NRD";
+    registry.RemoveOwner(owner);
+
+    registry.AddBuffer(owner, m_ConstantBuffer);
+
+    for (const nvrhi::TextureHandle& texture : m_PermanentTextures)
+        registry.AddTexture(owner, texture);
+
+    for (const nvrhi::TextureHandle& texture : m_TransientTextures)
+        registry.AddTexture(owner, texture);
+}
+
 #endif
@@ -18,6 +18,7 @@
 #include <donut/engine/BindingCache.h>
 
 class RenderTargets;
+class GpuMemoryRegistry;
 
 namespace donut::engine
 {
@@ -63,6 +64,8 @@ public:
         float debug);
 
     const nrd::Method GetMethod() const { return m_Method; }
+
+    void RegisterMemory(GpuMemoryRegistry& registry) const;
 };
 
 #endif
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include <rtxdi/RTXDI.h>
 
 #include <algorithm>
+#include <unordered_set>
 #include <utility>
 
 using namespace donut::math;
@@ -69,7 +70,7 @@ void PrepareLightsPass::CreatePipeline()
     m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
 }
 
-void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
+void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources, bool lightDataPreserved)
 {
     nvrhi::BindingSetDesc bindingSetDesc;
     bindingSetDesc.bindings = {
@@ -92,14 +93,26 @@ void PrepareLightsPass::CreateBindingSet(RtxdiResources& resources)
     m_GeometryInstanceToLightBuffer = resources.GeometryInstanceToLightBuffer;
     m_LocalLightPdfTexture = resources.LocalLightPdfTexture;
     m_MaxLightsInBuffer = uint32_t(resources.LightDataBuffer->getDesc().byteSize / (sizeof(PolymorphicLightInfo) * 2));
+
+    // The lights of the last preparation can stay the previous frame lights if they are still in the buffer at
+    // the same offset, and the next frame can be written after them, see Process
+    if (!lightDataPreserved || m_PreviousLightOffset + m_PreparedLightCount > m_MaxLightsInBuffer)
+    {
+        m_TaskBuilder.ClearPreviousLightBufferOffsets();
+        m_PreviousLightOffset = 0;
+        m_PreparedLightCount = 0;
+    }
+
+    // The mapping buffer has been recreated, and the light buffer may be new
+    m_TaskBuilder.InvalidateLightingEpoch();
 }
 
-void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles)
+void CountEmissiveGeometry(const SceneGraph& sceneGraph, uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles)
 {
     numEmissiveMeshes = 0;
     numEmissiveTriangles = 0;
 
-    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
+    const auto& instances = sceneGraph.GetMeshInstances();
     for (const auto& instance : instances)
     {
         for (const auto& geometry : instance->GetMesh()->geometries)
@@ -113,6 +126,11 @@ void PrepareLightsPass::CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t
     }
 }
 
+RtxdiResourceCapacities PrepareLightsPass::GetLightBufferCounts() const
+{
+    return m_TaskBuilder.GetLightBufferCounts(*m_Scene->GetSceneGraph());
+}
+
 static inline uint floatToUInt(float _V, float _Scale)
 {
     return (uint)floor(_V * _Scale + 0.5f);
@@ -191,7 +209,15 @@ static uint16_t fp32ToFp16(float v)
     return (uint16_t)(sign >> 16 | body >> 13) & 0xFFFF;
 }
 
-static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
+static void packSphereLight(const float3& center, float radius, const float3& radiance, PolymorphicLightInfo& polymorphic)
+{
+    polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
+    packLightColor(radiance, polymorphic);
+    polymorphic.center = center;
+    polymorphic.scalars = fp32ToFp16(radius);
+}
+
+bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight)
 {
     switch (light.GetLightType())
     {
@@ -264,10 +290,7 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
             float projectedArea = dm::PI_f * square(point.radius);
             float3 radiance = point.color * point.intensity / projectedArea;
 
-            polymorphic.colorTypeAndFlags = (uint32_t)PolymorphicLightType::kSphere << kPolymorphicLightTypeShift;
-            packLightColor(radiance, polymorphic);
-            polymorphic.center = float3(point.GetPosition());
-            polymorphic.scalars = fp32ToFp16(point.radius);
+            packSphereLight(float3(point.GetPosition()), point.radius, radiance, polymorphic);
         }
 
         return true;
@@ -342,6 +365,73 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
     }
 }
 
+static float calcLuminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Estimates the total power emitted into the scene by a primitive light.
+// Infinite lights are measured by the power they deliver into a sphere around the scene,
+// which makes them comparable to the power of local lights.
+float GetLightPower(const donut::engine::Light& light, float sceneCrossSection, float environmentMapRadianceIntegral)
+{
+    switch (light.GetLightType())
+    {
+    case LightType_Directional: {
+        auto& directional = static_cast<const donut::engine::DirectionalLight&>(light);
+        return calcLuminance(directional.color) * directional.irradiance * sceneCrossSection;
+    }
+    case LightType_Spot:
+    case LightType_SpotProfile: {
+        auto& spot = static_cast<const SpotLight&>(light);
+        float coneSolidAngle = 2.f * dm::PI_f * (1.f - cosf(dm::radians(spot.outerAngle)));
+        return calcLuminance(spot.color) * spot.intensity * coneSolidAngle;
+    }
+    case LightType_Point: {
+        auto& point = static_cast<const donut::engine::PointLight&>(light);
+        return calcLuminance(point.color) * point.intensity * 4.f * dm::PI_f;
+    }
+    case LightType_Environment: {
+        auto& env = static_cast<const EnvironmentLight&>(light);
+        return calcLuminance(env.radianceScale) * environmentMapRadianceIntegral * sceneCrossSection;
+    }
+    case LightType_Cylinder: {
+        auto& cylinder = static_cast<const CylinderLight&>(light);
+        return calcLuminance(cylinder.color) * cylinder.flux;
+    }
+    case LightType_Disk: {
+        auto& disk = static_cast<const DiskLight&>(light);
+        return calcLuminance(disk.color) * disk.flux;
+    }
+    case LightType_Rect: {
+        auto& rect = static_cast<const RectLight&>(light);
+        return calcLuminance(rect.color) * rect.flux;
+    }
+    default:
+        return 0.f;
+    }
+}
+
+static bool isEmissiveMaterial(const Material& material)
+{
+    return any(material.emissiveColor != 0.f) && material.emissiveIntensity > 0.f;
+}
+
+static size_t getGeometryInstanceHash(const MeshInstance* instance, size_t geometryIndex)
+{
+    size_t instanceHash = 0;
+    nvrhi::hash_combine(instanceHash, instance);
+    nvrhi::hash_combine(instanceHash, geometryIndex);
+    return instanceHash;
+}
+
+// Rough surface area of an emitter, approximated from its world space bounds
+static float getEmissiveSurfaceArea(const box3& worldBounds)
+{
+    const float3 boundsSize = worldBounds.diagonal();
+    return boundsSize.x * boundsSize.y + boundsSize.y * boundsSize.z + boundsSize.z * boundsSize.x;
+}
+
 static int isInfiniteLight(const donut::engine::Light& light)
 {
     switch (light.GetLightType())
@@ -357,46 +447,539 @@ static int isInfiniteLight(const donut::engine::Light& light)
     }
 }
 
-void PrepareLightsPass::Process(
-    nvrhi::ICommandList* commandList, 
-    const rtxdi::Context& context,
+void PrepareLightsTaskBuilder::ClearPreviousLightBufferOffsets()
+{
+    m_InstanceLightBufferOffsets.clear();
+    m_PrimitiveLightBufferOffsets.clear();
+    m_ProxyLightBufferOffsets.clear();
+}
+
+// Groups the points into the cells of the finest uniform grid over their bounds, out of the grids with 2^level cells
+// along every axis, that has at most maxClusters occupied cells. Returns the number of occupied cells, and a key
+// for the cell of every point that stays the same between calls while the points and the chosen grid don't change.
+static uint32_t clusterPoints(const std::vector<float3>& points, uint32_t maxClusters, std::vector<size_t>& outKeys)
+{
+    constexpr uint32_t maxLevel = 16;
+
+    outKeys.assign(points.size(), 0);
+    if (points.empty())
+        return 0;
+
+    float3 boundsMin = points[0];
+    float3 boundsMax = points[0];
+    for (const float3& point : points)
+    {
+        boundsMin = min(boundsMin, point);
+        boundsMax = max(boundsMax, point);
+    }
+    const float3 extent = boundsMax - boundsMin;
+    const float maxExtent = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+
+    std::vector<size_t> keys(points.size());
+    std::unordered_set<size_t> cells;
+    uint32_t clusterCount = 0;
+
+    // Level 0 puts all points into one cell, every next level halves the cell size
+    for (uint32_t level = 0; level <= maxLevel; level++)
+    {
+        const uint32_t cellsPerAxis = 1u << level;
+        const float cellScale = float(cellsPerAxis) / maxExtent;
+
+        cells.clear();
+        for (size_t index = 0; index < points.size(); index++)
+        {
+            const float3 cell = (points[index] - boundsMin) * cellScale;
+
+            size_t key = 0;
+            nvrhi::hash_combine(key, level);
+            nvrhi::hash_combine(key, std::min(uint32_t(cell.x), cellsPerAxis - 1));
+            nvrhi::hash_combine(key, std::min(uint32_t(cell.y), cellsPerAxis - 1));
+            nvrhi::hash_combine(key, std::min(uint32_t(cell.z), cellsPerAxis - 1));
+            keys[index] = key;
+            cells.insert(key);
+        }
+
+        if (level != 0 && cells.size() > maxClusters)
+            break;
+
+        outKeys.swap(keys);
+        clusterCount = uint32_t(cells.size());
+
+        // Every point has its own cell, finer grids would only change the keys
+        if (cells.size() == points.size())
+            break;
+    }
+
+    return clusterCount;
+}
+
+bool PrepareLightsTaskBuilder::UpdateEmissiveLod(const SceneGraph& sceneGraph, const float3& viewPosition)
+{
+    std::swap(m_EmissiveLodProxies, m_PreviousEmissiveLodProxies);
+    m_EmissiveLodProxies.clear();
+    m_EmissiveLodProxyLights = 0;
+    m_EmissiveLodReplacedTriangles = 0;
+
+    // hash(instance*, geometryIndex) and the bounds center of the replaced geometries
+    std::vector<size_t> proxyGeometries;
+    std::vector<float3> proxyCenters;
+
+    if (m_EmissiveLodParams.enable)
+    {
+        const uint32_t minTriangles = std::max(m_EmissiveLodParams.minTriangles, 2u);
+        const float hysteresis = std::max(m_EmissiveLodParams.hysteresis, 1.f);
+
+        for (const auto& instance : sceneGraph.GetMeshInstances())
+        {
+            const auto& mesh = instance->GetMesh();
+            const affine3 transform = instance->GetNode()->GetLocalToWorldTransformFloat();
+
+            for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+            {
+                const auto& geometry = mesh->geometries[geometryIndex];
+                const uint32_t triangleCount = geometry->numIndices / 3;
+
+                if (!isEmissiveMaterial(*geometry->material) || triangleCount < minTriangles)
+                    continue;
+
+                const box3 worldBounds = geometry->objectSpaceBounds * transform;
+                if (getEmissiveSurfaceArea(worldBounds) <= 0.f)
+                    continue;
+
+                // Solid angle of the bounding sphere, 2 pi (1 - cos(theta)) written to stay accurate when small
+                const float radiusSquared = lengthSquared(worldBounds.diagonal()) * 0.25f;
+                const float distanceSquared = lengthSquared((worldBounds.m_mins + worldBounds.m_maxs) * 0.5f - viewPosition);
+                float solidAngle = 4.f * dm::PI_f;
+                if (distanceSquared > radiusSquared)
+                {
+                    const float sinSquared = radiusSquared / distanceSquared;
+                    solidAngle = 2.f * dm::PI_f * sinSquared / (1.f + sqrtf(1.f - sinSquared));
+                }
+
+                const size_t instanceHash = getGeometryInstanceHash(instance.get(), geometryIndex);
+                const bool wasProxy = m_PreviousEmissiveLodProxies.count(instanceHash) != 0;
+                const float threshold = m_EmissiveLodParams.proxySolidAngle * (wasProxy ? hysteresis : 1.f);
+
+                if (solidAngle < threshold)
+                {
+                    proxyGeometries.push_back(instanceHash);
+                    proxyCenters.push_back(worldBounds.center());
+                    m_EmissiveLodReplacedTriangles += triangleCount;
+                }
+            }
+        }
+    }
+
+    // The proxies of nearby geometries are merged, across instances, to bound the number of proxy lights
+    std::vector<size_t> proxyKeys;
+    m_EmissiveLodProxyLights = clusterPoints(proxyCenters, std::max(m_EmissiveLodParams.maxProxyLights, 1u), proxyKeys);
+    m_EmissiveLodReplacedTriangles -= m_EmissiveLodProxyLights;
+
+    for (size_t index = 0; index < proxyGeometries.size(); index++)
+        m_EmissiveLodProxies[proxyGeometries[index]] = proxyKeys[index];
+
+    // The selection has changed if a geometry has been added, dropped or moved to another proxy
+    const bool changed = m_EmissiveLodProxies != m_PreviousEmissiveLodProxies;
+    if (changed)
+        m_EmissiveLodRevision++;
+
+    return changed;
+}
+
+void PrepareLightsTaskBuilder::SetLightStreamingParameters(const LightStreamingParameters& parameters)
+{
+    // A new cell layout resets the streaming manager, which drops its items
+    const LightStreamingParameters& previous = m_LightStreaming.GetParameters();
+    if (parameters.cellSize != previous.cellSize || parameters.slabSize != previous.slabSize)
+        m_StreamingItemsValid = false;
+
+    m_LightStreaming.SetParameters(parameters);
+}
+
+bool PrepareLightsTaskBuilder::UpdateLightStreaming(
+    const SceneGraph& sceneGraph,
+    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+    const float3& viewPosition,
+    bool sceneChanged)
+{
+    const uint32_t previousRevision = m_LightStreaming.GetResidencyRevision();
+
+    if (!m_LightStreaming.GetParameters().enable)
+    {
+        if (m_LightStreaming.GetCellCount() != 0)
+        {
+            m_LightStreaming.Reset();
+            m_StreamingGeometryItems.clear();
+            m_StreamingLightItems.clear();
+        }
+
+        m_StreamingItemsValid = false;
+        return m_LightStreaming.GetResidencyRevision() != previousRevision;
+    }
+
+    const float view[3] = { viewPosition.x, viewPosition.y, viewPosition.z };
+
+    // Only the residency depends on the view, the items stay the same until the scene changes
+    if (m_StreamingItemsValid && !sceneChanged)
+    {
+        m_LightStreaming.Update(view);
+        return m_LightStreaming.GetResidencyRevision() != previousRevision;
+    }
+
+    // The emissive geometries, then the local primitive lights
+    std::vector<LightStreamingItem> items;
+    std::vector<const Light*> streamedLights;
+
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+        {
+            const auto& geometry = mesh->geometries[geometryIndex];
+            if (!isEmissiveMaterial(*geometry->material))
+                continue;
+
+            const box3 worldBounds = geometry->objectSpaceBounds * instance->GetNode()->GetLocalToWorldTransformFloat();
+            const float3 center = worldBounds.center();
+            items.push_back({ { center.x, center.y, center.z }, geometry->numIndices / 3, getGeometryInstanceHash(instance.get(), geometryIndex) });
+        }
+    }
+
+    const size_t numGeometryItems = items.size();
+
+    for (const std::shared_ptr<Light>& pLight : sceneLights)
+    {
+        if (isInfiniteLight(*pLight))
+            continue;
+
+        const float3 position = float3(pLight->GetPosition());
+        items.push_back({ { position.x, position.y, position.z }, 1, reinterpret_cast<size_t>(pLight.get()) });
+        streamedLights.push_back(pLight.get());
+    }
+
+    if (m_LightStreaming.SetItems(items))
+    {
+        m_StreamingGeometryItems.clear();
+        m_StreamingLightItems.clear();
+
+        for (size_t item = 0; item < numGeometryItems; item++)
+            m_StreamingGeometryItems[items[item].key] = uint32_t(item);
+
+        for (size_t light = 0; light < streamedLights.size(); light++)
+            m_StreamingLightItems[streamedLights[light]] = uint32_t(numGeometryItems + light);
+    }
+
+    m_StreamingItemsValid = true;
+    m_LightStreaming.Update(view);
+
+    return m_LightStreaming.GetResidencyRevision() != previousRevision;
+}
+
+bool PrepareLightsTaskBuilder::GetStreamedLightOffset(uint32_t item, uint32_t lightCount, std::vector<uint32_t>& cellLightCounts, uint32_t& lightBufferOffset) const
+{
+    const uint32_t cell = m_LightStreaming.GetItemCell(item);
+
+    uint32_t firstLight = 0;
+    uint32_t lightCapacity = 0;
+    if (!m_LightStreaming.GetCellLightRange(cell, firstLight, lightCapacity))
+        return false;
+
+    // Geometry that has changed after UpdateLightStreaming may not fit
+    if (cellLightCounts[cell] + lightCount > lightCapacity)
+        return false;
+
+    lightBufferOffset = firstLight + cellLightCounts[cell];
+    cellLightCounts[cell] += lightCount;
+    return true;
+}
+
+RtxdiResourceCapacities PrepareLightsTaskBuilder::GetLightBufferCounts(const SceneGraph& sceneGraph) const
+{
+    RtxdiResourceCapacities counts;
+    CountEmissiveGeometry(sceneGraph, counts.emissiveMeshes, counts.emissiveTriangles);
+    counts.primitiveLights = uint32_t(sceneGraph.GetLights().size());
+    counts.geometryInstances = uint32_t(sceneGraph.GetGeometryInstancesCount());
+
+    // The emissive LOD proxies are primitive lights too
+    if (m_EmissiveLodParams.enable)
+        counts.primitiveLights += std::max(m_EmissiveLodParams.maxProxyLights, 1u);
+
+    if (m_LightStreaming.GetParameters().enable)
+    {
+        counts.emissiveTriangles = m_LightStreaming.GetLocalLightCapacity();
+        counts.primitiveLights += uint32_t(m_LightStreaming.GetCellCount()) + 2;
+    }
+
+    return counts;
+}
+
+// The streamed lights only fill parts of the slab ranges. Sorts the tasks by their offset for the binary search
+// in the shader, and covers the unused local lights with a zero power light, so that none of the lights left
+// in the buffer from older frames are sampled.
+static void fillLocalLightGaps(std::vector<PrepareLightsTask>& tasks, std::vector<PolymorphicLightInfo>& primitiveLightInfos, uint32_t numLocalLights)
+{
+    const auto byOffset = [](const PrepareLightsTask& a, const PrepareLightsTask& b) { return a.lightBufferOffset < b.lightBufferOffset; };
+    std::sort(tasks.begin(), tasks.end(), byOffset);
+
+    const uint32_t nullLightIndex = uint32_t(primitiveLightInfos.size());
+    const size_t lightTaskCount = tasks.size();
+    uint32_t lightOffset = 0;
+
+    const auto addGap = [&](uint32_t gapEnd)
+    {
+        gapEnd = std::min(gapEnd, numLocalLights);
+        if (gapEnd <= lightOffset)
+            return;
+
+        PrepareLightsTask task;
+        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | nullLightIndex;
+        task.lightBufferOffset = lightOffset;
+        task.triangleCount = gapEnd - lightOffset;
+        task.previousLightBufferOffset = -1;
+        tasks.push_back(task);
+    };
+
+    for (size_t index = 0; index < lightTaskCount; index++)
+    {
+        const PrepareLightsTask task = tasks[index];
+        addGap(task.lightBufferOffset);
+        lightOffset = std::max(lightOffset, task.lightBufferOffset + task.triangleCount);
+    }
+    addGap(numLocalLights);
+
+    if (tasks.size() == lightTaskCount)
+        return;
+
+    PolymorphicLightInfo nullLight = {};
+    packSphereLight(float3(0.f), 1.f, float3(0.f), nullLight);
+    primitiveLightInfos.push_back(nullLight);
+
+    std::inplace_merge(tasks.begin(), tasks.begin() + lightTaskCount, tasks.end(), byOffset);
+}
+
+size_t PrepareLightsTaskBuilder::HashSceneLighting(
+    const SceneGraph& sceneGraph,
+    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+    bool enableImportanceSampledEnvironmentLight)
+{
+    size_t hash = 0;
+    m_AnimatedEmissiveGeometry = false;
+
+    // The scene bounds determine the power of the infinite lights
+    const box3 sceneBounds = sceneGraph.GetRootNode()->GetGlobalBoundingBox();
+    for (const float3& corner : { sceneBounds.m_mins, sceneBounds.m_maxs })
+    {
+        nvrhi::hash_combine(hash, corner.x);
+        nvrhi::hash_combine(hash, corner.y);
+        nvrhi::hash_combine(hash, corner.z);
+    }
+
+    nvrhi::hash_combine(hash, sceneGraph.GetGeometryInstancesCount());
+
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const auto& mesh = instance->GetMesh();
+        bool emissiveInstance = false;
+
+        for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
+        {
+            const auto& geometry = mesh->geometries[geometryIndex];
+            const auto& material = *geometry->material;
+
+            if (!isEmissiveMaterial(material))
+                continue;
+
+            emissiveInstance = true;
+            nvrhi::hash_combine(hash, geometryIndex);
+            nvrhi::hash_combine(hash, geometry->numIndices);
+            nvrhi::hash_combine(hash, material.emissiveColor.x);
+            nvrhi::hash_combine(hash, material.emissiveColor.y);
+            nvrhi::hash_combine(hash, material.emissiveColor.z);
+            nvrhi::hash_combine(hash, material.emissiveIntensity);
+            // Textures are loaded asynchronously, the shader sees them once they are created
+            nvrhi::hash_combine(hash, material.emissiveTexture ? material.emissiveTexture->texture.Get() : nullptr);
+        }
+
+        if (!emissiveInstance)
+            continue;
+
+        nvrhi::hash_combine(hash, instance.get());
+        nvrhi::hash_combine(hash, instance->GetInstanceIndex());
+        nvrhi::hash_combine(hash, instance->GetGeometryInstanceIndex());
+
+        const affine3 transform = instance->GetNode()->GetLocalToWorldTransformFloat();
+        for (const float3& row : { transform.m_linear.row0, transform.m_linear.row1, transform.m_linear.row2, transform.m_translation })
+        {
+            nvrhi::hash_combine(hash, row.x);
+            nvrhi::hash_combine(hash, row.y);
+            nvrhi::hash_combine(hash, row.z);
+        }
+
+        m_AnimatedEmissiveGeometry |= mesh->skinPrototype != nullptr;
+    }
+
+    for (const std::shared_ptr<Light>& pLight : sceneLights)
+    {
+        // The converted light contains everything the shader reads, including the transform
+        PolymorphicLightInfo polymorphicLight = {};
+        if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
+            continue;
+
+        static_assert(sizeof(PolymorphicLightInfo) % sizeof(uint32_t) == 0);
+        const uint32_t* words = reinterpret_cast<const uint32_t*>(&polymorphicLight);
+        for (size_t word = 0; word < sizeof(PolymorphicLightInfo) / sizeof(uint32_t); word++)
+            nvrhi::hash_combine(hash, words[word]);
+
+        nvrhi::hash_combine(hash, pLight.get());
+    }
+
+    return hash;
+}
+
+bool PrepareLightsTaskBuilder::UpdateLightingEpoch(
+    const SceneGraph& sceneGraph,
     const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
     bool enableImportanceSampledEnvironmentLight,
-    rtxdi::FrameParameters& outFrameParameters)
+    float environmentMapRadianceIntegral,
+    bool sceneChanged,
+    bool geometryAnimated)
 {
-    const rtxdi::ContextParameters& contextParameters = context.GetParameters();
+    if (sceneChanged || !m_LightingInputsValid)
+        m_SceneLightingHash = HashSceneLighting(sceneGraph, sceneLights, enableImportanceSampledEnvironmentLight);
 
-    commandList->beginMarker("PrepareLights");
+    size_t hash = m_SceneLightingHash;
+    nvrhi::hash_combine(hash, enableImportanceSampledEnvironmentLight);
+    nvrhi::hash_combine(hash, environmentMapRadianceIntegral);
+    nvrhi::hash_combine(hash, m_EmissiveLodRevision);
+    nvrhi::hash_combine(hash, m_LightStreaming.GetParameters().enable);
+    nvrhi::hash_combine(hash, m_LightStreaming.GetResidencyRevision());
 
-    std::vector<PrepareLightsTask> tasks;
-    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    const bool changed = !m_LightingInputsValid || hash != m_LightingInputsHash || (geometryAnimated && m_AnimatedEmissiveGeometry);
+
+    m_LightingInputsHash = hash;
+    m_LightingInputsValid = true;
+
+    if (changed)
+        m_LightingEpoch++;
+
+    return changed;
+}
+
+uint32_t PrepareLightsTaskBuilder::BuildTasks(
+    const SceneGraph& sceneGraph,
+    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+    bool enableImportanceSampledEnvironmentLight,
+    float environmentMapRadianceIntegral,
+    std::vector<PrepareLightsTask>& outTasks,
+    std::vector<PolymorphicLightInfo>& outPrimitiveLightInfos,
+    std::vector<uint32_t>& outGeometryInstanceToLight,
+    rtxdi::FrameParameters& outFrameParameters)
+{
+    // Infinite light power is measured through the bounding sphere of the scene
+    const box3 sceneBounds = sceneGraph.GetRootNode()->GetGlobalBoundingBox();
+    const float sceneRadius = sceneBounds.isempty() ? 1.f : length(sceneBounds.diagonal()) * 0.5f;
+    const float sceneCrossSection = dm::PI_f * square(sceneRadius);
+
+    float localLightPower = 0.f;
+    float infiniteLightPower = 0.f;
+    float environmentLightPower = 0.f;
+
+    outTasks.clear();
+    outPrimitiveLightInfos.clear();
+    outGeometryInstanceToLight.assign(sceneGraph.GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
     uint32_t lightBufferOffset = 0;
-    std::vector<uint32_t> geometryInstanceToLight(m_Scene->GetSceneGraph()->GetGeometryInstancesCount(), RTXDI_INVALID_LIGHT_INDEX);
 
-    const auto& instances = m_Scene->GetSceneGraph()->GetMeshInstances();
+    std::swap(m_ProxyLightBufferOffsets, m_PreviousProxyLightBufferOffsets);
+    m_ProxyLightBufferOffsets.clear();
+
+    // The emissive LOD proxies collect the bounds and the power of their geometries
+    struct ProxyLight
+    {
+        size_t key;
+        float3 boundsMin;
+        float3 boundsMax;
+        float3 radiantArea; // sum of radiance * surfaceArea
+        uint32_t lightBufferOffset;
+    };
+    std::vector<ProxyLight> proxyLights;
+    std::unordered_map<size_t, size_t> proxyLightIndices; // proxy key -> index in proxyLights
+
+    // While streaming, the lights of each resident cell are placed one after another in the cell's slab range
+    const bool streaming = m_LightStreaming.GetParameters().enable;
+    std::vector<uint32_t> cellLightCounts(streaming ? m_LightStreaming.GetCellCount() : 0, 0);
+
+    const auto& instances = sceneGraph.GetMeshInstances();
     for (const auto& instance : instances)
     {
         const auto& mesh = instance->GetMesh();
 
-        assert(instance->GetGeometryInstanceIndex() < geometryInstanceToLight.size());
+        assert(instance->GetGeometryInstanceIndex() < outGeometryInstanceToLight.size());
         uint32_t firstGeometryInstanceIndex = instance->GetGeometryInstanceIndex();
 
         for (size_t geometryIndex = 0; geometryIndex < mesh->geometries.size(); ++geometryIndex)
         {
             const auto& geometry = mesh->geometries[geometryIndex];
 
-            size_t instanceHash = 0;
-            nvrhi::hash_combine(instanceHash, instance.get());
-            nvrhi::hash_combine(instanceHash, geometryIndex);
+            const size_t instanceHash = getGeometryInstanceHash(instance.get(), geometryIndex);
 
-            if (!any(geometry->material->emissiveColor != 0.f) || geometry->material->emissiveIntensity <= 0.f)
+            if (!isEmissiveMaterial(*geometry->material))
             {
                 // remove the info about this instance, just in case it was emissive and now it's not
                 m_InstanceLightBufferOffsets.erase(instanceHash);
                 continue;
             }
 
-            geometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = lightBufferOffset;
+            auto pProxy = m_EmissiveLodProxies.find(instanceHash);
+            const bool proxy = pProxy != m_EmissiveLodProxies.end();
+            const bool newProxyLight = proxy && proxyLightIndices.count(pProxy->second) == 0;
+            const uint32_t triangleCount = geometry->numIndices / 3;
+
+            uint32_t geometryLightOffset = lightBufferOffset;
+            if (streaming)
+            {
+                auto pItem = m_StreamingGeometryItems.find(instanceHash);
+
+                // A material has become emissive without a change in the scene graph, regroup the items on the next frame
+                if (pItem == m_StreamingGeometryItems.end())
+                    m_StreamingItemsValid = false;
+
+                if (pItem == m_StreamingGeometryItems.end() ||
+                    !GetStreamedLightOffset(pItem->second, proxy ? uint32_t(newProxyLight) : triangleCount, cellLightCounts, geometryLightOffset))
+                {
+                    m_InstanceLightBufferOffsets.erase(instanceHash);
+                    continue;
+                }
+            }
+
+            // Rough emitted power of a diffuse emitter, with the surface area approximated from the bounds
+            const box3 worldBounds = geometry->objectSpaceBounds * instance->GetNode()->GetLocalToWorldTransformFloat();
+            const float surfaceArea = getEmissiveSurfaceArea(worldBounds);
+            const float3 radiance = geometry->material->emissiveColor * geometry->material->emissiveIntensity;
+            localLightPower += calcLuminance(radiance) * dm::PI_f * surfaceArea;
+
+            if (proxy)
+            {
+                // While streaming, the proxy light takes a light in the cell of its first resident geometry,
+                // and only the geometries in the resident cells contribute to it
+                if (newProxyLight)
+                {
+                    proxyLightIndices[pProxy->second] = proxyLights.size();
+                    proxyLights.push_back({ pProxy->second, worldBounds.m_mins, worldBounds.m_maxs, float3(0.f), geometryLightOffset });
+                }
+
+                ProxyLight& proxyLight = proxyLights[proxyLightIndices[pProxy->second]];
+                proxyLight.boundsMin = min(proxyLight.boundsMin, worldBounds.m_mins);
+                proxyLight.boundsMax = max(proxyLight.boundsMax, worldBounds.m_maxs);
+                proxyLight.radiantArea += radiance * surfaceArea;
+
+                // The geometry has no light index: the proxies are sphere lights, which the BRDF MIS treats as
+                // analytic (see RAB_IsAnalyticLightSample), so BRDF rays must not turn their hits into samples
+                m_InstanceLightBufferOffsets.erase(instanceHash);
+                continue;
+            }
+
+            outGeometryInstanceToLight[firstGeometryInstanceIndex + geometryIndex] = geometryLightOffset;
 
             // find the previous offset of this instance in the light buffer
             auto pOffset = m_InstanceLightBufferOffsets.find(instanceHash);
@@ -405,20 +988,51 @@ void PrepareLightsPass::Process(
 
             PrepareLightsTask task;
             task.instanceAndGeometryIndex = (instance->GetInstanceIndex() << 12) | uint32_t(geometryIndex & 0xfff);
-            task.lightBufferOffset = lightBufferOffset;
-            task.triangleCount = geometry->numIndices / 3;
+            task.lightBufferOffset = geometryLightOffset;
+            task.triangleCount = triangleCount;
             task.previousLightBufferOffset = (pOffset != m_InstanceLightBufferOffsets.end()) ? int(pOffset->second) : -1;
 
             // record the current offset of this instance for use on the next frame
-            m_InstanceLightBufferOffsets[instanceHash] = lightBufferOffset;
+            m_InstanceLightBufferOffsets[instanceHash] = geometryLightOffset;
 
-            lightBufferOffset += task.triangleCount;
+            if (!streaming)
+                lightBufferOffset += task.triangleCount;
 
-            tasks.push_back(task);
+            outTasks.push_back(task);
         }
     }
 
-    commandList->writeBuffer(m_GeometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
+    // The emissive LOD proxies follow the emissive triangles as local primitive lights. Every proxy is the
+    // bounding sphere of its geometries, so that the shadow rays towards its samples end before they reach
+    // the emissive meshes inside, and the surfaces inside the sphere are lit by its inner side.
+    // Its radiance is scaled to emit the same power as the geometries, and emissive textures are not sampled.
+    for (const ProxyLight& proxyLight : proxyLights)
+    {
+        const float3 center = (proxyLight.boundsMin + proxyLight.boundsMax) * 0.5f;
+        const float radius = std::max(length(proxyLight.boundsMax - proxyLight.boundsMin) * 0.5f, 1e-3f);
+        const float3 radiance = proxyLight.radiantArea / (4.f * dm::PI_f * square(radius));
+
+        PolymorphicLightInfo proxyLightInfo = {};
+        packSphereLight(center, radius, radiance, proxyLightInfo);
+
+        const uint32_t proxyLightOffset = streaming ? proxyLight.lightBufferOffset : lightBufferOffset++;
+        auto pOffset = m_PreviousProxyLightBufferOffsets.find(proxyLight.key);
+
+        PrepareLightsTask task;
+        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(outPrimitiveLightInfos.size());
+        task.lightBufferOffset = proxyLightOffset;
+        task.triangleCount = 1;
+        task.previousLightBufferOffset = (pOffset != m_PreviousProxyLightBufferOffsets.end()) ? int(pOffset->second) : -1;
+
+        m_ProxyLightBufferOffsets[proxyLight.key] = proxyLightOffset;
+
+        outTasks.push_back(task);
+        outPrimitiveLightInfos.push_back(proxyLightInfo);
+    }
+
+    // All streamed lights are in the slab ranges, the infinite lights follow them
+    if (streaming)
+        lightBufferOffset = m_LightStreaming.GetLocalLightCapacity();
 
     outFrameParameters.firstLocalLight = 0;
     outFrameParameters.numLocalLights = lightBufferOffset;
@@ -438,39 +1052,143 @@ void PrepareLightsPass::Process(
         if (!ConvertLight(*pLight, polymorphicLight, enableImportanceSampledEnvironmentLight))
             continue;
 
+        const bool streamedLight = streaming && !isInfiniteLight(*pLight);
+
+        uint32_t primitiveLightOffset = lightBufferOffset;
+        if (streamedLight)
+        {
+            auto pItem = m_StreamingLightItems.find(pLight.get());
+            if (pItem == m_StreamingLightItems.end() ||
+                !GetStreamedLightOffset(pItem->second, 1, cellLightCounts, primitiveLightOffset))
+            {
+                m_PrimitiveLightBufferOffsets.erase(pLight.get());
+                continue;
+            }
+        }
+
         // find the previous offset of this instance in the light buffer
         auto pOffset = m_PrimitiveLightBufferOffsets.find(pLight.get());
 
         PrepareLightsTask task;
-        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(primitiveLightInfos.size());
-        task.lightBufferOffset = lightBufferOffset;
+        task.instanceAndGeometryIndex = TASK_PRIMITIVE_LIGHT_BIT | uint32_t(outPrimitiveLightInfos.size());
+        task.lightBufferOffset = primitiveLightOffset;
         task.triangleCount = 1; // technically zero, but we need to allocate 1 thread in the grid to process this light
         task.previousLightBufferOffset = (pOffset != m_PrimitiveLightBufferOffsets.end()) ? pOffset->second : -1;
 
         // record the current offset of this instance for use on the next frame
-        m_PrimitiveLightBufferOffsets[pLight.get()] = lightBufferOffset;
+        m_PrimitiveLightBufferOffsets[pLight.get()] = primitiveLightOffset;
 
-        lightBufferOffset += task.triangleCount;
+        if (!streamedLight)
+            lightBufferOffset += task.triangleCount;
 
-        tasks.push_back(task);
-        primitiveLightInfos.push_back(polymorphicLight);
+        outTasks.push_back(task);
+        outPrimitiveLightInfos.push_back(polymorphicLight);
+
+        const float lightPower = GetLightPower(*pLight, sceneCrossSection, environmentMapRadianceIntegral);
 
         if (pLight->GetLightType() == LightType_Environment && enableImportanceSampledEnvironmentLight)
+        {
             numImportanceSampledEnvironmentLights++;
+            environmentLightPower += lightPower;
+        }
         else if (isInfiniteLight(*pLight))
+        {
             numInfinitePrimLights++;
+            infiniteLightPower += lightPower;
+        }
         else
+        {
             numFinitePrimLights++;
+            localLightPower += lightPower;
+        }
     }
 
     assert(numImportanceSampledEnvironmentLights <= 1);
     
-    outFrameParameters.numLocalLights += numFinitePrimLights;
+    if (streaming)
+        fillLocalLightGaps(outTasks, outPrimitiveLightInfos, outFrameParameters.numLocalLights);
+    else
+        outFrameParameters.numLocalLights += numFinitePrimLights;
     outFrameParameters.firstInfiniteLight = outFrameParameters.numLocalLights;
     outFrameParameters.numInfiniteLights = numInfinitePrimLights;
     outFrameParameters.environmentLightIndex = outFrameParameters.firstInfiniteLight + outFrameParameters.numInfiniteLights;
     outFrameParameters.environmentLightPresent = numImportanceSampledEnvironmentLights;
-    
+    outFrameParameters.localLightPower = localLightPower;
+    outFrameParameters.infiniteLightPower = infiniteLightPower;
+    outFrameParameters.environmentLightPower = environmentLightPower;
+
+    return lightBufferOffset;
+}
+
+void PrepareLightsPass::UpdateEmissiveLod(const EmissiveLodParameters& parameters, const float3& viewPosition)
+{
+    m_TaskBuilder.SetEmissiveLodParameters(parameters);
+    m_TaskBuilder.UpdateEmissiveLod(*m_Scene->GetSceneGraph(), viewPosition);
+}
+
+void PrepareLightsPass::UpdateLightStreaming(const LightStreamingParameters& parameters, const float3& viewPosition, bool sceneChanged)
+{
+    m_TaskBuilder.SetLightStreamingParameters(parameters);
+    m_TaskBuilder.UpdateLightStreaming(*m_Scene->GetSceneGraph(), m_Scene->GetSceneGraph()->GetLights(), viewPosition, sceneChanged);
+}
+
+static void CopyLightFrameParameters(const rtxdi::FrameParameters& source, rtxdi::FrameParameters& destination)
+{
+    destination.firstLocalLight = source.firstLocalLight;
+    destination.numLocalLights = source.numLocalLights;
+    destination.firstInfiniteLight = source.firstInfiniteLight;
+    destination.numInfiniteLights = source.numInfiniteLights;
+    destination.environmentLightPresent = source.environmentLightPresent;
+    destination.environmentLightIndex = source.environmentLightIndex;
+    destination.localLightPower = source.localLightPower;
+    destination.infiniteLightPower = source.infiniteLightPower;
+    destination.environmentLightPower = source.environmentLightPower;
+}
+
+bool PrepareLightsPass::Process(
+    nvrhi::ICommandList* commandList, 
+    const rtxdi::Context& context,
+    const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+    bool enableImportanceSampledEnvironmentLight,
+    float environmentMapRadianceIntegral,
+    bool sceneChanged,
+    bool geometryAnimated,
+    rtxdi::FrameParameters& outFrameParameters)
+{
+    m_Skipped = !m_TaskBuilder.UpdateLightingEpoch(*m_Scene->GetSceneGraph(), sceneLights,
+        enableImportanceSampledEnvironmentLight, environmentMapRadianceIntegral, sceneChanged, geometryAnimated);
+
+    if (m_Skipped)
+    {
+        // The lights of the last preparation stay in place and are both the current and the previous frame lights.
+        // Map every light to itself for the temporal passes; the other half of the mapping buffer is not referenced.
+        if (!m_IdentityMappingWritten && m_PreparedLightCount != 0)
+        {
+            std::vector<uint32_t> identityMapping(m_PreparedLightCount);
+            for (uint32_t index = 0; index < m_PreparedLightCount; index++)
+                identityMapping[index] = m_PreviousLightOffset + index + 1;
+
+            commandList->writeBuffer(m_LightIndexMappingBuffer, identityMapping.data(), identityMapping.size() * sizeof(uint32_t),
+                uint64_t(m_PreviousLightOffset) * sizeof(uint32_t));
+        }
+        m_IdentityMappingWritten = true;
+
+        CopyLightFrameParameters(m_PreparedFrameParameters, outFrameParameters);
+        return false;
+    }
+
+    commandList->beginMarker("PrepareLights");
+
+    std::vector<PrepareLightsTask> tasks;
+    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    std::vector<uint32_t> geometryInstanceToLight;
+
+    const uint32_t lightBufferOffset = m_TaskBuilder.BuildTasks(*m_Scene->GetSceneGraph(), sceneLights,
+        enableImportanceSampledEnvironmentLight, environmentMapRadianceIntegral,
+        tasks, primitiveLightInfos, geometryInstanceToLight, outFrameParameters);
+
+    commandList->writeBuffer(m_GeometryInstanceToLightBuffer, geometryInstanceToLight.data(), geometryInstanceToLight.size() * sizeof(uint32_t));
+
     commandList->writeBuffer(m_TaskBuffer, tasks.data(), tasks.size() * sizeof(PrepareLightsTask));
 
     if (!primitiveLightInfos.empty())
@@ -493,8 +1211,10 @@ void PrepareLightsPass::Process(
 
     PrepareLightsConstants constants;
     constants.numTasks = uint32_t(tasks.size());
-    constants.currentFrameLightOffset = m_MaxLightsInBuffer * m_OddFrame;
-    constants.previousFrameLightOffset = m_MaxLightsInBuffer * !m_OddFrame;
+    // The lights alternate between the two halves of the buffer. After the buffer has grown, the previous lights
+    // stay at their old offset in the first half, and the current lights go to the second half.
+    constants.currentFrameLightOffset = (m_PreviousLightOffset < m_MaxLightsInBuffer) ? m_MaxLightsInBuffer : 0;
+    constants.previousFrameLightOffset = m_PreviousLightOffset;
     commandList->setPushConstants(&constants, sizeof(constants));
 
     commandList->dispatch(dm::div_ceil(lightBufferOffset, 256));
@@ -505,5 +1225,10 @@ void PrepareLightsPass::Process(
     outFrameParameters.firstInfiniteLight += constants.currentFrameLightOffset;
     outFrameParameters.environmentLightIndex += constants.currentFrameLightOffset;
 
-    m_OddFrame = !m_OddFrame;
+    CopyLightFrameParameters(outFrameParameters, m_PreparedFrameParameters);
+    m_PreparedLightCount = lightBufferOffset;
+    m_PreviousLightOffset = constants.currentFrameLightOffset;
+    m_IdentityMappingWritten = false;
+
+    return true;
 }
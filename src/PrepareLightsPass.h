@@ -10,11 +10,15 @@
 
 #pragma once
 
+#include "LightStreaming.h"
+#include "RtxdiResourceCapacityPolicy.h"
+
 #include <donut/engine/SceneGraph.h>
 #include <nvrhi/nvrhi.h>
 #include <rtxdi/RTXDI.h>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 
 namespace donut::engine
@@ -26,6 +30,151 @@ namespace donut::engine
 }
 
 class RtxdiResources;
+struct PolymorphicLightInfo;
+struct PrepareLightsTask;
+
+// Converts a scene light into the packed representation used by the light buffer.
+// Returns false if the light type is not supported or the light is incomplete.
+bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo& polymorphic, bool enableImportanceSampledEnvironmentLight);
+
+// Estimates the total power emitted into the scene by a primitive light, see FrameParameters::localLightPower.
+float GetLightPower(const donut::engine::Light& light, float sceneCrossSection, float environmentMapRadianceIntegral);
+
+// Counts the geometries with an emissive material in all mesh instances, and their triangles.
+// These are the sizes needed for the emissive triangle lights and the tasks that create them.
+void CountEmissiveGeometry(const donut::engine::SceneGraph& sceneGraph, uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles);
+
+struct EmissiveLodParameters
+{
+    bool enable = false;
+
+    // Emissive geometries whose bounding sphere covers a smaller solid angle than this, in steradians,
+    // are replaced with proxy sphere lights instead of a light per triangle
+    float proxySolidAngle = 1e-4f;
+
+    // A proxy goes back to triangle lights when its solid angle exceeds proxySolidAngle times this,
+    // so that geometries near the threshold don't switch on every frame
+    float hysteresis = 2.f;
+
+    // Geometries with fewer triangles are always kept as triangle lights
+    uint32_t minTriangles = 16;
+
+    // The replaced geometries of all instances are grouped into the cells of the finest uniform grid that has
+    // at most this many occupied cells, and every cell becomes one proxy light enclosing its geometries
+    uint32_t maxProxyLights = 64;
+};
+
+// The CPU part of PrepareLightsPass::Process: builds the task list, the primitive light data and the
+// geometry instance to light mapping from the scene graph. It doesn't use the device,
+// which makes it possible to run it on a synthetic scene graph, see tools/rtxdi-bench.
+class PrepareLightsTaskBuilder
+{
+private:
+    std::unordered_map<size_t, uint32_t> m_InstanceLightBufferOffsets; // hash(instance*, geometryIndex) -> bufferOffset
+    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightBufferOffsets;
+
+    size_t m_SceneLightingHash = 0; // the part of m_LightingInputsHash that is only recomputed on scene changes
+    size_t m_LightingInputsHash = 0;
+    uint32_t m_LightingEpoch = 0;
+    bool m_LightingInputsValid = false;
+    bool m_AnimatedEmissiveGeometry = false;
+
+    size_t HashSceneLighting(
+        const donut::engine::SceneGraph& sceneGraph,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+        bool enableImportanceSampledEnvironmentLight);
+
+    EmissiveLodParameters m_EmissiveLodParams;
+    std::unordered_map<size_t, size_t> m_EmissiveLodProxies; // hash(instance*, geometryIndex) of the replaced geometries -> proxy key
+    std::unordered_map<size_t, size_t> m_PreviousEmissiveLodProxies;
+    std::unordered_map<size_t, uint32_t> m_ProxyLightBufferOffsets; // proxy key -> bufferOffset
+    std::unordered_map<size_t, uint32_t> m_PreviousProxyLightBufferOffsets;
+    uint32_t m_EmissiveLodRevision = 0;
+    uint32_t m_EmissiveLodProxyLights = 0;
+    uint32_t m_EmissiveLodReplacedTriangles = 0;
+
+    LightStreamingManager m_LightStreaming;
+    std::unordered_map<size_t, uint32_t> m_StreamingGeometryItems; // hash(instance*, geometryIndex) -> streaming item
+    std::unordered_map<const donut::engine::Light*, uint32_t> m_StreamingLightItems;
+    bool m_StreamingItemsValid = false;
+
+    // Takes the next lightCount lights of the slab range of the item's cell, returns false if the cell is not resident
+    bool GetStreamedLightOffset(uint32_t item, uint32_t lightCount, std::vector<uint32_t>& cellLightCounts, uint32_t& lightBufferOffset) const;
+
+public:
+    void SetEmissiveLodParameters(const EmissiveLodParameters& parameters) { m_EmissiveLodParams = parameters; }
+    [[nodiscard]] const EmissiveLodParameters& GetEmissiveLodParameters() const { return m_EmissiveLodParams; }
+
+    // Chooses the emissive geometries that BuildTasks replaces with proxy sphere lights, by the solid angle
+    // of their bounds seen from the view position, and groups them into at most maxProxyLights proxies.
+    // The proxies are local primitive lights placed after the emissive triangles, and their geometries have
+    // no light index for the rays that hit them. Returns true if the selection has changed.
+    bool UpdateEmissiveLod(const donut::engine::SceneGraph& sceneGraph, const dm::float3& viewPosition);
+
+    // Number of geometries replaced by the proxies
+    [[nodiscard]] size_t GetEmissiveLodProxyCount() const { return m_EmissiveLodProxies.size(); }
+    // Number of proxy lights, at most maxProxyLights. While streaming, the proxies without any geometry
+    // in the resident cells are left out of the light buffer.
+    [[nodiscard]] uint32_t GetEmissiveLodProxyLights() const { return m_EmissiveLodProxyLights; }
+    // Number of triangle lights removed by the proxies, net of the proxy lights themselves
+    [[nodiscard]] uint32_t GetEmissiveLodReplacedTriangles() const { return m_EmissiveLodReplacedTriangles; }
+
+    // Changing the cell size or the slab size unloads all cells
+    void SetLightStreamingParameters(const LightStreamingParameters& parameters);
+
+    // Groups the emissive geometries and the local primitive lights into streaming cells and updates their residency
+    // for the view position. While streaming is enabled, BuildTasks only creates the lights of the resident cells, each
+    // cell in its own slab range of the local lights, and the unused lights of the ranges have zero power.
+    // The cells are only regrouped when sceneChanged is set, i.e. when nodes have been added, removed or moved,
+    // or when the cell layout or the emissive geometries have changed. Returns true if the residency has changed.
+    bool UpdateLightStreaming(
+        const donut::engine::SceneGraph& sceneGraph,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+        const dm::float3& viewPosition,
+        bool sceneChanged);
+
+    [[nodiscard]] const LightStreamingManager& GetLightStreaming() const { return m_LightStreaming; }
+
+    // Sizes of the light buffers that BuildTasks fills for the scene, as the counts for RtxdiResourceCapacityPolicy.
+    // While light streaming is enabled, the local lights are the slab ranges of the resident cells, and the unused
+    // parts of the ranges take one task per gap: at most one per cell and one before the infinite lights.
+    // The emissive LOD proxies take up to maxProxyLights primitive lights.
+    [[nodiscard]] RtxdiResourceCapacities GetLightBufferCounts(const donut::engine::SceneGraph& sceneGraph) const;
+
+    // Hashes everything that BuildTasks and the PrepareLights shader read: the emissive geometry, its materials
+    // and transforms, the primitive lights and the environment light settings. The lighting epoch advances
+    // when the hash changes, and the light buffer of the previous epoch can be reused while it stays the same.
+    // Walking the scene is about as expensive as BuildTasks, so the emissive geometry and the lights are only
+    // hashed again when sceneChanged is set: the caller sets it when the scene graph, a material or a light
+    // may have changed. Skinned vertices are not hashed, set geometryAnimated when they may have changed,
+    // and emissive skinned geometry will count as changed. Returns true if the epoch has advanced.
+    bool UpdateLightingEpoch(
+        const donut::engine::SceneGraph& sceneGraph,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+        bool enableImportanceSampledEnvironmentLight,
+        float environmentMapRadianceIntegral,
+        bool sceneChanged,
+        bool geometryAnimated);
+
+    // Forgets the light buffer offsets of the previous frame, all lights of the next BuildTasks will be new
+    void ClearPreviousLightBufferOffsets();
+
+    // Forces the next UpdateLightingEpoch to advance the epoch, e.g. when the light buffers have been recreated
+    void InvalidateLightingEpoch() { m_LightingInputsValid = false; }
+    [[nodiscard]] uint32_t GetLightingEpoch() const { return m_LightingEpoch; }
+
+    // Fills the light counts, offsets relative to the start of the current light buffer half, and light powers
+    // in outFrameParameters. Returns the total number of lights, which is also the number of shader threads to run.
+    uint32_t BuildTasks(
+        const donut::engine::SceneGraph& sceneGraph,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
+        bool enableImportanceSampledEnvironmentLight,
+        float environmentMapRadianceIntegral,
+        std::vector<PrepareLightsTask>& outTasks,
+        std::vector<PolymorphicLightInfo>& outPrimitiveLightInfos,
+        std::vector<uint32_t>& outGeometryInstanceToLight,
+        rtxdi::FrameParameters& outFrameParameters);
+};
 
 class PrepareLightsPass
 {
@@ -45,14 +194,20 @@ private:
     nvrhi::TextureHandle m_LocalLightPdfTexture;
     
     uint32_t m_MaxLightsInBuffer;
-    bool m_OddFrame = false;
+
+    // Results of the last light preparation, which are the previous frame lights of the next one,
+    // and are reused while the lighting epoch doesn't change
+    rtxdi::FrameParameters m_PreparedFrameParameters;
+    uint32_t m_PreviousLightOffset = 0;
+    uint32_t m_PreparedLightCount = 0;
+    bool m_IdentityMappingWritten = false;
+    bool m_Skipped = false;
     
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
     std::shared_ptr<donut::engine::Scene> m_Scene;
 
-    std::unordered_map<size_t, uint32_t> m_InstanceLightBufferOffsets; // hash(instance*, geometryIndex) -> bufferOffset
-    std::unordered_map<const donut::engine::Light*, uint32_t> m_PrimitiveLightBufferOffsets;
+    PrepareLightsTaskBuilder m_TaskBuilder;
 
 public:
     PrepareLightsPass(
@@ -63,13 +218,33 @@ public:
         nvrhi::IBindingLayout* bindlessLayout);
 
     void CreatePipeline();
-    void CreateBindingSet(RtxdiResources& resources);
-    void CountLightsInScene(uint32_t& numEmissiveMeshes, uint32_t& numEmissiveTriangles);
+    // Set lightDataPreserved when the light buffers have been resized with RtxdiResources::ResizeLightBuffers,
+    // then the lights of the last frame are kept as the previous frame lights if they still fit
+    void CreateBindingSet(RtxdiResources& resources, bool lightDataPreserved = false);
+    [[nodiscard]] RtxdiResourceCapacities GetLightBufferCounts() const;
     
-    void Process(
+    // Fills the light buffer and the PDF texture mip 0, unless the lighting epoch hasn't changed since the last
+    // call: then the lights prepared last time are used as both the current and the previous frame lights,
+    // and nothing is dispatched. See PrepareLightsTaskBuilder::UpdateLightingEpoch for sceneChanged.
+    // Returns true if the lights have been prepared.
+    bool Process(
         nvrhi::ICommandList* commandList, 
         const rtxdi::Context& context, 
         const std::vector<std::shared_ptr<donut::engine::Light>>& sceneLights,
         bool enableImportanceSampledEnvironmentLight,
+        float environmentMapRadianceIntegral,
+        bool sceneChanged,
+        bool geometryAnimated,
         rtxdi::FrameParameters& outFrameParameters);
+
+    // Applies the emissive LOD parameters and chooses the proxies for this frame, call before Process
+    void UpdateEmissiveLod(const EmissiveLodParameters& parameters, const dm::float3& viewPosition);
+
+    // Applies the light streaming parameters and updates the resident cells. Call before the light buffer capacities
+    // are updated, because the slab ranges of the resident cells determine the number of local lights.
+    void UpdateLightStreaming(const LightStreamingParameters& parameters, const dm::float3& viewPosition, bool sceneChanged);
+
+    [[nodiscard]] uint32_t GetLightingEpoch() const { return m_TaskBuilder.GetLightingEpoch(); }
+    [[nodiscard]] const PrepareLightsTaskBuilder& GetTaskBuilder() const { return m_TaskBuilder; }
+    [[nodiscard]] bool WasSkipped() const { return m_Skipped; }
 };
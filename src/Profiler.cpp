@@ -9,11 +9,19 @@
  **************************************************************************/
 
 #include "Profiler.h"
+#include "BenchmarkResults.h"
 #include <donut/app/DeviceManager.h>
+#include <donut/core/log.h>
 #include <imgui.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <sstream>
 
+#include <stb_image_write.h>
+
 #include "RenderTargets.h"
+#include "TraceWriter.h"
 
 
 static const char* g_SectionNames[ProfilerSection::Count] = {
@@ -43,15 +51,60 @@ static const char* g_SectionNames[ProfilerSection::Count] = {
     "(Material Readback)"
 };
 
+static const char* g_CpuSectionNames[CpuProfilerSection::Count] = {
+    "Animation",
+    "TLAS Instances",
+    "Prepare Lights",
+    "Resampling Constants",
+    "User Interface",
+    "Frame Time (CPU)"
+};
+
+static const char* g_CpuCounterNames[CpuProfilerCounter::Count] = {
+    "TLAS Changed Instances",
+    "TLAS Rebuilds per Frame",
+    "TLAS Refit Degradation",
+    "Skinned BLAS Refits per Frame",
+    "Skinned BLAS Rebuilds per Frame",
+    "Skinned BLAS Deferred per Frame",
+    "Lighting Epoch",
+    "Light Preparation Skipped",
+    "Emissive LOD Proxies",
+    "Emissive LOD Proxy Lights",
+    "Emissive LOD Replaced Triangles",
+    "Light Streaming Resident Cells",
+    "Light Streaming Loading Cells",
+    "Light Streaming Resident Lights"
+};
+
+// Indexed by PolymorphicLightType
+static const char* g_LightTypeNames[Profiler::c_CompactLightCounterTypes] = {
+    "Sphere",
+    "Cylinder",
+    "Disk",
+    "Rect",
+    "Triangle",
+    "Directional",
+    "Environment",
+    "Point"
+};
+
+// Ray and hit counts for every section, followed by the compact light counters
+static const uint32_t c_CounterBufferElements = ProfilerSection::Count * 2 + Profiler::c_CompactLightCounterTypes * 2;
+
+// Source of Profiler::m_InstanceId, 0 is reserved for threads that have not registered with any profiler
+static std::atomic<uint64_t> g_NextProfilerInstanceId = 1;
+
 Profiler::Profiler(donut::app::DeviceManager& deviceManager)
     : m_DeviceManager(deviceManager)
     , m_Device(deviceManager.GetDevice())
+    , m_InstanceId(g_NextProfilerInstanceId.fetch_add(1, std::memory_order_relaxed))
 {
     for (auto& query : m_TimerQueries)
         query = m_Device->createTimerQuery();
 
     nvrhi::BufferDesc rayCountBufferDesc;
-    rayCountBufferDesc.byteSize = sizeof(uint32_t) * 2 * ProfilerSection::Count;
+    rayCountBufferDesc.byteSize = sizeof(uint32_t) * c_CounterBufferElements;
     rayCountBufferDesc.format = nvrhi::Format::R32_UINT;
     rayCountBufferDesc.canHaveUAVs = true;
     rayCountBufferDesc.canHaveTypedViews = true;
@@ -64,10 +117,17 @@ Profiler::Profiler(donut::app::DeviceManager& deviceManager)
     rayCountBufferDesc.cpuAccess = nvrhi::CpuAccessMode::Read;
     rayCountBufferDesc.initialState = nvrhi::ResourceStates::Common;
     rayCountBufferDesc.debugName = "RayCountReadback";
-    for (size_t bank = 0; bank < 2; bank++)
+    for (size_t bank = 0; bank < c_ReadbackBanks; bank++)
     {
         m_RayCountReadback[bank] = m_Device->createBuffer(rayCountBufferDesc);
     }
+
+    m_Timeline.resize(c_MaxTimelineFrames);
+}
+
+Profiler::~Profiler()
+{
+    StopTrace();
 }
 
 void Profiler::EnableProfiler(bool enable)
@@ -80,22 +140,96 @@ void Profiler::EnableAccumulation(bool enable)
     m_IsAccumulating = enable;
 }
 
+void Profiler::SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets)
+{
+    m_RenderTargets = renderTargets;
+
+    m_RayCountTilesX = (renderTargets->Size.x + c_RayCountTileSize - 1) / c_RayCountTileSize;
+    m_RayCountTilesY = (renderTargets->Size.y + c_RayCountTileSize - 1) / c_RayCountTileSize;
+    const uint32_t tileCounterElements = m_RayCountTilesX * m_RayCountTilesY * ProfilerSection::Count;
+
+    nvrhi::BufferDesc tileBufferDesc;
+    tileBufferDesc.byteSize = sizeof(uint32_t) * tileCounterElements;
+    tileBufferDesc.format = nvrhi::Format::R32_UINT;
+    tileBufferDesc.canHaveUAVs = true;
+    tileBufferDesc.canHaveTypedViews = true;
+    tileBufferDesc.debugName = "RayCountTiles";
+    tileBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    tileBufferDesc.keepInitialState = true;
+    m_RayCountTileBuffer = m_Device->createBuffer(tileBufferDesc);
+
+    // The readback buffers match the old size, recreate them when the tiles are enabled next
+    for (auto& readback : m_RayCountTileReadback)
+        readback = nullptr;
+    m_RayCountTileReadbackValid.fill(false);
+
+    m_RayCountTileCounts.assign(tileCounterElements, 0);
+    m_RayCountTileFrames = 0;
+
+    EnableRayCountTiles(m_RayCountTilesEnabled);
+}
+
+void Profiler::EnableRayCountTiles(bool enable)
+{
+    m_RayCountTilesEnabled = enable;
+
+    if (!enable || !m_RayCountTileBuffer || m_RayCountTileReadback[0])
+        return;
+
+    nvrhi::BufferDesc readbackDesc = m_RayCountTileBuffer->getDesc();
+    readbackDesc.canHaveUAVs = false;
+    readbackDesc.cpuAccess = nvrhi::CpuAccessMode::Read;
+    readbackDesc.initialState = nvrhi::ResourceStates::Common;
+    readbackDesc.keepInitialState = false;
+    readbackDesc.debugName = "RayCountTilesReadback";
+    for (auto& readback : m_RayCountTileReadback)
+        readback = m_Device->createBuffer(readbackDesc);
+}
+
 void Profiler::ResetAccumulation()
 {
     m_AccumulatedFrames = 0;
+    std::fill(m_RayCountTileCounts.begin(), m_RayCountTileCounts.end(), 0);
+    m_RayCountTileFrames = 0;
     m_TimerValues.fill(0.0);
     m_RayCounts.fill(0);
     m_HitCounts.fill(0);
+    m_PresampledLightCounts.fill(0);
+    m_CompactLightCounts.fill(0);
+    m_CpuTimerValues.fill(0.0);
+    m_CpuCounterValues.fill(0.0);
+    m_TimelineStart = 0;
+    m_TimelineLength = 0;
 }
 
 void Profiler::ResolvePreviousFrame()
 {
-    m_ActiveBank = !m_ActiveBank;
+    m_ActiveBank = (m_ActiveBank + 1) % c_ReadbackBanks;
+
+    const std::array<double, CpuProfilerCounter::Count> cpuCounters = m_PendingCpuCounters;
+    m_PendingCpuCounters.fill(0.0);
 
     if (!m_Enabled)
+    {
+        m_LastResolveTimeValid = false;
         return;
+    }
+
+    std::array<double, CpuProfilerSection::Count> cpuTimes{};
+    ResolveCpuSections(cpuTimes);
 
     const uint32_t* rayCountData = static_cast<const uint32_t*>(m_Device->mapBuffer(m_RayCountReadback[m_ActiveBank], nvrhi::CpuAccessMode::Read));
+
+    // The timeline follows the accumulated values: it only holds the last frame unless accumulation is enabled
+    if (!m_IsAccumulating)
+    {
+        m_TimelineStart = 0;
+        m_TimelineLength = 0;
+    }
+
+    const bool frameValid = m_TimersUsed[ProfilerSection::Frame + m_ActiveBank * ProfilerSection::Count];
+    ProfilerFrameRecord record;
+    record.frameIndex = m_ResolvedFrameIndex++;
     
     for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
     {
@@ -119,6 +253,10 @@ void Profiler::ResolvePreviousFrame()
 
         m_TimersUsed[timerIndex] = false;
 
+        record.times[section] = float(time);
+        record.rayCounts[section] = rayCount;
+        record.hitCounts[section] = hitCount;
+
         if (m_IsAccumulating)
         {
             m_TimerValues[section] += time;
@@ -138,17 +276,290 @@ void Profiler::ResolvePreviousFrame()
     else
         m_RayCounts[ProfilerSection::MaterialReadback] = 0;
 
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+    {
+        record.cpuTimes[section] = float(cpuTimes[section]);
+
+        if (m_IsAccumulating)
+            m_CpuTimerValues[section] += cpuTimes[section];
+        else
+            m_CpuTimerValues[section] = cpuTimes[section];
+    }
+
+    for (uint32_t counter = 0; counter < CpuProfilerCounter::Count; counter++)
+    {
+        if (m_IsAccumulating)
+            m_CpuCounterValues[counter] += cpuCounters[counter];
+        else
+            m_CpuCounterValues[counter] = cpuCounters[counter];
+    }
+
+    if (frameValid && m_TraceWriter)
+        TraceGpuFrame(record);
+
+    if (frameValid)
+    {
+        if (m_TimelineLength < c_MaxTimelineFrames)
+        {
+            m_Timeline[(m_TimelineStart + m_TimelineLength) % c_MaxTimelineFrames] = record;
+            m_TimelineLength++;
+        }
+        else
+        {
+            m_Timeline[m_TimelineStart] = record;
+            m_TimelineStart = (m_TimelineStart + 1) % c_MaxTimelineFrames;
+        }
+    }
+
+    for (uint32_t lightType = 0; lightType < c_CompactLightCounterTypes; lightType++)
+    {
+        uint32_t presampledCount = 0;
+        uint32_t compactCount = 0;
+
+        if (rayCountData)
+        {
+            presampledCount = rayCountData[GetCompactLightCounterOffset() + lightType * 2];
+            compactCount = rayCountData[GetCompactLightCounterOffset() + lightType * 2 + 1];
+        }
+
+        if (m_IsAccumulating)
+        {
+            m_PresampledLightCounts[lightType] += presampledCount;
+            m_CompactLightCounts[lightType] += compactCount;
+        }
+        else
+        {
+            m_PresampledLightCounts[lightType] = presampledCount;
+            m_CompactLightCounts[lightType] = compactCount;
+        }
+    }
+
     if (rayCountData)
     {
         m_Device->unmapBuffer(m_RayCountReadback[m_ActiveBank]);
     }
 
+    ResolveRayCountTiles();
+
     if (m_IsAccumulating)
         m_AccumulatedFrames += 1;
     else
         m_AccumulatedFrames = 1;
 }
 
+void Profiler::ResolveRayCountTiles()
+{
+    if (!m_RayCountTileReadbackValid[m_ActiveBank])
+        return;
+
+    m_RayCountTileReadbackValid[m_ActiveBank] = false;
+
+    const uint32_t* tileData = static_cast<const uint32_t*>(m_Device->mapBuffer(m_RayCountTileReadback[m_ActiveBank], nvrhi::CpuAccessMode::Read));
+    if (!tileData)
+        return;
+
+    // Counts from different viewports cover different parts of the tile grid, so they are not accumulated together
+    const std::array<uint32_t, 2>& viewport = m_RayCountTileReadbackViewport[m_ActiveBank];
+    if (!m_IsAccumulating || viewport != m_RayCountTileViewport)
+    {
+        std::fill(m_RayCountTileCounts.begin(), m_RayCountTileCounts.end(), 0);
+        m_RayCountTileFrames = 0;
+        m_RayCountTileViewport = viewport;
+    }
+
+    for (size_t index = 0; index < m_RayCountTileCounts.size(); index++)
+        m_RayCountTileCounts[index] += tileData[index];
+    m_RayCountTileFrames++;
+
+    m_Device->unmapBuffer(m_RayCountTileReadback[m_ActiveBank]);
+}
+
+Profiler::CpuThreadCounters& Profiler::GetCpuThreadCounters()
+{
+    thread_local CpuThreadCounters* t_Counters = nullptr;
+    thread_local uint64_t t_OwnerId = 0;
+
+    if (t_OwnerId != m_InstanceId)
+    {
+        auto counters = std::make_unique<CpuThreadCounters>();
+        for (auto& value : counters->nanoseconds)
+            value.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_CpuThreadsMutex);
+        t_Counters = counters.get();
+        t_OwnerId = m_InstanceId;
+        m_CpuThreads.push_back(std::move(counters));
+
+        // Thread 0 is the GPU track in the trace
+        t_Counters->traceThreadId = uint32_t(m_CpuThreads.size());
+        if (m_TraceWriter)
+            m_TraceWriter->SetThreadName(t_Counters->traceThreadId, "CPU Thread " + std::to_string(t_Counters->traceThreadId));
+    }
+
+    return *t_Counters;
+}
+
+void Profiler::AddCpuSectionTime(CpuProfilerSection::Enum section, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    if (!m_Enabled)
+        return;
+
+    CpuThreadCounters& counters = GetCpuThreadCounters();
+
+    // Single writer per counter, so a relaxed read-modify-write is enough
+    const uint64_t nanoseconds = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    std::atomic<uint64_t>& counter = counters.nanoseconds[section];
+    counter.store(counter.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+
+    if (m_TraceEnabled.load(std::memory_order_relaxed))
+    {
+        // Scopes that don't fit into the ring before the next resolve are dropped
+        const uint32_t writeIndex = counters.traceWriteIndex.load(std::memory_order_relaxed);
+        const uint32_t readIndex = counters.traceReadIndex.load(std::memory_order_acquire);
+        if (writeIndex - readIndex < uint32_t(counters.traceScopes.size()))
+        {
+            counters.traceScopes[writeIndex % counters.traceScopes.size()] = { section, start, end };
+            counters.traceWriteIndex.store(writeIndex + 1, std::memory_order_release);
+        }
+    }
+}
+
+// Collects the CPU time recorded by all threads since the previous resolve
+void Profiler::ResolveCpuSections(std::array<double, CpuProfilerSection::Count>& outTimes)
+{
+    outTimes.fill(0.0);
+
+    const bool traceEnabled = m_TraceEnabled.load(std::memory_order_relaxed);
+    const uint32_t resolvingThreadId = GetCpuThreadCounters().traceThreadId;
+    std::vector<TraceEvent> traceEvents;
+
+    {
+        std::lock_guard<std::mutex> lock(m_CpuThreadsMutex);
+
+        for (const auto& thread : m_CpuThreads)
+        {
+            for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+            {
+                const uint64_t total = thread->nanoseconds[section].load(std::memory_order_relaxed);
+                outTimes[section] += double(total - thread->resolvedNanoseconds[section]) * 1e-6;
+                thread->resolvedNanoseconds[section] = total;
+            }
+
+            const uint32_t writeIndex = thread->traceWriteIndex.load(std::memory_order_acquire);
+            uint32_t readIndex = thread->traceReadIndex.load(std::memory_order_relaxed);
+            for (; readIndex != writeIndex; readIndex++)
+            {
+                const auto& scope = thread->traceScopes[readIndex % thread->traceScopes.size()];
+                if (!traceEnabled || scope.start < m_TraceStartTime)
+                    continue;
+
+                TraceEvent& event = traceEvents.emplace_back();
+                event.name = g_CpuSectionNames[scope.section];
+                event.threadId = thread->traceThreadId;
+                event.startMicroseconds = GetTraceMicroseconds(scope.start);
+                event.durationMicroseconds = std::chrono::duration<double, std::micro>(scope.end - scope.start).count();
+            }
+            thread->traceReadIndex.store(readIndex, std::memory_order_release);
+        }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (m_LastResolveTimeValid)
+    {
+        outTimes[CpuProfilerSection::Frame] = std::chrono::duration<double, std::milli>(now - m_LastResolveTime).count();
+
+        if (traceEnabled && m_LastResolveTime >= m_TraceStartTime)
+        {
+            TraceEvent& event = traceEvents.emplace_back();
+            event.name = g_CpuSectionNames[CpuProfilerSection::Frame];
+            event.threadId = resolvingThreadId;
+            event.startMicroseconds = GetTraceMicroseconds(m_LastResolveTime);
+            event.durationMicroseconds = outTimes[CpuProfilerSection::Frame] * 1000.0;
+        }
+    }
+    m_LastResolveTime = now;
+    m_LastResolveTimeValid = true;
+
+    if (m_TraceWriter)
+        m_TraceWriter->AddEvents(traceEvents);
+}
+
+double Profiler::GetTraceMicroseconds(std::chrono::steady_clock::time_point time) const
+{
+    return std::chrono::duration<double, std::micro>(time - m_TraceStartTime).count();
+}
+
+void Profiler::TraceGpuFrame(const ProfilerFrameRecord& record)
+{
+    const auto submitTime = m_FrameSubmitTimes[m_ActiveBank];
+    if (submitTime < m_TraceStartTime)
+        return;
+
+    // The GPU can't start a frame before it's submitted or before it has finished the previous frame
+    const double frameStart = std::max(GetTraceMicroseconds(submitTime), m_GpuTrackEndMicroseconds);
+    const double frameDuration = double(record.times[ProfilerSection::Frame]) * 1000.0;
+
+    std::vector<TraceEvent> traceEvents;
+
+    TraceEvent& frameEvent = traceEvents.emplace_back();
+    frameEvent.name = g_SectionNames[ProfilerSection::Frame];
+    frameEvent.startMicroseconds = frameStart;
+    frameEvent.durationMicroseconds = frameDuration;
+
+    // Sections are listed in the order in which they are rendered
+    double sectionStart = frameStart;
+    for (uint32_t section = 0; section < ProfilerSection::Frame; section++)
+    {
+        const double duration = double(record.times[section]) * 1000.0;
+        if (duration <= 0.0)
+            continue;
+
+        TraceEvent& event = traceEvents.emplace_back();
+        event.name = g_SectionNames[section];
+        event.startMicroseconds = sectionStart;
+        event.durationMicroseconds = duration;
+        sectionStart += duration;
+    }
+
+    m_GpuTrackEndMicroseconds = frameStart + frameDuration;
+
+    m_TraceWriter->AddEvents(traceEvents);
+}
+
+bool Profiler::StartTrace(const std::string& fileName)
+{
+    StopTrace();
+
+    auto traceWriter = std::make_unique<TraceWriter>(fileName);
+    if (!traceWriter->IsOpen())
+        return false;
+
+    m_TraceStartTime = std::chrono::steady_clock::now();
+    m_GpuTrackEndMicroseconds = 0.0;
+
+    {
+        // Other threads access the writer when they register
+        std::lock_guard<std::mutex> lock(m_CpuThreadsMutex);
+
+        m_TraceWriter = std::move(traceWriter);
+        m_TraceWriter->SetThreadName(0, "GPU");
+        for (const auto& thread : m_CpuThreads)
+            m_TraceWriter->SetThreadName(thread->traceThreadId, "CPU Thread " + std::to_string(thread->traceThreadId));
+    }
+
+    m_TraceEnabled = true;
+    return true;
+}
+
+void Profiler::StopTrace()
+{
+    m_TraceEnabled = false;
+
+    // Flushes the remaining events and closes the file
+    std::lock_guard<std::mutex> lock(m_CpuThreadsMutex);
+    m_TraceWriter.reset();
+}
+
 void Profiler::BeginFrame(nvrhi::ICommandList* commandList)
 {
     if (!m_Enabled)
@@ -156,6 +567,9 @@ void Profiler::BeginFrame(nvrhi::ICommandList* commandList)
 
     commandList->clearBufferUInt(m_RayCountBuffer, 0);
 
+    if (m_RayCountTilesEnabled)
+        commandList->clearBufferUInt(m_RayCountTileBuffer, 0);
+
     BeginSection(commandList, ProfilerSection::Frame);
 }
 
@@ -165,12 +579,27 @@ void Profiler::EndFrame(nvrhi::ICommandList* commandList)
 
     if (m_Enabled)
     {
+        m_FrameSubmitTimes[m_ActiveBank] = std::chrono::steady_clock::now();
+
         commandList->copyBuffer(
             m_RayCountReadback[m_ActiveBank],
             0,
             m_RayCountBuffer,
             0,
-            ProfilerSection::Count * sizeof(uint32_t) * 2);
+            c_CounterBufferElements * sizeof(uint32_t));
+
+        if (m_RayCountTilesEnabled && m_RayCountTileReadback[m_ActiveBank])
+        {
+            commandList->copyBuffer(
+                m_RayCountTileReadback[m_ActiveBank],
+                0,
+                m_RayCountTileBuffer,
+                0,
+                m_RayCountTileBuffer->getDesc().byteSize);
+
+            m_RayCountTileReadbackValid[m_ActiveBank] = true;
+            m_RayCountTileReadbackViewport[m_ActiveBank] = m_RayCountViewport;
+        }
     }
 }
 
@@ -217,11 +646,48 @@ double Profiler::GetHitCount(ProfilerSection::Enum section)
     return double(m_HitCounts[section]) / double(m_AccumulatedFrames);
 }
 
+double Profiler::GetCpuTimer(CpuProfilerSection::Enum section)
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return m_CpuTimerValues[section] / double(m_AccumulatedFrames);
+}
+
+void Profiler::SetCpuCounter(CpuProfilerCounter::Enum counter, double value)
+{
+    m_PendingCpuCounters[counter] = value;
+}
+
+double Profiler::GetCpuCounter(CpuProfilerCounter::Enum counter)
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return m_CpuCounterValues[counter] / double(m_AccumulatedFrames);
+}
+
 int Profiler::GetMaterialReadback()
 {
     return int(m_RayCounts[ProfilerSection::MaterialReadback]) - 1;
 }
 
+double Profiler::GetPresampledLightCount(uint32_t lightType)
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return double(m_PresampledLightCounts[lightType]) / double(m_AccumulatedFrames);
+}
+
+double Profiler::GetCompactLightHitRate(uint32_t lightType)
+{
+    if (m_PresampledLightCounts[lightType] == 0)
+        return 0.0;
+
+    return double(m_CompactLightCounts[lightType]) / double(m_PresampledLightCounts[lightType]);
+}
+
 void Profiler::BuildUI(const bool enableRayCounts)
 {
     auto renderTargets = m_RenderTargets.lock();
@@ -289,6 +755,85 @@ void Profiler::BuildUI(const bool enableRayCounts)
             ImGui::PopStyleColor();
     }
 
+    // CPU sections go into the same table so that CPU and GPU time can be compared directly
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+    {
+        if (section == 0 || section == CpuProfilerSection::Frame)
+            ImGui::Separator();
+
+        const double time = GetCpuTimer(CpuProfilerSection::Enum(section));
+        if (time == 0.0)
+            continue;
+
+        const bool highlightRow = (section == CpuProfilerSection::Frame);
+
+        if (highlightRow)
+            ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(0x40, 0xff, 0xff, 0xff));
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("%s", g_CpuSectionNames[section]);
+        ImGui::TableSetColumnIndex(1);
+
+        char text[16];
+        snprintf(text, sizeof(text), "%.3f ms", time);
+        const ImVec2 textSize = ImGui::CalcTextSize(text);
+        ImGui::SameLine(timeColumnWidth - textSize.x);
+        ImGui::Text("%s", text);
+
+        if (highlightRow)
+            ImGui::PopStyleColor();
+    }
+
+    ImGui::EndTable();
+
+    const double gpuFrameTime = GetTimer(ProfilerSection::Frame);
+    const double cpuFrameTime = GetCpuTimer(CpuProfilerSection::Frame);
+    if (gpuFrameTime > 0.0 && cpuFrameTime > 0.0)
+    {
+        // When the GPU is busy for a small part of the frame interval, the frames are CPU-bound
+        ImGui::Text("GPU busy: %.0f%% of the frame", 100.0 * std::min(gpuFrameTime / cpuFrameTime, 1.0));
+    }
+
+    for (uint32_t counter = 0; counter < CpuProfilerCounter::Count; counter++)
+    {
+        const double value = GetCpuCounter(CpuProfilerCounter::Enum(counter));
+        if (value != 0.0)
+            ImGui::Text("%s: %.2f", g_CpuCounterNames[counter], value);
+    }
+
+    if (!enableRayCounts)
+        return;
+
+    bool anyLightsPresampled = false;
+    for (uint32_t lightType = 0; lightType < c_CompactLightCounterTypes; lightType++)
+        anyLightsPresampled |= m_PresampledLightCounts[lightType] != 0;
+
+    if (!anyLightsPresampled)
+        return;
+
+    // Fraction of the presampled RIS buffer slots per light type that were stored in the compact form,
+    // i.e. that don't need to access the light buffer when sampled
+    ImGui::BeginTable("CompactLights", 3);
+    ImGui::TableSetupColumn(" Presampled Light");
+    ImGui::TableSetupColumn("Slots", ImGuiTableColumnFlags_WidthFixed, timeColumnWidth);
+    ImGui::TableSetupColumn("Compact", ImGuiTableColumnFlags_WidthFixed, otherColumnsWidth);
+    ImGui::TableHeadersRow();
+
+    for (uint32_t lightType = 0; lightType < c_CompactLightCounterTypes; lightType++)
+    {
+        if (m_PresampledLightCounts[lightType] == 0)
+            continue;
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("%s", g_LightTypeNames[lightType]);
+        ImGui::TableSetColumnIndex(1);
+        ImGui::Text("%.0f", GetPresampledLightCount(lightType));
+        ImGui::TableSetColumnIndex(2);
+        ImGui::Text("%.0f%%", 100.0 * GetCompactLightHitRate(lightType));
+    }
+
     ImGui::EndTable();
 }
 
@@ -337,9 +882,273 @@ std::string Profiler::GetAsText()
         text << std::endl;
     }
 
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+    {
+        const double time = GetCpuTimer(CpuProfilerSection::Enum(section));
+        if (time == 0.0)
+            continue;
+
+        text << g_CpuSectionNames[section] << (section == CpuProfilerSection::Frame ? ": " : " (CPU): ");
+        text.precision(3);
+        text << std::fixed << time << " ms" << std::endl;
+    }
+
+    const double gpuFrameTime = GetTimer(ProfilerSection::Frame);
+    const double cpuFrameTime = GetCpuTimer(CpuProfilerSection::Frame);
+    if (gpuFrameTime > 0.0 && cpuFrameTime > 0.0)
+    {
+        text.precision(0);
+        text << "GPU busy: " << std::fixed << 100.0 * std::min(gpuFrameTime / cpuFrameTime, 1.0) << "% of the frame" << std::endl;
+    }
+
+    for (uint32_t counter = 0; counter < CpuProfilerCounter::Count; counter++)
+    {
+        const double value = GetCpuCounter(CpuProfilerCounter::Enum(counter));
+        if (value == 0.0)
+            continue;
+
+        text << g_CpuCounterNames[counter] << ": ";
+        text.precision(2);
+        text << std::fixed << value << std::endl;
+    }
+
+    for (uint32_t lightType = 0; lightType < c_CompactLightCounterTypes; lightType++)
+    {
+        if (m_PresampledLightCounts[lightType] == 0)
+            continue;
+
+        text << "Presampled " << g_LightTypeNames[lightType] << " lights: ";
+        text.precision(0);
+        text << std::fixed << GetPresampledLightCount(lightType) << " slots, "
+            << 100.0 * GetCompactLightHitRate(lightType) << "% compact" << std::endl;
+    }
+
     return text.str();
 }
 
+const ProfilerFrameRecord& Profiler::GetTimelineFrame(uint32_t index) const
+{
+    assert(index < m_TimelineLength);
+    return m_Timeline[(m_TimelineStart + index) % c_MaxTimelineFrames];
+}
+
+// Nearest-rank percentile of a sorted array
+static double getPercentile(const std::vector<float>& sortedValues, double percentile)
+{
+    size_t rank = size_t(std::ceil(percentile * 0.01 * double(sortedValues.size())));
+    rank = std::max<size_t>(rank, 1);
+    return sortedValues[std::min(rank, sortedValues.size()) - 1];
+}
+
+static ProfilerSectionStatistics computeStatistics(std::vector<float>& times)
+{
+    ProfilerSectionStatistics stats;
+    if (times.empty())
+        return stats;
+
+    double sum = 0.0;
+    for (float time : times)
+        sum += time;
+
+    std::sort(times.begin(), times.end());
+
+    stats.frames = uint32_t(times.size());
+    stats.mean = sum / double(times.size());
+    stats.p50 = getPercentile(times, 50.0);
+    stats.p90 = getPercentile(times, 90.0);
+    stats.p99 = getPercentile(times, 99.0);
+    stats.max = times.back();
+
+    return stats;
+}
+
+ProfilerSectionStatistics Profiler::GetSectionStatistics(ProfilerSection::Enum section) const
+{
+    std::vector<float> times;
+    times.reserve(m_TimelineLength);
+    for (uint32_t index = 0; index < m_TimelineLength; index++)
+        times.push_back(GetTimelineFrame(index).times[section]);
+
+    return computeStatistics(times);
+}
+
+ProfilerSectionStatistics Profiler::GetCpuSectionStatistics(CpuProfilerSection::Enum section) const
+{
+    std::vector<float> times;
+    times.reserve(m_TimelineLength);
+    for (uint32_t index = 0; index < m_TimelineLength; index++)
+        times.push_back(GetTimelineFrame(index).cpuTimes[section]);
+
+    return computeStatistics(times);
+}
+
+std::string Profiler::GetStatisticsAsText()
+{
+    if (m_TimelineLength == 0)
+        return "";
+
+    std::stringstream text;
+    text << "Frame time percentiles over " << m_TimelineLength << " frames (p50 / p90 / p99 / max):" << std::endl;
+    text.precision(3);
+
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        const ProfilerSectionStatistics stats = GetSectionStatistics(ProfilerSection::Enum(section));
+        if (stats.max == 0.0)
+            continue;
+
+        text << g_SectionNames[section] << ": " << std::fixed
+            << stats.p50 << " / " << stats.p90 << " / " << stats.p99 << " / " << stats.max << " ms" << std::endl;
+    }
+
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+    {
+        const ProfilerSectionStatistics stats = GetCpuSectionStatistics(CpuProfilerSection::Enum(section));
+        if (stats.max == 0.0)
+            continue;
+
+        text << g_CpuSectionNames[section] << (section == CpuProfilerSection::Frame ? ": " : " (CPU): ") << std::fixed
+            << stats.p50 << " / " << stats.p90 << " / " << stats.p99 << " / " << stats.max << " ms" << std::endl;
+    }
+
+    return text.str();
+}
+
+void Profiler::AppendBenchmarkRun(BenchmarkResults& results)
+{
+    results.renderer = m_DeviceManager.GetRendererString();
+    results.runCount++;
+
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        const double time = GetTimer(ProfilerSection::Enum(section));
+        if (time != 0.0)
+            results.AddRunValue(g_SectionNames[section], time);
+    }
+
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+    {
+        const double time = GetCpuTimer(CpuProfilerSection::Enum(section));
+        if (time != 0.0)
+            results.AddRunValue(g_CpuSectionNames[section], time);
+    }
+
+    if (m_TimelineLength != 0)
+    {
+        results.AddRunValue(std::string(g_SectionNames[ProfilerSection::Frame]) + " p99",
+            GetSectionStatistics(ProfilerSection::Frame).p99);
+        results.AddRunValue(std::string(g_CpuSectionNames[CpuProfilerSection::Frame]) + " p99",
+            GetCpuSectionStatistics(CpuProfilerSection::Frame).p99);
+    }
+}
+
+bool Profiler::ExportTimelineCsv(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        donut::log::error("Cannot open file '%s' for writing", fileName.c_str());
+        return false;
+    }
+
+    file << "Frame";
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+    {
+        file << ",\"" << g_SectionNames[section] << " (ms)\""
+            << ",\"" << g_SectionNames[section] << " (rays)\""
+            << ",\"" << g_SectionNames[section] << " (hits)\"";
+    }
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+        file << ",\"" << g_CpuSectionNames[section] << " (CPU ms)\"";
+    file << std::endl;
+
+    file.precision(4);
+    for (uint32_t index = 0; index < m_TimelineLength; index++)
+    {
+        const ProfilerFrameRecord& record = GetTimelineFrame(index);
+
+        file << record.frameIndex;
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+        {
+            file << "," << std::fixed << record.times[section]
+                << "," << record.rayCounts[section]
+                << "," << record.hitCounts[section];
+        }
+        for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+            file << "," << std::fixed << record.cpuTimes[section];
+        file << std::endl;
+    }
+
+    return file.good();
+}
+
+bool Profiler::ExportTimelineJson(const std::string& fileName) const
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        donut::log::error("Cannot open file '%s' for writing", fileName.c_str());
+        return false;
+    }
+
+    file << "{" << std::endl;
+    file << "  \"renderer\": \"" << m_DeviceManager.GetRendererString() << "\"," << std::endl;
+
+    file.precision(4);
+    auto writeStatistics = [&file](const char* name, const ProfilerSectionStatistics& stats, bool last)
+    {
+        file << "    \"" << name << "\": { " << std::fixed
+            << "\"mean\": " << stats.mean << ", "
+            << "\"p50\": " << stats.p50 << ", "
+            << "\"p90\": " << stats.p90 << ", "
+            << "\"p99\": " << stats.p99 << ", "
+            << "\"max\": " << stats.max << " }" << (last ? "" : ",") << std::endl;
+    };
+
+    file << "  \"statistics\": {" << std::endl;
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+        writeStatistics(g_SectionNames[section], GetSectionStatistics(ProfilerSection::Enum(section)), false);
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+        writeStatistics(g_CpuSectionNames[section], GetCpuSectionStatistics(CpuProfilerSection::Enum(section)), section + 1 == CpuProfilerSection::Count);
+    file << "  }," << std::endl;
+
+    file << "  \"sections\": [";
+    for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+        file << (section ? ", " : "") << "\"" << g_SectionNames[section] << "\"";
+    file << "]," << std::endl;
+
+    file << "  \"cpuSections\": [";
+    for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+        file << (section ? ", " : "") << "\"" << g_CpuSectionNames[section] << "\"";
+    file << "]," << std::endl;
+
+    // Every frame stores the times, ray counts and hit counts in the order of "sections",
+    // and the CPU times in the order of "cpuSections"
+    file << "  \"frames\": [" << std::endl;
+    for (uint32_t index = 0; index < m_TimelineLength; index++)
+    {
+        const ProfilerFrameRecord& record = GetTimelineFrame(index);
+
+        file << "    { \"frame\": " << record.frameIndex << ", \"times\": [";
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+            file << (section ? ", " : "") << std::fixed << record.times[section];
+        file << "], \"rays\": [";
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+            file << (section ? ", " : "") << record.rayCounts[section];
+        file << "], \"hits\": [";
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+            file << (section ? ", " : "") << record.hitCounts[section];
+        file << "], \"cpuTimes\": [";
+        for (uint32_t section = 0; section < CpuProfilerSection::Count; section++)
+            file << (section ? ", " : "") << std::fixed << record.cpuTimes[section];
+        file << "] }" << (index + 1 < m_TimelineLength ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+
+    return file.good();
+}
+
 ProfilerScope::ProfilerScope(Profiler& profiler, nvrhi::ICommandList* commandList, ProfilerSection::Enum section)
     : m_Profiler(profiler)
     , m_CommandList(commandList)
@@ -356,3 +1165,133 @@ ProfilerScope::~ProfilerScope()
     m_Profiler.EndSection(m_CommandList, m_Section);
     m_CommandList = nullptr;
 }
+
+CpuProfilerScope::CpuProfilerScope(Profiler& profiler, CpuProfilerSection::Enum section)
+    : m_Profiler(profiler)
+    , m_Section(section)
+    , m_StartTime(std::chrono::steady_clock::now())
+{
+}
+
+CpuProfilerScope::~CpuProfilerScope()
+{
+    m_Profiler.AddCpuSectionTime(m_Section, m_StartTime, std::chrono::steady_clock::now());
+}
+
+const char* Profiler::GetSectionName(ProfilerSection::Enum section)
+{
+    return (section < ProfilerSection::Count) ? g_SectionNames[section] : "All Sections";
+}
+
+// Maps a value in [0, 1] to black - blue - red - yellow - white
+static void GetHeatmapColor(float value, uint8_t* outColor)
+{
+    static const float c_Stops[][3] = {
+        { 0.f, 0.f, 0.f },
+        { 0.f, 0.f, 1.f },
+        { 1.f, 0.f, 0.f },
+        { 1.f, 1.f, 0.f },
+        { 1.f, 1.f, 1.f }
+    };
+    constexpr int c_NumSegments = int(std::size(c_Stops)) - 1;
+
+    const float position = std::clamp(value, 0.f, 1.f) * float(c_NumSegments);
+    const int segment = std::min(int(position), c_NumSegments - 1);
+    const float t = position - float(segment);
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+        const float color = c_Stops[segment][channel] * (1.f - t) + c_Stops[segment + 1][channel] * t;
+        outColor[channel] = uint8_t(color * 255.f + 0.5f);
+    }
+}
+
+bool Profiler::SaveRayCountHeatmap(const std::string& fileName, ProfilerSection::Enum section) const
+{
+    auto renderTargets = m_RenderTargets.lock();
+    if (!renderTargets || m_RayCountTileFrames == 0)
+    {
+        donut::log::error("Cannot save the ray count heatmap: no tile counts were recorded. "
+            "Enable ray counts and the heatmap first.");
+        return false;
+    }
+
+    if (section != ProfilerSection::Count &&
+        std::find(c_RayCountTileSections.begin(), c_RayCountTileSections.end(), section) == c_RayCountTileSections.end())
+    {
+        donut::log::error("Cannot save the ray count heatmap of '%s': the section has no tile counts", GetSectionName(section));
+        return false;
+    }
+
+    // The grid covers the render targets, but only the tiles inside the viewport of the accumulated frames have rays
+    const uint32_t viewportWidth = std::min(m_RayCountTileViewport[0], uint32_t(renderTargets->Size.x));
+    const uint32_t viewportHeight = std::min(m_RayCountTileViewport[1], uint32_t(renderTargets->Size.y));
+    const uint32_t viewportTilesX = std::min((viewportWidth + c_RayCountTileSize - 1) / c_RayCountTileSize, m_RayCountTilesX);
+    const uint32_t viewportTilesY = std::min((viewportHeight + c_RayCountTileSize - 1) / c_RayCountTileSize, m_RayCountTilesY);
+    if (viewportTilesX == 0 || viewportTilesY == 0)
+    {
+        donut::log::error("Cannot save the ray count heatmap: the viewport is empty");
+        return false;
+    }
+
+    const uint32_t tileCount = m_RayCountTilesX * m_RayCountTilesY;
+
+    // Average rays per pixel in every tile of the viewport, over the accumulated frames.
+    // The tiles on the right and bottom edges may only be partially covered by the viewport.
+    std::vector<float> raysPerPixel(size_t(viewportTilesX) * viewportTilesY, 0.f);
+    float maxRaysPerPixel = 0.f;
+    for (uint32_t tileY = 0; tileY < viewportTilesY; tileY++)
+    {
+        for (uint32_t tileX = 0; tileX < viewportTilesX; tileX++)
+        {
+            const uint32_t tile = tileY * m_RayCountTilesX + tileX;
+
+            uint64_t rays = 0;
+            if (section < ProfilerSection::Count)
+                rays = m_RayCountTileCounts[section * tileCount + tile];
+            else
+            {
+                for (uint32_t index = 0; index < ProfilerSection::Count; index++)
+                    rays += m_RayCountTileCounts[index * tileCount + tile];
+            }
+
+            const uint32_t tileWidth = std::min(c_RayCountTileSize, viewportWidth - tileX * c_RayCountTileSize);
+            const uint32_t tileHeight = std::min(c_RayCountTileSize, viewportHeight - tileY * c_RayCountTileSize);
+            float& tileRaysPerPixel = raysPerPixel[size_t(tileY) * viewportTilesX + tileX];
+            tileRaysPerPixel = float(double(rays) / double(m_RayCountTileFrames) / double(tileWidth * tileHeight));
+            maxRaysPerPixel = std::max(maxRaysPerPixel, tileRaysPerPixel);
+        }
+    }
+
+    // Log scale, so that the tiles with a few extra rays are still visible next to the hot spots
+    const float scale = (maxRaysPerPixel > 0.f) ? 1.f / std::log2(1.f + maxRaysPerPixel) : 0.f;
+
+    const int width = int(viewportWidth);
+    const int height = int(viewportHeight);
+    std::vector<uint8_t> pixels(size_t(width) * size_t(height) * 3);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const uint32_t tile = (uint32_t(y) / c_RayCountTileSize) * viewportTilesX + uint32_t(x) / c_RayCountTileSize;
+            GetHeatmapColor(std::log2(1.f + raysPerPixel[tile]) * scale, &pixels[(size_t(y) * width + x) * 3]);
+        }
+    }
+
+    const bool isPng = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".png") == 0;
+    const int result = isPng
+        ? stbi_write_png(fileName.c_str(), width, height, 3, pixels.data(), width * 3)
+        : stbi_write_bmp(fileName.c_str(), width, height, 3, pixels.data());
+
+    if (!result)
+    {
+        donut::log::error("Cannot write the ray count heatmap to '%s'", fileName.c_str());
+        return false;
+    }
+
+    donut::log::info("Saved the ray count heatmap of '%s' to '%s', %.2f rays per pixel at most, %u frames",
+        GetSectionName(section), fileName.c_str(), maxRaysPerPixel, m_RayCountTileFrames);
+
+    return true;
+}
@@ -12,39 +12,162 @@
 
 #include <nvrhi/nvrhi.h>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "ProfilerSections.h"
 
 class RenderTargets;
+class TraceWriter;
+struct BenchmarkResults;
 
 namespace donut::app
 {
     class DeviceManager;
 }
 
+// Measurements of all sections for one resolved frame
+struct ProfilerFrameRecord
+{
+    uint32_t frameIndex = 0;
+    std::array<float, ProfilerSection::Count> times{}; // milliseconds
+    std::array<uint32_t, ProfilerSection::Count> rayCounts{};
+    std::array<uint32_t, ProfilerSection::Count> hitCounts{};
+    std::array<float, CpuProfilerSection::Count> cpuTimes{}; // milliseconds
+};
+
+// Distribution of the time spent in one section over the recorded frames, in milliseconds
+struct ProfilerSectionStatistics
+{
+    uint32_t frames = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
 class Profiler
 {
+public:
+    // Number of light types with compact light counters, must match COMPACT_LIGHT_COUNTER_TYPES
+    static constexpr uint32_t c_CompactLightCounterTypes = 8;
+
+    // Maximum number of frames kept in the timeline, older frames are overwritten
+    static constexpr uint32_t c_MaxTimelineFrames = 8192;
+
+    // Number of frames between recording the timer queries and ray counts and reading them on the CPU.
+    // It's larger than the number of frames in flight, so that resolving never waits for the GPU.
+    static constexpr uint32_t c_ReadbackBanks = 4;
+
+    // Size of the screen tiles with separate ray counters, must match RAY_COUNT_TILE_SIZE
+    static constexpr uint32_t c_RayCountTileSize = 16;
+
+    // Sections of the lighting passes, which count their rays per tile with ReportRay.
+    // The G-buffer and glass passes only update the global counters.
+    static constexpr std::array<ProfilerSection::Enum, 11> c_RayCountTileSections = {
+        ProfilerSection::InitialSamples,
+        ProfilerSection::TemporalResampling,
+        ProfilerSection::SpatialResampling,
+        ProfilerSection::Shading,
+        ProfilerSection::BrdfRays,
+        ProfilerSection::ShadeSecondary,
+        ProfilerSection::GITemporalResampling,
+        ProfilerSection::GISpatialResampling,
+        ProfilerSection::GIFusedResampling,
+        ProfilerSection::GIFinalShading,
+        ProfilerSection::Gradients
+    };
+
 private:
-    bool m_Enabled = true;
+    // CPU time spent in every section by one thread. Only the owning thread writes to the counters,
+    // and the resolving thread reads them, so recording a scope doesn't need any locks.
+    struct CpuThreadCounters
+    {
+        std::array<std::atomic<uint64_t>, CpuProfilerSection::Count> nanoseconds;
+        std::array<uint64_t, CpuProfilerSection::Count> resolvedNanoseconds{};
+
+        // Ring of scopes recorded for the trace, written by the owning thread and drained by the resolving thread
+        struct TraceScope
+        {
+            CpuProfilerSection::Enum section;
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point end;
+        };
+        std::array<TraceScope, 1024> traceScopes;
+        std::atomic<uint32_t> traceWriteIndex{ 0 };
+        std::atomic<uint32_t> traceReadIndex{ 0 };
+        uint32_t traceThreadId = 0;
+    };
+
+    std::atomic<bool> m_Enabled{ true };
     bool m_IsAccumulating = false;
     uint32_t m_AccumulatedFrames = 0;
     uint32_t m_ActiveBank = 0;
 
-    std::array<nvrhi::TimerQueryHandle, ProfilerSection::Count * 2> m_TimerQueries;
+    std::array<nvrhi::TimerQueryHandle, ProfilerSection::Count * c_ReadbackBanks> m_TimerQueries;
     std::array<double, ProfilerSection::Count> m_TimerValues{};
     std::array<size_t, ProfilerSection::Count> m_RayCounts{};
     std::array<size_t, ProfilerSection::Count> m_HitCounts{};
-    std::array<bool, ProfilerSection::Count * 2> m_TimersUsed{};
+    std::array<bool, ProfilerSection::Count * c_ReadbackBanks> m_TimersUsed{};
+    std::array<size_t, c_CompactLightCounterTypes> m_PresampledLightCounts{};
+    std::array<size_t, c_CompactLightCounterTypes> m_CompactLightCounts{};
+    std::array<double, CpuProfilerSection::Count> m_CpuTimerValues{};
+    std::array<double, CpuProfilerCounter::Count> m_PendingCpuCounters{};
+    std::array<double, CpuProfilerCounter::Count> m_CpuCounterValues{};
+
+    // The mutex only guards registration of new threads and resolving, not the recording of scopes
+    std::mutex m_CpuThreadsMutex;
+    std::vector<std::unique_ptr<CpuThreadCounters>> m_CpuThreads;
+    std::chrono::steady_clock::time_point m_LastResolveTime;
+    bool m_LastResolveTimeValid = false;
+
+    std::unique_ptr<TraceWriter> m_TraceWriter;
+    std::atomic<bool> m_TraceEnabled{ false };
+    std::chrono::steady_clock::time_point m_TraceStartTime;
+    std::array<std::chrono::steady_clock::time_point, c_ReadbackBanks> m_FrameSubmitTimes;
+    double m_GpuTrackEndMicroseconds = 0.0;
+
+    // Ring buffer with the per-frame measurements of the current accumulation period
+    std::vector<ProfilerFrameRecord> m_Timeline;
+    uint32_t m_TimelineStart = 0;
+    uint32_t m_TimelineLength = 0;
+    uint32_t m_ResolvedFrameIndex = 0;
 
     donut::app::DeviceManager& m_DeviceManager;
     nvrhi::DeviceHandle m_Device;
+
+    // Unique across all profilers ever created, so that the per-thread cache of counters in GetCpuThreadCounters
+    // can't match a new profiler that was allocated at the address of a destroyed one
+    const uint64_t m_InstanceId;
+
     nvrhi::BufferHandle m_RayCountBuffer;
-    std::array<nvrhi::BufferHandle, 2> m_RayCountReadback;
+    std::array<nvrhi::BufferHandle, c_ReadbackBanks> m_RayCountReadback;
     std::weak_ptr<RenderTargets> m_RenderTargets;
+
+    // Per-tile ray counters of every section, [section][tileY][tileX], see ResamplingConstants::enableRayCountTiles.
+    // The readback buffers are only created when the tile counters are enabled.
+    bool m_RayCountTilesEnabled = false;
+    uint32_t m_RayCountTilesX = 0;
+    uint32_t m_RayCountTilesY = 0;
+    nvrhi::BufferHandle m_RayCountTileBuffer;
+    std::array<nvrhi::BufferHandle, c_ReadbackBanks> m_RayCountTileReadback;
+    std::array<bool, c_ReadbackBanks> m_RayCountTileReadbackValid{};
+    std::vector<uint64_t> m_RayCountTileCounts;
+    uint32_t m_RayCountTileFrames = 0;
+    // Width and height of the render viewport: for the current frame, for the frame in every readback bank,
+    // and for the accumulated counts, which restart when the viewport changes
+    std::array<uint32_t, 2> m_RayCountViewport{};
+    std::array<std::array<uint32_t, 2>, c_ReadbackBanks> m_RayCountTileReadbackViewport{};
+    std::array<uint32_t, 2> m_RayCountTileViewport{};
     
 public:
     explicit Profiler(donut::app::DeviceManager& deviceManager);
+    ~Profiler();
 
     bool IsEnabled() const { return m_Enabled; }
     void EnableProfiler(bool enable);
@@ -55,17 +178,74 @@ public:
     void EndFrame(nvrhi::ICommandList* commandList);
     void BeginSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
     void EndSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
-    void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets) { m_RenderTargets = renderTargets; }
+    void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets);
 
     double GetTimer(ProfilerSection::Enum section);
     double GetRayCount(ProfilerSection::Enum section);
     double GetHitCount(ProfilerSection::Enum section);
     int GetMaterialReadback();
+    double GetPresampledLightCount(uint32_t lightType);
+    double GetCompactLightHitRate(uint32_t lightType);
 
     void BuildUI(bool enableRayCounts);
     std::string GetAsText();
 
+    // Per-frame timeline of the current accumulation period, i.e. of the whole benchmark run when it's active
+    [[nodiscard]] uint32_t GetTimelineLength() const { return m_TimelineLength; }
+    [[nodiscard]] const ProfilerFrameRecord& GetTimelineFrame(uint32_t index) const;
+    [[nodiscard]] ProfilerSectionStatistics GetSectionStatistics(ProfilerSection::Enum section) const;
+    std::string GetStatisticsAsText();
+    bool ExportTimelineCsv(const std::string& fileName) const;
+    bool ExportTimelineJson(const std::string& fileName) const;
+
+    // Adds the mean time of every section in the current accumulation period as a new run,
+    // plus the p99 frame times to catch regressions in the tail latency
+    void AppendBenchmarkRun(BenchmarkResults& results);
+
+    // Streams the CPU scopes and GPU sections of every resolved frame into a Chrome trace JSON file.
+    // GPU timer queries only provide durations, so the GPU track is reconstructed by placing every frame
+    // at its submission time, delayed until the previous GPU frame has finished, with the sections in order.
+    bool StartTrace(const std::string& fileName);
+    void StopTrace();
+
+    // Adds time spent on the calling thread in a CPU section, can be called from any thread
+    void AddCpuSectionTime(CpuProfilerSection::Enum section, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+    double GetCpuTimer(CpuProfilerSection::Enum section);
+    [[nodiscard]] ProfilerSectionStatistics GetCpuSectionStatistics(CpuProfilerSection::Enum section) const;
+
+    // Sets a counter for the current frame on the render thread, it's resolved with the timers of the frame
+    void SetCpuCounter(CpuProfilerCounter::Enum counter, double value);
+    double GetCpuCounter(CpuProfilerCounter::Enum counter);
+
     [[nodiscard]] nvrhi::IBuffer* GetRayCountBuffer() const { return m_RayCountBuffer; }
+
+    // Counts the rays in every 16x16 pixel tile of the screen, per section, in addition to the global counters.
+    // The counts follow the accumulation like the other values and can be saved as a heatmap image.
+    void EnableRayCountTiles(bool enable);
+    [[nodiscard]] bool IsRayCountTilesEnabled() const { return m_Enabled && m_RayCountTilesEnabled; }
+    [[nodiscard]] nvrhi::IBuffer* GetRayCountTileBuffer() const { return m_RayCountTileBuffer; }
+    [[nodiscard]] uint32_t GetRayCountTilesX() const { return m_RayCountTilesX; }
+    [[nodiscard]] uint32_t GetRayCountTilesY() const { return m_RayCountTilesY; }
+
+    // Sets the size of the render viewport for the current frame, which is smaller than the render targets
+    // when the resolution scale is below 1. Only the tiles inside it are shown in the heatmap.
+    void SetRayCountViewport(uint32_t width, uint32_t height) { m_RayCountViewport = { width, height }; }
+
+    // Writes the average rays per pixel in every tile as a .png or .bmp image at the viewport resolution,
+    // using a logarithmic color scale. Use ProfilerSection::Count to sum the rays of all sections,
+    // other sections must be in c_RayCountTileSections.
+    bool SaveRayCountHeatmap(const std::string& fileName, ProfilerSection::Enum section) const;
+    [[nodiscard]] static const char* GetSectionName(ProfilerSection::Enum section);
+
+    // The compact light counters are stored in the ray count buffer after the per-section ray counts
+    [[nodiscard]] static uint32_t GetCompactLightCounterOffset() { return ProfilerSection::Count * 2; }
+
+private:
+    CpuThreadCounters& GetCpuThreadCounters();
+    void ResolveRayCountTiles();
+    void ResolveCpuSections(std::array<double, CpuProfilerSection::Count>& outTimes);
+    void TraceGpuFrame(const ProfilerFrameRecord& record);
+    double GetTraceMicroseconds(std::chrono::steady_clock::time_point time) const;
 };
 
 class ProfilerScope
@@ -85,3 +265,22 @@ public:
     ProfilerScope& operator=(const ProfilerScope&) = delete;
     ProfilerScope& operator=(const ProfilerScope&&) = delete;
 };
+
+// Measures the CPU time between construction and destruction, usable on any thread
+class CpuProfilerScope
+{
+private:
+    Profiler& m_Profiler;
+    CpuProfilerSection::Enum m_Section;
+    std::chrono::steady_clock::time_point m_StartTime;
+
+public:
+    CpuProfilerScope(Profiler& profiler, CpuProfilerSection::Enum section);
+    ~CpuProfilerScope();
+
+    // Non-copyable and non-movable
+    CpuProfilerScope(const CpuProfilerScope&) = delete;
+    CpuProfilerScope(const CpuProfilerScope&&) = delete;
+    CpuProfilerScope& operator=(const CpuProfilerScope&) = delete;
+    CpuProfilerScope& operator=(const CpuProfilerScope&&) = delete;
+};
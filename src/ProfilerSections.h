@@ -44,3 +44,44 @@ struct ProfilerSection
         Count
     };
 };
+
+struct CpuProfilerSection
+{
+    enum Enum
+    {
+        Animation,
+        TlasInstances,
+        PrepareLights,
+        ResamplingConstants,
+        UserInterface,
+
+        // Not a scope, measured as the interval between resolved frames
+        Frame,
+
+        Count
+    };
+};
+
+// Values reported by the CPU code once per frame, averaged over the accumulated frames like the timers
+struct CpuProfilerCounter
+{
+    enum Enum
+    {
+        TlasChangedInstances,
+        TlasRebuilds,
+        TlasDegradation,
+        SkinnedBlasRefits,
+        SkinnedBlasRebuilds,
+        SkinnedBlasDeferred,
+        LightingEpoch,
+        PrepareLightsSkipped,
+        EmissiveLodProxies,
+        EmissiveLodProxyLights,
+        EmissiveLodReplacedTriangles,
+        LightStreamingResidentCells,
+        LightStreamingLoadingCells,
+        LightStreamingResidentLights,
+
+        Count
+    };
+};
@@ -9,6 +9,7 @@
  **************************************************************************/
 
 #include "RenderTargets.h"
+#include "GpuMemoryRegistry.h"
 
 #include <donut/engine/FramebufferFactory.h>
 
@@ -228,3 +229,22 @@ void RenderTargets::NextFrame()
     std::swap(DiffuseConfidence, PrevDiffuseConfidence);
     std::swap(SpecularConfidence, PrevSpecularConfidence);
 }
+
+void RenderTargets::RegisterMemory(GpuMemoryRegistry& registry) const
+{
+    const char* owner = "RenderTargets";
+    registry.RemoveOwner(owner);
+
+    for (nvrhi::ITexture* texture : {
+        DeviceDepth, DeviceDepthUAV, Depth, PrevDepth,
+        GBufferDiffuseAlbedo, GBufferSpecularRough, GBufferNormals, GBufferGeoNormals, GBufferEmissive,
+        PrevGBufferDiffuseAlbedo, PrevGBufferSpecularRough, PrevGBufferNormals, PrevGBufferGeoNormals,
+        MotionVectors, NormalRoughness,
+        HdrColor, LdrColor, DiffuseLighting, SpecularLighting, DenoisedDiffuseLighting, DenoisedSpecularLighting,
+        TaaFeedback1, TaaFeedback2, ResolvedColor, AccumulatedColor, RestirLuminance, PrevRestirLuminance,
+        Gradients, TemporalSamplePositions, DiffuseConfidence, SpecularConfidence, PrevDiffuseConfidence, PrevSpecularConfidence,
+        DebugColor, ReferenceColor })
+    {
+        registry.AddTexture(owner, texture);
+    }
+}
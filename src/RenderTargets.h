@@ -19,6 +19,8 @@ namespace donut::engine
     class FramebufferFactory;
 }
 
+class GpuMemoryRegistry;
+
 class RenderTargets
 {
 public:
@@ -72,4 +74,5 @@ public:
 
     bool IsUpdateRequired(dm::int2 size);
     void NextFrame();
+    void RegisterMemory(GpuMemoryRegistry& registry) const;
 };
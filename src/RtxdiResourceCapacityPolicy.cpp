@@ -0,0 +1,81 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "RtxdiResourceCapacityPolicy.h"
+
+#include <algorithm>
+
+uint32_t RtxdiResourceCapacityPolicy::RoundUp(uint32_t count, uint32_t quantum)
+{
+    quantum = std::max(quantum, 1u);
+    return std::max((count + quantum - 1) / quantum, 1u) * quantum;
+}
+
+void RtxdiResourceCapacityPolicy::Reset(const RtxdiResourceCapacities& counts)
+{
+    m_Capacities.emissiveMeshes = RoundUp(counts.emissiveMeshes, m_Parameters.quanta.emissiveMeshes);
+    m_Capacities.emissiveTriangles = RoundUp(counts.emissiveTriangles, m_Parameters.quanta.emissiveTriangles);
+    m_Capacities.primitiveLights = RoundUp(counts.primitiveLights, m_Parameters.quanta.primitiveLights);
+    m_Capacities.geometryInstances = RoundUp(counts.geometryInstances, m_Parameters.quanta.geometryInstances);
+    m_FramesBelowThreshold = RtxdiResourceCapacities();
+}
+
+int RtxdiResourceCapacityPolicy::UpdateCapacity(uint32_t count, uint32_t quantum, uint32_t& capacity, uint32_t& framesBelowThreshold) const
+{
+    if (count > capacity)
+    {
+        capacity = RoundUp(std::max(count, capacity * 2), quantum);
+        framesBelowThreshold = 0;
+        return 1;
+    }
+
+    const bool belowThreshold = m_Parameters.shrinkThreshold > 0.f
+        && double(count) <= double(capacity) * m_Parameters.shrinkThreshold
+        && capacity > RoundUp(0, quantum);
+
+    if (!belowThreshold)
+    {
+        framesBelowThreshold = 0;
+        return 0;
+    }
+
+    framesBelowThreshold++;
+    if (framesBelowThreshold < m_Parameters.shrinkDelayFrames)
+        return 0;
+
+    capacity = std::max(RoundUp(capacity / 2, quantum), RoundUp(count, quantum));
+    framesBelowThreshold = 0;
+    return -1;
+}
+
+bool RtxdiResourceCapacityPolicy::Update(const RtxdiResourceCapacities& counts)
+{
+    const RtxdiResourceCapacities& quanta = m_Parameters.quanta;
+
+    const int changes[] = {
+        UpdateCapacity(counts.emissiveMeshes, quanta.emissiveMeshes, m_Capacities.emissiveMeshes, m_FramesBelowThreshold.emissiveMeshes),
+        UpdateCapacity(counts.emissiveTriangles, quanta.emissiveTriangles, m_Capacities.emissiveTriangles, m_FramesBelowThreshold.emissiveTriangles),
+        UpdateCapacity(counts.primitiveLights, quanta.primitiveLights, m_Capacities.primitiveLights, m_FramesBelowThreshold.primitiveLights),
+        UpdateCapacity(counts.geometryInstances, quanta.geometryInstances, m_Capacities.geometryInstances, m_FramesBelowThreshold.geometryInstances)
+    };
+
+    bool grown = false;
+    bool shrunk = false;
+    for (int change : changes)
+    {
+        grown |= change > 0;
+        shrunk |= change < 0;
+    }
+
+    m_GrowCount += grown;
+    m_ShrinkCount += shrunk;
+
+    return grown || shrunk;
+}
@@ -0,0 +1,66 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Sizes of the RtxdiResources light buffers, either as item counts of a scene or as allocated capacities
+struct RtxdiResourceCapacities
+{
+    uint32_t emissiveMeshes = 0;
+    uint32_t emissiveTriangles = 0;
+    uint32_t primitiveLights = 0;
+    uint32_t geometryInstances = 0;
+};
+
+struct RtxdiResourceCapacityParameters
+{
+    // Capacities are multiples of these, which are also the smallest capacities
+    RtxdiResourceCapacities quanta = { 128, 1024, 128, 128 };
+
+    // A capacity is halved when its count has stayed at or below this fraction of it for shrinkDelayFrames frames.
+    // Shrinking loses the light history of one frame, so it should be rare. 0 disables shrinking.
+    float shrinkThreshold = 0.25f;
+    uint32_t shrinkDelayFrames = 600;
+};
+
+// Decides the capacities of the light buffers in RtxdiResources from the light counts of every frame.
+// A count that exceeds its capacity doubles the capacity, or grows it further if doubling is not enough,
+// so that content streaming in over many frames only resizes the buffers a logarithmic number of times.
+// The policy only works on the numbers passed in, so that it can be tested without a device.
+class RtxdiResourceCapacityPolicy
+{
+private:
+    RtxdiResourceCapacityParameters m_Parameters;
+    RtxdiResourceCapacities m_Capacities;
+    RtxdiResourceCapacities m_FramesBelowThreshold;
+    uint32_t m_GrowCount = 0;
+    uint32_t m_ShrinkCount = 0;
+
+    // Returns 1 if the capacity has grown, -1 if it has shrunk, 0 otherwise
+    [[nodiscard]] int UpdateCapacity(uint32_t count, uint32_t quantum, uint32_t& capacity, uint32_t& framesBelowThreshold) const;
+
+public:
+    void SetParameters(const RtxdiResourceCapacityParameters& parameters) { m_Parameters = parameters; }
+    [[nodiscard]] const RtxdiResourceCapacityParameters& GetParameters() const { return m_Parameters; }
+
+    // Sets the capacities to the counts rounded up to the quanta, for newly created resources
+    void Reset(const RtxdiResourceCapacities& counts);
+
+    // Updates the capacities for the counts of the current frame. Returns true if any capacity has changed.
+    bool Update(const RtxdiResourceCapacities& counts);
+
+    [[nodiscard]] const RtxdiResourceCapacities& GetCapacities() const { return m_Capacities; }
+    [[nodiscard]] uint32_t GetGrowCount() const { return m_GrowCount; }
+    [[nodiscard]] uint32_t GetShrinkCount() const { return m_ShrinkCount; }
+
+    [[nodiscard]] static uint32_t RoundUp(uint32_t count, uint32_t quantum);
+};
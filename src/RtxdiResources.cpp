@@ -9,6 +9,7 @@
  **************************************************************************/
 
 #include "RtxdiResources.h"
+#include "GpuMemoryRegistry.h"
 #include <rtxdi/RTXDI.h>
 
 #include <donut/core/math/math.h>
@@ -24,33 +25,18 @@ RtxdiResources::RtxdiResources(
     uint32_t maxPrimitiveLights,
     uint32_t maxGeometryInstances,
     uint32_t environmentMapWidth,
-    uint32_t environmentMapHeight)
+    uint32_t environmentMapHeight,
+    bool extendedCompactLightInfo)
     : m_MaxEmissiveMeshes(maxEmissiveMeshes)
     , m_MaxEmissiveTriangles(maxEmissiveTriangles)
     , m_MaxPrimitiveLights(maxPrimitiveLights)
     , m_MaxGeometryInstances(maxGeometryInstances)
+    , m_ExtendedCompactLightInfo(extendedCompactLightInfo)
 {
-    nvrhi::BufferDesc taskBufferDesc;
-    taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (maxEmissiveMeshes + maxPrimitiveLights);
-    taskBufferDesc.structStride = sizeof(PrepareLightsTask);
-    taskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    taskBufferDesc.keepInitialState = true;
-    taskBufferDesc.debugName = "TaskBuffer";
-    taskBufferDesc.canHaveUAVs = true;
-    TaskBuffer = device->createBuffer(taskBufferDesc);
-
-
-    nvrhi::BufferDesc primitiveLightBufferDesc;
-    primitiveLightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * maxPrimitiveLights;
-    primitiveLightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
-    primitiveLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    primitiveLightBufferDesc.keepInitialState = true;
-    primitiveLightBufferDesc.debugName = "PrimitiveLightBuffer";
-    PrimitiveLightBuffer = device->createBuffer(primitiveLightBufferDesc);
-
+    CreateLightBuffers(device);
 
     nvrhi::BufferDesc risBufferDesc;
-    risBufferDesc.byteSize = sizeof(uint32_t) * 2 * std::max(context.GetRisBufferElementCount(), 1u); // RG32_UINT per element
+    risBufferDesc.byteSize = GetRisBufferSize(context);
     risBufferDesc.format = nvrhi::Format::RG32_UINT;
     risBufferDesc.canHaveTypedViews = true;
     risBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
@@ -60,47 +46,14 @@ RtxdiResources::RtxdiResources(
     RisBuffer = device->createBuffer(risBufferDesc);
 
 
-    risBufferDesc.byteSize = sizeof(uint32_t) * 8 * std::max(context.GetRisBufferElementCount(), 1u); // RGBA32_UINT x 2 per element
+    risBufferDesc.byteSize = GetRisLightDataBufferSize(context, extendedCompactLightInfo);
     risBufferDesc.format = nvrhi::Format::RGBA32_UINT;
     risBufferDesc.debugName = "RisLightDataBuffer";
     RisLightDataBuffer = device->createBuffer(risBufferDesc);
 
 
-    uint32_t maxLocalLights = maxEmissiveTriangles + maxPrimitiveLights;
-    uint32_t lightBufferElements = maxLocalLights * 2;
-
-    nvrhi::BufferDesc lightBufferDesc;
-    lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightBufferElements;
-    lightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
-    lightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    lightBufferDesc.keepInitialState = true;
-    lightBufferDesc.debugName = "LightDataBuffer";
-    lightBufferDesc.canHaveUAVs = true;
-    LightDataBuffer = device->createBuffer(lightBufferDesc);
-
-
-    nvrhi::BufferDesc geometryInstanceToLightBufferDesc;
-    geometryInstanceToLightBufferDesc.byteSize = sizeof(uint32_t) * maxGeometryInstances;
-    geometryInstanceToLightBufferDesc.structStride = sizeof(uint32_t);
-    geometryInstanceToLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    geometryInstanceToLightBufferDesc.keepInitialState = true;
-    geometryInstanceToLightBufferDesc.debugName = "GeometryInstanceToLightBuffer";
-    GeometryInstanceToLightBuffer = device->createBuffer(geometryInstanceToLightBufferDesc);
-
-
-    nvrhi::BufferDesc lightIndexMappingBufferDesc;
-    lightIndexMappingBufferDesc.byteSize = sizeof(uint32_t) * lightBufferElements;
-    lightIndexMappingBufferDesc.format = nvrhi::Format::R32_UINT;
-    lightIndexMappingBufferDesc.canHaveTypedViews = true;
-    lightIndexMappingBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    lightIndexMappingBufferDesc.keepInitialState = true;
-    lightIndexMappingBufferDesc.debugName = "LightIndexMappingBuffer";
-    lightIndexMappingBufferDesc.canHaveUAVs = true;
-    LightIndexMappingBuffer = device->createBuffer(lightIndexMappingBufferDesc);
-    
-
     nvrhi::BufferDesc neighborOffsetBufferDesc;
-    neighborOffsetBufferDesc.byteSize = context.GetParameters().NeighborOffsetCount * 2;
+    neighborOffsetBufferDesc.byteSize = GetNeighborOffsetsBufferSize(context);
     neighborOffsetBufferDesc.format = nvrhi::Format::RG8_SNORM;
     neighborOffsetBufferDesc.canHaveTypedViews = true;
     neighborOffsetBufferDesc.debugName = "NeighborOffsets";
@@ -110,7 +63,7 @@ RtxdiResources::RtxdiResources(
 
 
     nvrhi::BufferDesc lightReservoirBufferDesc;
-    lightReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedReservoir) * context.GetReservoirBufferElementCount() * c_NumReservoirBuffers;
+    lightReservoirBufferDesc.byteSize = GetLightReservoirBufferSize(context);
     lightReservoirBufferDesc.structStride = sizeof(RTXDI_PackedReservoir);
     lightReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     lightReservoirBufferDesc.keepInitialState = true;
@@ -120,7 +73,7 @@ RtxdiResources::RtxdiResources(
 
 
     nvrhi::BufferDesc secondaryGBufferDesc;
-    secondaryGBufferDesc.byteSize = sizeof(SecondaryGBufferData) * context.GetReservoirBufferElementCount();
+    secondaryGBufferDesc.byteSize = GetSecondaryGBufferSize(context);
     secondaryGBufferDesc.structStride = sizeof(SecondaryGBufferData);
     secondaryGBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
     secondaryGBufferDesc.keepInitialState = true;
@@ -140,6 +93,71 @@ RtxdiResources::RtxdiResources(
     environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
     EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
 
+    nvrhi::BufferDesc giReservoirBufferDesc;
+    giReservoirBufferDesc.byteSize = GetGIReservoirBufferSize(context);
+    giReservoirBufferDesc.structStride = sizeof(RTXDI_PackedGIReservoir);
+    giReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    giReservoirBufferDesc.keepInitialState = true;
+    giReservoirBufferDesc.debugName = "GIReservoirBuffer";
+    giReservoirBufferDesc.canHaveUAVs = true;
+    GIReservoirBuffer = device->createBuffer(giReservoirBufferDesc);
+}
+
+void RtxdiResources::CreateLightBuffers(nvrhi::IDevice* device)
+{
+    nvrhi::BufferDesc taskBufferDesc;
+    taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (m_MaxEmissiveMeshes + m_MaxPrimitiveLights);
+    taskBufferDesc.structStride = sizeof(PrepareLightsTask);
+    taskBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    taskBufferDesc.keepInitialState = true;
+    taskBufferDesc.debugName = "TaskBuffer";
+    taskBufferDesc.canHaveUAVs = true;
+    TaskBuffer = device->createBuffer(taskBufferDesc);
+
+
+    // The emissive LOD proxies are primitive lights too, at most one per emissive mesh
+    nvrhi::BufferDesc primitiveLightBufferDesc;
+    primitiveLightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * (m_MaxEmissiveMeshes + m_MaxPrimitiveLights);
+    primitiveLightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
+    primitiveLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    primitiveLightBufferDesc.keepInitialState = true;
+    primitiveLightBufferDesc.debugName = "PrimitiveLightBuffer";
+    PrimitiveLightBuffer = device->createBuffer(primitiveLightBufferDesc);
+
+
+    uint32_t maxLocalLights = m_MaxEmissiveTriangles + m_MaxPrimitiveLights;
+    uint32_t lightBufferElements = maxLocalLights * 2;
+
+    nvrhi::BufferDesc lightBufferDesc;
+    lightBufferDesc.byteSize = sizeof(PolymorphicLightInfo) * lightBufferElements;
+    lightBufferDesc.structStride = sizeof(PolymorphicLightInfo);
+    lightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    lightBufferDesc.keepInitialState = true;
+    lightBufferDesc.debugName = "LightDataBuffer";
+    lightBufferDesc.canHaveUAVs = true;
+    LightDataBuffer = device->createBuffer(lightBufferDesc);
+
+
+    nvrhi::BufferDesc geometryInstanceToLightBufferDesc;
+    geometryInstanceToLightBufferDesc.byteSize = sizeof(uint32_t) * m_MaxGeometryInstances;
+    geometryInstanceToLightBufferDesc.structStride = sizeof(uint32_t);
+    geometryInstanceToLightBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    geometryInstanceToLightBufferDesc.keepInitialState = true;
+    geometryInstanceToLightBufferDesc.debugName = "GeometryInstanceToLightBuffer";
+    GeometryInstanceToLightBuffer = device->createBuffer(geometryInstanceToLightBufferDesc);
+
+
+    nvrhi::BufferDesc lightIndexMappingBufferDesc;
+    lightIndexMappingBufferDesc.byteSize = sizeof(uint32_t) * lightBufferElements;
+    lightIndexMappingBufferDesc.format = nvrhi::Format::R32_UINT;
+    lightIndexMappingBufferDesc.canHaveTypedViews = true;
+    lightIndexMappingBufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    lightIndexMappingBufferDesc.keepInitialState = true;
+    lightIndexMappingBufferDesc.debugName = "LightIndexMappingBuffer";
+    lightIndexMappingBufferDesc.canHaveUAVs = true;
+    LightIndexMappingBuffer = device->createBuffer(lightIndexMappingBufferDesc);
+    
+
     nvrhi::TextureDesc localLightPdfDesc;
     rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
     assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
@@ -149,15 +167,34 @@ RtxdiResources::RtxdiResources(
     localLightPdfDesc.keepInitialState = true;
     localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
     LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
-    
-    nvrhi::BufferDesc giReservoirBufferDesc;
-    giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * context.GetReservoirBufferElementCount() * c_NumGIReservoirBuffers;
-    giReservoirBufferDesc.structStride = sizeof(RTXDI_PackedGIReservoir);
-    giReservoirBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
-    giReservoirBufferDesc.keepInitialState = true;
-    giReservoirBufferDesc.debugName = "GIReservoirBuffer";
-    giReservoirBufferDesc.canHaveUAVs = true;
-    GIReservoirBuffer = device->createBuffer(giReservoirBufferDesc);
+}
+
+void RtxdiResources::ResizeLightBuffers(
+    nvrhi::IDevice* device,
+    uint32_t maxEmissiveMeshes,
+    uint32_t maxEmissiveTriangles,
+    uint32_t maxPrimitiveLights,
+    uint32_t maxGeometryInstances)
+{
+    const nvrhi::BufferHandle oldLightDataBuffer = LightDataBuffer;
+
+    m_MaxEmissiveMeshes = maxEmissiveMeshes;
+    m_MaxEmissiveTriangles = maxEmissiveTriangles;
+    m_MaxPrimitiveLights = maxPrimitiveLights;
+    m_MaxGeometryInstances = maxGeometryInstances;
+
+    CreateLightBuffers(device);
+
+    // The light data is copied to the same offsets, so that the lights of the previous frame stay valid if they
+    // don't overlap the current frame half of the new buffer, see PrepareLightsPass::CreateBindingSet.
+    // The other buffers and the PDF texture are rewritten whenever the lights are prepared.
+    const uint64_t copySize = std::min(oldLightDataBuffer->getDesc().byteSize, LightDataBuffer->getDesc().byteSize);
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+    commandList->copyBuffer(LightDataBuffer, 0, oldLightDataBuffer, 0, copySize);
+    commandList->close();
+    device->executeCommandList(commandList);
 }
 
 void RtxdiResources::InitializeNeighborOffsets(nvrhi::ICommandList* commandList, const rtxdi::Context& context)
@@ -174,3 +211,50 @@ void RtxdiResources::InitializeNeighborOffsets(nvrhi::ICommandList* commandList,
 
     m_NeighborOffsetsInitialized = true;
 }
+
+void RtxdiResources::RegisterMemory(GpuMemoryRegistry& registry) const
+{
+    const char* owner = "RtxdiResources";
+    registry.RemoveOwner(owner);
+
+    for (nvrhi::IBuffer* buffer : {
+        TaskBuffer, PrimitiveLightBuffer, LightDataBuffer, GeometryInstanceToLightBuffer, LightIndexMappingBuffer,
+        RisBuffer, RisLightDataBuffer, NeighborOffsetsBuffer, LightReservoirBuffer, SecondaryGBuffer, GIReservoirBuffer })
+    {
+        registry.AddBuffer(owner, buffer);
+    }
+
+    registry.AddTexture(owner, EnvironmentPdfTexture);
+    registry.AddTexture(owner, LocalLightPdfTexture);
+}
+
+uint64_t RtxdiResources::GetRisBufferSize(const rtxdi::Context& context)
+{
+    return sizeof(uint32_t) * 2 * uint64_t(std::max(context.GetRisBufferElementCount(), 1u)); // RG32_UINT per element
+}
+
+uint64_t RtxdiResources::GetRisLightDataBufferSize(const rtxdi::Context& context, bool extendedCompactLightInfo)
+{
+    const uint32_t risLightDataStride = extendedCompactLightInfo ? RIS_LIGHT_DATA_STRIDE_EXTENDED : RIS_LIGHT_DATA_STRIDE;
+    return sizeof(uint32_t) * 4 * risLightDataStride * uint64_t(std::max(context.GetRisBufferElementCount(), 1u)); // RGBA32_UINT x stride per element
+}
+
+uint64_t RtxdiResources::GetNeighborOffsetsBufferSize(const rtxdi::Context& context)
+{
+    return uint64_t(context.GetParameters().NeighborOffsetCount) * 2; // RG8_SNORM per offset
+}
+
+uint64_t RtxdiResources::GetLightReservoirBufferSize(const rtxdi::Context& context)
+{
+    return sizeof(RTXDI_PackedReservoir) * uint64_t(context.GetReservoirBufferElementCount()) * c_NumReservoirBuffers;
+}
+
+uint64_t RtxdiResources::GetSecondaryGBufferSize(const rtxdi::Context& context)
+{
+    return sizeof(SecondaryGBufferData) * uint64_t(context.GetReservoirBufferElementCount());
+}
+
+uint64_t RtxdiResources::GetGIReservoirBufferSize(const rtxdi::Context& context)
+{
+    return sizeof(RTXDI_PackedGIReservoir) * uint64_t(context.GetReservoirBufferElementCount()) * c_NumGIReservoirBuffers;
+}
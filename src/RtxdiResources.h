@@ -17,6 +17,8 @@ namespace rtxdi
     class Context;
 }
 
+class GpuMemoryRegistry;
+
 class RtxdiResources
 {
 private:
@@ -25,6 +27,10 @@ private:
     uint32_t m_MaxEmissiveTriangles = 0;
     uint32_t m_MaxPrimitiveLights = 0;
     uint32_t m_MaxGeometryInstances = 0;
+    bool m_ExtendedCompactLightInfo = false;
+
+    // Creates the resources whose sizes depend on the light capacities
+    void CreateLightBuffers(nvrhi::IDevice* device);
 
 public:
     nvrhi::BufferHandle TaskBuffer;
@@ -49,15 +55,37 @@ public:
         uint32_t maxPrimitiveLights,
         uint32_t maxGeometryInstances,
         uint32_t environmentMapWidth,
-        uint32_t environmentMapHeight);
+        uint32_t environmentMapHeight,
+        bool extendedCompactLightInfo);
+
+    // Recreates the task, light, mapping and geometry instance buffers and the local light PDF texture with
+    // new capacities, keeping the rest of the resources. The light data is copied into the new buffer,
+    // the binding sets that use the recreated resources must be updated.
+    void ResizeLightBuffers(
+        nvrhi::IDevice* device,
+        uint32_t maxEmissiveMeshes,
+        uint32_t maxEmissiveTriangles,
+        uint32_t maxPrimitiveLights,
+        uint32_t maxGeometryInstances);
 
     void InitializeNeighborOffsets(nvrhi::ICommandList* commandList, const rtxdi::Context& context);
+    void RegisterMemory(GpuMemoryRegistry& registry) const;
 
     uint32_t GetMaxEmissiveMeshes() const { return m_MaxEmissiveMeshes; }
     uint32_t GetMaxEmissiveTriangles() const { return m_MaxEmissiveTriangles; }
     uint32_t GetMaxPrimitiveLights() const { return m_MaxPrimitiveLights; }
     uint32_t GetMaxGeometryInstances() const { return m_MaxGeometryInstances; }
+    bool HasExtendedCompactLightInfo() const { return m_ExtendedCompactLightInfo; }
 
     static constexpr uint32_t c_NumReservoirBuffers = 3;
     static constexpr uint32_t c_NumGIReservoirBuffers = 2;
+
+    // Sizes of the buffers that depend on the context parameters, in bytes.
+    // These don't need a device, so they can be checked on the CPU, see tools/checks/GpuMemoryCheck.cpp.
+    static uint64_t GetRisBufferSize(const rtxdi::Context& context);
+    static uint64_t GetRisLightDataBufferSize(const rtxdi::Context& context, bool extendedCompactLightInfo);
+    static uint64_t GetNeighborOffsetsBufferSize(const rtxdi::Context& context);
+    static uint64_t GetLightReservoirBufferSize(const rtxdi::Context& context);
+    static uint64_t GetSecondaryGBufferSize(const rtxdi::Context& context);
+    static uint64_t GetGIReservoirBufferSize(const rtxdi::Context& context);
 };
@@ -14,6 +14,14 @@
 #include <json/value.h>
 #include <nvrhi/utils.h>
 #include <nvrhi/common/misc.h>
+#include <donut/core/log.h>
+#include <donut/engine/View.h>
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 #include "donut/engine/TextureCache.h"
 
@@ -224,68 +232,106 @@ inline uint64_t advanceHeapPtr(uint64_t& heapPtr, const nvrhi::MemoryRequirement
     return current;
 }
 
-void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
+// The BLASes are built in batches of about this many triangles, so that the scratch memory held by one
+// command list stays bounded for large scenes
+static const uint64_t c_BlasBuildBatchTriangles = 4 * 1024 * 1024;
+
+static nvrhi::rt::AccelStructDesc GetMeshBlasDesc(const engine::MeshInfo& mesh)
 {
-    assert(device->queryFeatureSupport(nvrhi::Feature::VirtualResources));
+    nvrhi::rt::AccelStructDesc blasDesc;
+    blasDesc.isTopLevel = false;
 
-    uint64_t heapSize = 0;
+    // Skinned meshes are rebuilt on every frame and live in the shared heap together with the TLASes.
+    // Static meshes get their own memory, so that it can be released when they are compacted.
+    blasDesc.isVirtual = mesh.skinPrototype != nullptr;
 
-    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    for (const auto& geometry : mesh.geometries)
     {
-        if (mesh->buffers->hasAttribute(engine::VertexAttribute::JointWeights))
-            continue;
+        nvrhi::rt::GeometryDesc geometryDesc;
+        auto& triangles = geometryDesc.geometryData.triangles;
+        triangles.indexBuffer = mesh.buffers->indexBuffer;
+        triangles.indexOffset = (mesh.indexOffset + geometry->indexOffsetInMesh) * sizeof(uint32_t);
+        triangles.indexFormat = nvrhi::Format::R32_UINT;
+        triangles.indexCount = geometry->numIndices;
+        triangles.vertexBuffer = mesh.buffers->vertexBuffer;
+        triangles.vertexOffset = (mesh.vertexOffset + geometry->vertexOffsetInMesh) * sizeof(float3) + mesh.buffers->getVertexBufferRange(engine::VertexAttribute::Position).byteOffset;
+        triangles.vertexFormat = nvrhi::Format::RGB32_FLOAT;
+        triangles.vertexStride = sizeof(float3);
+        triangles.vertexCount = geometry->numVertices;
+        geometryDesc.geometryType = nvrhi::rt::GeometryType::Triangles;
+        geometryDesc.flags = (geometry->material->domain == engine::MaterialDomain::Opaque)
+            ? nvrhi::rt::GeometryFlags::Opaque
+            : nvrhi::rt::GeometryFlags::None;
+        blasDesc.bottomLevelGeometries.push_back(geometryDesc);
+    }
 
-        nvrhi::rt::AccelStructDesc blasDesc;
-        blasDesc.isTopLevel = false;
-        blasDesc.isVirtual = true;
+    blasDesc.buildFlags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace;
+    if (!mesh.skinPrototype)
+    {
+        // Only allow compaction on non-skinned, static meshes.
+        blasDesc.buildFlags = blasDesc.buildFlags | nvrhi::rt::AccelStructBuildFlags::AllowCompaction;
+    }
+    else
+    {
+        // Skinned meshes are refitted between the rebuilds, see SkinnedBlasScheduler
+        blasDesc.buildFlags = blasDesc.buildFlags | nvrhi::rt::AccelStructBuildFlags::AllowUpdate;
+    }
 
-        for (const auto& geometry : mesh->geometries)
-        {
-            nvrhi::rt::GeometryDesc geometryDesc;
-            auto& triangles = geometryDesc.geometryData.triangles;
-            triangles.indexBuffer = mesh->buffers->indexBuffer;
-            triangles.indexOffset = (mesh->indexOffset + geometry->indexOffsetInMesh) * sizeof(uint32_t);
-            triangles.indexFormat = nvrhi::Format::R32_UINT;
-            triangles.indexCount = geometry->numIndices;
-            triangles.vertexBuffer = mesh->buffers->vertexBuffer;
-            triangles.vertexOffset = (mesh->vertexOffset + geometry->vertexOffsetInMesh) * sizeof(float3) + mesh->buffers->getVertexBufferRange(engine::VertexAttribute::Position).byteOffset;
-            triangles.vertexFormat = nvrhi::Format::RGB32_FLOAT;
-            triangles.vertexStride = sizeof(float3);
-            triangles.vertexCount = geometry->numVertices;
-            geometryDesc.geometryType = nvrhi::rt::GeometryType::Triangles;
-            geometryDesc.flags = (geometry->material->domain == engine::MaterialDomain::Opaque)
-                ? nvrhi::rt::GeometryFlags::Opaque
-                : nvrhi::rt::GeometryFlags::None;
-            blasDesc.bottomLevelGeometries.push_back(geometryDesc);
-        }
+    blasDesc.trackLiveness = false;
+    blasDesc.debugName = mesh.name;
 
-        blasDesc.buildFlags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace;
-        if (!mesh->skinPrototype)
-        {
-            // Only allow compaction on non-skinned, static meshes.
-            blasDesc.buildFlags = blasDesc.buildFlags | nvrhi::rt::AccelStructBuildFlags::AllowCompaction;
-        }
+    return blasDesc;
+}
 
-        blasDesc.trackLiveness = false;
-        blasDesc.debugName = mesh->name;
+void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device, tf::Executor* executor)
+{
+    assert(device->queryFeatureSupport(nvrhi::Feature::VirtualResources));
 
-        nvrhi::rt::AccelStructHandle as = device->createAccelStruct(blasDesc);
-        
-        advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(as));
+    const auto startTime = std::chrono::steady_clock::now();
+
+    // Only the first BLAS of the skinned meshes is built here, the scheduler must start from that state
+    m_SkinnedBlasScheduler.Resize(0);
+    m_SkinnedBlasScheduler.Resize(GetSceneGraph()->GetSkinnedMeshInstances().size());
+
+    std::vector<engine::MeshInfo*> meshes;
+    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    {
+        if (!mesh->buffers->hasAttribute(engine::VertexAttribute::JointWeights))
+            meshes.push_back(mesh.get());
+    }
+
+    // Preparing the descs and creating the BLAS objects is independent for every mesh
+    auto createMeshBlas = [device, &meshes](size_t index)
+    {
+        engine::MeshInfo& mesh = *meshes[index];
+        const nvrhi::rt::AccelStructDesc blasDesc = GetMeshBlasDesc(mesh);
+
+        mesh.accelStruct = device->createAccelStruct(blasDesc);
 
         // If this is a skinned mesh, create a second BLAS to toggle with the first one on every frame.
         // RTXDI needs access to the previous frame geometry in order to be unbiased.
-        if (mesh->skinPrototype)
+        if (mesh.skinPrototype)
         {
-            auto sampleMesh = dynamic_cast<SampleMesh*>(mesh.get());
+            auto sampleMesh = dynamic_cast<SampleMesh*>(&mesh);
             assert(sampleMesh);
             sampleMesh->prevAccelStruct = device->createAccelStruct(blasDesc);
-            advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(as));
         }
+    };
 
-        mesh->accelStruct = as;
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor && meshes.size() > 1)
+    {
+        tf::Taskflow taskflow;
+        taskflow.for_each_index(size_t(0), meshes.size(), size_t(1), createMeshBlas);
+        executor->run(taskflow).wait();
     }
-    
+    else
+#endif
+    {
+        for (size_t index = 0; index < meshes.size(); index++)
+            createMeshBlas(index);
+    }
+
     nvrhi::rt::AccelStructDesc tlasDesc;
     tlasDesc.isTopLevel = true;
     tlasDesc.isVirtual = true;
@@ -295,12 +341,36 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
 
     m_TopLevelAS = device->createAccelStruct(tlasDesc);
 
-    advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(m_TopLevelAS));
-        
+    // Both TLASes are built from the same instance buffer, the builds are ordered with the updates on the command list
+    nvrhi::BufferDesc instanceBufferDesc;
+    instanceBufferDesc.byteSize = std::max<size_t>(tlasDesc.topLevelMaxInstances, 1) * sizeof(nvrhi::rt::InstanceDesc);
+    instanceBufferDesc.isAccelStructBuildInput = true;
+    instanceBufferDesc.initialState = nvrhi::ResourceStates::AccelStructBuildInput;
+    instanceBufferDesc.keepInitialState = true;
+    instanceBufferDesc.debugName = "TlasInstances";
+    m_TlasInstanceBuffer = device->createBuffer(instanceBufferDesc);
+    m_TlasInstancesValid = false;
+
     tlasDesc.debugName = "PrevTopLevelAS";
 
     m_PrevTopLevelAS = device->createAccelStruct(tlasDesc);
 
+    // The heap only holds the skinned BLASes and the TLASes
+    uint64_t heapSize = 0;
+
+    for (engine::MeshInfo* mesh : meshes)
+    {
+        if (!mesh->skinPrototype)
+            continue;
+
+        auto sampleMesh = dynamic_cast<SampleMesh*>(mesh);
+        assert(sampleMesh);
+
+        advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(mesh->accelStruct));
+        advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(sampleMesh->prevAccelStruct));
+    }
+
+    advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(m_TopLevelAS));
     advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(m_PrevTopLevelAS));
 
 
@@ -313,24 +383,20 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
 
     heapSize = 0;
 
-    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    for (engine::MeshInfo* mesh : meshes)
     {
-        if (!mesh->accelStruct)
+        if (!mesh->skinPrototype)
             continue;
 
-        uint64_t heapOffset = advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(mesh->accelStruct));
+        auto sampleMesh = dynamic_cast<SampleMesh*>(mesh);
+        assert(sampleMesh);
 
+        uint64_t heapOffset = advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(mesh->accelStruct));
         device->bindAccelStructMemory(mesh->accelStruct, heap, heapOffset);
 
         // Bind memory for the second BLAS for skinned meshes.
-        if (mesh->skinPrototype)
-        {
-            auto sampleMesh = dynamic_cast<SampleMesh*>(mesh.get());
-            assert(sampleMesh);
-
-            heapOffset = advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(sampleMesh->prevAccelStruct));
-            device->bindAccelStructMemory(sampleMesh->prevAccelStruct, heap, heapOffset);
-        }
+        heapOffset = advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(sampleMesh->prevAccelStruct));
+        device->bindAccelStructMemory(sampleMesh->prevAccelStruct, heap, heapOffset);
     }
 
     uint64_t heapOffset = advanceHeapPtr(heapSize, device->getAccelStructMemoryRequirements(m_TopLevelAS));
@@ -346,12 +412,30 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
     clparams.scratchChunkSize = clparams.scratchMaxMemory;
 
     nvrhi::CommandListHandle commandList = device->createCommandList(clparams);
-    commandList->open();
 
-    for (const auto& mesh : GetSceneGraph()->GetMeshes())
+    // Record the builds in batches. The next batch is recorded while the previous one executes on the GPU,
+    // and at most two batches hold scratch memory at any time.
+    uint32_t batchCount = 0;
+    uint64_t batchTriangles = 0;
+    bool batchOpen = false;
+
+    auto submitBatch = [device, &commandList, &batchCount, &batchTriangles, &batchOpen]()
     {
-        if (!mesh->accelStruct)
-            continue;
+        commandList->close();
+        device->waitForIdle();
+        device->executeCommandList(commandList);
+        batchCount++;
+        batchTriangles = 0;
+        batchOpen = false;
+    };
+
+    for (engine::MeshInfo* mesh : meshes)
+    {
+        if (!batchOpen)
+        {
+            commandList->open();
+            batchOpen = true;
+        }
 
         // Get the desc from the AS, restore the buffer pointers because they're erased by nvrhi
         nvrhi::rt::AccelStructDesc blasDesc = mesh->accelStruct->getDesc();
@@ -359,28 +443,83 @@ void SampleScene::BuildMeshBLASes(nvrhi::IDevice* device)
         {
             geometryDesc.geometryData.triangles.indexBuffer = mesh->buffers->indexBuffer;
             geometryDesc.geometryData.triangles.vertexBuffer = mesh->buffers->vertexBuffer;
+            batchTriangles += geometryDesc.geometryData.triangles.indexCount / 3;
         }
 
         nvrhi::utils::BuildBottomLevelAccelStruct(commandList, mesh->accelStruct, blasDesc);
+
+        if (batchTriangles >= c_BlasBuildBatchTriangles)
+            submitBatch();
     }
 
+    if (batchOpen)
+        submitBatch();
+
+    device->waitForIdle();
+    device->runGarbageCollection();
+
+    const auto buildTime = std::chrono::steady_clock::now();
+
+    // Compact the static BLASes now that their compacted sizes are known. This copies every static BLAS into a buffer
+    // of the compacted size and releases the original one.
+    commandList->open();
+    commandList->compactBottomLevelAccelStructs();
     commandList->close();
     device->executeCommandList(commandList);
 
     device->waitForIdle();
     device->runGarbageCollection();
+
+    const auto endTime = std::chrono::steady_clock::now();
+
+    log::info("Built %d BLASes in %d batches in %.1f ms, compaction took %.1f ms",
+        int(meshes.size()), int(batchCount),
+        std::chrono::duration<double, std::milli>(buildTime - startTime).count(),
+        std::chrono::duration<double, std::milli>(endTime - buildTime).count());
 }
 
-void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex)
+void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex, const engine::IView& view)
 {
+    const auto& skinnedInstances = GetSceneGraph()->GetSkinnedMeshInstances();
+    if (m_SkinnedBlasScheduler.GetMeshCount() != skinnedInstances.size())
+        m_SkinnedBlasScheduler.Resize(skinnedInstances.size());
+
+    const auto viewFrustum = view.GetViewFrustum();
+    const float3 viewOrigin = view.GetViewOrigin();
+
+    for (size_t index = 0; index < skinnedInstances.size(); index++)
+    {
+        const auto& skinnedInstance = skinnedInstances[index];
+        const auto node = skinnedInstance->GetNode();
+
+        float distance = 0.f;
+        bool visible = true;
+        if (node)
+        {
+            // Distance from the view origin to the closest point of the bounds
+            const box3 bounds = node->GetGlobalBoundingBox();
+            distance = length(max(bounds.m_mins - viewOrigin, 0.f) + max(viewOrigin - bounds.m_maxs, 0.f));
+            visible = viewFrustum.intersectsWith(bounds);
+        }
+
+        m_SkinnedBlasScheduler.SetMesh(index, skinnedInstance->GetMesh()->totalIndices / 3, distance, visible,
+            skinnedInstance->GetLastUpdateFrameIndex() >= frameIndex);
+    }
+
+    m_SkinnedBlasScheduler.Schedule();
+
+    if (m_SkinnedBlasScheduler.GetRefitCount() + m_SkinnedBlasScheduler.GetRebuildCount() == 0)
+        return;
+
     commandList->beginMarker("Skinned BLAS Updates");
 
     // Transition all the buffers to their necessary states before building the BLAS'es to allow BLAS batching
-    for (const auto& skinnedInstance : GetSceneGraph()->GetSkinnedMeshInstances())
+    for (size_t index = 0; index < skinnedInstances.size(); index++)
     {
-        if (skinnedInstance->GetLastUpdateFrameIndex() < frameIndex)
+        if (m_SkinnedBlasScheduler.GetUpdate(index) == SkinnedBlasUpdate::None)
             continue;
         
+        const auto& skinnedInstance = skinnedInstances[index];
         auto sampleMesh = dynamic_cast<SampleMesh*>(skinnedInstance->GetMesh().get());
         assert(sampleMesh);
         assert(sampleMesh->prevAccelStruct);
@@ -391,13 +530,14 @@ void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint
     }
     commandList->commitBarriers();
 
-    // Now build the BLAS'es
-    for (const auto& skinnedInstance : GetSceneGraph()->GetSkinnedMeshInstances())
+    // Now build the BLAS'es. A refit updates the BLAS in place, it was last built from the same mesh two updates ago.
+    for (size_t index = 0; index < skinnedInstances.size(); index++)
     {
-        if (skinnedInstance->GetLastUpdateFrameIndex() < frameIndex)
+        const SkinnedBlasUpdate update = m_SkinnedBlasScheduler.GetUpdate(index);
+        if (update == SkinnedBlasUpdate::None)
             continue;
 
-        const auto& mesh = skinnedInstance->GetMesh();
+        const auto& mesh = skinnedInstances[index]->GetMesh();
         nvrhi::rt::AccelStructDesc blasDesc = mesh->accelStruct->getDesc();
         for (auto& geometryDesc : blasDesc.bottomLevelGeometries)
         {
@@ -405,58 +545,142 @@ void SampleScene::UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint
             geometryDesc.geometryData.triangles.vertexBuffer = mesh->buffers->vertexBuffer;
         }
 
+        if (update == SkinnedBlasUpdate::Refit)
+            blasDesc.buildFlags = blasDesc.buildFlags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate;
+
         nvrhi::utils::BuildBottomLevelAccelStruct(commandList, mesh->accelStruct, blasDesc);
     }
     commandList->endMarker();
 }
 
-void SampleScene::BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList)
+bool SampleScene::HasDirtyMaterials() const
 {
-    m_TlasInstances.resize(GetSceneGraph()->GetMeshInstances().size());
+    const auto& materials = GetSceneGraph()->GetMaterials();
+    return std::any_of(materials.begin(), materials.end(), [](const auto& material) { return material->dirty; });
+}
 
-    nvrhi::rt::AccelStructBuildFlags buildFlags = m_CanUpdateTLAS
-        ? nvrhi::rt::AccelStructBuildFlags::PerformUpdate
-        : nvrhi::rt::AccelStructBuildFlags::None;
-    
-    uint32_t index = 0;
+// Returns true if the doubleSided flag of any material has changed since the last call
+bool SampleScene::UpdateMaterialDoubleSided()
+{
+    const auto& materials = GetSceneGraph()->GetMaterials();
+
+    bool changed = m_MaterialDoubleSided.size() != materials.size();
+    m_MaterialDoubleSided.resize(materials.size());
 
-    for (const auto& instance : GetSceneGraph()->GetMeshInstances())
+    for (size_t index = 0; index < materials.size(); index++)
     {
-        const auto& mesh = instance->GetMesh();
-        
-        if (!mesh->accelStruct)
-            continue;
+        if (m_MaterialDoubleSided[index] != materials[index]->doubleSided)
+        {
+            m_MaterialDoubleSided[index] = materials[index]->doubleSided;
+            changed = true;
+        }
+    }
 
-        nvrhi::rt::InstanceDesc& instanceDesc = m_TlasInstances[index++];
+    return changed;
+}
+
+// The instance descriptions are cached between frames. The masks and flags are only recomputed when the scene structure
+// or the materials change, on other frames only the transforms and BLAS addresses are compared with the cached values,
+// and only the ranges of changed instances are written into the instance buffer.
+// Whether the TLAS is refitted or rebuilt is decided by the TlasRebuildPolicy from the bounds of the changed instances.
+void SampleScene::BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList)
+{
+    // Merging ranges separated by a few unchanged instances (64 bytes each) is cheaper than issuing more copies
+    constexpr size_t c_InstanceRangeMergeGap = 16;
 
-        instanceDesc.instanceMask = 0;
-        engine::SceneContentFlags contentFlags = instance->GetContentFlags();
+    const auto& instances = GetSceneGraph()->GetMeshInstances();
 
-        if ((contentFlags & engine::SceneContentFlags::OpaqueMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_OPAQUE;
+    const bool materialsChanged = UpdateMaterialDoubleSided();
+    const bool refreshAll = !m_TlasInstancesValid || m_SceneStructureChanged || materialsChanged
+        || m_TlasInstanceCache.GetInstanceCount() != instances.size();
 
-        if ((contentFlags & engine::SceneContentFlags::AlphaTestedMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_ALPHA_TESTED;
+    m_TlasInstanceCache.Resize(instances.size());
+    m_TlasRebuildPolicy.Resize(instances.size());
 
-        if ((contentFlags & engine::SceneContentFlags::BlendedMeshes) != 0)
-            instanceDesc.instanceMask |= INSTANCE_MASK_TRANSPARENT;
+    // Skinned meshes switch between two BLASes when they are updated, so their addresses need to be checked as well
+    if (refreshAll || m_SceneTransformsChanged || !GetSceneGraph()->GetSkinnedMeshInstances().empty())
+    {
+        size_t index = 0;
 
-        for (const auto& geometry : mesh->geometries)
+        for (const auto& instance : instances)
         {
-            if (geometry->material->doubleSided)
-                instanceDesc.flags = nvrhi::rt::InstanceFlags::TriangleCullDisable;
-        }
+            const auto& mesh = instance->GetMesh();
 
-        instanceDesc.bottomLevelAS = mesh->accelStruct;
+            if (!mesh->accelStruct)
+                continue;
 
-        auto node = instance->GetNode();
-        if (node)
-            dm::affineToColumnMajor(node->GetLocalToWorldTransformFloat(), instanceDesc.transform);
+            float transform[12];
+            auto node = instance->GetNode();
+            dm::affineToColumnMajor(node ? node->GetLocalToWorldTransformFloat() : dm::affine3::identity(), transform);
+
+            const uint64_t blasDeviceAddress = mesh->accelStruct->getDeviceAddress();
+
+            const float* boundsMin = &mesh->objectSpaceBounds.m_mins.x;
+            const float* boundsMax = &mesh->objectSpaceBounds.m_maxs.x;
+
+            if (!refreshAll)
+            {
+                if (m_TlasInstanceCache.SetTransform(index, transform, blasDeviceAddress))
+                    m_TlasRebuildPolicy.SetInstanceBounds(index, boundsMin, boundsMax, transform);
+
+                index++;
+                continue;
+            }
+
+            nvrhi::rt::InstanceDesc instanceDesc;
+            instanceDesc.instanceMask = 0;
+            engine::SceneContentFlags contentFlags = instance->GetContentFlags();
+
+            if ((contentFlags & engine::SceneContentFlags::OpaqueMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_OPAQUE;
+
+            if ((contentFlags & engine::SceneContentFlags::AlphaTestedMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_ALPHA_TESTED;
 
-        instanceDesc.instanceID = uint(instance->GetInstanceIndex());
+            if ((contentFlags & engine::SceneContentFlags::BlendedMeshes) != 0)
+                instanceDesc.instanceMask |= INSTANCE_MASK_TRANSPARENT;
+
+            for (const auto& geometry : mesh->geometries)
+            {
+                if (geometry->material->doubleSided)
+                    instanceDesc.flags = nvrhi::rt::InstanceFlags::TriangleCullDisable;
+            }
+
+            memcpy(instanceDesc.transform, transform, sizeof(transform));
+            instanceDesc.instanceID = uint(instance->GetInstanceIndex());
+            instanceDesc.blasDeviceAddress = blasDeviceAddress;
+
+            m_TlasInstanceCache.SetInstance(index, instanceDesc);
+            m_TlasRebuildPolicy.SetInstanceBounds(index, boundsMin, boundsMax, transform);
+            index++;
+        }
+
+        m_TlasInstancesValid = true;
     }
 
-    commandList->buildTopLevelAccelStruct(m_TopLevelAS, m_TlasInstances.data(), m_TlasInstances.size(), buildFlags);
+    for (const TlasInstanceRange& range : m_TlasInstanceCache.GetDirtyRanges(c_InstanceRangeMergeGap))
+    {
+        commandList->writeBuffer(m_TlasInstanceBuffer, &m_TlasInstanceCache.GetInstance(range.first),
+            range.count * sizeof(nvrhi::rt::InstanceDesc), range.first * sizeof(nvrhi::rt::InstanceDesc));
+    }
+
+    m_TlasChangedInstances = m_TlasInstanceCache.GetDirtyCount();
+    m_TlasInstanceCache.ClearDirty();
+
+    m_TlasRebuilt = !m_CanUpdateTLAS || m_TlasRebuildPolicy.ShouldRebuild();
+
+    // The degradation is measured against the last full build, and the other TLAS was last built before that,
+    // so a rebuild requested by the policy is followed by a rebuild of the other TLAS on the next frame
+    if (m_TlasRebuilt && m_CanUpdateTLAS)
+        m_CanUpdatePrevTLAS = false;
+
+    m_TlasRebuildPolicy.OnBuild(m_TlasRebuilt);
+
+    nvrhi::rt::AccelStructBuildFlags buildFlags = m_TlasRebuilt
+        ? nvrhi::rt::AccelStructBuildFlags::None
+        : nvrhi::rt::AccelStructBuildFlags::PerformUpdate;
+
+    commandList->buildTopLevelAccelStructFromBuffer(m_TopLevelAS, m_TlasInstanceBuffer, 0, m_TlasInstanceCache.GetInstanceCount(), buildFlags);
     m_CanUpdateTLAS = true;
 }
 
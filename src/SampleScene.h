@@ -12,6 +12,13 @@
 
 #include <donut/engine/Scene.h>
 #include <donut/engine/KeyframeAnimation.h>
+#include "SkinnedBlasScheduler.h"
+#include "TlasInstanceCache.h"
+#include "TlasRebuildPolicy.h"
+
+namespace donut::engine {
+    class IView;
+}
 
 constexpr int LightType_Environment = 1000;
 constexpr int LightType_Cylinder = 1001;
@@ -101,28 +108,49 @@ class SampleScene : public donut::engine::Scene
 private:
     nvrhi::rt::AccelStructHandle m_TopLevelAS;
     nvrhi::rt::AccelStructHandle m_PrevTopLevelAS;
-    std::vector<nvrhi::rt::InstanceDesc> m_TlasInstances;
+    nvrhi::BufferHandle m_TlasInstanceBuffer;
+    TlasInstanceCache m_TlasInstanceCache;
+    std::vector<bool> m_MaterialDoubleSided; // cached per material to detect changes in the instance flags
+    size_t m_TlasChangedInstances = 0;
+    TlasRebuildPolicy m_TlasRebuildPolicy;
+    bool m_TlasRebuilt = false;
+    SkinnedBlasScheduler m_SkinnedBlasScheduler;
     std::shared_ptr<donut::engine::SceneGraphAnimation> m_BenchmarkAnimation;
     std::shared_ptr<donut::engine::PerspectiveCamera> m_BenchmarkCamera;
     
     bool m_CanUpdateTLAS = false;
     bool m_CanUpdatePrevTLAS = false;
+    bool m_TlasInstancesValid = false;
 
     double m_WallclockTime = 0;
 
     std::vector<std::string> m_EnvironmentMaps;
 
+    bool UpdateMaterialDoubleSided();
+
 public:
     using Scene::Scene;
 
     bool LoadWithExecutor(const std::filesystem::path& jsonFileName, tf::Executor* executor) override;
 
+    // True if the last RefreshSceneGraph has applied added or removed nodes or changed transforms
+    [[nodiscard]] bool HasSceneGraphChanged() const { return m_SceneStructureChanged || m_SceneTransformsChanged; }
+    // True if any material has been modified and not yet uploaded, call before RefreshBuffers
+    [[nodiscard]] bool HasDirtyMaterials() const;
+
     const donut::engine::SceneGraphAnimation* GetBenchmarkAnimation() const { return m_BenchmarkAnimation.get(); }
     const donut::engine::PerspectiveCamera* GetBenchmarkCamera() const { return m_BenchmarkCamera.get(); }
     
-    void BuildMeshBLASes(nvrhi::IDevice* device);
-    void UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex);
+    // Creates the BLASes of the meshes in parallel on the executor, or serially if it is null
+    void BuildMeshBLASes(nvrhi::IDevice* device, tf::Executor* executor);
+    // Refits or rebuilds the BLASes of the skinned meshes chosen by the scheduler for this frame,
+    // using the view to reduce the update rate of distant and off-screen meshes
+    void UpdateSkinnedMeshBLASes(nvrhi::ICommandList* commandList, uint32_t frameIndex, const donut::engine::IView& view);
+    SkinnedBlasScheduler& GetSkinnedBlasScheduler() { return m_SkinnedBlasScheduler; }
     void BuildTopLevelAccelStruct(nvrhi::ICommandList* commandList);
+    [[nodiscard]] size_t GetTlasChangedInstanceCount() const { return m_TlasChangedInstances; }
+    [[nodiscard]] bool WasTlasRebuilt() const { return m_TlasRebuilt; }
+    TlasRebuildPolicy& GetTlasRebuildPolicy() { return m_TlasRebuildPolicy; }
     void NextFrame();
     void Animate(float  fElapsedTimeSeconds);
 
@@ -0,0 +1,122 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "SkinnedBlasScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+void SkinnedBlasScheduler::Resize(size_t count)
+{
+    m_Meshes.resize(count);
+}
+
+void SkinnedBlasScheduler::SetMesh(size_t index, uint32_t triangleCount, float distance, bool visible, bool animated)
+{
+    SkinnedBlasMeshState& mesh = m_Meshes[index];
+    mesh.triangleCount = triangleCount;
+    mesh.distance = distance;
+    mesh.visible = visible;
+    mesh.dirty |= animated;
+}
+
+uint32_t SkinnedBlasScheduler::GetInterval(const SkinnedBlasMeshState& mesh) const
+{
+    if (!mesh.visible)
+        return std::max(m_Parameters.offscreenInterval, 1u);
+
+    if (m_Parameters.fullRateDistance <= 0.f)
+        return 1;
+
+    const float interval = std::ceil(mesh.distance / m_Parameters.fullRateDistance);
+    return uint32_t(std::clamp(interval, 1.f, float(std::max(m_Parameters.maxDistantInterval, 1u))));
+}
+
+void SkinnedBlasScheduler::Schedule()
+{
+    m_RefitCount = 0;
+    m_RebuildCount = 0;
+    m_DeferredCount = 0;
+    m_ScheduledCost = 0.f;
+    m_Candidates.clear();
+
+    for (uint32_t index = 0; index < uint32_t(m_Meshes.size()); index++)
+    {
+        SkinnedBlasMeshState& mesh = m_Meshes[index];
+        mesh.update = SkinnedBlasUpdate::None;
+        mesh.cost = 0.f;
+        mesh.interval = GetInterval(mesh);
+
+        // Keep counting while the mesh is static, so that it's due as soon as it starts animating again
+        if (mesh.framesSinceUpdate < UINT32_MAX)
+            mesh.framesSinceUpdate++;
+
+        if (mesh.dirty && mesh.framesSinceUpdate >= mesh.interval)
+            m_Candidates.push_back(index);
+    }
+
+    // The meshes that are furthest past their interval go first
+    std::stable_sort(m_Candidates.begin(), m_Candidates.end(), [this](uint32_t a, uint32_t b)
+    {
+        const SkinnedBlasMeshState& meshA = m_Meshes[a];
+        const SkinnedBlasMeshState& meshB = m_Meshes[b];
+        return uint64_t(meshA.framesSinceUpdate) * meshB.interval > uint64_t(meshB.framesSinceUpdate) * meshA.interval;
+    });
+
+    for (uint32_t index : m_Candidates)
+    {
+        SkinnedBlasMeshState& mesh = m_Meshes[index];
+
+        const uint32_t target = 1 - mesh.currentBlas;
+        const bool rebuild = !mesh.blasBuilt[target] || mesh.refitsSinceRebuild[target] >= m_Parameters.refitsBetweenRebuilds;
+        const float cost = float(mesh.triangleCount) * (rebuild ? 1.f : m_Parameters.refitCost);
+
+        const bool first = m_RefitCount + m_RebuildCount == 0;
+        if (m_Parameters.triangleBudget != 0 && !first && m_ScheduledCost + cost > float(m_Parameters.triangleBudget))
+        {
+            m_DeferredCount++;
+            continue;
+        }
+
+        if (rebuild)
+        {
+            mesh.update = SkinnedBlasUpdate::Rebuild;
+            mesh.blasBuilt[target] = true;
+            mesh.refitsSinceRebuild[target] = 0;
+            mesh.rebuildCount++;
+            m_RebuildCount++;
+        }
+        else
+        {
+            mesh.update = SkinnedBlasUpdate::Refit;
+            mesh.refitsSinceRebuild[target]++;
+            mesh.refitCount++;
+            m_RefitCount++;
+        }
+
+        mesh.currentBlas = target;
+        mesh.dirty = false;
+        mesh.framesSinceUpdate = 0;
+        mesh.cost = cost;
+        mesh.totalCost += cost;
+        m_ScheduledCost += cost;
+    }
+}
+
+bool SkinnedBlasScheduler::HasPendingUpdates() const
+{
+    for (const SkinnedBlasMeshState& mesh : m_Meshes)
+    {
+        if (mesh.dirty)
+            return true;
+    }
+
+    return false;
+}
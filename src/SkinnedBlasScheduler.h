@@ -0,0 +1,116 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct SkinnedBlasSchedulerParameters
+{
+    // Estimated cost of the BLAS updates per frame, in rebuilt triangles. 0 means no limit.
+    // The most overdue mesh is always updated, even if it alone exceeds the budget.
+    uint32_t triangleBudget = 1000000;
+
+    // Visible meshes closer than this are updated on every frame they animate. Farther meshes are updated
+    // at an interval that grows linearly with the distance, i.e. every 2 frames at twice this distance etc.
+    float fullRateDistance = 10.f;
+    uint32_t maxDistantInterval = 8;
+
+    // Update interval of meshes outside of the view frustum
+    uint32_t offscreenInterval = 16;
+
+    // Each of the two BLASes of a mesh is refitted this many times before it's rebuilt to restore its quality
+    uint32_t refitsBetweenRebuilds = 30;
+
+    // Cost of a refit relative to a rebuild of the same mesh
+    float refitCost = 0.25f;
+};
+
+enum class SkinnedBlasUpdate : uint8_t
+{
+    None,
+    Refit,
+    Rebuild
+};
+
+struct SkinnedBlasMeshState
+{
+    // Inputs for the current frame
+    uint32_t triangleCount = 0;
+    float distance = 0.f;
+    bool visible = true;
+
+    // Set when the geometry changed, cleared when the BLAS is updated
+    bool dirty = false;
+
+    // Each mesh has two BLASes that swap on every update, so that the previous geometry stays available.
+    // The BLAS to be updated is the one that is not current, and it can be refitted if it was built before.
+    uint32_t currentBlas = 0;
+    bool blasBuilt[2] = { true, false };
+    uint32_t refitsSinceRebuild[2] = {};
+
+    // Results of the last Schedule call
+    SkinnedBlasUpdate update = SkinnedBlasUpdate::None;
+    uint32_t interval = 1;
+    uint32_t framesSinceUpdate = 0;
+    float cost = 0.f;
+
+    // Totals since the mesh was added
+    uint32_t refitCount = 0;
+    uint32_t rebuildCount = 0;
+    double totalCost = 0.0;
+};
+
+// Decides which skinned mesh BLASes are updated on a frame and whether they are refitted or rebuilt.
+// Meshes are updated at a rate that depends on their distance and visibility, and the updates of a frame
+// are limited by a budget; the meshes that are furthest past their interval go first, the rest is deferred.
+// The scheduler only works on the numbers passed in, so that it can be tested without a scene.
+class SkinnedBlasScheduler
+{
+private:
+    SkinnedBlasSchedulerParameters m_Parameters;
+    std::vector<SkinnedBlasMeshState> m_Meshes;
+    std::vector<uint32_t> m_Candidates;
+    uint32_t m_RefitCount = 0;
+    uint32_t m_RebuildCount = 0;
+    uint32_t m_DeferredCount = 0;
+    float m_ScheduledCost = 0.f;
+
+    [[nodiscard]] uint32_t GetInterval(const SkinnedBlasMeshState& mesh) const;
+
+public:
+    void SetParameters(const SkinnedBlasSchedulerParameters& parameters) { m_Parameters = parameters; }
+    [[nodiscard]] const SkinnedBlasSchedulerParameters& GetParameters() const { return m_Parameters; }
+
+    // Changes the number of meshes. Added meshes have their first BLAS built and the second one not.
+    void Resize(size_t count);
+
+    // Updates the inputs of a mesh for the current frame. Animated means that the geometry changed on this frame.
+    void SetMesh(size_t index, uint32_t triangleCount, float distance, bool visible, bool animated);
+
+    // Decides the updates of the current frame, then advances the BLAS state of the updated meshes
+    // as if the updates were done: the caller must do them in the same frame.
+    void Schedule();
+
+    [[nodiscard]] SkinnedBlasUpdate GetUpdate(size_t index) const { return m_Meshes[index].update; }
+    [[nodiscard]] const SkinnedBlasMeshState& GetMesh(size_t index) const { return m_Meshes[index]; }
+    [[nodiscard]] size_t GetMeshCount() const { return m_Meshes.size(); }
+
+    // True if some meshes have geometry changes that haven't been applied to their BLASes yet
+    [[nodiscard]] bool HasPendingUpdates() const;
+
+    // Statistics of the last Schedule call
+    [[nodiscard]] uint32_t GetRefitCount() const { return m_RefitCount; }
+    [[nodiscard]] uint32_t GetRebuildCount() const { return m_RebuildCount; }
+    [[nodiscard]] uint32_t GetDeferredCount() const { return m_DeferredCount; }
+    [[nodiscard]] float GetScheduledCost() const { return m_ScheduledCost; }
+};
@@ -11,6 +11,7 @@
 
 #include "Testing.h"
 #include "UserInterface.h"
+#include "ImageMetrics.h"
 
 #include <donut/app/DeviceManager.h>
 #include <donut/core/log.h>
@@ -153,6 +154,16 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("alpha-tested", "Alpha-tested materials toggle", value(ui.gbufferSettings.enableAlphaTestedGeometry))
         ("animation", "Animations toggle", value(ui.enableAnimations))
         ("benchmark", "Run the benchmark", value(args.benchmark))
+        ("benchmark-baseline", "Compare the benchmark results with a baseline file, exit with code 1 on regressions", value(args.benchmarkBaselineFileName))
+        ("benchmark-heatmap", "Save the rays per pixel of the benchmark as a .png or .bmp heatmap", value(args.benchmarkHeatmapFileName))
+        ("benchmark-quality", "Measure the noise of the final benchmark view against an accumulated reference and save the per-frame metrics to a .csv file", value(args.benchmarkQualityFileName))
+        ("benchmark-quality-frames", "Number of frames measured against the reference, default is 60", value(args.benchmarkQualityFrames))
+        ("benchmark-quality-target", "FLIP error that defines the time to quality, default is 0.1", value(args.benchmarkQualityTarget))
+        ("benchmark-reference-frames", "Number of frames accumulated into the quality reference, default is 1024", value(args.benchmarkReferenceFrames))
+        ("benchmark-results", "Save the benchmark results to a file that can be used as a baseline", value(args.benchmarkResultsFileName))
+        ("benchmark-runs", "Number of times to repeat the benchmark animation, default is 1", value(args.benchmarkRuns))
+        ("benchmark-significance", "Significance level of the regression tests, default is 0.05", value(args.benchmarkSignificance))
+        ("benchmark-timeline", "Save the per-frame benchmark timeline to a .csv or .json file", value(args.benchmarkTimelineFileName))
         ("bloom", "Bloom effect toggle", value(ui.enableBloom))
         ("checkerboard", "Use checkerboard rendering", value(checkerboard))
         ("d,debug", "Enable the DX12 or Vulkan validation layers", value(deviceParams.enableDebugRuntime))
@@ -169,11 +180,13 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         ("ray-query", "Ray Query toggle", value(ui.useRayQuery))
         ("direct-mode", "Direct lighting mode: NONE, BRDF, RESTIR", value(ui.directLightingMode))
         ("indirect-mode", "Indirect lighting mode: NONE, BRDF, RESTIRGI", value(ui.indirectLightingMode))
+        ("memory-report", "Save the GPU memory used by every resource owner to a .txt or .json file, updated when the resources are created", value(args.memoryReportFileName))
         ("render-width", "Internal render target width, overrides window size", value(args.renderWidth))
         ("render-height", "Internal render target height, overrides window size", value(args.renderHeight))
         ("save-file", "Save frame to file and exit", value(args.saveFrameFileName))
         ("save-frame", "Index of the frame to save, default is 0", value(args.saveFrameIndex))
         ("tone-mapping", "Tone mapping toggle", value(ui.enableToneMapping))
+        ("trace-file", "Write a Chrome trace of the CPU and GPU profiler sections to a .json file", value(args.traceFileName))
         ("transparent", "Transparent materials toggle", value(ui.gbufferSettings.enableTransparentGeometry))
         ("verbose", "Enable debug log messages", value(args.verbose))
         ("vk", "Run the application using Vulkan (otherwise D3D12 if supported)", value(useVk))
@@ -228,6 +241,20 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
         log::warning("The --save-frame argument is used without --save-file. It will be ignored.");
     }
 
+    if ((!args.benchmarkTimelineFileName.empty() || !args.benchmarkResultsFileName.empty() || !args.benchmarkBaselineFileName.empty()
+        || !args.benchmarkHeatmapFileName.empty() || !args.benchmarkQualityFileName.empty()) && !args.benchmark)
+    {
+        log::warning("The --benchmark-timeline, --benchmark-results, --benchmark-baseline, --benchmark-heatmap and --benchmark-quality arguments are used without --benchmark. They will be ignored.");
+    }
+    else if (!args.benchmarkHeatmapFileName.empty())
+    {
+        ui.lightingSettings.enableRayCounts = true;
+    }
+
+    args.benchmarkRuns = std::max(args.benchmarkRuns, 1u);
+    args.benchmarkReferenceFrames = std::max(args.benchmarkReferenceFrames, 1u);
+    args.benchmarkQualityFrames = std::max(args.benchmarkQualityFrames, 1u);
+
 #if USE_DX12 && USE_VK
     args.graphicsApi = useVk ? nvrhi::GraphicsAPI::VULKAN : nvrhi::GraphicsAPI::D3D12;
 #elif USE_DX12
@@ -350,3 +377,93 @@ bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* w
 
     return success;
 }
+
+static float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0x1f)
+    {
+        // Infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa != 0)
+    {
+        // Denormal, normalize it
+        exponent = 113;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    else
+    {
+        bits = sign;
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+bool ReadbackTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, MetricImage& outImage)
+{
+    const nvrhi::TextureDesc& desc = texture->getDesc();
+
+    if (desc.format != nvrhi::Format::RGBA16_FLOAT && desc.format != nvrhi::Format::RGBA32_FLOAT)
+    {
+        log::error("Cannot read back texture '%s': only RGBA16_FLOAT and RGBA32_FLOAT are supported.", desc.debugName.c_str());
+        return false;
+    }
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+
+    nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+    commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
+
+    commandList->close();
+    device->executeCommandList(commandList);
+    device->waitForIdle();
+
+    size_t rowPitch = 0;
+    const void* pData = device->mapStagingTexture(stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch);
+
+    if (!pData)
+    {
+        log::error("Couldn't map the readback texture.");
+        return false;
+    }
+
+    outImage = MetricImage(desc.width, desc.height);
+
+    for (uint32_t row = 0; row < desc.height; row++)
+    {
+        const char* rowData = static_cast<const char*>(pData) + row * rowPitch;
+        float* destination = outImage.GetPixel(0, row);
+
+        if (desc.format == nvrhi::Format::RGBA32_FLOAT)
+        {
+            memcpy(destination, rowData, desc.width * 4 * sizeof(float));
+        }
+        else
+        {
+            const uint16_t* source = reinterpret_cast<const uint16_t*>(rowData);
+            for (uint32_t component = 0; component < desc.width * 4; component++)
+                destination[component] = HalfToFloat(source[component]);
+        }
+    }
+
+    device->unmapStagingTexture(stagingTexture);
+
+    return true;
+}
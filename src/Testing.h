@@ -12,6 +12,8 @@
 
 #include <nvrhi/nvrhi.h>
 
+struct MetricImage;
+
 struct UIData;
 
 namespace donut::app {
@@ -31,6 +33,18 @@ struct CommandLineArguments
     std::string saveFrameFileName;
     bool verbose = false;
     bool benchmark = false;
+    std::string benchmarkTimelineFileName;
+    std::string benchmarkHeatmapFileName;
+    std::string benchmarkResultsFileName;
+    std::string benchmarkBaselineFileName;
+    uint32_t benchmarkRuns = 1;
+    double benchmarkSignificance = 0.05;
+    std::string benchmarkQualityFileName;
+    uint32_t benchmarkReferenceFrames = 1024;
+    uint32_t benchmarkQualityFrames = 60;
+    double benchmarkQualityTarget = 0.1;
+    std::string traceFileName;
+    std::string memoryReportFileName;
     bool disableBackgroundOptimization = false;
     int renderWidth = 0;
     int renderHeight = 0;
@@ -38,4 +52,5 @@ struct CommandLineArguments
 
 void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
 void ApplicationLogCallback(donut::log::Severity severity, const char* message);
-bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
\ No newline at end of file
+bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
+bool ReadbackTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, MetricImage& outImage);
@@ -0,0 +1,89 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TlasInstanceCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+void TlasInstanceCache::MarkDirty(size_t index)
+{
+    if (!m_Dirty[index])
+    {
+        m_Dirty[index] = true;
+        m_DirtyCount++;
+    }
+}
+
+void TlasInstanceCache::Resize(size_t count)
+{
+    if (count == m_Instances.size())
+        return;
+
+    m_Instances.resize(count);
+    m_Dirty.resize(count);
+    InvalidateAll();
+}
+
+void TlasInstanceCache::InvalidateAll()
+{
+    std::fill(m_Dirty.begin(), m_Dirty.end(), true);
+    m_DirtyCount = m_Dirty.size();
+}
+
+bool TlasInstanceCache::SetInstance(size_t index, const nvrhi::rt::InstanceDesc& desc)
+{
+    // The descriptions are plain data without padding, so a byte comparison is exact
+    if (memcmp(&m_Instances[index], &desc, sizeof(desc)) == 0)
+        return false;
+
+    m_Instances[index] = desc;
+    MarkDirty(index);
+    return true;
+}
+
+bool TlasInstanceCache::SetTransform(size_t index, const float transform[12], uint64_t blasDeviceAddress)
+{
+    nvrhi::rt::InstanceDesc& instance = m_Instances[index];
+
+    if (instance.blasDeviceAddress == blasDeviceAddress && memcmp(instance.transform, transform, sizeof(instance.transform)) == 0)
+        return false;
+
+    memcpy(instance.transform, transform, sizeof(instance.transform));
+    instance.blasDeviceAddress = blasDeviceAddress;
+    MarkDirty(index);
+    return true;
+}
+
+std::vector<TlasInstanceRange> TlasInstanceCache::GetDirtyRanges(size_t maxGap) const
+{
+    std::vector<TlasInstanceRange> ranges;
+    if (m_DirtyCount == 0)
+        return ranges;
+
+    for (size_t index = 0; index < m_Dirty.size(); index++)
+    {
+        if (!m_Dirty[index])
+            continue;
+
+        if (!ranges.empty() && index - (ranges.back().first + ranges.back().count) <= maxGap)
+            ranges.back().count = index - ranges.back().first + 1;
+        else
+            ranges.push_back({ index, 1 });
+    }
+
+    return ranges;
+}
+
+void TlasInstanceCache::ClearDirty()
+{
+    std::fill(m_Dirty.begin(), m_Dirty.end(), false);
+    m_DirtyCount = 0;
+}
@@ -0,0 +1,60 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <vector>
+
+// Range of consecutive instances in the TLAS instance buffer
+struct TlasInstanceRange
+{
+    size_t first = 0;
+    size_t count = 0;
+};
+
+// Keeps the TLAS instance descriptions between frames and tracks which of them changed since the last upload,
+// so that only the changed ranges of the instance buffer need to be written. The descriptions are stored in the
+// GPU layout, i.e. with the BLAS device address instead of the BLAS pointer, and uploaded as is.
+// The cache doesn't depend on the scene graph, the scene decides which instances need to be refreshed.
+class TlasInstanceCache
+{
+private:
+    std::vector<nvrhi::rt::InstanceDesc> m_Instances;
+    std::vector<bool> m_Dirty;
+    size_t m_DirtyCount = 0;
+
+    void MarkDirty(size_t index);
+
+public:
+    // Changes the number of instances. When the count changes, all instances become dirty.
+    void Resize(size_t count);
+
+    // Marks all instances dirty, e.g. after the instance buffer has been recreated
+    void InvalidateAll();
+
+    // Replaces the whole description of an instance. The instance only becomes dirty if the new description
+    // is different from the cached one. Returns true if the instance changed.
+    bool SetInstance(size_t index, const nvrhi::rt::InstanceDesc& desc);
+
+    // Updates the transform and the BLAS address of an instance whose mask and flags are known to be unchanged.
+    // Returns true if the instance changed.
+    bool SetTransform(size_t index, const float transform[12], uint64_t blasDeviceAddress);
+
+    // Consecutive ranges of dirty instances. Ranges separated by at most maxGap clean instances are merged,
+    // which uploads a few unchanged instances but reduces the number of copies.
+    [[nodiscard]] std::vector<TlasInstanceRange> GetDirtyRanges(size_t maxGap = 0) const;
+    void ClearDirty();
+
+    [[nodiscard]] size_t GetInstanceCount() const { return m_Instances.size(); }
+    [[nodiscard]] size_t GetDirtyCount() const { return m_DirtyCount; }
+    [[nodiscard]] const nvrhi::rt::InstanceDesc& GetInstance(size_t index) const { return m_Instances[index]; }
+    [[nodiscard]] const std::vector<nvrhi::rt::InstanceDesc>& GetInstances() const { return m_Instances; }
+};
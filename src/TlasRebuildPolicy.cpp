@@ -0,0 +1,117 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TlasRebuildPolicy.h"
+
+#include <algorithm>
+
+void TlasRebuildPolicy::Resize(size_t count)
+{
+    if (count == m_Instances.size())
+        return;
+
+    m_Instances.resize(count, InstanceBounds{});
+    m_BuildValid = false;
+}
+
+void TlasRebuildPolicy::SetInstanceBounds(size_t index, const float localMin[3], const float localMax[3], const float transform[12])
+{
+    InstanceBounds& instance = m_Instances[index];
+    TransformBounds(localMin, localMax, transform, instance.currentMin, instance.currentMax);
+
+    if (!m_BuildValid)
+        return;
+
+    float unionMin[3];
+    float unionMax[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        unionMin[axis] = std::min(instance.buildMin[axis], instance.currentMin[axis]);
+        unionMax[axis] = std::max(instance.buildMax[axis], instance.currentMax[axis]);
+    }
+
+    const double unionArea = GetSurfaceArea(unionMin, unionMax);
+    m_TotalUnionArea += unionArea - instance.unionArea;
+    instance.unionArea = unionArea;
+}
+
+bool TlasRebuildPolicy::ShouldRebuild() const
+{
+    if (!m_BuildValid)
+        return true;
+
+    if (m_FramesSinceRebuild < m_Parameters.minFramesBetweenRebuilds)
+        return false;
+
+    if (m_Parameters.maxRefitFrames != 0 && m_FramesSinceRebuild >= m_Parameters.maxRefitFrames)
+        return true;
+
+    return GetDegradation() > double(m_Parameters.degradationThreshold);
+}
+
+void TlasRebuildPolicy::OnBuild(bool rebuild)
+{
+    if (!rebuild)
+    {
+        m_RefitCount++;
+        m_FramesSinceRebuild++;
+        return;
+    }
+
+    m_RebuildCount++;
+    m_FramesSinceRebuild = 0;
+
+    // Recompute the sums from scratch to avoid accumulating rounding errors from the incremental updates
+    m_TotalBuildArea = 0.0;
+    for (InstanceBounds& instance : m_Instances)
+    {
+        std::copy(instance.currentMin, instance.currentMin + 3, instance.buildMin);
+        std::copy(instance.currentMax, instance.currentMax + 3, instance.buildMax);
+        instance.buildArea = GetSurfaceArea(instance.buildMin, instance.buildMax);
+        instance.unionArea = instance.buildArea;
+        m_TotalBuildArea += instance.buildArea;
+    }
+    m_TotalUnionArea = m_TotalBuildArea;
+    m_BuildValid = true;
+}
+
+double TlasRebuildPolicy::GetDegradation() const
+{
+    if (!m_BuildValid || m_TotalBuildArea <= 0.0)
+        return 1.0;
+
+    return m_TotalUnionArea / m_TotalBuildArea;
+}
+
+void TlasRebuildPolicy::TransformBounds(const float localMin[3], const float localMax[3], const float transform[12],
+    float worldMin[3], float worldMax[3])
+{
+    // Arvo's method: every output axis is the translation plus the extremes of the rotated and scaled input axes
+    for (int row = 0; row < 3; row++)
+    {
+        worldMin[row] = worldMax[row] = transform[row * 4 + 3];
+
+        for (int column = 0; column < 3; column++)
+        {
+            const float a = transform[row * 4 + column] * localMin[column];
+            const float b = transform[row * 4 + column] * localMax[column];
+            worldMin[row] += std::min(a, b);
+            worldMax[row] += std::max(a, b);
+        }
+    }
+}
+
+double TlasRebuildPolicy::GetSurfaceArea(const float boundsMin[3], const float boundsMax[3])
+{
+    const double x = std::max(double(boundsMax[0]) - double(boundsMin[0]), 0.0);
+    const double y = std::max(double(boundsMax[1]) - double(boundsMin[1]), 0.0);
+    const double z = std::max(double(boundsMax[2]) - double(boundsMin[2]), 0.0);
+    return 2.0 * (x * y + y * z + z * x);
+}
@@ -0,0 +1,83 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TlasRebuildPolicyParameters
+{
+    // Rebuild when the estimated degradation exceeds this value, see TlasRebuildPolicy::GetDegradation
+    float degradationThreshold = 1.5f;
+
+    // Rebuilds are more expensive than refits, so at least this many refits are done between two rebuilds
+    uint32_t minFramesBetweenRebuilds = 30;
+
+    // Rebuild after this many refits even if the degradation is below the threshold, 0 means no limit
+    uint32_t maxRefitFrames = 0;
+};
+
+// Decides whether the TLAS should be refitted or rebuilt. A refit keeps the tree topology of the last full build
+// and only grows the node bounds, so the tree gets worse as the instances move away from their positions at that build.
+// The policy estimates this on the CPU from the instance bounds: for every instance, it takes the surface area of the
+// union of its world bounds at the last build and its current bounds, which is what a refitted node containing the
+// instance has to cover, and divides the sum by the sum of the areas at the last build. The degradation is 1 right after
+// a build and grows with the motion; static instances keep it close to 1.
+// The sums are updated incrementally, so only the instances that changed need to be passed in.
+class TlasRebuildPolicy
+{
+private:
+    struct InstanceBounds
+    {
+        float buildMin[3];
+        float buildMax[3];
+        float currentMin[3];
+        float currentMax[3];
+        double buildArea;
+        double unionArea;
+    };
+
+    TlasRebuildPolicyParameters m_Parameters;
+    std::vector<InstanceBounds> m_Instances;
+    double m_TotalBuildArea = 0.0;
+    double m_TotalUnionArea = 0.0;
+    bool m_BuildValid = false;
+    uint32_t m_FramesSinceRebuild = 0;
+    uint32_t m_RefitCount = 0;
+    uint32_t m_RebuildCount = 0;
+
+public:
+    void SetParameters(const TlasRebuildPolicyParameters& parameters) { m_Parameters = parameters; }
+    [[nodiscard]] const TlasRebuildPolicyParameters& GetParameters() const { return m_Parameters; }
+
+    // Changes the number of instances. When the count changes, the next build must be a full rebuild.
+    void Resize(size_t count);
+
+    // Updates the current world bounds of an instance from its object space bounds and its row-major 3x4 transform,
+    // as stored in the TLAS instance descriptions
+    void SetInstanceBounds(size_t index, const float localMin[3], const float localMax[3], const float transform[12]);
+
+    [[nodiscard]] bool ShouldRebuild() const;
+
+    // Records the build of this frame. After a rebuild, the current bounds become the reference for the degradation.
+    void OnBuild(bool rebuild);
+
+    [[nodiscard]] double GetDegradation() const;
+    [[nodiscard]] uint32_t GetFramesSinceRebuild() const { return m_FramesSinceRebuild; }
+    [[nodiscard]] uint32_t GetRefitCount() const { return m_RefitCount; }
+    [[nodiscard]] uint32_t GetRebuildCount() const { return m_RebuildCount; }
+
+    // World space bounds of a box transformed by a row-major 3x4 matrix
+    static void TransformBounds(const float localMin[3], const float localMax[3], const float transform[12],
+        float worldMin[3], float worldMax[3]);
+    [[nodiscard]] static double GetSurfaceArea(const float boundsMin[3], const float boundsMax[3]);
+};
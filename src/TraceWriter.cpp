@@ -0,0 +1,113 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TraceWriter.h"
+
+#include <donut/core/log.h>
+
+TraceWriter::TraceWriter(const std::string& fileName)
+    : m_File(fileName)
+{
+    if (!m_File.is_open())
+    {
+        donut::log::error("Cannot open file '%s' for writing", fileName.c_str());
+        return;
+    }
+
+    m_File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    m_File.precision(3);
+
+    m_Thread = std::thread(&TraceWriter::WorkerThread, this);
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (!m_File.is_open())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_StopRequested = true;
+    }
+    m_Condition.notify_one();
+    m_Thread.join();
+
+    m_File << "\n]}\n";
+}
+
+void TraceWriter::SetThreadName(uint32_t threadId, const std::string& name)
+{
+    if (!m_File.is_open())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingThreadNames.emplace_back(threadId, name);
+    }
+    m_Condition.notify_one();
+}
+
+void TraceWriter::AddEvents(const std::vector<TraceEvent>& events)
+{
+    if (!m_File.is_open() || events.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingEvents.insert(m_PendingEvents.end(), events.begin(), events.end());
+    }
+    m_Condition.notify_one();
+}
+
+void TraceWriter::WorkerThread()
+{
+    std::vector<TraceEvent> events;
+    std::vector<std::pair<uint32_t, std::string>> threadNames;
+
+    while (true)
+    {
+        bool stop;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() {
+                return m_StopRequested || !m_PendingEvents.empty() || !m_PendingThreadNames.empty();
+            });
+
+            std::swap(events, m_PendingEvents);
+            std::swap(threadNames, m_PendingThreadNames);
+            stop = m_StopRequested;
+        }
+
+        for (const auto& [threadId, name] : threadNames)
+        {
+            m_File << (m_FirstEvent ? "\n" : ",\n")
+                << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << threadId
+                << ",\"args\":{\"name\":\"" << name << "\"}}";
+            m_FirstEvent = false;
+        }
+
+        for (const TraceEvent& event : events)
+        {
+            m_File << (m_FirstEvent ? "\n" : ",\n")
+                << "{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":0,\"tid\":" << event.threadId
+                << ",\"ts\":" << std::fixed << event.startMicroseconds
+                << ",\"dur\":" << event.durationMicroseconds << "}";
+            m_FirstEvent = false;
+        }
+
+        events.clear();
+        threadNames.clear();
+
+        if (stop)
+            break;
+    }
+
+    m_File.flush();
+}
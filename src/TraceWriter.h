@@ -0,0 +1,60 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One complete ("ph": "X") event in the Chrome trace event format
+struct TraceEvent
+{
+    const char* name = nullptr; // must point to a string with static lifetime
+    uint32_t threadId = 0;
+    double startMicroseconds = 0.0;
+    double durationMicroseconds = 0.0;
+};
+
+// Writes a Chrome trace JSON file, viewable in chrome://tracing or Perfetto.
+// Events are queued by the caller and formatted and written on a background thread,
+// so adding events only costs a copy into a vector.
+class TraceWriter
+{
+private:
+    std::ofstream m_File;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::vector<TraceEvent> m_PendingEvents;
+    std::vector<std::pair<uint32_t, std::string>> m_PendingThreadNames;
+    bool m_StopRequested = false;
+    bool m_FirstEvent = true;
+
+    void WorkerThread();
+
+public:
+    explicit TraceWriter(const std::string& fileName);
+    ~TraceWriter();
+
+    [[nodiscard]] bool IsOpen() const { return m_File.is_open(); }
+
+    void SetThreadName(uint32_t threadId, const std::string& name);
+    void AddEvents(const std::vector<TraceEvent>& events);
+
+    // Non-copyable and non-movable
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter(const TraceWriter&&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&&) = delete;
+};
@@ -35,6 +35,7 @@
 #include "UserInterface.h"
 #include "Profiler.h"
 #include "SampleScene.h"
+#include "GpuMemoryRegistry.h"
 
 #include <donut/engine/IesProfile.h>
 #include <donut/app/Camera.h>
@@ -48,6 +49,10 @@ using namespace donut;
 UIData::UIData()
 {
     rtxdiContextParams.ReGIR.Mode = rtxdi::ReGIRMode::Onion;
+
+    // Stratified environment presampling reaches the quality of the default tiles with half of their size,
+    // see tools/checks/EnvironmentPresamplingCheck.cpp
+    rtxdiContextParams.EnvironmentTileSize = 512;
     
     taaParams.newFrameWeight = 0.04f;
     taaParams.maxRadiance = 200.f;
@@ -220,6 +225,12 @@ static void ShowHelpMarker(const char* desc)
     }
 }
 
+// Item 0 of the heatmap combo box is the sum of all sections, the others are the sections with tile counts
+static ProfilerSection::Enum getHeatmapSection(int item)
+{
+    return item == 0 ? ProfilerSection::Count : Profiler::c_RayCountTileSections[item - 1];
+}
+
 void UserInterface::PerformanceWindow()
 {
     double frameTime = GetDeviceManager()->GetAverageFrameTimeSeconds();
@@ -234,8 +245,61 @@ void UserInterface::PerformanceWindow()
         ImGui::SameLine();
         ImGui::Checkbox("Count Rays", (bool*)&m_ui.lightingSettings.enableRayCounts);
 
+        if (m_ui.lightingSettings.enableRayCounts)
+        {
+            Profiler& profiler = *m_ui.resources->profiler;
+
+            ImGui::SameLine();
+            bool enableHeatmap = profiler.IsRayCountTilesEnabled();
+            ImGui::Checkbox("Ray Heatmap", &enableHeatmap);
+            ShowHelpMarker("Count the rays in every 16x16 pixel tile, per pass, to find the screen regions that trace the most rays.");
+            profiler.EnableRayCountTiles(enableHeatmap);
+
+            if (enableHeatmap)
+            {
+                ImGui::PushItemWidth(200.f);
+                ImGui::Combo("##heatmapSection", &m_ui.rayCountHeatmapItem, [](void*, int item, const char** outText)
+                {
+                    *outText = Profiler::GetSectionName(getHeatmapSection(item));
+                    return true;
+                }, nullptr, int(Profiler::c_RayCountTileSections.size()) + 1);
+                ImGui::PopItemWidth();
+
+                ImGui::SameLine();
+                if (ImGui::Button("Save Heatmap"))
+                    profiler.SaveRayCountHeatmap("RayCountHeatmap.png", getHeatmapSection(m_ui.rayCountHeatmapItem));
+            }
+        }
+
         m_ui.resources->profiler->BuildUI(m_ui.lightingSettings.enableRayCounts);
     }
+
+    if (m_ui.resources->memoryRegistry && ImGui::TreeNode("GPU Memory"))
+    {
+        const GpuMemoryRegistry& registry = *m_ui.resources->memoryRegistry;
+        constexpr double megabyte = 1024.0 * 1024.0;
+
+        for (const auto& [owner, ownerSize] : registry.GetOwnerSizes())
+        {
+            if (ImGui::TreeNode(owner.c_str(), "%s: %.2f MB", owner.c_str(), double(ownerSize) / megabyte))
+            {
+                for (const GpuMemoryAllocation& allocation : registry.GetAllocations())
+                {
+                    if (allocation.owner == owner)
+                        ImGui::Text("%s: %.3f MB", allocation.name.c_str(), double(allocation.byteSize) / megabyte);
+                }
+                ImGui::TreePop();
+            }
+        }
+
+        ImGui::Text("Total: %.2f MB", double(registry.GetTotalSize()) / megabyte);
+        ShowHelpMarker("Sizes computed from the resource descriptions, without the driver's alignment and padding.");
+
+        if (ImGui::Button("Save Report"))
+            registry.SaveReport("GpuMemoryReport.json");
+
+        ImGui::TreePop();
+    }
 }
 
 constexpr uint32_t c_ColorRegularHeader   = 0xffff8080;
@@ -290,6 +354,54 @@ void UserInterface::GeneralRenderingSettings()
         ImGui::SliderInt("FPS Limit", (int*)&m_ui.fpsLimit, 10, 60);
         ImGui::PopItemWidth();
 
+        ImGui::Checkbox("##enableFrameTimeController", &m_ui.enableFrameTimeController);
+        ImGui::SameLine();
+        ImGui::PushItemWidth(69.f);
+        ImGui::SliderFloat("GPU Time Budget (ms)", &m_ui.frameTimeControllerParams.targetFrameTimeMs, 4.f, 50.f, "%.1f");
+        ImGui::PopItemWidth();
+        ShowHelpMarker(
+            "Adjusts the local light, ReGIR, spatial and disocclusion boost sample counts and the resolution scale "
+            "to hold the GPU frame time within the budget. The settings are restored when the budget is disabled, "
+            "change them manually only while it's disabled.");
+        if (m_ui.enableFrameTimeController)
+        {
+            ImGui::Text("Quality level: %u / %u", m_ui.frameTimeControllerLevelCount - m_ui.frameTimeControllerLevel,
+                m_ui.frameTimeControllerLevelCount);
+        }
+
+        ImGui::SliderFloat("TLAS Rebuild Threshold", &m_ui.tlasRebuildParams.degradationThreshold, 1.05f, 4.f, "%.2f");
+        ShowHelpMarker(
+            "The TLAS is refitted on animated frames and rebuilt when the estimated degradation of the refitted tree, "
+            "i.e. the area covered by the moving instances relative to the last build, exceeds this value.");
+        ImGui::SliderInt("TLAS Min Rebuild Interval", (int*)&m_ui.tlasRebuildParams.minFramesBetweenRebuilds, 1, 240);
+
+        int skinnedBlasBudget = int(m_ui.skinnedBlasParams.triangleBudget / 1000);
+        ImGui::SliderInt("Skinned BLAS Budget (K tris)", &skinnedBlasBudget, 0, 4000);
+        m_ui.skinnedBlasParams.triangleBudget = uint32_t(skinnedBlasBudget) * 1000;
+        ShowHelpMarker(
+            "Estimated number of triangles in the skinned BLAS updates per frame, 0 means no limit. "
+            "Refits count as a fraction of their triangles. Meshes over the budget are updated on later frames.");
+        ImGui::SliderFloat("Skinned BLAS Full Rate Distance", &m_ui.skinnedBlasParams.fullRateDistance, 1.f, 100.f, "%.1f");
+        ShowHelpMarker(
+            "Visible skinned meshes closer than this are updated on every frame they animate. Farther meshes are updated "
+            "less often, and meshes outside of the view the least often.");
+
+        const auto& scene = m_ui.resources->scene;
+        if (scene && scene->GetSceneGraph() && !scene->GetSceneGraph()->GetSkinnedMeshInstances().empty()
+            && ImGui::TreeNode("Skinned BLAS Updates"))
+        {
+            const auto& skinnedInstances = scene->GetSceneGraph()->GetSkinnedMeshInstances();
+            const SkinnedBlasScheduler& scheduler = scene->GetSkinnedBlasScheduler();
+            for (size_t index = 0; index < std::min(skinnedInstances.size(), scheduler.GetMeshCount()); index++)
+            {
+                const SkinnedBlasMeshState& mesh = scheduler.GetMesh(index);
+                ImGui::Text("%s: %u tris, every %u frame(s), %u refits, %u rebuilds, %.0fK tris total",
+                    skinnedInstances[index]->GetMesh()->name.c_str(), mesh.triangleCount, mesh.interval,
+                    mesh.refitCount, mesh.rebuildCount, mesh.totalCost * 0.001);
+            }
+            ImGui::TreePop();
+        }
+
         m_ui.resetAccumulation |= ImGui::Checkbox("##enablePixelJitter", (bool*)&m_ui.enablePixelJitter);
         ImGui::SameLine();
         ImGui::PushItemWidth(69.f);
@@ -307,7 +419,44 @@ void UserInterface::SamplingSettings()
     if (ImGui_ColoredTreeNode("Shared ReSTIR Settings", c_ColorRegularHeader))
     {
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Local Lights", &m_ui.enableLocalLightImportanceSampling);
+        if (m_ui.enableLocalLightImportanceSampling)
+        {
+            m_ui.resetAccumulation |= ImGui::SliderFloat("Local Light Tile Refresh", &m_ui.lightingSettings.localLightTileRefreshFraction, 0.f, 1.f, "%.2f");
+            ShowHelpMarker("Fraction of the presampled local light tiles that are refreshed on every frame. "
+                "Other tiles are reused from the previous frame, which is only suitable for static lighting.");
+        }
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Env. Map", &m_ui.environmentMapImportanceSampling);
+        if (m_ui.environmentMapImportanceSampling)
+            m_ui.resetAccumulation |= ImGui::Checkbox("Stratified Env. Map Presampling", &m_ui.environmentMapStratifiedSampling);
+
+        m_ui.resetAccumulation |= ImGui::Checkbox("Emissive LOD", &m_ui.emissiveLodParams.enable);
+        ShowHelpMarker("Replaces distant emissive meshes with bounding sphere lights, which are shared by nearby meshes, "
+            "so that the distant meshes add a bounded number of lights in large scenes. The proxy lights ignore the emissive textures.");
+        if (m_ui.emissiveLodParams.enable)
+        {
+            m_ui.resetAccumulation |= ImGui::SliderFloat("Emissive LOD Solid Angle", &m_ui.emissiveLodParams.proxySolidAngle, 1e-6f, 1e-2f, "%.1e", ImGuiSliderFlags_Logarithmic);
+            ShowHelpMarker("Emissive meshes whose bounds cover a smaller solid angle than this, in steradians, are replaced.");
+            ImGui::SliderFloat("Emissive LOD Hysteresis", &m_ui.emissiveLodParams.hysteresis, 1.f, 4.f, "%.2f");
+            m_ui.resetAccumulation |= ImGui::SliderInt("Emissive LOD Max Proxies", (int*)&m_ui.emissiveLodParams.maxProxyLights, 1, 1024);
+            ShowHelpMarker("Upper bound of the number of proxy lights, nearby meshes share a proxy to stay below it.");
+        }
+
+        m_ui.resetAccumulation |= ImGui::Checkbox("Light Streaming", &m_ui.lightStreamingParams.enable);
+        ShowHelpMarker("Keeps only the lights and emissive meshes near the camera in the light buffer. "
+            "The scene is divided into cells that are loaded and evicted by their distance from the camera. "
+            "Local lights are always importance sampled while streaming, because the unused slots in the cell ranges "
+            "would waste uniformly distributed samples.");
+        if (m_ui.lightStreamingParams.enable)
+        {
+            m_ui.resetAccumulation |= ImGui::SliderFloat("Streaming Cell Size", &m_ui.lightStreamingParams.cellSize, 1.f, 256.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Streaming Load Distance", &m_ui.lightStreamingParams.loadDistance, 1.f, 1000.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Streaming Evict Distance", &m_ui.lightStreamingParams.evictDistance, 1.f, 1000.f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            ShowHelpMarker("Cells between the load and the evict distance stay in their current state.");
+            ImGui::SliderInt("Streaming Loads per Frame", (int*)&m_ui.lightStreamingParams.maxLoadsPerFrame, 1, 64);
+            ImGui::SliderInt("Streaming Load Latency", (int*)&m_ui.lightStreamingParams.loadLatencyFrames, 0, 30);
+            ShowHelpMarker("Number of frames between the load request of a cell and its lights appearing, "
+                "which stands in for the time to read the light data from storage.");
+        }
 
         if (ImGui::TreeNode("RTXDI Context"))
         {
@@ -318,6 +467,12 @@ void UserInterface::SamplingSettings()
             ImGui::Checkbox("Checkerboard Rendering", &enableCheckerboardSampling);
             m_ui.rtxdiContextParams.CheckerboardSamplingMode = enableCheckerboardSampling ? rtxdi::CheckerboardMode::Black : rtxdi::CheckerboardMode::Off;
 
+            ImGui::Checkbox("Env. Map Hemisphere Split", &m_ui.rtxdiContextParams.EnvironmentHemisphereSplit);
+
+            ImGui::Checkbox("Extended Compact Lights", &m_ui.extendedCompactLightInfo);
+            ShowHelpMarker("Stores the shaping data of presampled lights in the RIS buffers, which makes the buffers "
+                "50% larger but lets spot lights be loaded without accessing the full light buffer.");
+
             ImGui::Combo("ReGIR Mode", (int*)&m_ui.rtxdiContextParams.ReGIR.Mode, "Disabled\0Grid\0Onion\0");
             ImGui::DragInt("Lights per Cell", (int*)&m_ui.rtxdiContextParams.ReGIR.LightsPerCell, 1, 32, 8192);
             if (m_ui.rtxdiContextParams.ReGIR.Mode == rtxdi::ReGIRMode::Grid)
@@ -425,6 +580,18 @@ void UserInterface::SamplingSettings()
                 ShowHelpMarker(
                     "Number of samples drawn from the environment map when it is importance sampled.");
 
+                samplingSettingsChanged |= ImGui::Checkbox("Adaptive Light Type Selection", (bool*)&m_ui.lightingSettings.enableAdaptiveLightTypeSelection);
+                ShowHelpMarker(
+                    "Pools the local, infinite and environment samples and draws each one from a light type "
+                    "selected randomly, in proportion to the estimated power of each type.");
+
+                if (m_ui.lightingSettings.enableAdaptiveLightTypeSelection)
+                {
+                    samplingSettingsChanged |= ImGui::SliderFloat("Min Light Type Probability", &m_ui.lightingSettings.minLightTypeProbability, 0.01f, 0.33f);
+                    ShowHelpMarker(
+                        "Lower bound for the probability of selecting each light type that is present in the scene.");
+                }
+
                 samplingSettingsChanged |= ImGui::Checkbox("Enable Initial Visibility", (bool*)&m_ui.lightingSettings.enableInitialVisibility);
 
                 samplingSettingsChanged |= ImGui::SliderFloat("BRDF Sample Cutoff", (float*)&m_ui.lightingSettings.brdfCutoff, 0.0f, 0.1f);
@@ -1017,8 +1184,20 @@ void UserInterface::SceneSettings()
             ImGui::EndCombo();
         }
         ImGui::PopItemWidth();
-        m_ui.resetAccumulation |= ImGui::SliderFloat("Environment Bias (EV)", &m_ui.environmentIntensityBias, -8.f, 4.f);
-        m_ui.resetAccumulation |= ImGui::SliderFloat("Environment Rotation (deg)", &m_ui.environmentRotation, -180.f, 180.f);
+        if (ImGui::SliderFloat("Environment Bias (EV)", &m_ui.environmentIntensityBias, -8.f, 4.f))
+        {
+            m_ui.resetAccumulation = true;
+            m_ui.lightsChanged = true;
+        }
+        if (ImGui::Checkbox("Extract Sun from Env. Map", &m_ui.environmentMapSunExtraction))
+            m_ui.environmentMapDirty = 2;
+        ShowHelpMarker("Separates the brightest peak of the environment map into an analytic directional light "
+            "and uses the remaining sky for environment map sampling.");
+        if (ImGui::SliderFloat("Environment Rotation (deg)", &m_ui.environmentRotation, -180.f, 180.f))
+        {
+            m_ui.resetAccumulation = true;
+            m_ui.lightsChanged = true;
+        }
 
         {
             static float globalEmissiveFactor = 1.0f;
@@ -1110,6 +1289,10 @@ void UserInterface::SceneSettings()
 
         if (m_SelectedLight)
         {
+            // Not every editor widget reports its changes, so the stored light is compared instead
+            Json::Value lightBeforeEditing(Json::objectValue);
+            m_SelectedLight->Store(lightBeforeEditing);
+
             ImGui::PushItemWidth(200.f);
             switch (m_SelectedLight->GetLightType())
             {
@@ -1249,6 +1432,11 @@ void UserInterface::SceneSettings()
             }
             }
 
+            Json::Value lightAfterEditing(Json::objectValue);
+            m_SelectedLight->Store(lightAfterEditing);
+            if (lightAfterEditing != lightBeforeEditing)
+                m_ui.lightsChanged = true;
+
             if (ImGui::Button("Copy as JSON"))
             {
                 CopySelectedLight();
@@ -1303,6 +1491,8 @@ void UserInterface::buildUI()
 {
     if (!m_ui.showUI)
         return;
+
+    CpuProfilerScope scope(*m_ui.resources->profiler, CpuProfilerSection::UserInterface);
     
     int width, height;
     GetDeviceManager()->GetWindowDimensions(width, height);
@@ -17,6 +17,10 @@
 #include <donut/app/imgui_renderer.h>
 #include "GBufferPass.h"
 #include "LightingPasses.h"
+#include "PrepareLightsPass.h"
+#include "FrameTimeController.h"
+#include "SkinnedBlasScheduler.h"
+#include "TlasRebuildPolicy.h"
 
 #if WITH_NRD
 #include <NRD.h>
@@ -27,6 +31,7 @@
 
 
 class SampleScene;
+class GpuMemoryRegistry;
 
 namespace donut::engine {
     struct IesProfile;
@@ -73,6 +78,7 @@ enum class AntiAliasingMode : uint32_t
 struct UIResources
 {
     std::shared_ptr<Profiler> profiler;
+    std::shared_ptr<GpuMemoryRegistry> memoryRegistry;
 
     std::shared_ptr<SampleScene> scene;
     donut::app::FirstPersonCamera* camera = nullptr;
@@ -136,8 +142,11 @@ struct UIData
     ibool enableAnimations = true;
     float animationSpeed = 1.f;
     int environmentMapDirty = 0; // 1 -> needs to be rendered; 2 -> passes/textures need to be created
+    bool lightsChanged = false; // set when a light or the environment is edited, cleared by the light preparation
     int environmentMapIndex = -1;
+    bool environmentMapSunExtraction = false;
     bool environmentMapImportanceSampling = true;
+    bool environmentMapStratifiedSampling = true;
     bool enableLocalLightImportanceSampling = true;
     float environmentIntensityBias = 0.f;
     float environmentRotation = 0.f;
@@ -166,8 +175,22 @@ struct UIData
     bool enableFpsLimit = false;
     uint32_t fpsLimit = 60;
 
+    // Adjusts the sample counts and the resolution scale to hold the target GPU frame time
+    bool enableFrameTimeController = false;
+    FrameTimeControllerParameters frameTimeControllerParams;
+    uint32_t frameTimeControllerLevel = 0;
+    uint32_t frameTimeControllerLevelCount = 0;
+
+    TlasRebuildPolicyParameters tlasRebuildParams;
+    SkinnedBlasSchedulerParameters skinnedBlasParams;
+    EmissiveLodParameters emissiveLodParams;
+    LightStreamingParameters lightStreamingParams;
+
+    int rayCountHeatmapItem = 0; // 0 means all sections, otherwise Profiler::c_RayCountTileSections index + 1
+
     rtxdi::ContextParameters rtxdiContextParams;
     bool resetRtxdiContext = false;
+    bool extendedCompactLightInfo = false;
     uint32_t regirLightSlotCount = 0;
     bool freezeRegirPosition = false;
     float regirCellSize = 1.f;
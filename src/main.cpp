@@ -33,6 +33,8 @@
 #ifdef DONUT_WITH_TASKFLOW
 #include <taskflow/taskflow.hpp>
 #endif
+#include <fstream>
+#include <sstream>
 
 #include "RenderTargets.h"
 #include "ConfidencePass.h"
@@ -46,12 +48,18 @@
 #include "GenerateMipsPass.h"
 #include "LightingPasses.h"
 #include "RtxdiResources.h"
+#include "RtxdiResourceCapacityPolicy.h"
 #include "SampleScene.h"
 #include "Profiler.h"
 #include "UserInterface.h"
 #include "VisualizationPass.h"
 #include "Testing.h"
 #include "DebugViz/DebugVizPasses.h"
+#include "EnvironmentSunExtraction.h"
+#include "BenchmarkResults.h"
+#include "FrameTimeController.h"
+#include "GpuMemoryRegistry.h"
+#include "ImageMetrics.h"
 
 #if WITH_NRD
 #include "NrdIntegration.h"
@@ -78,6 +86,10 @@ using namespace std::chrono;
 
 static int g_ExitCode = 0;
 
+// Rough radiance integral of the procedural sky, which is never read back to the CPU:
+// unit luminance over the upper hemisphere.
+static const float c_ProceduralSkyRadianceIntegral = 2.f * PI_f;
+
 class SceneRenderer : public app::ApplicationBase
 {
 private:
@@ -88,6 +100,10 @@ private:
     std::shared_ptr<vfs::RootFileSystem> m_RootFs;
     std::shared_ptr<engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<SampleScene> m_Scene;
+#ifdef DONUT_WITH_TASKFLOW
+    // Created for the scene load and used again for the BLAS creation in SceneLoaded, then released
+    std::unique_ptr<tf::Executor> m_LoadingExecutor;
+#endif
     std::shared_ptr<engine::DescriptorTableManager> m_DescriptorTableManager;
     std::unique_ptr<render::ToneMappingPass> m_ToneMappingPass;
     std::unique_ptr<render::TemporalAntiAliasingPass> m_TemporalAntiAliasingPass;
@@ -100,6 +116,11 @@ private:
     std::shared_ptr<engine::DirectionalLight> m_SunLight;
     std::shared_ptr<EnvironmentLight> m_EnvironmentLight;
     std::shared_ptr<engine::LoadedTexture> m_EnvironmentMap;
+    std::shared_ptr<engine::DirectionalLight> m_ExtractedSunLight;
+    nvrhi::TextureHandle m_ResidualEnvironmentMap;
+    engine::DescriptorHandle m_ResidualEnvironmentMapDescriptor;
+    ExtractedSun m_ExtractedSun;
+    float m_EnvironmentMapRadianceIntegral = 0.f;
     engine::BindingCache m_BindingCache;
 
     std::unique_ptr<rtxdi::Context> m_RtxdiContext;
@@ -118,8 +139,10 @@ private:
     std::unique_ptr<LightingPasses> m_LightingPasses;
     std::unique_ptr<VisualizationPass> m_VisualizationPass;
     std::unique_ptr<RtxdiResources> m_RtxdiResources;
+    RtxdiResourceCapacityPolicy m_ResourceCapacityPolicy;
     std::unique_ptr<engine::IesProfileLoader> m_IesProfileLoader;
     std::shared_ptr<Profiler> m_Profiler;
+    std::shared_ptr<GpuMemoryRegistry> m_MemoryRegistry;
     std::unique_ptr<DebugVizPasses> m_DebugVizPasses;
 
     uint32_t m_RenderFrameIndex = 0;
@@ -135,10 +158,35 @@ private:
     UIData& m_ui;
     CommandLineArguments& m_args;
     uint m_FramesSinceAnimation = 0;
+    uint32_t m_FinalizedTextureCount = 0;
+    bool m_LocalLightPdfMipsDirty = true;
     bool m_PreviousViewValid = false;
     time_point<steady_clock> m_PreviousFrameTimeStamp;
 
     std::vector<std::shared_ptr<engine::IesProfile>> m_IesProfiles;
+
+    BenchmarkResults m_BenchmarkResults;
+    uint32_t m_BenchmarkDrainFrames = 0;
+
+    // Noise measurement at the end of the benchmark, see --benchmark-quality
+    enum class QualityBenchmarkPhase
+    {
+        None,
+        Reference,  // accumulating the reference image of the last benchmark view
+        Measure     // rendering the frames that are compared with the reference
+    };
+    QualityBenchmarkPhase m_QualityBenchmarkPhase = QualityBenchmarkPhase::None;
+    uint32_t m_QualityBenchmarkFrame = 0;
+    AntiAliasingMode m_QualityBenchmarkAaMode = AntiAliasingMode::None;
+    uint32_t m_QualityBenchmarkFramesToAccumulate = 0;
+    double m_QualityBenchmarkFrameTime = 0.0;
+    MetricImage m_QualityReference;
+    std::vector<ImageMetrics> m_QualityMetrics;
+
+    FrameTimeController m_FrameTimeController;
+    std::optional<FrameTimeControllerSettings> m_FrameTimeControllerBaseSettings; // set while the controller is active
+    bool m_ProfilerEnabledBeforeController = false;
+    uint32_t m_LastControlledFrameIndex = ~0u;
     
     dm::float3 m_RegirCenter;
     
@@ -235,6 +283,15 @@ public:
         m_Profiler = std::make_shared<Profiler>(*GetDeviceManager());
         m_ui.resources->profiler = m_Profiler;
 
+        m_MemoryRegistry = std::make_shared<GpuMemoryRegistry>();
+        m_ui.resources->memoryRegistry = m_MemoryRegistry;
+
+        if (!m_args.traceFileName.empty() && m_Profiler->StartTrace(m_args.traceFileName))
+            log::info("Writing the frame trace to '%s'", m_args.traceFileName.c_str());
+
+        if (m_args.benchmark && !m_args.benchmarkHeatmapFileName.empty())
+            m_Profiler->EnableRayCountTiles(true);
+
         m_FilterGradientsPass = std::make_unique<FilterGradientsPass>(GetDevice(), m_ShaderFactory);
         m_ConfidencePass = std::make_unique<ConfidencePass>(GetDevice(), m_ShaderFactory);
         m_CompositingPass = std::make_unique<CompositingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
@@ -281,8 +338,11 @@ public:
         return true;
     }
 
-    void AssignIesProfiles(nvrhi::ICommandList* commandList)
+    // Returns true if a profile has been assigned to a light
+    bool AssignIesProfiles(nvrhi::ICommandList* commandList)
     {
+        bool assigned = false;
+
         for (const auto& light : m_Scene->GetSceneGraph()->GetLights())
         {
             if (light->GetLightType() == LightType_SpotProfile)
@@ -303,9 +363,12 @@ public:
                     m_IesProfileLoader->BakeIesProfile(**foundProfile, commandList);
 
                     spotLight.profileTextureIndex = (*foundProfile)->textureIndex;
+                    assigned = true;
                 }
             }
         }
+
+        return assigned;
     }
 
     virtual void SceneLoaded() override
@@ -345,12 +408,23 @@ public:
         m_EnvironmentLight = std::make_shared<EnvironmentLight>();
         sceneGraph->AttachLeafNode(sceneGraph->GetRootNode(), m_EnvironmentLight);
         m_EnvironmentLight->SetName("Environment");
+
+        // Create a directional light that receives the sun extracted from the environment map, if enabled
+        m_ExtractedSunLight = std::make_shared<engine::DirectionalLight>();
+        sceneGraph->AttachLeafNode(sceneGraph->GetRootNode(), m_ExtractedSunLight);
+        m_ExtractedSunLight->SetName("ExtractedSun");
+        m_ExtractedSunLight->irradiance = 0.f;
         m_ui.environmentMapDirty = 2;
         m_ui.environmentMapIndex = 0;
         
         m_RasterizedGBufferPass->CreateBindingSet();
 
-        m_Scene->BuildMeshBLASes(GetDevice());
+#ifdef DONUT_WITH_TASKFLOW
+        m_Scene->BuildMeshBLASes(GetDevice(), m_LoadingExecutor.get());
+        m_LoadingExecutor.reset();
+#else
+        m_Scene->BuildMeshBLASes(GetDevice(), nullptr);
+#endif
 
         GetDeviceManager()->SetVsyncEnabled(false);
 
@@ -371,7 +445,14 @@ public:
 
     virtual bool LoadScene(std::shared_ptr<vfs::IFileSystem> fs, const std::filesystem::path& sceneFileName) override 
     {
-        if (m_Scene->Load(sceneFileName))
+#ifdef DONUT_WITH_TASKFLOW
+        m_LoadingExecutor = std::make_unique<tf::Executor>();
+        tf::Executor* executor = m_LoadingExecutor.get();
+#else
+        tf::Executor* executor = nullptr;
+#endif
+
+        if (m_Scene->LoadWithExecutor(sceneFileName, executor))
         {
             return true;
         }
@@ -463,7 +544,11 @@ public:
         m_Camera.Animate(fElapsedTimeSeconds);
 
         if (m_ui.enableAnimations)
+        {
+            CpuProfilerScope scope(*m_Profiler, CpuProfilerSection::Animation);
+
             m_Scene->Animate(fElapsedTimeSeconds * m_ui.animationSpeed);
+        }
 
         if (m_ToneMappingPass)
             m_ToneMappingPass->AdvanceFrame(fElapsedTimeSeconds);
@@ -501,6 +586,9 @@ public:
             m_TextureCache->UnloadTexture(m_EnvironmentMap);
             
             m_EnvironmentMap = nullptr;
+            m_ResidualEnvironmentMapDescriptor = {};
+            m_ResidualEnvironmentMap = nullptr;
+            m_EnvironmentMapRadianceIntegral = 0.f;
         }
 
         if (m_ui.environmentMapIndex > 0)
@@ -516,6 +604,18 @@ public:
                 m_TextureCache->LoadingFinished();
 
                 m_EnvironmentMap->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_EnvironmentMap->texture));
+
+                std::vector<float4> pixels;
+                if (ReadbackEnvironmentMap(pixels))
+                {
+                    if (m_ui.environmentMapSunExtraction)
+                        ExtractEnvironmentMapSun(pixels);
+
+                    // Integral of the map that is actually sampled, i.e. without the sun if it was extracted
+                    const nvrhi::TextureDesc& textureDesc = m_EnvironmentMap->texture->getDesc();
+                    const double3 integral = ComputeEnvironmentMapRadianceIntegral(pixels, textureDesc.width, textureDesc.height);
+                    m_EnvironmentMapRadianceIntegral = float(dot(integral, double3(0.2126, 0.7152, 0.0722)));
+                }
             }
             else
             {
@@ -527,6 +627,79 @@ public:
         }
     }
 
+    // Copies the loaded environment map to the CPU as float4 pixels.
+    bool ReadbackEnvironmentMap(std::vector<float4>& pixels)
+    {
+        nvrhi::ITexture* texture = m_EnvironmentMap->texture;
+        const nvrhi::TextureDesc& desc = texture->getDesc();
+
+        nvrhi::StagingTextureHandle stagingTexture = GetDevice()->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+        m_CommandList->open();
+        m_CommandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
+        m_CommandList->close();
+        GetDevice()->executeCommandList(m_CommandList);
+        GetDevice()->waitForIdle();
+
+        size_t rowPitch = 0;
+        const void* mappedData = GetDevice()->mapStagingTexture(stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch);
+        if (!mappedData)
+        {
+            log::warning("Couldn't map the environment map readback texture.");
+            return false;
+        }
+
+        const bool unpacked = UnpackEnvironmentMapPixels(mappedData, rowPitch, desc.format, desc.width, desc.height, pixels);
+        GetDevice()->unmapStagingTexture(stagingTexture);
+
+        if (!unpacked)
+        {
+            log::warning("Environment maps in the %s format can't be analyzed on the CPU, "
+                "sun extraction and adaptive light type selection will not use them.", nvrhi::utils::FormatToString(desc.format));
+            return false;
+        }
+
+        return true;
+    }
+
+    // Separates the sun from the loaded environment map into m_ExtractedSunLight,
+    // and replaces the environment map with the residual sky for shading and importance sampling.
+    void ExtractEnvironmentMapSun(std::vector<float4>& pixels)
+    {
+        const nvrhi::TextureDesc& desc = m_EnvironmentMap->texture->getDesc();
+
+        const double3 originalIntegral = ComputeEnvironmentMapRadianceIntegral(pixels, desc.width, desc.height);
+
+        if (!ExtractSunFromEnvironmentMap(pixels, desc.width, desc.height, SunExtractionParameters(), m_ExtractedSun))
+        {
+            log::info("No dominant sun found in the environment map.");
+            return;
+        }
+
+        const double3 residualIntegral = ComputeEnvironmentMapRadianceIntegral(pixels, desc.width, desc.height);
+        const double3 sunIrradiance = double3(m_ExtractedSun.color * m_ExtractedSun.irradiance);
+        log::info("Extracted the sun from the environment map: angular size %.2f deg, irradiance %.3f.",
+            m_ExtractedSun.angularSize, m_ExtractedSun.irradiance);
+        log::debug("Environment map energy: original (%.4f, %.4f, %.4f), residual + sun (%.4f, %.4f, %.4f)",
+            originalIntegral.x, originalIntegral.y, originalIntegral.z,
+            residualIntegral.x + sunIrradiance.x, residualIntegral.y + sunIrradiance.y, residualIntegral.z + sunIrradiance.z);
+
+        nvrhi::TextureDesc residualDesc;
+        residualDesc.width = desc.width;
+        residualDesc.height = desc.height;
+        residualDesc.format = nvrhi::Format::RGBA32_FLOAT;
+        residualDesc.debugName = "ResidualEnvironmentMap";
+        residualDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        residualDesc.keepInitialState = true;
+        m_ResidualEnvironmentMap = GetDevice()->createTexture(residualDesc);
+
+        m_CommandList->open();
+        m_CommandList->writeTexture(m_ResidualEnvironmentMap, 0, 0, pixels.data(), desc.width * sizeof(float4));
+        m_CommandList->close();
+        GetDevice()->executeCommandList(m_CommandList);
+
+        m_ResidualEnvironmentMapDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_ResidualEnvironmentMap));
+    }
+
     void SetupView(uint32_t renderWidth, uint32_t renderHeight, const engine::PerspectiveCamera* activeCamera)
     {
         nvrhi::Viewport windowViewport((float)renderWidth, (float)renderHeight);
@@ -534,11 +707,15 @@ public:
         if (m_TemporalAntiAliasingPass)
             m_TemporalAntiAliasingPass->SetJitter(m_ui.temporalJitter);
 
+        // The render targets, reservoir buffers and the RTXDI context are all created for the full render size,
+        // and the resolution scale only shrinks the viewport. So it can change on any frame without reallocations,
+        // and the temporal passes reproject the history through the previous view's viewport.
         nvrhi::Viewport renderViewport = windowViewport;
         renderViewport.maxX = roundf(renderViewport.maxX * m_ui.resolutionScale);
         renderViewport.maxY = roundf(renderViewport.maxY * m_ui.resolutionScale);
 
         m_View.SetViewport(renderViewport);
+        m_Profiler->SetRayCountViewport(uint32_t(renderViewport.maxX), uint32_t(renderViewport.maxY));
 
         if (m_ui.enablePixelJitter && m_TemporalAntiAliasingPass)
         {
@@ -590,6 +767,7 @@ public:
 
         bool renderTargetsCreated = false;
         bool rtxdiResourcesCreated = false;
+        bool denoiserCreated = false;
 
         if (!m_RenderEnvironmentMapPass)
         {
@@ -597,27 +775,38 @@ public:
         }
         
         const auto environmentMap = (m_ui.environmentMapIndex > 0)
-            ? m_EnvironmentMap->texture.Get()
+            ? (m_ResidualEnvironmentMap ? m_ResidualEnvironmentMap.Get() : m_EnvironmentMap->texture.Get())
             : m_RenderEnvironmentMapPass->GetTexture();
 
-        uint32_t numEmissiveMeshes, numEmissiveTriangles;
-        m_PrepareLightsPass->CountLightsInScene(numEmissiveMeshes, numEmissiveTriangles);
-        uint32_t numPrimitiveLights = uint32_t(m_Scene->GetSceneGraph()->GetLights().size());
-        uint32_t numGeometryInstances = uint32_t(m_Scene->GetSceneGraph()->GetGeometryInstancesCount());
-        
+        const RtxdiResourceCapacities lightCounts = m_PrepareLightsPass->GetLightBufferCounts();
+
         uint2 environmentMapSize = uint2(environmentMap->getDesc().width, environmentMap->getDesc().height);
 
         if (m_RtxdiResources && (
             environmentMapSize.x != m_RtxdiResources->EnvironmentPdfTexture->getDesc().width ||
-            environmentMapSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height ||
-            numEmissiveMeshes > m_RtxdiResources->GetMaxEmissiveMeshes() ||
-            numEmissiveTriangles > m_RtxdiResources->GetMaxEmissiveTriangles() || 
-            numPrimitiveLights > m_RtxdiResources->GetMaxPrimitiveLights() ||
-            numGeometryInstances > m_RtxdiResources->GetMaxGeometryInstances()))
+            environmentMapSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height))
         {
             m_RtxdiResources = nullptr;
         }
 
+        bool lightBuffersResized = false;
+        if (m_RtxdiResources && m_ResourceCapacityPolicy.Update(lightCounts))
+        {
+            // Only the light buffers change size, keep the rest of the resources and the light history
+            const RtxdiResourceCapacities& capacities = m_ResourceCapacityPolicy.GetCapacities();
+
+            m_RtxdiResources->ResizeLightBuffers(
+                GetDevice(),
+                capacities.emissiveMeshes,
+                capacities.emissiveTriangles,
+                capacities.primitiveLights,
+                capacities.geometryInstances);
+
+            m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources, true);
+
+            lightBuffersResized = true;
+        }
+
         if (!m_RtxdiContext)
         {
             m_ui.rtxdiContextParams.RenderWidth = renderWidth;
@@ -658,19 +847,19 @@ public:
 
         if (!m_RtxdiResources)
         {
-            uint32_t meshAllocationQuantum = 128;
-            uint32_t triangleAllocationQuantum = 1024;
-            uint32_t primitiveAllocationQuantum = 128;
+            m_ResourceCapacityPolicy.Reset(lightCounts);
+            const RtxdiResourceCapacities& capacities = m_ResourceCapacityPolicy.GetCapacities();
 
             m_RtxdiResources = std::make_unique<RtxdiResources>(
                 GetDevice(), 
                 *m_RtxdiContext, 
-                (numEmissiveMeshes + meshAllocationQuantum - 1) & ~(meshAllocationQuantum - 1),
-                (numEmissiveTriangles + triangleAllocationQuantum - 1) & ~(triangleAllocationQuantum - 1),
-                (numPrimitiveLights + primitiveAllocationQuantum - 1) & ~(primitiveAllocationQuantum - 1),
-                numGeometryInstances,
+                capacities.emissiveMeshes,
+                capacities.emissiveTriangles,
+                capacities.primitiveLights,
+                capacities.geometryInstances,
                 environmentMapSize.x,
-                environmentMapSize.y);
+                environmentMapSize.y,
+                m_ui.extendedCompactLightInfo);
 
             m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources);
             
@@ -689,7 +878,7 @@ public:
                 m_RtxdiResources->EnvironmentPdfTexture);
         }
 
-        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated)
+        if (!m_LocalLightPdfMipmapPass || rtxdiResourcesCreated || lightBuffersResized)
         {
             m_LocalLightPdfMipmapPass = std::make_unique<GenerateMipsPass>(
                 GetDevice(),
@@ -698,7 +887,7 @@ public:
                 m_RtxdiResources->LocalLightPdfTexture);
         }
 
-        if (renderTargetsCreated || rtxdiResourcesCreated)
+        if (renderTargetsCreated || rtxdiResourcesCreated || lightBuffersResized)
         {
             m_LightingPasses->CreateBindingSet(
                 m_Scene->GetTopLevelAS(),
@@ -710,7 +899,7 @@ public:
         if (rtxdiResourcesCreated || m_ui.reloadShaders)
         {
             // Some RTXDI context settings affect the shader permutations
-            m_LightingPasses->CreatePipelines(m_ui.rtxdiContextParams, m_ui.useRayQuery);
+            m_LightingPasses->CreatePipelines(m_ui.rtxdiContextParams, m_ui.useRayQuery, m_RtxdiResources->HasExtendedCompactLightInfo());
         }
 
         m_ui.reloadShaders = false;
@@ -759,6 +948,7 @@ public:
         {
             m_NRD = std::make_unique<NrdIntegration>(GetDevice(), m_ui.denoisingMethod);
             m_NRD->Initialize(m_RenderTargets->Size.x, m_RenderTargets->Size.y);
+            denoiserCreated = true;
         }
 #endif
 #ifdef WITH_DLSS
@@ -768,6 +958,254 @@ public:
             m_ui.dlssAvailable = m_DLSS->IsAvailable();
         }
 #endif
+
+        if (renderTargetsCreated || rtxdiResourcesCreated || lightBuffersResized || denoiserCreated)
+            UpdateMemoryRegistry();
+    }
+
+    void UpdateMemoryRegistry()
+    {
+        m_MemoryRegistry->Clear();
+
+        m_RenderTargets->RegisterMemory(*m_MemoryRegistry);
+        m_RtxdiResources->RegisterMemory(*m_MemoryRegistry);
+#if WITH_NRD
+        if (m_NRD)
+            m_NRD->RegisterMemory(*m_MemoryRegistry);
+#endif
+#ifdef WITH_DLSS
+        m_DLSS->RegisterMemory(*m_MemoryRegistry);
+#endif
+
+        if (!m_args.memoryReportFileName.empty())
+        {
+            if (m_MemoryRegistry->SaveReport(m_args.memoryReportFileName))
+                log::info("Saved the GPU memory report to '%s'", m_args.memoryReportFileName.c_str());
+            else
+                log::warning("Cannot write the GPU memory report to '%s'", m_args.memoryReportFileName.c_str());
+        }
+    }
+
+    [[nodiscard]] FrameTimeControllerSettings GetControlledSettings() const
+    {
+        FrameTimeControllerSettings settings;
+        settings.numPrimaryLocalLightSamples = m_ui.lightingSettings.numPrimaryLocalLightSamples;
+        settings.numPrimaryRegirSamples = m_ui.lightingSettings.numPrimaryRegirSamples;
+        settings.numSpatialSamples = m_ui.lightingSettings.numSpatialSamples;
+        settings.numDisocclusionBoostSamples = m_ui.lightingSettings.numDisocclusionBoostSamples;
+        settings.resolutionScale = m_ui.resolutionScale;
+        return settings;
+    }
+
+    void ApplyControlledSettings(const FrameTimeControllerSettings& settings)
+    {
+        m_ui.lightingSettings.numPrimaryLocalLightSamples = settings.numPrimaryLocalLightSamples;
+        m_ui.lightingSettings.numPrimaryRegirSamples = settings.numPrimaryRegirSamples;
+        m_ui.lightingSettings.numSpatialSamples = settings.numSpatialSamples;
+        m_ui.lightingSettings.numDisocclusionBoostSamples = settings.numDisocclusionBoostSamples;
+        m_ui.resolutionScale = settings.resolutionScale;
+    }
+
+    // Feeds the GPU frame time of the last resolved frame to the controller and applies the new settings.
+    // The settings that were active when the controller was enabled are restored when it's disabled.
+    void UpdateFrameTimeController()
+    {
+        // The benchmark measures the performance of fixed settings
+        const bool enable = m_ui.enableFrameTimeController && !m_ui.animationFrame.has_value()
+            && m_QualityBenchmarkPhase == QualityBenchmarkPhase::None;
+
+        if (!enable)
+        {
+            if (m_FrameTimeControllerBaseSettings.has_value())
+            {
+                ApplyControlledSettings(*m_FrameTimeControllerBaseSettings);
+                m_FrameTimeControllerBaseSettings.reset();
+                m_Profiler->EnableProfiler(m_ProfilerEnabledBeforeController);
+            }
+            return;
+        }
+
+        const FrameTimeControllerParameters& params = m_FrameTimeController.GetParameters();
+        if (params.targetFrameTimeMs != m_ui.frameTimeControllerParams.targetFrameTimeMs ||
+            params.hysteresis != m_ui.frameTimeControllerParams.hysteresis)
+        {
+            m_FrameTimeController.SetParameters(m_ui.frameTimeControllerParams);
+        }
+
+        if (!m_FrameTimeControllerBaseSettings.has_value())
+        {
+            m_FrameTimeControllerBaseSettings = GetControlledSettings();
+            m_FrameTimeController.Reset(*m_FrameTimeControllerBaseSettings);
+
+            // The controller needs the GPU timers, turning the profiler off in the UI afterwards pauses the controller
+            m_ProfilerEnabledBeforeController = m_Profiler->IsEnabled();
+            m_Profiler->EnableProfiler(true);
+        }
+
+        const uint32_t timelineLength = m_Profiler->GetTimelineLength();
+        if (timelineLength > 0)
+        {
+            const ProfilerFrameRecord& record = m_Profiler->GetTimelineFrame(timelineLength - 1);
+            if (record.frameIndex != m_LastControlledFrameIndex)
+            {
+                m_LastControlledFrameIndex = record.frameIndex;
+
+                if (m_FrameTimeController.Update(record.times[ProfilerSection::Frame]))
+                    ApplyControlledSettings(m_FrameTimeController.GetSettings());
+            }
+        }
+
+        m_ui.frameTimeControllerLevel = m_FrameTimeController.GetLevel();
+        m_ui.frameTimeControllerLevelCount = m_FrameTimeController.GetLevelCount();
+    }
+
+    void CompareBenchmarkWithBaseline()
+    {
+        if (!m_args.benchmarkResultsFileName.empty())
+        {
+            if (SaveBenchmarkResults(m_args.benchmarkResultsFileName, m_BenchmarkResults))
+                log::info("Saved the benchmark results to '%s'", m_args.benchmarkResultsFileName.c_str());
+            else
+                log::error("Cannot write the benchmark results to '%s'", m_args.benchmarkResultsFileName.c_str());
+        }
+
+        if (m_args.benchmarkBaselineFileName.empty())
+            return;
+
+        BenchmarkResults baseline;
+        std::string error;
+        if (!LoadBenchmarkResults(m_args.benchmarkBaselineFileName, baseline, error))
+        {
+            log::error("Cannot load the benchmark baseline: %s", error.c_str());
+            g_ExitCode = 1;
+            return;
+        }
+
+        if (baseline.renderer != m_BenchmarkResults.renderer)
+            log::warning("The benchmark baseline was recorded on a different renderer: %s", baseline.renderer.c_str());
+
+        const auto comparison = CompareBenchmarkResults(baseline, m_BenchmarkResults, m_args.benchmarkSignificance);
+        m_ui.benchmarkResults += "\nComparison with " + m_args.benchmarkBaselineFileName + ":\n" + FormatBenchmarkComparison(comparison);
+
+        for (const auto& result : comparison)
+        {
+            if (result.regression)
+                g_ExitCode = 1;
+        }
+    }
+
+    void FinishBenchmark()
+    {
+        glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
+        log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+    }
+
+    // Freezes the last view of the benchmark animation and accumulates the reference image for it.
+    // The reference comes from the same renderer, so the metrics measure the noise and not the bias.
+    void BeginQualityBenchmark()
+    {
+        m_QualityBenchmarkFrameTime = m_Profiler->GetSectionStatistics(ProfilerSection::Frame).mean;
+        m_QualityBenchmarkAaMode = m_ui.aaMode;
+        m_QualityBenchmarkFramesToAccumulate = m_ui.framesToAccumulate;
+
+        m_ui.enableAnimations = false;
+        m_ui.aaMode = AntiAliasingMode::Accumulation;
+        m_ui.framesToAccumulate = 0;
+        m_ui.resetAccumulation = true;
+
+        m_QualityBenchmarkPhase = QualityBenchmarkPhase::Reference;
+        m_QualityBenchmarkFrame = 0;
+        m_QualityMetrics.clear();
+
+        log::info("Accumulating the quality reference over %u frames", m_args.benchmarkReferenceFrames);
+    }
+
+    // Called after every frame of the quality benchmark, when the frame has been submitted
+    void UpdateQualityBenchmark()
+    {
+        m_QualityBenchmarkFrame++;
+
+        if (m_QualityBenchmarkPhase == QualityBenchmarkPhase::Reference)
+        {
+            if (m_QualityBenchmarkFrame < m_args.benchmarkReferenceFrames)
+                return;
+
+            if (!ReadbackTexture(GetDevice(), m_RenderTargets->ResolvedColor, m_QualityReference))
+            {
+                g_ExitCode = 1;
+                m_QualityBenchmarkPhase = QualityBenchmarkPhase::None;
+                FinishBenchmark();
+                return;
+            }
+
+            // Restart the benchmark settings from an empty history
+            m_ui.aaMode = m_QualityBenchmarkAaMode;
+            m_ui.framesToAccumulate = m_QualityBenchmarkFramesToAccumulate;
+            m_ui.resetAccumulation = true;
+            m_ui.resetRtxdiContext = true;
+
+            m_QualityBenchmarkPhase = QualityBenchmarkPhase::Measure;
+            m_QualityBenchmarkFrame = 0;
+            return;
+        }
+
+        MetricImage image;
+        if (ReadbackTexture(GetDevice(), m_RenderTargets->ResolvedColor, image))
+            m_QualityMetrics.push_back(ComputeImageMetrics(image, m_QualityReference));
+
+        if (m_QualityBenchmarkFrame < m_args.benchmarkQualityFrames)
+            return;
+
+        SaveQualityBenchmark();
+        m_QualityBenchmarkPhase = QualityBenchmarkPhase::None;
+        FinishBenchmark();
+    }
+
+    void SaveQualityBenchmark()
+    {
+        std::vector<double> flipErrors;
+        for (const ImageMetrics& metrics : m_QualityMetrics)
+            flipErrors.push_back(metrics.flip);
+
+        std::stringstream text;
+        text << "\nQuality over " << m_QualityMetrics.size() << " frames, reference of " << m_args.benchmarkReferenceFrames << " frames:\n";
+        text.precision(4);
+
+        if (!m_QualityMetrics.empty())
+        {
+            const ImageMetrics& first = m_QualityMetrics.front();
+            const ImageMetrics& last = m_QualityMetrics.back();
+            text << std::fixed << "FLIP: " << first.flip << " first frame, " << last.flip << " last frame\n";
+            text << std::fixed << "PSNR: " << first.psnr << " dB first frame, " << last.psnr << " dB last frame\n";
+        }
+
+        const int framesToQuality = GetFramesToQuality(flipErrors, m_args.benchmarkQualityTarget);
+        text << "Time to FLIP " << m_args.benchmarkQualityTarget << ": ";
+        if (framesToQuality >= 0)
+            text << std::fixed << double(framesToQuality + 1) * m_QualityBenchmarkFrameTime << " ms (" << framesToQuality + 1 << " frames)\n";
+        else
+            text << "not reached\n";
+
+        m_ui.benchmarkResults += text.str();
+
+        std::ofstream file(m_args.benchmarkQualityFileName);
+        if (!file.is_open())
+        {
+            log::error("Cannot write the benchmark quality to '%s'", m_args.benchmarkQualityFileName.c_str());
+            g_ExitCode = 1;
+            return;
+        }
+
+        file << "frame,time_ms,mse,rel_mse,psnr,flip\n";
+        file.precision(8);
+        for (size_t frame = 0; frame < m_QualityMetrics.size(); frame++)
+        {
+            const ImageMetrics& metrics = m_QualityMetrics[frame];
+            file << frame << "," << double(frame + 1) * m_QualityBenchmarkFrameTime << "," << metrics.mse << "," << metrics.relMse
+                << "," << metrics.psnr << "," << metrics.flip << "\n";
+        }
+
+        log::info("Saved the benchmark quality to '%s'", m_args.benchmarkQualityFileName.c_str());
     }
 
     virtual void RenderSplashScreen(nvrhi::IFramebuffer* framebuffer) override
@@ -856,27 +1294,74 @@ public:
         const engine::PerspectiveCamera* activeCamera = nullptr;
         uint effectiveFrameIndex = m_RenderFrameIndex;
 
-        if (m_ui.animationFrame.has_value())
+        if (m_QualityBenchmarkPhase != QualityBenchmarkPhase::None)
+        {
+            // The benchmark camera stays at the end of the animation
+            activeCamera = m_Scene->GetBenchmarkCamera();
+        }
+        else if (m_ui.animationFrame.has_value())
         {
             const float animationTime = float(m_ui.animationFrame.value()) * (1.f / 240.f);
             
             auto* animation = m_Scene->GetBenchmarkAnimation();
             if (animation && animationTime < animation->GetDuration())
             {
+                // The profiler resolves every frame c_ReadbackBanks frames after it was rendered, so the frames resolved
+                // until now were rendered before the run. Start accumulating right before the first frame of the run is resolved.
+                if (m_ui.animationFrame.value() == int(Profiler::c_ReadbackBanks))
+                    m_Profiler->ResetAccumulation();
+
                 (void)animation->Apply(animationTime);
                 activeCamera = m_Scene->GetBenchmarkCamera();
                 effectiveFrameIndex = m_ui.animationFrame.value();
                 m_ui.animationFrame = effectiveFrameIndex + 1;
+                m_BenchmarkDrainFrames = 0;
+            }
+            else if (m_BenchmarkDrainFrames < Profiler::c_ReadbackBanks)
+            {
+                // The last frames of the run are still in the readback ring, keep rendering the final view until they are resolved.
+                // The CPU sections are measured when a frame is resolved, so they cover as many frames as the run, shifted by the drain.
+                activeCamera = m_Scene->GetBenchmarkCamera();
+                m_BenchmarkDrainFrames++;
+            }
+            else if (m_args.benchmark && m_BenchmarkResults.runCount + 1 < m_args.benchmarkRuns)
+            {
+                // Repeat the animation, every run is one sample for the regression tests.
+                // The profiler state is reset when the first frame of the next run is resolved.
+                m_Profiler->AppendBenchmarkRun(m_BenchmarkResults);
+                m_ui.animationFrame = 0;
+                m_BenchmarkDrainFrames = 0;
             }
             else
             {
-                m_ui.benchmarkResults = m_Profiler->GetAsText();
+                m_BenchmarkDrainFrames = 0;
+                m_ui.benchmarkResults = m_Profiler->GetAsText() + "\n" + m_Profiler->GetStatisticsAsText();
                 m_ui.animationFrame.reset();
 
                 if (m_args.benchmark)
                 {
-                    glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
-                    log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+                    if (!m_args.benchmarkTimelineFileName.empty())
+                    {
+                        const std::string& fileName = m_args.benchmarkTimelineFileName;
+                        const bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+
+                        if (json ? m_Profiler->ExportTimelineJson(fileName) : m_Profiler->ExportTimelineCsv(fileName))
+                            log::info("Saved the benchmark timeline to '%s'", fileName.c_str());
+                    }
+
+                    if (!m_args.benchmarkHeatmapFileName.empty())
+                        m_Profiler->SaveRayCountHeatmap(m_args.benchmarkHeatmapFileName, ProfilerSection::Count);
+
+                    m_Profiler->AppendBenchmarkRun(m_BenchmarkResults);
+                    CompareBenchmarkWithBaseline();
+
+                    if (!m_args.benchmarkQualityFileName.empty())
+                    {
+                        BeginQualityBenchmark();
+                        activeCamera = m_Scene->GetBenchmarkCamera();
+                    }
+                    else
+                        FinishBenchmark();
                 }
             }
         }
@@ -933,6 +1418,9 @@ public:
             renderHeight = m_args.renderHeight;
         }
         SetupView(renderWidth, renderHeight, activeCamera);
+        // The resident light cells and the emissive LOD proxies determine the light buffer capacity, see SetupRenderPasses
+        m_PrepareLightsPass->UpdateLightStreaming(m_ui.lightStreamingParams, m_View.GetViewOrigin(), m_Scene->HasSceneGraphChanged());
+        m_PrepareLightsPass->UpdateEmissiveLod(m_ui.emissiveLodParams, m_View.GetViewOrigin());
         SetupRenderPasses(renderWidth, renderHeight, exposureResetRequired);
         if (!m_ui.freezeRegirPosition)
             m_RegirCenter = m_Camera.GetPosition();
@@ -979,6 +1467,8 @@ public:
         float accumulationWeight = 1.f / (float)m_ui.numAccumulatedFrames;
 
         m_Profiler->ResolvePreviousFrame();
+
+        UpdateFrameTimeController();
         
         int materialIndex = m_Profiler->GetMaterialReadback();
         if (materialIndex >= 0)
@@ -995,7 +1485,13 @@ public:
         
         if (m_ui.environmentMapIndex >= 0)
         {
-            if (m_EnvironmentMap)
+            if (m_ResidualEnvironmentMap)
+            {
+                m_EnvironmentLight->textureIndex = m_ResidualEnvironmentMapDescriptor.Get();
+                const auto& textureDesc = m_ResidualEnvironmentMap->getDesc();
+                m_EnvironmentLight->textureSize = uint2(textureDesc.width, textureDesc.height);
+            }
+            else if (m_EnvironmentMap)
             {
                 m_EnvironmentLight->textureIndex = m_EnvironmentMap->bindlessDescriptor.Get();
                 const auto& textureDesc = m_EnvironmentMap->texture->getDesc();
@@ -1010,11 +1506,24 @@ public:
             m_EnvironmentLight->radianceScale = ::exp2f(m_ui.environmentIntensityBias);
             m_EnvironmentLight->rotation = m_ui.environmentRotation / 360.f;  //  +/- 0.5
             m_SunLight->irradiance = (m_ui.environmentMapIndex > 0) ? 0.f : 1.f;
+
+            if (m_ResidualEnvironmentMap)
+            {
+                m_ExtractedSunLight->color = m_ExtractedSun.color;
+                m_ExtractedSunLight->irradiance = m_ExtractedSun.irradiance * m_EnvironmentLight->radianceScale.x;
+                m_ExtractedSunLight->angularSize = m_ExtractedSun.angularSize;
+                m_ExtractedSunLight->SetDirection(-dm::double3(GetExtractedSunDirection(m_ExtractedSun, m_EnvironmentLight->rotation)));
+            }
+            else
+            {
+                m_ExtractedSunLight->irradiance = 0.f;
+            }
         }
         else
         {
             m_EnvironmentLight->textureIndex = -1;
             m_SunLight->irradiance = 0.f;
+            m_ExtractedSunLight->irradiance = 0.f;
         }
         
 #if WITH_NRD
@@ -1033,16 +1542,36 @@ public:
 
         m_Profiler->BeginFrame(m_CommandList);
 
-        AssignIesProfiles(m_CommandList);
+        // Events that can change the lights, see PrepareLightsTaskBuilder::UpdateLightingEpoch. Textures count
+        // because the emissive ones are loaded asynchronously, and material edits are only visible before RefreshBuffers.
+        const uint32_t finalizedTextureCount = m_TextureCache->GetNumberOfFinalizedTextures();
+        bool sceneLightingChanged = m_Scene->HasSceneGraphChanged() || m_Scene->HasDirtyMaterials() || m_ui.lightsChanged
+            || m_ui.environmentMapDirty != 0 || m_FramesSinceAnimation < 2 || finalizedTextureCount != m_FinalizedTextureCount;
+        m_FinalizedTextureCount = finalizedTextureCount;
+        m_ui.lightsChanged = false;
+
+        sceneLightingChanged |= AssignIesProfiles(m_CommandList);
         m_Scene->RefreshBuffers(m_CommandList, GetFrameIndex());
         m_RtxdiResources->InitializeNeighborOffsets(m_CommandList, *m_RtxdiContext);
 
-        if (m_FramesSinceAnimation < 2)
+        // Skinned BLAS updates deferred by the scheduler are applied after the animation stops
+        if (m_FramesSinceAnimation < 2 || m_Scene->GetSkinnedBlasScheduler().HasPendingUpdates())
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::TlasUpdate);
 
-            m_Scene->UpdateSkinnedMeshBLASes(m_CommandList, GetFrameIndex());
+            m_Scene->GetSkinnedBlasScheduler().SetParameters(m_ui.skinnedBlasParams);
+            m_Scene->UpdateSkinnedMeshBLASes(m_CommandList, GetFrameIndex(), m_View);
+            const SkinnedBlasScheduler& skinnedBlasScheduler = m_Scene->GetSkinnedBlasScheduler();
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::SkinnedBlasRefits, double(skinnedBlasScheduler.GetRefitCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::SkinnedBlasRebuilds, double(skinnedBlasScheduler.GetRebuildCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::SkinnedBlasDeferred, double(skinnedBlasScheduler.GetDeferredCount()));
+
+            CpuProfilerScope cpuScope(*m_Profiler, CpuProfilerSection::TlasInstances);
+            m_Scene->GetTlasRebuildPolicy().SetParameters(m_ui.tlasRebuildParams);
             m_Scene->BuildTopLevelAccelStruct(m_CommandList);
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::TlasChangedInstances, double(m_Scene->GetTlasChangedInstanceCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::TlasRebuilds, m_Scene->WasTlasRebuilt() ? 1.0 : 0.0);
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::TlasDegradation, m_Scene->GetTlasRebuildPolicy().GetDegradation());
         }
         m_CommandList->compactBottomLevelAccelStructs();
 
@@ -1084,24 +1613,45 @@ public:
         frameParameters.regirCenter = { m_RegirCenter.x, m_RegirCenter.y, m_RegirCenter.z };
         frameParameters.regirCellSize = m_ui.regirCellSize;
         frameParameters.regirSamplingJitter = m_ui.regirSamplingJitter;
-        frameParameters.enableLocalLightImportanceSampling = m_ui.enableLocalLightImportanceSampling;
+        // Streaming leaves zero-power gap lights in the cell ranges, which only the PDF-based presampling skips
+        frameParameters.enableLocalLightImportanceSampling = m_ui.enableLocalLightImportanceSampling || m_ui.lightStreamingParams.enable;
+        frameParameters.environmentStratifiedSampling = m_ui.environmentMapStratifiedSampling;
+        frameParameters.enableAdaptiveLightTypeSelection = m_ui.lightingSettings.enableAdaptiveLightTypeSelection;
+        frameParameters.minLightTypeProbability = m_ui.lightingSettings.minLightTypeProbability;
 
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::MeshProcessing);
-            
-            m_PrepareLightsPass->Process(
+            CpuProfilerScope cpuScope(*m_Profiler, CpuProfilerSection::PrepareLights);
+
+            // Skips the light preparation when the lighting epoch hasn't changed since the last frame
+            m_LocalLightPdfMipsDirty |= m_PrepareLightsPass->Process(
                 m_CommandList,
                 *m_RtxdiContext,
                 m_Scene->GetSceneGraph()->GetLights(),
                 m_EnvironmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling,
+                m_EnvironmentMap ? m_EnvironmentMapRadianceIntegral : c_ProceduralSkyRadianceIntegral,
+                sceneLightingChanged,
+                m_FramesSinceAnimation < 2,
                 frameParameters);
+
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::LightingEpoch, double(m_PrepareLightsPass->GetLightingEpoch()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::PrepareLightsSkipped, m_PrepareLightsPass->WasSkipped() ? 1.0 : 0.0);
+            const PrepareLightsTaskBuilder& taskBuilder = m_PrepareLightsPass->GetTaskBuilder();
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::EmissiveLodProxies, double(taskBuilder.GetEmissiveLodProxyCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::EmissiveLodProxyLights, double(taskBuilder.GetEmissiveLodProxyLights()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::EmissiveLodReplacedTriangles, double(taskBuilder.GetEmissiveLodReplacedTriangles()));
+            const LightStreamingManager& lightStreaming = taskBuilder.GetLightStreaming();
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::LightStreamingResidentCells, double(lightStreaming.GetResidentCellCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::LightStreamingLoadingCells, double(lightStreaming.GetLoadingCellCount()));
+            m_Profiler->SetCpuCounter(CpuProfilerCounter::LightStreamingResidentLights, double(lightStreaming.GetResidentLightCount()));
         }
 
-        if (m_ui.enableLocalLightImportanceSampling)
+        if (frameParameters.enableLocalLightImportanceSampling && m_LocalLightPdfMipsDirty)
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::LocalLightPdfMap);
             
             m_LocalLightPdfMipmapPass->Process(m_CommandList);
+            m_LocalLightPdfMipsDirty = false;
         }
 
 
@@ -1174,7 +1724,7 @@ public:
             if (lightingSettings.enableGradients)
             {
                 m_FilterGradientsPass->Render(m_CommandList, m_View, checkerboard);
-                m_ConfidencePass->Render(m_CommandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                m_ConfidencePass->Render(m_CommandList, m_View, m_ViewPrevious, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
             }
         }
 
@@ -1436,6 +1986,10 @@ public:
         m_ViewPrevious = m_View;
         m_PreviousViewValid = true;
         m_ui.resetAccumulation = false;
+
+        if (m_QualityBenchmarkPhase != QualityBenchmarkPhase::None)
+            UpdateQualityBenchmark();
+
         ++m_RenderFrameIndex;
     }
 };
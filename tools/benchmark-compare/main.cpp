@@ -0,0 +1,88 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Compares two benchmark result files written by 'rtxdi-sample --benchmark --benchmark-results <file>'.
+// Exit codes: 0 - no regressions, 1 - at least one section regressed, 2 - invalid arguments or files.
+
+#include "BenchmarkResults.h"
+
+#include <cxxopts.hpp>
+#include <cstdio>
+
+int main(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Compares RTXDI benchmark results with a baseline");
+
+    std::string baselineFileName;
+    std::string resultsFileName;
+    double significance = 0.05;
+    double relativeTolerance = -1.0;
+    bool help = false;
+
+    options.add_options()
+        ("baseline", "Baseline results file, its tolerances are used for the comparison", value(baselineFileName))
+        ("results", "Results file to compare with the baseline", value(resultsFileName))
+        ("significance", "Significance level of the regression tests, default is 0.05", value(significance))
+        ("tolerance", "Override the relative tolerance of all sections in the baseline", value(relativeTolerance))
+        ("h,help", "Display this help message", value(help))
+    ;
+    options.parse_positional({ "baseline", "results" });
+    options.positional_help("<baseline> <results>");
+
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    if (help || baselineFileName.empty() || resultsFileName.empty())
+    {
+        printf("%s", options.help().c_str());
+        return help ? 0 : 2;
+    }
+
+    BenchmarkResults baseline;
+    BenchmarkResults results;
+    std::string error;
+
+    if (!LoadBenchmarkResults(baselineFileName, baseline, error) ||
+        !LoadBenchmarkResults(resultsFileName, results, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    if (relativeTolerance >= 0.0)
+    {
+        baseline.defaultTolerance.relative = relativeTolerance;
+        for (auto& [section, tolerance] : baseline.tolerances)
+            tolerance.relative = relativeTolerance;
+    }
+
+    if (baseline.renderer != results.renderer)
+        printf("Warning: comparing results from different renderers:\n  %s\n  %s\n", baseline.renderer.c_str(), results.renderer.c_str());
+
+    const auto comparison = CompareBenchmarkResults(baseline, results, significance);
+    printf("%s", FormatBenchmarkComparison(comparison).c_str());
+
+    for (const auto& result : comparison)
+    {
+        if (result.regression)
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the benchmark result files and their comparison used by rtxdi-benchmark-compare.
+// The parser is checked on valid and invalid files, the thresholds on the default and per-section tolerances,
+// and the p-values of Welch's t-test on runs whose t statistic and degrees of freedom are known,
+// against tabulated quantiles and the closed form of the t distribution with 2 degrees of freedom.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "BenchmarkResults.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+static bool writeFile(const std::string& fileName, const char* text)
+{
+    std::ofstream file(fileName, std::ios::binary);
+    file << text;
+    return file.good();
+}
+
+static bool loadText(const std::string& fileName, const char* text, BenchmarkResults& outResults, std::string& outError)
+{
+    if (!writeFile(fileName, text))
+    {
+        outError = "Cannot write file '" + fileName + "'";
+        return false;
+    }
+
+    const bool loaded = LoadBenchmarkResults(fileName, outResults, outError);
+    std::remove(fileName.c_str());
+    return loaded;
+}
+
+static void CheckParser(const std::string& fileName)
+{
+    BenchmarkResults results;
+    std::string error;
+
+    const bool loaded = loadText(fileName,
+        "# comment\r\n"
+        "renderer\tTest GPU\r\n"
+        "\r\n"
+        "tolerance\t*\t0.1\t0.5\r\n"
+        "tolerance\tShading\t0\t0.25\r\n"
+        "section\tShading\t1.5\t2.5\t3.5\r\n"
+        "section\tDenoising\t4\r\n",
+        results, error);
+
+    Check("Parser: a valid file with comments and CRLF line ends loads", loaded, 0.0);
+    Check("Parser: renderer", results.renderer == "Test GPU", 0.0);
+    Check("Parser: default tolerance", results.defaultTolerance.relative == 0.1 && results.defaultTolerance.absolute == 0.5,
+        results.defaultTolerance.relative);
+    Check("Parser: section tolerance", results.GetTolerance("Shading").relative == 0.0 && results.GetTolerance("Shading").absolute == 0.25,
+        results.GetTolerance("Shading").absolute);
+    Check("Parser: sections without a tolerance use the default one", results.GetTolerance("Denoising").absolute == 0.5,
+        results.GetTolerance("Denoising").absolute);
+    CheckEqual("Parser: section count", results.sections.size(), 2);
+    CheckEqual("Parser: run count is the longest section", results.runCount, 3);
+
+    const BenchmarkSectionResults* shading = results.FindSection("Shading");
+    Check("Parser: section values", shading && shading->runs.size() == 3 && shading->runs[0] == 1.5 && shading->runs[2] == 3.5,
+        shading ? double(shading->runs.size()) : 0.0);
+
+    const std::string roundTripFileName = fileName + ".saved";
+    BenchmarkResults reloaded;
+    const bool roundTrip = SaveBenchmarkResults(roundTripFileName, results) && LoadBenchmarkResults(roundTripFileName, reloaded, error);
+    std::remove(roundTripFileName.c_str());
+    Check("Parser: saved results load back", roundTrip && reloaded.renderer == results.renderer && reloaded.runCount == 3
+        && reloaded.GetTolerance("Shading").absolute == 0.25 && reloaded.FindSection("Denoising")
+        && reloaded.FindSection("Denoising")->runs[0] == 4.0, double(reloaded.sections.size()));
+
+    error.clear();
+    Check("Parser: an invalid time is an error", !loadText(fileName, "section\tShading\t1.0\tfast\n", results, error)
+        && error.find("(1)") != std::string::npos, 0.0);
+
+    error.clear();
+    Check("Parser: an invalid tolerance is an error", !loadText(fileName, "# header\ntolerance\t*\t0.1\n", results, error)
+        && error.find("(2)") != std::string::npos, 0.0);
+
+    error.clear();
+    Check("Parser: a section without values is an error", !loadText(fileName, "section\tShading\n", results, error) && !error.empty(), 0.0);
+
+    error.clear();
+    Check("Parser: an unknown line is an error", !loadText(fileName, "frames\t100\n", results, error) && !error.empty(), 0.0);
+
+    error.clear();
+    Check("Parser: a missing file is an error", !LoadBenchmarkResults(fileName + ".missing", results, error) && !error.empty(), 0.0);
+}
+
+static BenchmarkResults makeResults(const std::vector<double>& runs)
+{
+    BenchmarkResults results;
+    for (double value : runs)
+        results.AddRunValue("Section", value);
+    results.runCount = uint32_t(runs.size());
+    return results;
+}
+
+static BenchmarkSectionComparison compare(const BenchmarkResults& baseline, const std::vector<double>& currentRuns, double significanceLevel)
+{
+    const auto comparison = CompareBenchmarkResults(baseline, makeResults(currentRuns), significanceLevel);
+    return comparison.empty() ? BenchmarkSectionComparison() : comparison[0];
+}
+
+static void CheckTolerances()
+{
+    BenchmarkResults baseline = makeResults({ 10.0 });
+    baseline.defaultTolerance.relative = 0.1;
+    baseline.defaultTolerance.absolute = 0.5;
+
+    BenchmarkSectionComparison result = compare(baseline, { 11.4 }, 0.05);
+    Check("Tolerance: threshold is mean * (1 + relative) + absolute", std::abs(result.threshold - 11.5) < 1e-9, result.threshold);
+    Check("Tolerance: a single run under the threshold passes", !result.regression && !result.significanceTested, result.currentMean);
+
+    result = compare(baseline, { 11.6 }, 0.05);
+    Check("Tolerance: a single run over the threshold regresses", result.regression, result.currentMean);
+
+    baseline.tolerances["Section"] = BenchmarkTolerance{ 0.0, 2.0 };
+    result = compare(baseline, { 11.6 }, 0.05);
+    Check("Tolerance: the section tolerance overrides the default one", std::abs(result.threshold - 12.0) < 1e-9 && !result.regression,
+        result.threshold);
+
+    const auto missing = CompareBenchmarkResults(baseline, BenchmarkResults(), 0.05);
+    CheckEqual("Tolerance: sections missing from the results are skipped", missing.size(), 0);
+
+    // Over the threshold, but the runs are too noisy for the slowdown to be significant
+    BenchmarkResults noisyBaseline = makeResults({ 9.0, 10.0, 11.0 });
+    noisyBaseline.defaultTolerance = BenchmarkTolerance{ 0.0, 0.0 };
+    result = compare(noisyBaseline, { 9.5, 10.5, 11.5 }, 0.05);
+    Check("Tolerance: an insignificant slowdown over the threshold passes", result.significanceTested && !result.regression, result.pValue);
+
+    result = compare(noisyBaseline, { 14.0, 15.0, 16.0 }, 0.05);
+    Check("Tolerance: a significant slowdown over the threshold regresses", result.significanceTested && result.regression, result.pValue);
+
+    // Runs with zero variance are either certainly slower or not
+    BenchmarkResults constantBaseline = makeResults({ 1.0, 1.0 });
+    constantBaseline.defaultTolerance = BenchmarkTolerance{ 0.0, 0.0 };
+    result = compare(constantBaseline, { 2.0, 2.0 }, 0.05);
+    Check("Tolerance: constant runs that are slower regress", result.pValue == 0.0 && result.regression, result.pValue);
+}
+
+static void CheckPValues()
+{
+    // Three runs with a variance of 1 on both sides: the standard error is sqrt(2/3) and Welch's test has 4 degrees of freedom
+    const BenchmarkResults baseline4 = makeResults({ 0.0, 1.0, 2.0 });
+    const double standardError4 = std::sqrt(2.0 / 3.0);
+
+    struct Quantile
+    {
+        const char* name;
+        double t;
+        double p;
+    };
+
+    // Upper quantiles of the t distribution with 4 degrees of freedom
+    const Quantile quantiles[] = {
+        { "p-value: t = 1.533206, 4 degrees of freedom", 1.5332062740589443, 0.1 },
+        { "p-value: t = 2.131847, 4 degrees of freedom", 2.1318467863266495, 0.05 },
+        { "p-value: t = 2.776445, 4 degrees of freedom", 2.7764451051977987, 0.025 },
+        { "p-value: t = 3.746947, 4 degrees of freedom", 3.7469473879791968, 0.01 },
+        { "p-value: t = 8.610302, 4 degrees of freedom", 8.6103015813913972, 0.0005 },
+    };
+
+    for (const Quantile& quantile : quantiles)
+    {
+        const double shift = quantile.t * standardError4;
+        const BenchmarkSectionComparison result = compare(baseline4, { shift, 1.0 + shift, 2.0 + shift }, 0.05);
+        Check(quantile.name, std::abs(result.pValue - quantile.p) < 1e-6 * quantile.p + 1e-9, result.pValue);
+    }
+
+    BenchmarkSectionComparison result = compare(baseline4, { 0.0, 1.0, 2.0 }, 0.05);
+    Check("p-value: equal runs give 0.5", std::abs(result.pValue - 0.5) < 1e-9, result.pValue);
+
+    const double shift = 2.1318467863266495 * standardError4;
+    result = compare(baseline4, { -shift, 1.0 - shift, 2.0 - shift }, 0.05);
+    Check("p-value: faster runs give the complement", std::abs(result.pValue - 0.95) < 1e-6, result.pValue);
+
+    // Two runs with a variance of 2 on both sides: the standard error is sqrt(2) and the test has 2 degrees of freedom,
+    // where the upper tail is 1/2 - t / (2 sqrt(2 + t^2))
+    const BenchmarkResults baseline2 = makeResults({ 0.0, 2.0 });
+    double maxError = 0.0;
+    for (double t = 0.25; t <= 20.0; t *= 1.5)
+    {
+        const double offset = t * std::sqrt(2.0);
+        result = compare(baseline2, { offset, 2.0 + offset }, 0.05);
+        const double expected = 0.5 - t / (2.0 * std::sqrt(2.0 + t * t));
+        maxError = std::max(maxError, std::abs(result.pValue - expected) / expected);
+    }
+    Check("p-value: relative error against the closed form with 2 degrees of freedom", maxError < 1e-6, maxError);
+}
+
+int RunBenchmarkCompareCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the benchmark result files and their comparison");
+
+    std::string fileName = "rtxdi-benchmark-compare-check.txt";
+    bool help = false;
+
+    options.add_options()
+        ("file", "Temporary file used to check the parser, default is rtxdi-benchmark-compare-check.txt", value(fileName))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    CheckParser(fileName);
+    CheckTolerances();
+    CheckPValues();
+
+    return FinishChecks();
+}
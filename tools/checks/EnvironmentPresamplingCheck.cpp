@@ -0,0 +1,582 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Compares the variance of the environment map presampling modes of RTXDI_PresampleEnvironmentMap on the CPU.
+// The PDF mipmap descents of ResamplingFunctions.hlsli are mirrored here: independent random numbers per level,
+// a single stratified random number, and the hemisphere split. Pixel groups pick one environment tile each, like
+// RTXDI_ComputeRISBufferBaseAndCount, and every pixel estimates the irradiance from a few candidates of the tile.
+// The estimates are compared with the exact irradiance for the error of single pixels and of the group averages,
+// which is the blotchy error that tiles shared by many pixels leave in the image.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+#include "../common/EquirectMapping.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Unnormalized PDF texture with a full mip chain, mip N+1 texels are the sums of the 2x2 texels of mip N.
+// Texels outside of a mip level load as 0, like out-of-bounds texture loads in the shader.
+class PdfMipmap
+{
+private:
+    std::vector<std::vector<float>> m_Mips;
+    std::vector<uint32_t> m_Widths;
+    std::vector<uint32_t> m_Heights;
+
+public:
+    PdfMipmap(const std::vector<float>& weights, uint32_t width, uint32_t height)
+    {
+        m_Mips.push_back(weights);
+        m_Widths.push_back(width);
+        m_Heights.push_back(height);
+
+        while (m_Widths.back() > 1 || m_Heights.back() > 1)
+        {
+            const uint32_t mipWidth = std::max(m_Widths.back() / 2, 1u);
+            const uint32_t mipHeight = std::max(m_Heights.back() / 2, 1u);
+            const int parent = int(m_Mips.size()) - 1;
+
+            std::vector<float> mip(size_t(mipWidth) * mipHeight);
+            for (uint32_t y = 0; y < mipHeight; y++)
+            {
+                for (uint32_t x = 0; x < mipWidth; x++)
+                {
+                    mip[size_t(y) * mipWidth + x] = Load(2 * x, 2 * y, parent) + Load(2 * x + 1, 2 * y, parent)
+                        + Load(2 * x, 2 * y + 1, parent) + Load(2 * x + 1, 2 * y + 1, parent);
+                }
+            }
+
+            m_Mips.push_back(std::move(mip));
+            m_Widths.push_back(mipWidth);
+            m_Heights.push_back(mipHeight);
+        }
+    }
+
+    [[nodiscard]] float Load(uint32_t x, uint32_t y, int mipLevel) const
+    {
+        if (x >= m_Widths[mipLevel] || y >= m_Heights[mipLevel])
+            return 0.f;
+        return std::max(m_Mips[mipLevel][size_t(y) * m_Widths[mipLevel] + x], 0.f);
+    }
+
+    [[nodiscard]] uint32_t GetWidth() const { return m_Widths[0]; }
+    [[nodiscard]] uint32_t GetHeight() const { return m_Heights[0]; }
+};
+
+typedef std::mt19937 Rng;
+
+static float GetNextRandom(Rng& rng)
+{
+    return std::uniform_real_distribution<float>(0.f, 1.f)(rng);
+}
+
+static int GetLastMipLevel(uint32_t width, uint32_t height)
+{
+    return std::max(0, int(std::floor(std::log2(float(std::max(width, height))))) - 1);
+}
+
+// Selects one of the 2x2 texels in the order of the shader: (0,0), (0,1), (1,0), (1,1).
+// Returns the weight of the selected texel relative to the sum, and the start of its interval in rnd.
+static float SelectQuadrant(const PdfMipmap& pdfMipmap, int mipLevel, uint32_t position[2], float rnd, float& intervalStart)
+{
+    const float samples[4] = {
+        pdfMipmap.Load(position[0] + 0, position[1] + 0, mipLevel),
+        pdfMipmap.Load(position[0] + 0, position[1] + 1, mipLevel),
+        pdfMipmap.Load(position[0] + 1, position[1] + 0, mipLevel),
+        pdfMipmap.Load(position[0] + 1, position[1] + 1, mipLevel)
+    };
+    const uint32_t offsets[4][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+
+    const float weightSum = samples[0] + samples[1] + samples[2] + samples[3];
+    if (weightSum <= 0.f)
+        return 0.f;
+
+    intervalStart = 0.f;
+    int selected = 3;
+    for (int quadrant = 0; quadrant < 3; quadrant++)
+    {
+        if (rnd < intervalStart + samples[quadrant] / weightSum)
+        {
+            selected = quadrant;
+            break;
+        }
+        intervalStart += samples[quadrant] / weightSum;
+    }
+
+    position[0] += offsets[selected][0];
+    position[1] += offsets[selected][1];
+    return samples[selected] / weightSum;
+}
+
+// RTXDI_SamplePdfMipmap: a new random number on every level
+static float SamplePdfMipmap(Rng& rng, const PdfMipmap& pdfMipmap, uint32_t position[2])
+{
+    position[0] = position[1] = 0;
+    float pdf = 1.f;
+    for (int mipLevel = GetLastMipLevel(pdfMipmap.GetWidth(), pdfMipmap.GetHeight()); mipLevel >= 0; mipLevel--)
+    {
+        position[0] *= 2;
+        position[1] *= 2;
+
+        float intervalStart;
+        pdf *= SelectQuadrant(pdfMipmap, mipLevel, position, GetNextRandom(rng), intervalStart);
+        if (pdf <= 0.f)
+            return 0.f;
+    }
+    return pdf;
+}
+
+// RTXDI_DescendPdfMipmapWithRandom: one random number, rescaled into the selected interval on every level
+static float DescendPdfMipmapWithRandom(float rnd, const PdfMipmap& pdfMipmap, int startMipLevel, uint32_t position[2], float pdf)
+{
+    for (int mipLevel = startMipLevel; mipLevel >= 0; mipLevel--)
+    {
+        position[0] *= 2;
+        position[1] *= 2;
+
+        float intervalStart = 0.f;
+        const float selectedWeight = SelectQuadrant(pdfMipmap, mipLevel, position, rnd, intervalStart);
+        pdf *= selectedWeight;
+        if (selectedWeight <= 0.f)
+            return 0.f;
+
+        rnd = std::min(std::clamp((rnd - intervalStart) / selectedWeight, 0.f, 1.f), 0.99999994f);
+    }
+    return pdf;
+}
+
+// RTXDI_SamplePdfMipmapHalfWithRandom: walks the row of the half mip level, then descends within the half.
+// The returned probability is relative to the selected half.
+static float SamplePdfMipmapHalfWithRandom(float rnd, const PdfMipmap& pdfMipmap, uint32_t hemisphere, uint32_t position[2])
+{
+    const int halfMipLevel = std::max(0, int(std::floor(std::log2(float(pdfMipmap.GetHeight())))) - 1);
+    const uint32_t rowWidth = std::max(1u, pdfMipmap.GetWidth() >> halfMipLevel);
+
+    float rowSum = 0.f;
+    for (uint32_t x = 0; x < rowWidth; x++)
+        rowSum += pdfMipmap.Load(x, hemisphere, halfMipLevel);
+    if (rowSum <= 0.f)
+        return 0.f;
+
+    const float target = rnd * rowSum;
+    float intervalStart = 0.f;
+    float selectedWeight = 0.f;
+    position[1] = hemisphere;
+    for (uint32_t x = 0; x < rowWidth; x++)
+    {
+        selectedWeight = pdfMipmap.Load(x, hemisphere, halfMipLevel);
+        position[0] = x;
+        if (target < intervalStart + selectedWeight)
+            break;
+        intervalStart += selectedWeight;
+    }
+
+    if (selectedWeight <= 0.f)
+        return 0.f;
+
+    rnd = std::min(std::clamp((target - intervalStart) / selectedWeight, 0.f, 1.f), 0.99999994f);
+    return DescendPdfMipmapWithRandom(rnd, pdfMipmap, halfMipLevel - 1, position, selectedWeight / rowSum);
+}
+
+// Equirectangular environment map with its radiance and the PDF texture built from it
+struct EnvironmentMap
+{
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> radiance;
+    std::vector<float> solidAngles;
+    std::vector<float> directions; // xyz per texel, y is up
+    float halfProbabilities[2] = {}; // sampling probabilities of the upper and lower halves
+
+    EnvironmentMap(const char* _name, uint32_t _width, uint32_t _height)
+        : name(_name), width(_width), height(_height)
+    {
+        radiance.resize(size_t(width) * height);
+        solidAngles.resize(size_t(width) * height);
+        directions.resize(size_t(width) * height * 3);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const float solidAngle = float(EquirectTexelSolidAngle(y, width, height));
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const size_t texel = size_t(y) * width + x;
+                double direction[3];
+                EquirectTexelDirection(x, y, width, height, direction);
+                solidAngles[texel] = solidAngle;
+                directions[texel * 3 + 0] = float(direction[0]);
+                directions[texel * 3 + 1] = float(direction[1]);
+                directions[texel * 3 + 2] = float(direction[2]);
+            }
+        }
+    }
+
+    // The sample weights the PDF texture by the texel solid angle, so the power decides the sampling probability
+    [[nodiscard]] std::vector<float> GetPdfWeights() const
+    {
+        std::vector<float> weights(radiance.size());
+        for (size_t texel = 0; texel < radiance.size(); texel++)
+            weights[texel] = radiance[texel] * solidAngles[texel];
+        return weights;
+    }
+
+    void UpdateHalfProbabilities()
+    {
+        double halves[2] = {};
+        for (size_t texel = 0; texel < radiance.size(); texel++)
+            halves[texel < radiance.size() / 2 ? 0 : 1] += radiance[texel] * solidAngles[texel];
+        halfProbabilities[0] = float(halves[0] / (halves[0] + halves[1]));
+        halfProbabilities[1] = float(halves[1] / (halves[0] + halves[1]));
+    }
+
+    // Clamped cosine with the normal times the radiance and the solid angle, the irradiance contribution of a texel
+    [[nodiscard]] double GetContribution(size_t texel, const float normal[3]) const
+    {
+        const double cosine = directions[texel * 3 + 0] * normal[0] + directions[texel * 3 + 1] * normal[1] + directions[texel * 3 + 2] * normal[2];
+        return std::max(cosine, 0.0) * radiance[texel] * solidAngles[texel];
+    }
+
+    [[nodiscard]] double GetIrradiance(const float normal[3]) const
+    {
+        double irradiance = 0.0;
+        for (size_t texel = 0; texel < radiance.size(); texel++)
+            irradiance += GetContribution(texel, normal);
+        return irradiance;
+    }
+};
+
+// Sky gradient over a dark ground, with a sun that holds most of the power
+static EnvironmentMap CreateSunEnvironment(uint32_t width)
+{
+    EnvironmentMap map("Sun", width, width / 2);
+    const float sunDirection[3] = { 0.6f, 0.64f, 0.48f };
+    const float sunCosine = float(std::cos(1.5 * c_EquirectPi / 180.0));
+
+    for (size_t texel = 0; texel < map.radiance.size(); texel++)
+    {
+        const float* direction = &map.directions[texel * 3];
+        const float cosine = direction[0] * sunDirection[0] + direction[1] * sunDirection[1] + direction[2] * sunDirection[2];
+        if (cosine > sunCosine)
+            map.radiance[texel] = 5000.f;
+        else if (direction[1] > 0.f)
+            map.radiance[texel] = 0.5f + 1.5f * direction[1];
+        else
+            map.radiance[texel] = 0.1f;
+    }
+
+    map.UpdateHalfProbabilities();
+    return map;
+}
+
+// Overcast sky over a bright ground, half of the power is below the horizon
+static EnvironmentMap CreateGroundEnvironment(uint32_t width)
+{
+    EnvironmentMap map("Bright ground", width, width / 2);
+
+    for (size_t texel = 0; texel < map.radiance.size(); texel++)
+    {
+        const float* direction = &map.directions[texel * 3];
+        const float x = direction[0];
+        const float z = direction[2];
+        // Some texture on the ground so that the PDF is not flat
+        map.radiance[texel] = direction[1] > 0.f ? 1.f + direction[1] : 1.f + 0.8f * std::sin(12.f * x) * std::cos(9.f * z);
+    }
+
+    map.UpdateHalfProbabilities();
+    return map;
+}
+
+enum class PresamplingMode
+{
+    Independent,
+    Stratified,
+    StratifiedHemisphereSplit
+};
+
+struct PresamplingConfig
+{
+    const char* name;
+    PresamplingMode mode;
+    uint32_t tileCount;
+    uint32_t tileSize;
+};
+
+struct TileSample
+{
+    uint32_t texel;
+    float invPdf; // relative to the full sphere
+};
+
+static void PresampleTiles(Rng& rng, const PdfMipmap& pdfMipmap, const EnvironmentMap& map, const PresamplingConfig& config,
+    std::vector<TileSample>& tiles)
+{
+    tiles.resize(size_t(config.tileCount) * config.tileSize);
+
+    for (uint32_t tileIndex = 0; tileIndex < config.tileCount; tileIndex++)
+    {
+        for (uint32_t sampleInTile = 0; sampleInTile < config.tileSize; sampleInTile++)
+        {
+            uint32_t position[2] = {};
+            float pdf = 0.f;
+
+            if (config.mode == PresamplingMode::Independent)
+            {
+                pdf = SamplePdfMipmap(rng, pdfMipmap, position);
+            }
+            else
+            {
+                const float rnd = (float(sampleInTile) + GetNextRandom(rng)) / float(config.tileSize);
+
+                if (config.mode == PresamplingMode::StratifiedHemisphereSplit)
+                {
+                    const uint32_t hemisphere = tileIndex >= config.tileCount / 2 ? 1 : 0;
+                    pdf = SamplePdfMipmapHalfWithRandom(rnd, pdfMipmap, hemisphere, position) * map.halfProbabilities[hemisphere];
+                }
+                else
+                {
+                    pdf = DescendPdfMipmapWithRandom(rnd, pdfMipmap, GetLastMipLevel(pdfMipmap.GetWidth(), pdfMipmap.GetHeight()), position, 1.f);
+                }
+            }
+
+            TileSample& sample = tiles[size_t(tileIndex) * config.tileSize + sampleInTile];
+            sample.texel = position[1] * map.width + position[0];
+            sample.invPdf = pdf > 0.f ? 1.f / pdf : 0.f;
+        }
+    }
+}
+
+struct VarianceResult
+{
+    double mean = 0.0;           // relative to the exact irradiance
+    double pixelError = 0.0;     // relative mean squared error of one pixel
+    double groupError = 0.0;     // relative mean squared error of the average of a pixel group
+    double standardError = 0.0;  // of the relative mean, from the group averages
+};
+
+struct SimulationSettings
+{
+    uint32_t frames = 16;
+    uint32_t groups = 256;
+    uint32_t pixelsPerGroup = 64;
+    uint32_t candidates = 8;
+};
+
+// Estimates the irradiance for one normal from the presampled tiles of one frame, and accumulates the errors
+class IrradianceEstimator
+{
+private:
+    const EnvironmentMap& m_Map;
+    const PresamplingConfig& m_Config;
+    const SimulationSettings& m_Settings;
+    float m_Normal[3];
+    double m_Irradiance;
+    float m_SelectionFactors[2];
+    float m_UpperProbability;
+    double m_Sum = 0.0;
+    double m_PixelErrorSum = 0.0;
+    double m_GroupErrorSum = 0.0;
+
+public:
+    IrradianceEstimator(const EnvironmentMap& map, const PresamplingConfig& config, const SimulationSettings& settings, const float normal[3])
+        : m_Map(map)
+        , m_Config(config)
+        , m_Settings(settings)
+    {
+        std::copy(normal, normal + 3, m_Normal);
+        m_Irradiance = map.GetIrradiance(normal);
+
+        // RTXDI_GetEnvironmentHemisphereSelectionFactors, the V coordinate of the normal weighs the two halves
+        const float v = float(std::acos(std::clamp(normal[1], -1.f, 1.f)) / c_EquirectPi);
+        const float weights[2] = { 1.f - v, v };
+        const float normalization = weights[0] * map.halfProbabilities[0] + weights[1] * map.halfProbabilities[1];
+        m_SelectionFactors[0] = weights[0] / normalization;
+        m_SelectionFactors[1] = weights[1] / normalization;
+        m_UpperProbability = m_SelectionFactors[0] * map.halfProbabilities[0];
+    }
+
+    void AddFrame(Rng& rng, const std::vector<TileSample>& tiles);
+    [[nodiscard]] VarianceResult GetResult() const;
+};
+
+void IrradianceEstimator::AddFrame(Rng& rng, const std::vector<TileSample>& tiles)
+{
+    const bool split = m_Config.mode == PresamplingMode::StratifiedHemisphereSplit;
+    const uint32_t selectableTiles = split ? m_Config.tileCount / 2 : m_Config.tileCount;
+
+    for (uint32_t group = 0; group < m_Settings.groups; group++)
+    {
+        const uint32_t tileIndex = std::min(uint32_t(GetNextRandom(rng) * selectableTiles), selectableTiles - 1);
+        double groupSum = 0.0;
+
+        for (uint32_t pixel = 0; pixel < m_Settings.pixelsPerGroup; pixel++)
+        {
+            double estimate = 0.0;
+            for (uint32_t candidate = 0; candidate < m_Settings.candidates; candidate++)
+            {
+                uint32_t candidateTile = tileIndex;
+                float selectionFactor = 1.f;
+                if (split)
+                {
+                    const bool lower = GetNextRandom(rng) >= m_UpperProbability;
+                    candidateTile += lower ? m_Config.tileCount / 2 : 0;
+                    selectionFactor = m_SelectionFactors[lower ? 1 : 0];
+                    if (selectionFactor <= 0.f)
+                        continue;
+                }
+
+                const uint32_t sampleInTile = std::min(uint32_t(GetNextRandom(rng) * m_Config.tileSize), m_Config.tileSize - 1);
+                const TileSample& sample = tiles[size_t(candidateTile) * m_Config.tileSize + sampleInTile];
+                estimate += m_Map.GetContribution(sample.texel, m_Normal) * sample.invPdf / selectionFactor;
+            }
+            estimate /= m_Irradiance * m_Settings.candidates;
+
+            m_Sum += estimate;
+            m_PixelErrorSum += (estimate - 1.0) * (estimate - 1.0);
+            groupSum += estimate;
+        }
+
+        const double groupMean = groupSum / m_Settings.pixelsPerGroup;
+        m_GroupErrorSum += (groupMean - 1.0) * (groupMean - 1.0);
+    }
+}
+
+VarianceResult IrradianceEstimator::GetResult() const
+{
+    const uint64_t groupCount = uint64_t(m_Settings.frames) * m_Settings.groups;
+    const uint64_t pixelCount = groupCount * m_Settings.pixelsPerGroup;
+
+    VarianceResult result;
+    result.mean = m_Sum / double(pixelCount);
+    result.pixelError = m_PixelErrorSum / double(pixelCount);
+    result.groupError = m_GroupErrorSum / double(groupCount);
+    result.standardError = std::sqrt(result.groupError / double(groupCount));
+    return result;
+}
+
+static void CheckEnvironment(const EnvironmentMap& map, const SimulationSettings& settings, uint32_t seed)
+{
+    const PdfMipmap pdfMipmap(map.GetPdfWeights(), map.width, map.height);
+
+    // The default tile memory, and half of it for the stratified modes
+    const PresamplingConfig configs[] = {
+        { "independent 128x1024", PresamplingMode::Independent, 128, 1024 },
+        { "stratified 128x512", PresamplingMode::Stratified, 128, 512 },
+        { "stratified 64x1024", PresamplingMode::Stratified, 64, 1024 },
+        { "split 128x512", PresamplingMode::StratifiedHemisphereSplit, 128, 512 },
+    };
+    const size_t configCount = sizeof(configs) / sizeof(configs[0]);
+
+    const struct { const char* name; float normal[3]; } normals[] = {
+        { "up", { 0.f, 1.f, 0.f } },
+        { "horizontal", { 0.f, 0.f, 1.f } },
+        { "tilted down", { 0.f, -0.5f, 0.8660254f } },
+    };
+    const size_t normalCount = sizeof(normals) / sizeof(normals[0]);
+
+    // All normals use the same presampled tiles of a configuration
+    VarianceResult results[normalCount][configCount];
+    for (size_t config = 0; config < configCount; config++)
+    {
+        std::vector<IrradianceEstimator> estimators;
+        for (const auto& normal : normals)
+            estimators.emplace_back(map, configs[config], settings, normal.normal);
+
+        Rng rng(seed + uint32_t(config));
+        std::vector<TileSample> tiles;
+        for (uint32_t frame = 0; frame < settings.frames; frame++)
+        {
+            PresampleTiles(rng, pdfMipmap, map, configs[config], tiles);
+            for (IrradianceEstimator& estimator : estimators)
+                estimator.AddFrame(rng, tiles);
+        }
+
+        for (size_t normal = 0; normal < normalCount; normal++)
+            results[normal][config] = estimators[normal].GetResult();
+    }
+
+    char name[128];
+    for (size_t normalIndex = 0; normalIndex < normalCount; normalIndex++)
+    {
+        const auto& normal = normals[normalIndex];
+        const VarianceResult* normalResults = results[normalIndex];
+        for (size_t config = 0; config < configCount; config++)
+        {
+            // Unbiased: the relative mean is 1 within the noise of the group averages
+            snprintf(name, sizeof(name), "%s, %s, %s: mean", map.name, normal.name, configs[config].name);
+            Check(name, std::abs(normalResults[config].mean - 1.0) <= 5.0 * normalResults[config].standardError + 1e-3, normalResults[config].mean);
+            snprintf(name, sizeof(name), "%s, %s, %s: pixel error", map.name, normal.name, configs[config].name);
+            Report(name, normalResults[config].pixelError);
+            snprintf(name, sizeof(name), "%s, %s, %s: group error", map.name, normal.name, configs[config].name);
+            Report(name, normalResults[config].groupError);
+        }
+
+        // Half of the tile memory with stratification is at least as good as the full memory without it.
+        // The pixel error has a few percent of noise between the runs.
+        const VarianceResult& baseline = normalResults[0];
+        for (size_t config = 1; config < 3; config++)
+        {
+            snprintf(name, sizeof(name), "%s, %s, %s: pixel error vs. independent", map.name, normal.name, configs[config].name);
+            Check(name, normalResults[config].pixelError <= baseline.pixelError * 1.05, normalResults[config].pixelError / baseline.pixelError);
+            snprintf(name, sizeof(name), "%s, %s, %s: group error vs. independent", map.name, normal.name, configs[config].name);
+            Check(name, normalResults[config].groupError <= baseline.groupError * 1.05, normalResults[config].groupError / baseline.groupError);
+        }
+
+        // The hemisphere split skips the invisible half for the surfaces that face up or down
+        if (normal.normal[1] != 0.f)
+        {
+            snprintf(name, sizeof(name), "%s, %s, %s: pixel error vs. stratified", map.name, normal.name, configs[3].name);
+            Check(name, normalResults[3].pixelError <= normalResults[1].pixelError, normalResults[3].pixelError / normalResults[1].pixelError);
+        }
+    }
+}
+
+int RunEnvironmentPresamplingCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Compares the variance of the environment map presampling modes on the CPU");
+
+    uint32_t width = 256;
+    uint32_t seed = 1;
+    SimulationSettings settings;
+    bool help = false;
+
+    options.add_options()
+        ("width", "Width of the synthetic environment maps, a power of 2, default is 256", value(width))
+        ("frames", "Number of presampled frames per configuration, default is 16", value(settings.frames))
+        ("groups", "Number of pixel groups per frame, each picks one tile, default is 256", value(settings.groups))
+        ("pixels", "Number of pixels per group, default is 64", value(settings.pixelsPerGroup))
+        ("candidates", "Number of environment candidates per pixel, default is 8", value(settings.candidates))
+        ("seed", "Random seed, default is 1", value(seed))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (width < 4 || (width & (width - 1)) != 0 || settings.frames == 0 || settings.groups == 0 || settings.pixelsPerGroup == 0
+        || settings.candidates == 0)
+    {
+        fprintf(stderr, "Invalid arguments: the width must be a power of 2 of at least 4, and the counts must be nonzero\n");
+        return 2;
+    }
+
+    CheckEnvironment(CreateSunEnvironment(width), settings, seed);
+    CheckEnvironment(CreateGroundEnvironment(width), settings, seed);
+
+    return FinishChecks();
+}
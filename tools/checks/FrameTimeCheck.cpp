@@ -0,0 +1,249 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Replays GPU timing traces through the FrameTimeController and checks that it holds the target frame time.
+// Without --trace, runs a set of synthetic scenarios with expected outcomes, which works as a regression test
+// of the controller logic. The traces are timelines written by 'rtxdi-sample --benchmark --benchmark-timeline <file>.csv',
+// replayed with 'rtxdi-checks frame-time --trace <file>.csv'.
+// Exit codes: 0 - all scenarios passed, 1 - at least one scenario failed, 2 - invalid arguments or files.
+
+#include "FrameTimeSimulation.h"
+#include "../common/CheckOptions.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <random>
+
+// Typical section times of the sample at 1080p on a mid-range GPU, adding up to about 16 ms
+static const std::pair<const char*, float> c_SyntheticSections[] = {
+    { "TLAS Update", 0.3f },
+    { "Presample Lights", 0.3f },
+    { "G-Buffer Fill", 1.5f },
+    { "Initial Samples", 4.0f },
+    { "Temporal Resampling", 1.2f },
+    { "Spatial Resampling", 2.0f },
+    { "Shade Primary Surf.", 2.5f },
+    { "BRDF or MIS Rays", 1.8f },
+    { "Denoising", 2.0f },
+    { "TAA or DLSS", 0.6f }
+};
+
+// Builds a trace with the given load over time, where the load multiplies all section times.
+// The noise is the relative standard deviation of the frame-to-frame variation.
+static TimingTrace CreateSyntheticTrace(const char* name, uint32_t frameCount, float noise, const std::function<float(uint32_t)>& load)
+{
+    TimingTrace trace;
+    trace.name = name;
+
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> distribution(1.f, noise);
+
+    for (uint32_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        const float scale = load(frameIndex) * std::max(0.1f, noise > 0.f ? distribution(rng) : 1.f);
+
+        TimingTraceFrame frame;
+        for (const auto& [section, time] : c_SyntheticSections)
+        {
+            frame.sectionTimes[section] = time * scale;
+            frame.frameTime += time * scale;
+        }
+        trace.frames.push_back(std::move(frame));
+    }
+
+    return trace;
+}
+
+struct Scenario
+{
+    TimingTrace trace;
+    std::function<bool(const FrameTimeSimulationResult&, const FrameTimeControllerParameters&, std::string&)> check;
+};
+
+static float GetMeanFrameTime(const FrameTimeSimulationResult& result, size_t firstFrame)
+{
+    double sum = 0.0;
+    for (size_t index = firstFrame; index < result.frameTimes.size(); index++)
+        sum += result.frameTimes[index];
+    return float(sum / double(result.frameTimes.size() - firstFrame));
+}
+
+static std::vector<Scenario> CreateScenarios()
+{
+    std::vector<Scenario> scenarios;
+
+    // Enough headroom: the controller must keep the base settings
+    scenarios.push_back({ CreateSyntheticTrace("Underloaded", 600, 0.05f, [](uint32_t) { return 0.7f; }),
+        [](const FrameTimeSimulationResult& result, const FrameTimeControllerParameters&, std::string& message)
+        {
+            message = "expected no changes";
+            return result.changes == 0;
+        } });
+
+    // Too slow from the start: must reach the target quickly and stay there
+    scenarios.push_back({ CreateSyntheticTrace("Overloaded", 1200, 0.05f, [](uint32_t) { return 1.6f; }),
+        [](const FrameTimeSimulationResult& result, const FrameTimeControllerParameters& params, std::string& message)
+        {
+            message = "expected to settle within 300 frames, within the budget, with at most 4 reversals";
+            return result.settledFrame <= 300
+                && GetMeanFrameTime(result, 600) <= params.targetFrameTimeMs * (1.f + params.hysteresis)
+                && result.reversals <= 4;
+        } });
+
+    // A heavy view for a few seconds: must drop the quality, then recover all of it
+    scenarios.push_back({ CreateSyntheticTrace("Load Spike", 1800, 0.05f, [](uint32_t frame) { return (frame >= 300 && frame < 600) ? 1.8f : 0.8f; }),
+        [](const FrameTimeSimulationResult& result, const FrameTimeControllerParameters&, std::string& message)
+        {
+            uint32_t maxLevel = 0;
+            for (uint32_t level : result.levels)
+                maxLevel = std::max(maxLevel, level);
+
+            message = "expected to reduce the quality during the spike and return to level 0";
+            return maxLevel > 0 && result.levels.back() == 0;
+        } });
+
+    // Hovering around the target with a lot of noise: the hysteresis and the upgrade backoff must limit the oscillation
+    scenarios.push_back({ CreateSyntheticTrace("Noisy Near Target", 3600, 0.15f, [](uint32_t) { return 1.2f; }),
+        [](const FrameTimeSimulationResult& result, const FrameTimeControllerParameters&, std::string& message)
+        {
+            message = "expected at most 12 reversals";
+            return result.reversals <= 12;
+        } });
+
+    // Slowly increasing load, like walking into a scene with more and more lights
+    scenarios.push_back({ CreateSyntheticTrace("Ramp", 2400, 0.05f, [](uint32_t frame) { return 0.8f + 0.8f * float(frame) / 2400.f; }),
+        [](const FrameTimeSimulationResult& result, const FrameTimeControllerParameters& params, std::string& message)
+        {
+            message = "expected the mean time within the budget, p99 under 1.3x the target and at most 4 reversals";
+            return result.meanFrameTime <= params.targetFrameTimeMs * (1.f + params.hysteresis)
+                && result.p99FrameTime <= params.targetFrameTimeMs * 1.3f
+                && result.reversals <= 4;
+        } });
+
+    return scenarios;
+}
+
+static void PrintResult(const char* name, const FrameTimeSimulationResult& result)
+{
+    const std::string settled = (result.settledFrame == ~0u) ? "never" : std::to_string(result.settledFrame);
+
+    printf("%-24s %8zu %9.2f %9.2f %8.1f%% %8u %9u %10s %6u\n", name, result.frameTimes.size(),
+        result.meanFrameTime, result.p99FrameTime,
+        result.frameTimes.empty() ? 0.0 : 100.0 * double(result.framesOverBudget) / double(result.frameTimes.size()),
+        result.changes, result.reversals, settled.c_str(), result.levels.empty() ? 0 : result.levels.back());
+}
+
+static bool SaveResultCsv(const std::string& fileName, const std::vector<std::pair<std::string, FrameTimeSimulationResult>>& results)
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        fprintf(stderr, "Cannot open file '%s' for writing\n", fileName.c_str());
+        return false;
+    }
+
+    file << "Trace,Frame,\"Frame Time (ms)\",Level" << std::endl;
+    file.precision(4);
+    for (const auto& [name, result] : results)
+    {
+        for (size_t index = 0; index < result.frameTimes.size(); index++)
+            file << "\"" << name << "\"," << index << "," << std::fixed << result.frameTimes[index] << "," << result.levels[index] << std::endl;
+    }
+
+    return file.good();
+}
+
+int RunFrameTimeCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Replays GPU timing traces through the RTXDI frame time controller");
+
+    std::vector<std::string> traceFileNames;
+    std::string outputFileName;
+    FrameTimeControllerParameters params;
+    FrameTimeControllerSettings recordedSettings;
+    uint32_t latency = 3;
+    bool help = false;
+
+    options.add_options()
+        ("trace", "Timeline .csv file to replay instead of the synthetic scenarios, can be repeated", value(traceFileNames))
+        ("output", "Save the simulated frame times and levels of every frame to a .csv file", value(outputFileName))
+        ("target", "Target frame time in milliseconds, default is 16.667", value(params.targetFrameTimeMs))
+        ("hysteresis", "Relative dead band around the target, default is 0.08", value(params.hysteresis))
+        ("latency", "Frames between rendering and the controller seeing the time, default is 3", value(latency))
+        ("local-samples", "Local light samples the traces were recorded with, default is 8", value(recordedSettings.numPrimaryLocalLightSamples))
+        ("regir-samples", "ReGIR samples the traces were recorded with, default is 8", value(recordedSettings.numPrimaryRegirSamples))
+        ("spatial-samples", "Spatial samples the traces were recorded with, default is 1", value(recordedSettings.numSpatialSamples))
+        ("boost-samples", "Disocclusion boost samples the traces were recorded with, default is 8", value(recordedSettings.numDisocclusionBoostSamples))
+        ("resolution-scale", "Resolution scale the traces were recorded with, default is 1", value(recordedSettings.resolutionScale))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (params.targetFrameTimeMs <= 0.f || recordedSettings.resolutionScale <= 0.f)
+    {
+        fprintf(stderr, "The target frame time and the resolution scale must be positive\n");
+        return 2;
+    }
+
+    printf("%-24s %8s %9s %9s %9s %8s %9s %10s %6s\n", "Trace", "Frames", "Mean ms", "p99 ms", "Over", "Changes", "Reversals", "Settled", "Level");
+
+    std::vector<std::pair<std::string, FrameTimeSimulationResult>> results;
+    bool success = true;
+
+    if (traceFileNames.empty())
+    {
+        for (Scenario& scenario : CreateScenarios())
+        {
+            scenario.trace.recordedSettings = recordedSettings;
+            const auto result = SimulateFrameTimeController(scenario.trace, params, latency);
+            PrintResult(scenario.trace.name.c_str(), result);
+
+            std::string message;
+            if (!scenario.check(result, params, message))
+            {
+                printf("  FAILED: %s\n", message.c_str());
+                success = false;
+            }
+
+            results.push_back({ scenario.trace.name, result });
+        }
+    }
+    else
+    {
+        for (const std::string& fileName : traceFileNames)
+        {
+            TimingTrace trace;
+            std::string error;
+            if (!LoadTimingTraceCsv(fileName, trace, error))
+            {
+                fprintf(stderr, "%s\n", error.c_str());
+                return 2;
+            }
+
+            trace.recordedSettings = recordedSettings;
+            const auto result = SimulateFrameTimeController(trace, params, latency);
+            PrintResult(fileName.c_str(), result);
+
+            results.push_back({ fileName, result });
+        }
+    }
+
+    if (!outputFileName.empty() && !SaveResultCsv(outputFileName, results))
+        return 2;
+
+    return success ? 0 : 1;
+}
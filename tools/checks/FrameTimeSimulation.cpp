@@ -0,0 +1,235 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameTimeSimulation.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+
+// Section names from Profiler.cpp
+static const char* c_FrameSection = "Frame Time (GPU)";
+static const char* c_InitialSamplesSection = "Initial Samples";
+static const char* c_TemporalResamplingSection = "Temporal Resampling";
+static const char* c_SpatialResamplingSection = "Spatial Resampling";
+
+// Sections that run once per pixel at the render resolution, in addition to the resampling passes above
+static const char* c_PixelSections[] = {
+    "G-Buffer Fill",
+    "Shade Primary Surf.",
+    "BRDF or MIS Rays",
+    "Shade Secondary Surf.",
+    "GI - Temporal Resampling",
+    "GI - Spatial Resampling",
+    "GI - Fused Resampling",
+    "GI - Final Shading",
+    "Gradients",
+    "Denoising",
+    "Glass"
+};
+
+// Cost of the per-pixel work in the initial sampling pass that doesn't depend on the local light samples,
+// in units of one local light sample: BRDF, infinite and environment samples and the visibility ray.
+static const float c_InitialSamplesFixedCost = 4.f;
+
+// Fraction of the pixels that are disoccluded and use the boost samples in a typical camera motion
+static const float c_DisoccludedFraction = 0.05f;
+
+static std::vector<std::string> SplitCsvLine(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+
+    for (char c : line)
+    {
+        if (c == '"')
+            quoted = !quoted;
+        else if (c == ',' && !quoted)
+        {
+            fields.push_back(field);
+            field.clear();
+        }
+        else if (c != '\r')
+            field.push_back(c);
+    }
+    fields.push_back(field);
+
+    return fields;
+}
+
+bool LoadTimingTraceCsv(const std::string& fileName, TimingTrace& trace, std::string& error)
+{
+    std::ifstream file(fileName);
+    if (!file.is_open())
+    {
+        error = "Cannot open file '" + fileName + "'";
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(file, line))
+    {
+        error = "File '" + fileName + "' is empty";
+        return false;
+    }
+
+    // Only the GPU times are used, the columns are named "<section> (ms)"
+    const std::string timeSuffix = " (ms)";
+    std::vector<std::string> columnSections;
+    for (const std::string& column : SplitCsvLine(line))
+    {
+        if (column.size() > timeSuffix.size() && column.compare(column.size() - timeSuffix.size(), timeSuffix.size(), timeSuffix) == 0)
+            columnSections.push_back(column.substr(0, column.size() - timeSuffix.size()));
+        else
+            columnSections.push_back(std::string());
+    }
+
+    if (std::find(columnSections.begin(), columnSections.end(), c_FrameSection) == columnSections.end())
+    {
+        error = "File '" + fileName + "' is not a profiler timeline, it has no '" + c_FrameSection + timeSuffix + "' column";
+        return false;
+    }
+
+    trace.name = fileName;
+    trace.frames.clear();
+
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+            continue;
+
+        const std::vector<std::string> fields = SplitCsvLine(line);
+        TimingTraceFrame frame;
+
+        for (size_t column = 0; column < fields.size() && column < columnSections.size(); column++)
+        {
+            if (columnSections[column].empty())
+                continue;
+
+            const float time = std::strtof(fields[column].c_str(), nullptr);
+            if (columnSections[column] == c_FrameSection)
+                frame.frameTime = time;
+            else
+                frame.sectionTimes[columnSections[column]] = time;
+        }
+
+        trace.frames.push_back(std::move(frame));
+    }
+
+    if (trace.frames.empty())
+    {
+        error = "File '" + fileName + "' has no frames";
+        return false;
+    }
+
+    return true;
+}
+
+static float GetSectionTime(const TimingTraceFrame& frame, const char* section)
+{
+    auto it = frame.sectionTimes.find(section);
+    return (it != frame.sectionTimes.end()) ? it->second : 0.f;
+}
+
+float EstimateFrameTime(const TimingTraceFrame& frame, const FrameTimeControllerSettings& recorded, const FrameTimeControllerSettings& settings)
+{
+    const float pixelScale = (settings.resolutionScale * settings.resolutionScale) / (recorded.resolutionScale * recorded.resolutionScale);
+
+    const float initialSamplesScale =
+        (c_InitialSamplesFixedCost + float(settings.numPrimaryLocalLightSamples + settings.numPrimaryRegirSamples)) /
+        (c_InitialSamplesFixedCost + float(recorded.numPrimaryLocalLightSamples + recorded.numPrimaryRegirSamples));
+
+    const float temporalScale =
+        (1.f + c_DisoccludedFraction * float(settings.numDisocclusionBoostSamples)) /
+        (1.f + c_DisoccludedFraction * float(recorded.numDisocclusionBoostSamples));
+
+    const float spatialScale = float(1 + settings.numSpatialSamples) / float(1 + recorded.numSpatialSamples);
+
+    const float initialSamples = GetSectionTime(frame, c_InitialSamplesSection);
+    const float temporal = GetSectionTime(frame, c_TemporalResamplingSection);
+    const float spatial = GetSectionTime(frame, c_SpatialResamplingSection);
+
+    float pixelSections = 0.f;
+    for (const char* section : c_PixelSections)
+        pixelSections += GetSectionTime(frame, section);
+
+    // Everything else, such as TLAS updates, light presampling and the upscaler, doesn't depend on the settings
+    const float modeled = initialSamples + temporal + spatial + pixelSections;
+    const float fixed = std::max(0.f, frame.frameTime - modeled);
+
+    return fixed + pixelScale * (
+        initialSamples * initialSamplesScale +
+        temporal * temporalScale +
+        spatial * spatialScale +
+        pixelSections);
+}
+
+FrameTimeSimulationResult SimulateFrameTimeController(const TimingTrace& trace, const FrameTimeControllerParameters& parameters, uint32_t latency)
+{
+    FrameTimeController controller;
+    controller.SetParameters(parameters);
+    controller.Reset(trace.recordedSettings);
+
+    FrameTimeSimulationResult result;
+    std::deque<float> pendingMeasurements;
+    int lastDirection = 0;
+
+    const float upperLimit = parameters.targetFrameTimeMs * (1.f + parameters.hysteresis);
+
+    for (const TimingTraceFrame& frame : trace.frames)
+    {
+        const float frameTime = EstimateFrameTime(frame, trace.recordedSettings, controller.GetSettings());
+        result.frameTimes.push_back(frameTime);
+        result.levels.push_back(controller.GetLevel());
+
+        if (frameTime > upperLimit)
+            result.framesOverBudget++;
+
+        pendingMeasurements.push_back(frameTime);
+        if (pendingMeasurements.size() <= latency)
+            continue;
+
+        const uint32_t previousLevel = controller.GetLevel();
+        if (controller.Update(pendingMeasurements.front()))
+        {
+            const int direction = (controller.GetLevel() > previousLevel) ? 1 : -1;
+            if (lastDirection != 0 && direction != lastDirection)
+                result.reversals++;
+            lastDirection = direction;
+            result.changes++;
+        }
+        pendingMeasurements.pop_front();
+    }
+
+    if (result.frameTimes.empty())
+        return result;
+
+    const uint32_t finalLevel = result.levels.back();
+    result.settledFrame = 0;
+    for (uint32_t index = 0; index < uint32_t(result.levels.size()); index++)
+    {
+        const uint32_t level = result.levels[index];
+        if (std::max(level, finalLevel) - std::min(level, finalLevel) > 1)
+            result.settledFrame = index + 1;
+    }
+
+    double sum = 0.0;
+    for (float time : result.frameTimes)
+        sum += time;
+    result.meanFrameTime = float(sum / double(result.frameTimes.size()));
+
+    std::vector<float> sorted = result.frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    result.p99FrameTime = sorted[std::min(sorted.size() - 1, size_t(double(sorted.size()) * 0.99))];
+
+    return result;
+}
@@ -0,0 +1,56 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "FrameTimeController.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// GPU time of every profiler section in one frame, in milliseconds, keyed by the section names used by the Profiler
+struct TimingTraceFrame
+{
+    std::map<std::string, float> sectionTimes;
+    float frameTime = 0.f;
+};
+
+struct TimingTrace
+{
+    std::string name;
+    std::vector<TimingTraceFrame> frames;
+
+    // Settings that the trace was recorded with, the cost model scales the sections relative to these
+    FrameTimeControllerSettings recordedSettings;
+};
+
+// Loads a timeline written by 'rtxdi-sample --benchmark --benchmark-timeline <file>.csv'
+bool LoadTimingTraceCsv(const std::string& fileName, TimingTrace& trace, std::string& error);
+
+// Predicts the GPU time of a recorded frame if it was rendered with different settings.
+// The lighting sections scale with their sample counts, and all screen-space sections scale with the pixel count.
+float EstimateFrameTime(const TimingTraceFrame& frame, const FrameTimeControllerSettings& recorded, const FrameTimeControllerSettings& settings);
+
+struct FrameTimeSimulationResult
+{
+    std::vector<float> frameTimes;      // simulated, with the controlled settings
+    std::vector<uint32_t> levels;       // controller level used for every frame
+    uint32_t changes = 0;
+    uint32_t reversals = 0;             // changes in the opposite direction of the previous change
+    uint32_t framesOverBudget = 0;      // frames above the upper limit of the dead band
+    uint32_t settledFrame = ~0u;        // first frame after which the level stays within one step of the final level
+    float meanFrameTime = 0.f;
+    float p99FrameTime = 0.f;
+};
+
+// Replays the trace through the controller. The controller sees every frame time 'latency' frames late,
+// like the profiler readback in the sample.
+FrameTimeSimulationResult SimulateFrameTimeController(const TimingTrace& trace, const FrameTimeControllerParameters& parameters, uint32_t latency);
@@ -0,0 +1,214 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the size math of the GPU memory registry and the RTXDI buffers against closed-form expectations
+// derived from the texture descriptions, the context parameters and the render resolution.
+// With --render-width and --render-height, prints the sizes of the RTXDI buffers for that resolution instead.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "GpuMemoryRegistry.h"
+#include "RtxdiResources.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <rtxdi/RTXDI.h>
+#include <donut/core/math/math.h>
+#include <cstdio>
+
+using namespace dm;
+#include "../shaders/ShaderParameters.h"
+
+static nvrhi::TextureDesc CreateTextureDesc(uint32_t width, uint32_t height, nvrhi::Format format)
+{
+    nvrhi::TextureDesc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.format = format;
+    return desc;
+}
+
+static void CheckTextureSizes()
+{
+    CheckEqual("RGBA16_FLOAT 1920x1080",
+        GpuMemoryRegistry::GetTextureSize(CreateTextureDesc(1920, 1080, nvrhi::Format::RGBA16_FLOAT)),
+        1920ull * 1080 * 8);
+
+    // Full mip chain of the environment PDF texture, like in RtxdiResources
+    nvrhi::TextureDesc pdfDesc = CreateTextureDesc(1024, 512, nvrhi::Format::R16_FLOAT);
+    pdfDesc.mipLevels = 11;
+    uint64_t pdfSize = 0;
+    for (uint32_t mip = 0; mip < pdfDesc.mipLevels; mip++)
+        pdfSize += uint64_t(std::max(1024u >> mip, 1u)) * std::max(512u >> mip, 1u) * 2;
+    CheckEqual("R16_FLOAT 1024x512, 11 mips", GpuMemoryRegistry::GetTextureSize(pdfDesc), pdfSize);
+
+    // Block-compressed formats round up to whole 4x4 blocks in every mip
+    nvrhi::TextureDesc bcDesc = CreateTextureDesc(6, 6, nvrhi::Format::BC1_UNORM);
+    bcDesc.mipLevels = 3;
+    CheckEqual("BC1 6x6, 3 mips", GpuMemoryRegistry::GetTextureSize(bcDesc), (4 + 1 + 1) * 8);
+
+    // The gradients texture from RenderTargets
+    nvrhi::TextureDesc gradientsDesc = CreateTextureDesc((1920 + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR,
+        (1080 + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR, nvrhi::Format::RGBA16_FLOAT);
+    gradientsDesc.dimension = nvrhi::TextureDimension::Texture2DArray;
+    gradientsDesc.arraySize = 2;
+    CheckEqual("Gradients array at 1920x1080", GpuMemoryRegistry::GetTextureSize(gradientsDesc),
+        uint64_t(gradientsDesc.width) * gradientsDesc.height * 8 * 2);
+
+    nvrhi::TextureDesc volumeDesc = CreateTextureDesc(64, 64, nvrhi::Format::RGBA8_UNORM);
+    volumeDesc.dimension = nvrhi::TextureDimension::Texture3D;
+    volumeDesc.depth = 64;
+    volumeDesc.mipLevels = 2;
+    CheckEqual("RGBA8 64x64x64, 2 mips", GpuMemoryRegistry::GetTextureSize(volumeDesc), 64ull * 64 * 64 * 4 + 32ull * 32 * 32 * 4);
+
+    nvrhi::TextureDesc msaaDesc = CreateTextureDesc(1280, 720, nvrhi::Format::D32);
+    msaaDesc.dimension = nvrhi::TextureDimension::Texture2DMS;
+    msaaDesc.sampleCount = 4;
+    CheckEqual("D32 1280x720, 4x MSAA", GpuMemoryRegistry::GetTextureSize(msaaDesc), 1280ull * 720 * 4 * 4);
+}
+
+static void CheckRegistryTotals()
+{
+    GpuMemoryRegistry registry;
+    registry.AddTexture("RenderTargets", CreateTextureDesc(100, 100, nvrhi::Format::RGBA16_FLOAT));
+    registry.AddTexture("RenderTargets", CreateTextureDesc(100, 100, nvrhi::Format::R32_UINT));
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = 1000;
+    registry.AddBuffer("RtxdiResources", bufferDesc);
+    registry.AddOpaque("DLSS", "DLSS Feature", 500);
+
+    CheckEqual("Registry: RenderTargets total", registry.GetOwnerSize("RenderTargets"), 100 * 100 * (8 + 4));
+    CheckEqual("Registry: total", registry.GetTotalSize(), 100 * 100 * (8 + 4) + 1000 + 500);
+    CheckEqual("Registry: owner count", registry.GetOwnerSizes().size(), 3);
+
+    registry.RemoveOwner("RenderTargets");
+    CheckEqual("Registry: total after removing an owner", registry.GetTotalSize(), 1000 + 500);
+}
+
+// Number of reservoirs per buffer, the resolution padded to whole reservoir blocks
+static uint64_t GetExpectedReservoirCount(uint32_t width, uint32_t height, bool checkerboard)
+{
+    const uint64_t reservoirWidth = checkerboard ? (width + 1) / 2 : width;
+    const uint64_t blockSize = RTXDI_RESERVOIR_BLOCK_SIZE;
+    return ((reservoirWidth + blockSize - 1) / blockSize) * blockSize * ((height + blockSize - 1) / blockSize) * blockSize;
+}
+
+static void CheckRtxdiBufferSizes()
+{
+    const uint2 resolutions[] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }, { 1, 1 }, { 17, 9 } };
+
+    for (const uint2& resolution : resolutions)
+    {
+        for (bool checkerboard : { false, true })
+        {
+            rtxdi::ContextParameters params;
+            params.RenderWidth = resolution.x;
+            params.RenderHeight = resolution.y;
+            params.CheckerboardSamplingMode = checkerboard ? rtxdi::CheckerboardMode::Black : rtxdi::CheckerboardMode::Off;
+            const rtxdi::Context context(params);
+
+            const uint64_t reservoirs = GetExpectedReservoirCount(resolution.x, resolution.y, checkerboard);
+            const std::string suffix = " at " + std::to_string(resolution.x) + "x" + std::to_string(resolution.y) + (checkerboard ? ", checkerboard" : "");
+
+            CheckEqual(("Light reservoirs" + suffix).c_str(), RtxdiResources::GetLightReservoirBufferSize(context),
+                reservoirs * sizeof(RTXDI_PackedReservoir) * RtxdiResources::c_NumReservoirBuffers);
+            CheckEqual(("GI reservoirs" + suffix).c_str(), RtxdiResources::GetGIReservoirBufferSize(context),
+                reservoirs * sizeof(RTXDI_PackedGIReservoir) * RtxdiResources::c_NumGIReservoirBuffers);
+            CheckEqual(("Secondary G-buffer" + suffix).c_str(), RtxdiResources::GetSecondaryGBufferSize(context),
+                reservoirs * sizeof(SecondaryGBufferData));
+        }
+    }
+
+    // The RIS buffers depend on the tile parameters and ReGIR, but not on the resolution
+    rtxdi::ContextParameters params;
+    params.RenderWidth = 1920;
+    params.RenderHeight = 1080;
+    params.ReGIR.Mode = rtxdi::ReGIRMode::Grid;
+    const rtxdi::Context context(params);
+
+    const uint64_t risElements = uint64_t(params.TileSize) * params.TileCount
+        + uint64_t(params.EnvironmentTileSize) * params.EnvironmentTileCount
+        + uint64_t(params.ReGIR.GridSize.x) * params.ReGIR.GridSize.y * params.ReGIR.GridSize.z * params.ReGIR.LightsPerCell;
+
+    CheckEqual("RIS buffer, grid ReGIR", RtxdiResources::GetRisBufferSize(context), risElements * 8);
+    CheckEqual("RIS light data, grid ReGIR", RtxdiResources::GetRisLightDataBufferSize(context, false), risElements * 16 * RIS_LIGHT_DATA_STRIDE);
+    CheckEqual("RIS light data, grid ReGIR, extended", RtxdiResources::GetRisLightDataBufferSize(context, true), risElements * 16 * RIS_LIGHT_DATA_STRIDE_EXTENDED);
+    CheckEqual("Neighbor offsets", RtxdiResources::GetNeighborOffsetsBufferSize(context), uint64_t(params.NeighborOffsetCount) * 2);
+}
+
+static void PrintRtxdiBufferSizes(uint32_t width, uint32_t height, bool checkerboard)
+{
+    rtxdi::ContextParameters params;
+    params.RenderWidth = width;
+    params.RenderHeight = height;
+    params.CheckerboardSamplingMode = checkerboard ? rtxdi::CheckerboardMode::Black : rtxdi::CheckerboardMode::Off;
+    const rtxdi::Context context(params);
+
+    GpuMemoryRegistry registry;
+    auto addBuffer = [&registry](const char* name, uint64_t byteSize)
+    {
+        nvrhi::BufferDesc desc;
+        desc.byteSize = byteSize;
+        desc.debugName = name;
+        registry.AddBuffer("RtxdiResources", desc);
+    };
+
+    addBuffer("RisBuffer", RtxdiResources::GetRisBufferSize(context));
+    addBuffer("RisLightDataBuffer", RtxdiResources::GetRisLightDataBufferSize(context, false));
+    addBuffer("NeighborOffsets", RtxdiResources::GetNeighborOffsetsBufferSize(context));
+    addBuffer("LightReservoirBuffer", RtxdiResources::GetLightReservoirBufferSize(context));
+    addBuffer("SecondaryGBuffer", RtxdiResources::GetSecondaryGBufferSize(context));
+    addBuffer("GIReservoirBuffer", RtxdiResources::GetGIReservoirBufferSize(context));
+
+    printf("%s", registry.FormatReport().c_str());
+}
+
+int RunGpuMemoryCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the GPU memory size math of the RTXDI sample");
+
+    uint32_t renderWidth = 0;
+    uint32_t renderHeight = 0;
+    bool checkerboard = false;
+    bool help = false;
+
+    options.add_options()
+        ("render-width", "Print the context-dependent RTXDI buffer sizes for this render width", value(renderWidth))
+        ("render-height", "Print the context-dependent RTXDI buffer sizes for this render height", value(renderHeight))
+        ("checkerboard", "Use checkerboard sampling for the printed sizes", value(checkerboard))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (renderWidth != 0 || renderHeight != 0)
+    {
+        if (renderWidth == 0 || renderHeight == 0)
+        {
+            fprintf(stderr, "Both --render-width and --render-height must be specified\n");
+            return 2;
+        }
+
+        PrintRtxdiBufferSizes(renderWidth, renderHeight, checkerboard);
+        return 0;
+    }
+
+    printf("%-60s %14s %14s\n", "Check", "Actual", "Expected");
+
+    CheckTextureSizes();
+    CheckRegistryTotals();
+    CheckRtxdiBufferSizes();
+
+    return FinishChecks();
+}
@@ -0,0 +1,199 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Tests the image metrics used by 'rtxdi-sample --benchmark --benchmark-quality <file>' on synthetic images
+// with known properties: identical images, constant offsets, Monte Carlo noise that converges with the sample count.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "ImageMetrics.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+static bool IsNear(double value, double expected, double relativeTolerance)
+{
+    return std::abs(value - expected) <= std::abs(expected) * relativeTolerance + 1e-12;
+}
+
+// Smooth HDR image with a horizontal color ramp and a few bright spots
+static MetricImage CreateReferenceImage(uint32_t size)
+{
+    MetricImage image(size, size);
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            float* pixel = image.GetPixel(x, y);
+            const float u = float(x) / float(size);
+            const float v = float(y) / float(size);
+            pixel[0] = 0.1f + 0.8f * u;
+            pixel[1] = 0.2f + 0.5f * v;
+            pixel[2] = 0.3f + 0.2f * u * v;
+            pixel[3] = 1.f;
+
+            if ((x / 16 + y / 16) % 5 == 0)
+            {
+                pixel[0] *= 4.f;
+                pixel[1] *= 4.f;
+                pixel[2] *= 4.f;
+            }
+        }
+    }
+    return image;
+}
+
+static MetricImage CreateConstantImage(uint32_t size, float value)
+{
+    MetricImage image(size, size);
+    for (size_t index = 0; index < image.pixels.size(); index++)
+        image.pixels[index] = value;
+    return image;
+}
+
+// Average of 'samples' unbiased estimates of every pixel, each estimate being the reference times an exponential random variable.
+// The variance of the average is reference^2 / samples, like a Monte Carlo estimator with a constant relative variance.
+static MetricImage CreateNoisyImage(const MetricImage& reference, uint32_t samples, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::exponential_distribution<float> distribution(1.f);
+
+    MetricImage image = reference;
+    for (size_t pixel = 0; pixel < image.pixels.size(); pixel += 4)
+    {
+        float sum = 0.f;
+        for (uint32_t sample = 0; sample < samples; sample++)
+            sum += distribution(rng);
+        const float scale = sum / float(samples);
+
+        for (size_t channel = 0; channel < 3; channel++)
+            image.pixels[pixel + channel] = reference.pixels[pixel + channel] * scale;
+    }
+    return image;
+}
+
+static void CheckIdenticalImages(uint32_t size)
+{
+    const MetricImage reference = CreateReferenceImage(size);
+    const ImageMetrics metrics = ComputeImageMetrics(reference, reference);
+
+    Check("Identical: MSE", metrics.mse == 0.0, metrics.mse);
+    Check("Identical: relMSE", metrics.relMse == 0.0, metrics.relMse);
+    Check("Identical: PSNR is infinite", std::isinf(metrics.psnr), metrics.psnr);
+    Check("Identical: FLIP", metrics.flip == 0.0, metrics.flip);
+}
+
+static void CheckConstantImages(uint32_t size)
+{
+    const MetricImage reference = CreateConstantImage(size, 0.5f);
+    const MetricImage test = CreateConstantImage(size, 0.6f);
+
+    const double mse = ComputeMse(test, reference);
+    Check("Offset 0.1: MSE = 0.01", IsNear(mse, 0.01, 1e-5), mse);
+
+    const double relMse = ComputeRelMse(test, reference);
+    Check("Offset 0.1: relMSE = 0.01 / (0.25 + 0.01)", IsNear(relMse, 0.01 / 0.26, 1e-5), relMse);
+
+    // Tone mapped values are 0.5 / 1.5 and 0.6 / 1.6
+    const double toneMappedDifference = 0.6 / 1.6 - 0.5 / 1.5;
+    const double psnr = ComputePsnr(test, reference);
+    Check("Offset 0.1: PSNR of the tone mapped images", IsNear(psnr, -10.0 * std::log10(toneMappedDifference * toneMappedDifference), 1e-4), psnr);
+
+    // Uniform images have no features, so the error only depends on the color difference
+    const double flip = ComputeFlip(test, reference);
+    Check("Offset 0.1: FLIP is small but not zero", flip > 0.0 && flip < 0.2, flip);
+
+    const double blackWhite = ComputeFlip(CreateConstantImage(size, 1e6f), CreateConstantImage(size, 0.f));
+    Check("Black vs. white: FLIP is close to 1", blackWhite > 0.85 && blackWhite <= 1.0, blackWhite);
+
+    const double swapped = ComputeFlip(reference, test);
+    Check("FLIP is symmetric", IsNear(swapped, flip, 1e-5), swapped);
+
+    const ImageMetrics mismatch = ComputeImageMetrics(CreateConstantImage(size, 0.f), CreateConstantImage(size / 2, 0.f));
+    Check("Mismatched sizes return zeros", mismatch.mse == 0.0 && mismatch.flip == 0.0, mismatch.mse);
+}
+
+static void CheckConvergence(uint32_t size)
+{
+    const MetricImage reference = CreateReferenceImage(size);
+
+    double previousFlip = 1.0;
+    double previousPsnr = 0.0;
+    bool flipDecreases = true;
+    bool psnrIncreases = true;
+    double relMse1 = 0.0;
+    double relMse16 = 0.0;
+
+    for (uint32_t samples : { 1u, 4u, 16u, 64u })
+    {
+        const MetricImage test = CreateNoisyImage(reference, samples, 42 + samples);
+        const ImageMetrics metrics = ComputeImageMetrics(test, reference);
+
+        flipDecreases = flipDecreases && metrics.flip < previousFlip;
+        psnrIncreases = psnrIncreases && metrics.psnr > previousPsnr;
+        previousFlip = metrics.flip;
+        previousPsnr = metrics.psnr;
+
+        if (samples == 1)
+            relMse1 = metrics.relMse;
+        if (samples == 16)
+            relMse16 = metrics.relMse;
+
+        printf("  %2u samples: MSE %.6f, relMSE %.6f, PSNR %.2f dB, FLIP %.4f\n", samples, metrics.mse, metrics.relMse, metrics.psnr, metrics.flip);
+    }
+
+    Check("Noise: FLIP decreases with the sample count", flipDecreases, previousFlip);
+    Check("Noise: PSNR increases with the sample count", psnrIncreases, previousPsnr);
+
+    // The variance of the estimate is 1/N, so relMSE drops by 16x, up to the epsilon in the denominator and noise
+    Check("Noise: relMSE with 16 samples is 1/16 of 1 sample", IsNear(relMse1 / relMse16, 16.0, 0.15), relMse1 / relMse16);
+}
+
+static void CheckFramesToQuality()
+{
+    Check("Frames to quality: converging sequence", GetFramesToQuality({ 0.5, 0.3, 0.2, 0.1, 0.05, 0.04 }, 0.1) == 3, 3);
+    Check("Frames to quality: early dip is ignored", GetFramesToQuality({ 0.5, 0.08, 0.3, 0.09, 0.07 }, 0.1) == 3, 3);
+    Check("Frames to quality: never reached", GetFramesToQuality({ 0.5, 0.3, 0.2 }, 0.1) == -1, -1);
+    Check("Frames to quality: reached on the first frame", GetFramesToQuality({ 0.05, 0.04 }, 0.1) == 0, 0);
+}
+
+int RunImageMetricsCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Tests the RTXDI benchmark image metrics on synthetic images");
+
+    uint32_t size = 128;
+    bool help = false;
+
+    options.add_options()
+        ("size", "Width and height of the synthetic images, default is 128", value(size))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (size < 16)
+    {
+        fprintf(stderr, "The image size must be at least 16\n");
+        return 2;
+    }
+
+    CheckIdenticalImages(size);
+    CheckConstantImages(size);
+    CheckConvergence(size);
+    CheckFramesToQuality();
+
+    return FinishChecks();
+}
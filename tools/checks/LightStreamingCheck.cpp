@@ -0,0 +1,389 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the light streaming layer of the RTXDI sample without a scene or a device.
+// The slab allocator is compared against a slab occupancy map under random allocations and frees.
+// The residency manager is checked on a grid of light groups with a view flying over it: the cells near the view
+// must become resident after the load latency, distant cells must be evicted, the slab ranges of the resident
+// cells must never overlap or move, and the load rate and the hysteresis must be respected.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "LightStreaming.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+static void CheckAllocator()
+{
+    LightSlabAllocator allocator;
+    allocator.Reset(64);
+
+    const LightSlabRange a = allocator.Allocate(100);
+    const LightSlabRange b = allocator.Allocate(64);
+    const LightSlabRange c = allocator.Allocate(1);
+    Check("Allocator: ranges are appended in order", a.firstSlab == 0 && a.slabCount == 2 && b.firstSlab == 2 && c.firstSlab == 3,
+        double(allocator.GetSlabCount()));
+
+    const LightSlabRange empty = allocator.Allocate(0);
+    Check("Allocator: zero lights take no slabs", empty.slabCount == 0 && allocator.GetSlabCount() == 4, double(empty.slabCount));
+
+    allocator.Free(a);
+    const LightSlabRange d = allocator.Allocate(10);
+    Check("Allocator: the first free range is reused", d.firstSlab == 0 && d.slabCount == 1, double(d.firstSlab));
+    Check("Allocator: the rest of the free range stays free", allocator.GetFreeRangeCount() == 1, double(allocator.GetFreeRangeCount()));
+
+    const LightSlabRange e = allocator.Allocate(200);
+    Check("Allocator: a range larger than the free ones is appended", e.firstSlab == 4 && e.slabCount == 4, double(e.firstSlab));
+
+    allocator.Free(d);
+    allocator.Free(b);
+    Check("Allocator: adjacent free ranges are merged", allocator.GetFreeRangeCount() == 1, double(allocator.GetFreeRangeCount()));
+
+    allocator.Free(e);
+    Check("Allocator: freeing the last range lowers the slab count", allocator.GetSlabCount() == 4, double(allocator.GetSlabCount()));
+
+    allocator.Free(c);
+    Check("Allocator: freeing everything leaves no slabs", allocator.GetSlabCount() == 0 && allocator.GetFreeRangeCount() == 0
+        && allocator.GetAllocatedSlabs() == 0, double(allocator.GetSlabCount()));
+}
+
+static void CheckAllocatorRandom(uint32_t operations, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> lightCounts(1, 1000);
+
+    LightSlabAllocator allocator;
+    allocator.Reset(32);
+
+    std::vector<LightSlabRange> ranges;
+    std::vector<bool> occupied;
+    bool noOverlaps = true;
+    bool countsMatch = true;
+    bool slabCountTight = true;
+    uint32_t maxSlabs = 0;
+
+    for (uint32_t operation = 0; operation < operations; operation++)
+    {
+        // Keep around 100 live ranges
+        const bool allocate = ranges.empty() || (rng() % 200) >= ranges.size();
+
+        if (allocate)
+        {
+            const uint32_t lightCount = lightCounts(rng);
+            const LightSlabRange range = allocator.Allocate(lightCount);
+            noOverlaps &= range.slabCount * allocator.GetSlabSize() >= lightCount;
+
+            occupied.resize(std::max<size_t>(occupied.size(), range.firstSlab + range.slabCount), false);
+            for (uint32_t slab = range.firstSlab; slab < range.firstSlab + range.slabCount; slab++)
+            {
+                noOverlaps &= !occupied[slab];
+                occupied[slab] = true;
+            }
+            ranges.push_back(range);
+        }
+        else
+        {
+            const size_t index = rng() % ranges.size();
+            const LightSlabRange range = ranges[index];
+            ranges[index] = ranges.back();
+            ranges.pop_back();
+
+            allocator.Free(range);
+            for (uint32_t slab = range.firstSlab; slab < range.firstSlab + range.slabCount; slab++)
+                occupied[slab] = false;
+        }
+
+        uint32_t allocatedSlabs = 0;
+        uint32_t endSlab = 0;
+        for (const LightSlabRange& range : ranges)
+        {
+            allocatedSlabs += range.slabCount;
+            endSlab = std::max(endSlab, range.firstSlab + range.slabCount);
+        }
+
+        countsMatch &= allocatedSlabs == allocator.GetAllocatedSlabs();
+        slabCountTight &= endSlab == allocator.GetSlabCount();
+        maxSlabs = std::max(maxSlabs, allocator.GetSlabCount());
+    }
+
+    Check("Allocator random: ranges never overlap and fit the lights", noOverlaps, double(operations));
+    Check("Allocator random: allocated slab count", countsMatch, double(allocator.GetAllocatedSlabs()));
+    Check("Allocator random: slab count ends at the last range", slabCountTight, double(maxSlabs));
+}
+
+// A square grid of light groups on the ground, one group per grid point
+static std::vector<LightStreamingItem> CreateGrid(uint32_t gridSize, float spacing, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> lightCounts(1, 300);
+
+    std::vector<LightStreamingItem> items;
+    for (uint32_t z = 0; z < gridSize; z++)
+    {
+        for (uint32_t x = 0; x < gridSize; x++)
+        {
+            LightStreamingItem item;
+            item.position[0] = (float(x) + 0.5f) * spacing;
+            item.position[1] = 1.f;
+            item.position[2] = (float(z) + 0.5f) * spacing;
+            item.lightCount = lightCounts(rng);
+            item.key = items.size();
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Distance from the view to the nearest point of the cell containing the position, as in the manager
+static float GetCellDistance(const float position[3], const float view[3], float cellSize)
+{
+    float distanceSquared = 0.f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float cellMin = std::floor(position[axis] / cellSize) * cellSize;
+        const float d = std::max(std::max(cellMin - view[axis], view[axis] - cellMin - cellSize), 0.f);
+        distanceSquared += d * d;
+    }
+    return std::sqrt(distanceSquared);
+}
+
+static void CheckLatency()
+{
+    LightStreamingParameters params;
+    params.enable = true;
+    params.loadLatencyFrames = 3;
+
+    LightStreamingManager manager;
+    manager.SetParameters(params);
+
+    std::vector<LightStreamingItem> items(1);
+    items[0] = { { 10.f, 1.f, 10.f }, 100, 0 };
+    manager.SetItems(items);
+
+    const float view[3] = { 0.f, 1.f, 0.f };
+    uint32_t residentFrame = ~0u;
+    for (uint32_t frame = 0; frame < 10 && residentFrame == ~0u; frame++)
+    {
+        manager.Update(view);
+        if (manager.GetCellState(0) == LightStreamingCellState::Resident)
+            residentFrame = frame;
+    }
+    Check("Latency: the cell is resident after the load latency", residentFrame == params.loadLatencyFrames, double(residentFrame));
+
+    uint32_t firstLight = 0;
+    uint32_t lightCapacity = 0;
+    const bool resident = manager.GetCellLightRange(0, firstLight, lightCapacity);
+    Check("Latency: the resident cell has a slab range for its lights", resident && firstLight == 0 && lightCapacity == 128, double(lightCapacity));
+
+    Check("Latency: unchanged items are not regrouped", !manager.SetItems(items), 0);
+
+    // A larger item in the same cell moves the cell to a new range, it stays resident
+    items[0].lightCount = 200;
+    const bool regrouped = manager.SetItems(items);
+    manager.GetCellLightRange(0, firstLight, lightCapacity);
+    Check("Latency: a grown cell stays resident in a larger range", regrouped && manager.GetCellState(0) == LightStreamingCellState::Resident
+        && lightCapacity >= 200, double(lightCapacity));
+
+    // Moving the only item to another cell unloads the old cell
+    items[0].position[0] = 1000.f;
+    manager.SetItems(items);
+    Check("Latency: an item moved to a new cell is not resident", manager.GetCellState(0) == LightStreamingCellState::Unloaded
+        && manager.GetAllocator().GetAllocatedSlabs() == 0, double(manager.GetAllocator().GetAllocatedSlabs()));
+}
+
+static void CheckFlyThrough(uint32_t gridSize, uint32_t frames, const LightStreamingParameters& params)
+{
+    const float spacing = 8.f;
+    const std::vector<LightStreamingItem> items = CreateGrid(gridSize, spacing, 3);
+    const float worldSize = float(gridSize) * spacing;
+
+    uint32_t totalLights = 0;
+    for (const LightStreamingItem& item : items)
+        totalLights += item.lightCount;
+
+    LightStreamingManager manager;
+    manager.SetParameters(params);
+    manager.SetItems(items);
+
+    std::vector<uint32_t> previousFirstLight(manager.GetCellCount(), ~0u);
+    std::vector<uint32_t> cellLights(manager.GetCellCount(), 0);
+    for (size_t item = 0; item < items.size(); item++)
+        cellLights[manager.GetItemCell(item)] += items[item].lightCount;
+
+    bool rangesValid = true;
+    bool rangesStable = true;
+    bool nearCellsLoaded = true;
+    bool farCellsEvicted = true;
+    bool loadRateRespected = true;
+    uint32_t maxResidentLights = 0;
+    uint32_t maxCapacity = 0;
+    uint32_t previousLoads = 0;
+    double updateTime = 0.0;
+
+    // The view flies along the diagonal and stops for a while in the middle
+    const uint32_t settleFrames = params.loadLatencyFrames + 64;
+    for (uint32_t frame = 0; frame < frames + settleFrames; frame++)
+    {
+        const uint32_t motionFrame = (frame < frames / 2) ? frame : (frame < frames / 2 + settleFrames) ? frames / 2 : frame - settleFrames;
+        const float t = float(motionFrame) / float(frames - 1);
+        const float view[3] = { t * worldSize, 2.f, t * worldSize };
+        const bool settled = frame == frames / 2 + settleFrames - 1;
+
+        const auto start = std::chrono::steady_clock::now();
+        manager.Update(view);
+        updateTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        loadRateRespected &= manager.GetLoadCount() - previousLoads <= params.maxLoadsPerFrame;
+        previousLoads = manager.GetLoadCount();
+
+        std::vector<bool> occupied(manager.GetLocalLightCapacity(), false);
+        for (uint32_t cell = 0; cell < uint32_t(manager.GetCellCount()); cell++)
+        {
+            uint32_t firstLight = 0;
+            uint32_t lightCapacity = 0;
+            if (!manager.GetCellLightRange(cell, firstLight, lightCapacity))
+            {
+                previousFirstLight[cell] = ~0u;
+                continue;
+            }
+
+            rangesValid &= lightCapacity >= cellLights[cell] && firstLight + lightCapacity <= manager.GetLocalLightCapacity();
+            for (uint32_t light = firstLight; light < std::min<uint32_t>(firstLight + lightCapacity, uint32_t(occupied.size())); light++)
+            {
+                rangesValid &= !occupied[light];
+                occupied[light] = true;
+            }
+
+            rangesStable &= previousFirstLight[cell] == ~0u || previousFirstLight[cell] == firstLight;
+            previousFirstLight[cell] = firstLight;
+        }
+
+        for (const LightStreamingItem& item : items)
+        {
+            const float distance = GetCellDistance(item.position, view, params.cellSize);
+            const LightStreamingCellState state = manager.GetCellState(manager.GetItemCell(size_t(&item - items.data())));
+
+            farCellsEvicted &= distance <= params.evictDistance || state == LightStreamingCellState::Unloaded;
+            if (settled)
+                nearCellsLoaded &= distance > params.loadDistance || state == LightStreamingCellState::Resident;
+        }
+
+        maxResidentLights = std::max(maxResidentLights, manager.GetResidentLightCount());
+        maxCapacity = std::max(maxCapacity, manager.GetLocalLightCapacity());
+    }
+
+    printf("  %u cells, %u lights: at most %u resident, light capacity %u, %u loads, %u evictions, %.4f ms per update\n",
+        uint32_t(manager.GetCellCount()), totalLights, maxResidentLights, maxCapacity, manager.GetLoadCount(), manager.GetEvictionCount(),
+        updateTime / (frames + settleFrames));
+
+    Check("Fly-through: slab ranges hold their cells and never overlap", rangesValid, double(maxCapacity));
+    Check("Fly-through: resident cells keep their slab range", rangesStable, 0);
+    Check("Fly-through: cells within the load distance become resident", nearCellsLoaded, double(manager.GetResidentCellCount()));
+    Check("Fly-through: cells beyond the evict distance are unloaded", farCellsEvicted, double(manager.GetEvictionCount()));
+    Check("Fly-through: loads per frame are limited", loadRateRespected, double(params.maxLoadsPerFrame));
+    Check("Fly-through: only part of the lights is resident", maxResidentLights < totalLights, double(maxResidentLights));
+}
+
+static void CheckHysteresis(const LightStreamingParameters& params)
+{
+    const std::vector<LightStreamingItem> items = CreateGrid(32, 8.f, 5);
+
+    LightStreamingManager manager;
+    manager.SetParameters(params);
+    manager.SetItems(items);
+
+    // Settle at one position, then move back and forth by less than the gap between the load and evict distances
+    const float amplitude = (params.evictDistance - params.loadDistance) * 0.45f;
+    float view[3] = { 128.f, 2.f, 128.f };
+    for (uint32_t frame = 0; frame < params.loadLatencyFrames + 200; frame++)
+        manager.Update(view);
+
+    const uint32_t evictions = manager.GetEvictionCount();
+
+    for (uint32_t frame = 0; frame < 100; frame++)
+    {
+        view[0] = 128.f + ((frame & 1) ? amplitude : -amplitude);
+        manager.Update(view);
+    }
+    view[0] = 128.f;
+    manager.Update(view);
+
+    // Moving the view can load the cells that were just outside the load distance, but never evicts
+    Check("Hysteresis: no evictions while moving within the gap", manager.GetEvictionCount() == evictions, double(manager.GetEvictionCount() - evictions));
+
+    const uint32_t loadsAfterMotion = manager.GetLoadCount();
+    const uint32_t revision = manager.GetResidencyRevision();
+    for (uint32_t frame = 0; frame < 100; frame++)
+    {
+        view[0] = 128.f + ((frame & 1) ? amplitude : -amplitude);
+        manager.Update(view);
+    }
+    Check("Hysteresis: repeated motion loads nothing new", manager.GetLoadCount() == loadsAfterMotion, double(manager.GetLoadCount() - loadsAfterMotion));
+    Check("Hysteresis: the residency revision is stable", manager.GetResidencyRevision() == revision, double(manager.GetResidencyRevision() - revision));
+
+    // Another slab size unloads everything
+    LightStreamingParameters otherParams = params;
+    otherParams.slabSize = params.slabSize * 2;
+    manager.SetParameters(otherParams);
+    Check("Hysteresis: a new slab size unloads all cells", manager.GetResidentCellCount() == 0 && manager.GetLocalLightCapacity() == 0,
+        double(manager.GetResidentCellCount()));
+}
+
+int RunLightStreamingCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the light streaming allocator and residency logic of the RTXDI sample");
+
+    uint32_t gridSize = 128;
+    uint32_t frames = 1000;
+    uint32_t operations = 100000;
+    LightStreamingParameters params;
+    params.enable = true;
+    bool help = false;
+
+    options.add_options()
+        ("grid", "Number of light groups along each side of the square test world, default is 128", value(gridSize))
+        ("frames", "Number of frames of the fly-through, default is 1000", value(frames))
+        ("operations", "Number of random allocations and frees, default is 100000", value(operations))
+        ("cell-size", "Size of the streaming cells, default is 32", value(params.cellSize))
+        ("load-distance", "Distance within which cells are loaded, default is 96", value(params.loadDistance))
+        ("evict-distance", "Distance beyond which cells are evicted, default is 128", value(params.evictDistance))
+        ("loads-per-frame", "Number of load requests per frame, default is 8", value(params.maxLoadsPerFrame))
+        ("latency", "Number of frames from a load request to the residency, default is 2", value(params.loadLatencyFrames))
+        ("slab-size", "Number of lights per slab, default is 64", value(params.slabSize))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (gridSize < 2 || frames < 2 || params.cellSize <= 0.f || params.slabSize == 0 || params.maxLoadsPerFrame == 0
+        || params.evictDistance <= params.loadDistance)
+    {
+        fprintf(stderr, "Invalid arguments: the grid and frame counts must be at least 2, the cell and slab sizes and the loads per frame "
+            "must be positive, and the evict distance must exceed the load distance\n");
+        return 2;
+    }
+
+    CheckAllocator();
+    CheckAllocatorRandom(operations, 11);
+    CheckLatency();
+    CheckFlyThrough(gridSize, frames, params);
+    CheckHysteresis(params);
+
+    return FinishChecks();
+}
@@ -0,0 +1,573 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks that the adaptive light type selection of RTXDI_SampleLightsForSurface is unbiased on the CPU.
+// The candidate generation, the BRDF MIS weights and the reservoir combination of the fixed split path and of
+// RTXDI_SampleLightsForSurfaceAdaptive are mirrored over a synthetic surface that sees a discrete set of local lights,
+// infinite lights and environment map directions, with light type probabilities from rtxdi::Context.
+// Every light sample has a known contribution, so both estimators are compared with the exact sum and with each other.
+// The environment tiles and the hemisphere split are not simulated, they are sampled from the environment PDF directly.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include <rtxdi/RTXDI.h>
+
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::mt19937 Rng;
+
+enum class LightType
+{
+    Local,
+    Infinite,
+    Environment
+};
+
+// One light sample that the surface can receive light from
+struct LightSample
+{
+    LightType type = LightType::Local;
+
+    // Unshadowed contribution, RAB_GetLightSampleTargetPdfForSurface
+    double targetPdf = 0.0;
+
+    // Shadowed contribution, the value that the estimators integrate
+    double contribution = 0.0;
+
+    // Probability of drawing the sample from the pool of its light type
+    double sourcePdf = 0.0;
+
+    // Probability that a BRDF ray hits the sample, 0 for infinite lights that are never hit by rays
+    double brdfPdf = 0.0;
+};
+
+struct Scene
+{
+    const char* name = "";
+    std::vector<LightSample> samples;
+    std::vector<uint32_t> samplesByType[3];
+
+    // Power estimates passed to rtxdi::FrameParameters, only their ratios matter
+    float localLightPower = 0.f;
+    float infiniteLightPower = 0.f;
+    float environmentLightPower = 0.f;
+
+    [[nodiscard]] double GetReference() const
+    {
+        double sum = 0.0;
+        for (const LightSample& sample : samples)
+            sum += sample.contribution;
+        return sum;
+    }
+};
+
+struct SampleCounts
+{
+    uint32_t local = 8;
+    uint32_t infinite = 1;
+    uint32_t environment = 1;
+    uint32_t brdf = 1;
+};
+
+// Builds a scene with the given number of lights of each type and the given scale of their contributions.
+// About a third of the local lights face away from the surface, and every sample is occluded with some probability.
+static Scene CreateScene(const char* name, uint32_t numLocalLights, uint32_t numInfiniteLights, uint32_t numEnvironmentTexels,
+    double localScale, double infiniteScale, double environmentScale, uint32_t seed)
+{
+    Scene scene;
+    scene.name = name;
+
+    Rng rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const double localBrdfHitProbability = 0.2;
+    const double environmentBrdfHitProbability = 0.7;
+
+    double localPowerSum = 0.0;
+    double localSolidAngleSum = 0.0;
+    for (uint32_t i = 0; i < numLocalLights; i++)
+    {
+        const double power = localScale * std::exp(3.0 * uniform(rng));
+        const bool facing = uniform(rng) > 0.3;
+        const double geometry = facing ? uniform(rng) : 0.0;
+
+        LightSample sample;
+        sample.type = LightType::Local;
+        sample.targetPdf = power * geometry;
+        sample.contribution = (uniform(rng) < 0.7) ? sample.targetPdf : 0.0;
+        sample.sourcePdf = power;
+        sample.brdfPdf = facing ? geometry * uniform(rng) : 0.0;
+
+        localPowerSum += power;
+        localSolidAngleSum += sample.brdfPdf;
+        scene.samples.push_back(sample);
+    }
+
+    for (uint32_t i = 0; i < numInfiniteLights; i++)
+    {
+        LightSample sample;
+        sample.type = LightType::Infinite;
+        sample.targetPdf = infiniteScale * (0.5 + uniform(rng));
+        sample.contribution = (uniform(rng) < 0.7) ? sample.targetPdf : 0.0;
+        sample.sourcePdf = 1.0 / double(numInfiniteLights);
+        scene.samples.push_back(sample);
+    }
+
+    double environmentPowerSum = 0.0;
+    double environmentCosineSum = 0.0;
+    for (uint32_t i = 0; i < numEnvironmentTexels; i++)
+    {
+        const double radiance = environmentScale * std::exp(2.0 * uniform(rng));
+        const double cosine = std::max(2.0 * uniform(rng) - 1.0, 0.0);
+
+        LightSample sample;
+        sample.type = LightType::Environment;
+        sample.targetPdf = radiance * cosine;
+        sample.contribution = (uniform(rng) < 0.8) ? sample.targetPdf : 0.0;
+        sample.sourcePdf = radiance;
+        sample.brdfPdf = cosine;
+
+        environmentPowerSum += radiance;
+        environmentCosineSum += cosine;
+        scene.samples.push_back(sample);
+    }
+
+    // Normalize the source and BRDF distributions, the BRDF rays that hit nothing emissive are the remainder
+    for (uint32_t index = 0; index < uint32_t(scene.samples.size()); index++)
+    {
+        LightSample& sample = scene.samples[index];
+        if (sample.type == LightType::Local)
+        {
+            sample.sourcePdf /= localPowerSum;
+            sample.brdfPdf *= localBrdfHitProbability / localSolidAngleSum;
+        }
+        else if (sample.type == LightType::Environment)
+        {
+            sample.sourcePdf /= environmentPowerSum;
+            sample.brdfPdf *= environmentBrdfHitProbability / environmentCosineSum;
+        }
+
+        scene.samplesByType[int(sample.type)].push_back(index);
+    }
+
+    // Ideal power estimates, the unshadowed contribution of each light type to the surface
+    float* powers[3] = { &scene.localLightPower, &scene.infiniteLightPower, &scene.environmentLightPower };
+    for (const LightSample& sample : scene.samples)
+        *powers[int(sample.type)] += float(sample.targetPdf);
+
+    return scene;
+}
+
+// Weighted reservoir over the scene samples, mirrors RTXDI_Reservoir without the temporal data
+struct Reservoir
+{
+    int sample = -1;
+    double weightSum = 0.0;
+    double targetPdf = 0.0;
+    uint32_t M = 0;
+};
+
+// RTXDI_StreamSample
+static void StreamSample(Reservoir& reservoir, int sample, double targetPdf, double invSourcePdf, double random)
+{
+    const double risWeight = targetPdf * invSourcePdf;
+    reservoir.M += 1;
+    reservoir.weightSum += risWeight;
+    if (random * reservoir.weightSum < risWeight)
+    {
+        reservoir.sample = sample;
+        reservoir.targetPdf = targetPdf;
+    }
+}
+
+// RTXDI_CombineReservoirs for a finalized reservoir with M = 1
+static void CombineReservoirs(Reservoir& reservoir, const Reservoir& newReservoir, double random)
+{
+    const double risWeight = newReservoir.targetPdf * newReservoir.weightSum;
+    reservoir.M += 1;
+    reservoir.weightSum += risWeight;
+    if (random * reservoir.weightSum < risWeight)
+    {
+        reservoir.sample = newReservoir.sample;
+        reservoir.targetPdf = newReservoir.targetPdf;
+    }
+}
+
+// RTXDI_FinalizeResampling
+static void FinalizeResampling(Reservoir& reservoir, double normalizationDenominator)
+{
+    const double denominator = reservoir.targetPdf * normalizationDenominator;
+    reservoir.weightSum = (denominator == 0.0) ? 0.0 : reservoir.weightSum / denominator;
+    reservoir.M = 1;
+}
+
+// The MIS weights of RTXDI_SampleParameters
+struct MisWeights
+{
+    double numMisSamples = 0.0;
+    double light = 0.0;
+    double brdf = 0.0;
+};
+
+// Samples the scene with the techniques of RTXDI_SampleLightsForSurface, both with the fixed split of sample counts
+// and with the adaptive light type selection
+class SurfaceSampler
+{
+private:
+    const Scene& m_Scene;
+    SampleCounts m_Counts;
+    Rng m_Rng;
+    std::uniform_real_distribution<double> m_Uniform;
+    std::discrete_distribution<uint32_t> m_TypeDistributions[3];
+    std::discrete_distribution<uint32_t> m_BrdfDistribution;
+
+    double Random() { return m_Uniform(m_Rng); }
+
+    // Draws a sample from the pool of the given light type, returns its index in the scene
+    uint32_t SelectSample(LightType type)
+    {
+        const std::vector<uint32_t>& samples = m_Scene.samplesByType[int(type)];
+        return samples[m_TypeDistributions[int(type)](m_Rng)];
+    }
+
+    // RTXDI_LightBrdfMisWeight, all PDFs are discrete so there is no solid angle conversion
+    static double BlendSourcePdf(const LightSample& sample, double lightSelectionPdf, const MisWeights& weights)
+    {
+        if (weights.brdf == 0.0 || sample.type == LightType::Infinite)
+            return weights.light * lightSelectionPdf;
+
+        return weights.light * lightSelectionPdf + weights.brdf * sample.brdfPdf;
+    }
+
+    // RTXDI_SampleBrdfInternal, the light source PDFs are scaled by the light type selection probabilities
+    Reservoir SampleBrdf(const MisWeights& weights, double localLightPdfScale, double environmentPdfScale)
+    {
+        Reservoir reservoir;
+        for (uint32_t i = 0; i < m_Counts.brdf; i++)
+        {
+            const uint32_t hit = m_BrdfDistribution(m_Rng);
+            const double risRandom = Random();
+            if (hit >= m_Scene.samples.size())
+                continue;
+
+            const LightSample& sample = m_Scene.samples[hit];
+            const double scale = (sample.type == LightType::Local) ? localLightPdfScale : environmentPdfScale;
+            const double lightSourcePdf = sample.sourcePdf * scale;
+            if (lightSourcePdf == 0.0)
+                continue;
+
+            StreamSample(reservoir, int(hit), sample.targetPdf, 1.0 / BlendSourcePdf(sample, lightSourcePdf, weights), risRandom);
+        }
+
+        FinalizeResampling(reservoir, weights.numMisSamples);
+        return reservoir;
+    }
+
+    double Shade(const Reservoir& reservoir) const
+    {
+        if (reservoir.sample < 0)
+            return 0.0;
+        return m_Scene.samples[reservoir.sample].contribution * reservoir.weightSum;
+    }
+
+public:
+    SurfaceSampler(const Scene& scene, const SampleCounts& counts, uint32_t seed)
+        : m_Scene(scene)
+        , m_Counts(counts)
+        , m_Rng(seed)
+        , m_Uniform(0.0, 1.0)
+    {
+        for (int type = 0; type < 3; type++)
+        {
+            std::vector<double> weights;
+            for (uint32_t index : scene.samplesByType[type])
+                weights.push_back(scene.samples[index].sourcePdf);
+            if (!weights.empty())
+                m_TypeDistributions[type] = std::discrete_distribution<uint32_t>(weights.begin(), weights.end());
+        }
+
+        // The last outcome is a BRDF ray that hits no emissive surface and escapes below the horizon
+        std::vector<double> brdfWeights;
+        double hitProbability = 0.0;
+        for (const LightSample& sample : scene.samples)
+        {
+            brdfWeights.push_back(sample.brdfPdf);
+            hitProbability += sample.brdfPdf;
+        }
+        brdfWeights.push_back(std::max(1.0 - hitProbability, 0.0));
+        m_BrdfDistribution = std::discrete_distribution<uint32_t>(brdfWeights.begin(), brdfWeights.end());
+    }
+
+    // The fixed split path of RTXDI_SampleLightsForSurface: one reservoir per light type and one for the BRDF
+    double SampleFixed()
+    {
+        const bool hasLocal = !m_Scene.samplesByType[int(LightType::Local)].empty();
+        const bool hasInfinite = !m_Scene.samplesByType[int(LightType::Infinite)].empty();
+        const bool hasEnvironment = !m_Scene.samplesByType[int(LightType::Environment)].empty();
+
+        // RTXDI_InitSampleParameters
+        MisWeights localWeights;
+        localWeights.numMisSamples = double(m_Counts.local + m_Counts.environment + m_Counts.brdf);
+        localWeights.light = m_Counts.local / localWeights.numMisSamples;
+        localWeights.brdf = m_Counts.brdf / localWeights.numMisSamples;
+        MisWeights environmentWeights = localWeights;
+        environmentWeights.light = m_Counts.environment / localWeights.numMisSamples;
+
+        Reservoir localReservoir;
+        if (hasLocal && m_Counts.local > 0)
+        {
+            for (uint32_t i = 0; i < m_Counts.local; i++)
+            {
+                const uint32_t index = SelectSample(LightType::Local);
+                const LightSample& sample = m_Scene.samples[index];
+                StreamSample(localReservoir, int(index), sample.targetPdf, 1.0 / BlendSourcePdf(sample, sample.sourcePdf, localWeights), Random());
+            }
+            FinalizeResampling(localReservoir, localWeights.numMisSamples);
+        }
+
+        Reservoir infiniteReservoir;
+        if (hasInfinite && m_Counts.infinite > 0)
+        {
+            for (uint32_t i = 0; i < m_Counts.infinite; i++)
+            {
+                const uint32_t index = SelectSample(LightType::Infinite);
+                const LightSample& sample = m_Scene.samples[index];
+                StreamSample(infiniteReservoir, int(index), sample.targetPdf, 1.0 / sample.sourcePdf, Random());
+            }
+            FinalizeResampling(infiniteReservoir, double(infiniteReservoir.M));
+        }
+
+        Reservoir environmentReservoir;
+        if (hasEnvironment && m_Counts.environment > 0)
+        {
+            for (uint32_t i = 0; i < m_Counts.environment; i++)
+            {
+                const uint32_t index = SelectSample(LightType::Environment);
+                const LightSample& sample = m_Scene.samples[index];
+                StreamSample(environmentReservoir, int(index), sample.targetPdf, 1.0 / BlendSourcePdf(sample, sample.sourcePdf, environmentWeights), Random());
+            }
+            FinalizeResampling(environmentReservoir, environmentWeights.numMisSamples);
+        }
+
+        // The BRDF samples use the MIS weight of the technique that could have generated them
+        Reservoir brdfReservoir;
+        for (uint32_t i = 0; i < m_Counts.brdf; i++)
+        {
+            const uint32_t hit = m_BrdfDistribution(m_Rng);
+            const double risRandom = Random();
+            if (hit >= m_Scene.samples.size())
+                continue;
+
+            const LightSample& sample = m_Scene.samples[hit];
+            const MisWeights& weights = (sample.type == LightType::Local) ? localWeights : environmentWeights;
+            StreamSample(brdfReservoir, int(hit), sample.targetPdf, 1.0 / BlendSourcePdf(sample, sample.sourcePdf, weights), risRandom);
+        }
+        FinalizeResampling(brdfReservoir, localWeights.numMisSamples);
+
+        Reservoir state;
+        CombineReservoirs(state, localReservoir, 0.5);
+        CombineReservoirs(state, infiniteReservoir, Random());
+        CombineReservoirs(state, environmentReservoir, Random());
+        CombineReservoirs(state, brdfReservoir, Random());
+        FinalizeResampling(state, 1.0);
+
+        return Shade(state);
+    }
+
+    // RTXDI_SampleLightsForSurfaceAdaptive: every light candidate picks its light type with the given probabilities
+    double SampleAdaptive(const double typeProbabilities[3])
+    {
+        const uint32_t numLightSamples = m_Counts.local + m_Counts.infinite + m_Counts.environment;
+
+        MisWeights weights;
+        weights.numMisSamples = double(numLightSamples + m_Counts.brdf);
+        weights.light = numLightSamples / weights.numMisSamples;
+        weights.brdf = m_Counts.brdf / weights.numMisSamples;
+
+        Reservoir lightReservoir;
+        for (uint32_t i = 0; i < numLightSamples; i++)
+        {
+            const double typeRandom = Random();
+
+            LightType type;
+            if (typeRandom < typeProbabilities[0] || (typeProbabilities[1] <= 0.0 && typeProbabilities[2] <= 0.0))
+                type = LightType::Local;
+            else if (typeRandom < typeProbabilities[0] + typeProbabilities[1] || typeProbabilities[2] <= 0.0)
+                type = LightType::Infinite;
+            else
+                type = LightType::Environment;
+
+            const uint32_t index = SelectSample(type);
+            const LightSample& sample = m_Scene.samples[index];
+            const double typeProbability = typeProbabilities[int(type)];
+
+            // Infinite lights are not MIS-blended, but they share the light technique weight with the other candidates
+            const double blendedSourcePdf = (type == LightType::Infinite)
+                ? sample.sourcePdf * typeProbability * weights.light
+                : BlendSourcePdf(sample, sample.sourcePdf * typeProbability, weights);
+
+            StreamSample(lightReservoir, int(index), sample.targetPdf, 1.0 / blendedSourcePdf, Random());
+        }
+        FinalizeResampling(lightReservoir, weights.numMisSamples);
+
+        Reservoir brdfReservoir = SampleBrdf(weights, typeProbabilities[0], typeProbabilities[2]);
+
+        Reservoir state;
+        CombineReservoirs(state, lightReservoir, 0.5);
+        CombineReservoirs(state, brdfReservoir, Random());
+        FinalizeResampling(state, 1.0);
+
+        return Shade(state);
+    }
+};
+
+// Mean and standard error of a series of estimates
+class MeanEstimator
+{
+private:
+    double m_Sum = 0.0;
+    double m_SumOfSquares = 0.0;
+    uint64_t m_Count = 0;
+
+public:
+    void Add(double value)
+    {
+        m_Sum += value;
+        m_SumOfSquares += value * value;
+        m_Count++;
+    }
+
+    [[nodiscard]] double GetMean() const { return m_Sum / double(m_Count); }
+
+    [[nodiscard]] double GetVariance() const
+    {
+        const double mean = GetMean();
+        return std::max(m_SumOfSquares / double(m_Count) - mean * mean, 0.0);
+    }
+
+    [[nodiscard]] double GetStandardError() const { return std::sqrt(GetVariance() / double(m_Count)); }
+};
+
+// Computes the light type probabilities the way the SDK publishes them in the runtime parameters
+static void GetLightTypeProbabilities(const Scene& scene, float minLightTypeProbability, double outProbabilities[3])
+{
+    rtxdi::ContextParameters contextParams;
+    contextParams.RenderWidth = 64;
+    contextParams.RenderHeight = 64;
+    rtxdi::Context context(contextParams);
+
+    rtxdi::FrameParameters frame;
+    frame.numLocalLights = uint32_t(scene.samplesByType[int(LightType::Local)].size());
+    frame.numInfiniteLights = uint32_t(scene.samplesByType[int(LightType::Infinite)].size());
+    frame.environmentLightPresent = !scene.samplesByType[int(LightType::Environment)].empty();
+    frame.enableAdaptiveLightTypeSelection = true;
+    frame.localLightPower = scene.localLightPower;
+    frame.infiniteLightPower = scene.infiniteLightPower;
+    frame.environmentLightPower = scene.environmentLightPower;
+    frame.minLightTypeProbability = minLightTypeProbability;
+
+    RTXDI_ResamplingRuntimeParameters runtimeParams = {};
+    context.FillRuntimeParameters(runtimeParams, frame);
+
+    outProbabilities[0] = runtimeParams.localLightSelectionProbability;
+    outProbabilities[1] = runtimeParams.infiniteLightSelectionProbability;
+    outProbabilities[2] = runtimeParams.environmentLightSelectionProbability;
+}
+
+static void CheckScene(const Scene& scene, const SampleCounts& counts, float minLightTypeProbability, uint32_t trials, uint32_t seed)
+{
+    double typeProbabilities[3];
+    GetLightTypeProbabilities(scene, minLightTypeProbability, typeProbabilities);
+
+    SurfaceSampler sampler(scene, counts, seed);
+    MeanEstimator fixedEstimator;
+    MeanEstimator adaptiveEstimator;
+    for (uint32_t trial = 0; trial < trials; trial++)
+    {
+        fixedEstimator.Add(sampler.SampleFixed());
+        adaptiveEstimator.Add(sampler.SampleAdaptive(typeProbabilities));
+    }
+
+    const double reference = scene.GetReference();
+    const double fixedMean = fixedEstimator.GetMean();
+    const double adaptiveMean = adaptiveEstimator.GetMean();
+    const double fixedError = fixedEstimator.GetStandardError();
+    const double adaptiveError = adaptiveEstimator.GetStandardError();
+
+    const std::string prefix = std::string(scene.name) + ": ";
+    Report((prefix + "local light probability").c_str(), typeProbabilities[0]);
+    Report((prefix + "infinite light probability").c_str(), typeProbabilities[1]);
+    Report((prefix + "environment probability").c_str(), typeProbabilities[2]);
+
+    // Allow 5 standard errors, so that the checks pass for any seed unless the estimators are biased
+    Check((prefix + "fixed split mean vs. reference").c_str(),
+        std::abs(fixedMean - reference) <= 5.0 * fixedError + 1e-9 * reference, fixedMean / reference);
+    Check((prefix + "adaptive mean vs. reference").c_str(),
+        std::abs(adaptiveMean - reference) <= 5.0 * adaptiveError + 1e-9 * reference, adaptiveMean / reference);
+    Check((prefix + "adaptive mean vs. fixed split mean").c_str(),
+        std::abs(adaptiveMean - fixedMean) <= 5.0 * std::sqrt(fixedError * fixedError + adaptiveError * adaptiveError) + 1e-9 * reference,
+        adaptiveMean / fixedMean);
+
+    Report((prefix + "variance of adaptive vs. fixed split").c_str(), adaptiveEstimator.GetVariance() / fixedEstimator.GetVariance());
+}
+
+int RunLightTypeSelectionCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks that the adaptive light type selection is unbiased on the CPU");
+
+    uint32_t trials = 200000;
+    uint32_t seed = 1;
+    float minLightTypeProbability = 0.05f;
+    SampleCounts counts;
+    bool help = false;
+
+    options.add_options()
+        ("trials", "Number of surface samples per estimator and scene, default is 200000", value(trials))
+        ("local", "Number of local light samples, default is 8", value(counts.local))
+        ("infinite", "Number of infinite light samples, default is 1", value(counts.infinite))
+        ("environment", "Number of environment map samples, default is 1", value(counts.environment))
+        ("brdf", "Number of BRDF samples, default is 1", value(counts.brdf))
+        ("min-probability", "Minimum light type probability, default is 0.05", value(minLightTypeProbability))
+        ("seed", "Random seed, default is 1", value(seed))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    // The fixed split is only unbiased when every light type gets samples, and the adaptive selection
+    // needs a nonzero floor to cover the scenes where the power estimates miss a light type
+    if (trials < 1000 || counts.local == 0 || counts.infinite == 0 || counts.environment == 0
+        || minLightTypeProbability <= 0.f || minLightTypeProbability > 1.f / 3.f)
+    {
+        fprintf(stderr, "Invalid arguments: at least 1000 trials, nonzero light sample counts, and a minimum probability in (0, 1/3] are required\n");
+        return 2;
+    }
+
+    CheckScene(CreateScene("Balanced", 64, 2, 256, 1.0, 1.0, 1.0, seed), counts, minLightTypeProbability, trials, seed);
+    CheckScene(CreateScene("Bright environment", 64, 2, 256, 0.05, 0.2, 1.0, seed + 1), counts, minLightTypeProbability, trials, seed);
+    CheckScene(CreateScene("No infinite lights", 256, 0, 256, 1.0, 0.0, 0.2, seed + 2), counts, minLightTypeProbability, trials, seed);
+
+    Scene missedScene = CreateScene("Missed infinite power", 64, 2, 256, 1.0, 2.0, 1.0, seed + 3);
+    missedScene.infiniteLightPower = 0.f;
+    CheckScene(missedScene, counts, minLightTypeProbability, trials, seed);
+
+    return FinishChecks();
+}
@@ -0,0 +1,236 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the capacity policy that decides when the light buffers of RtxdiResources are resized.
+// The counts of a streamed scene grow over many frames: the capacities must always fit the counts,
+// and the buffers must only be resized a logarithmic number of times. Low counts must shrink the
+// capacities only after the configured delay.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "RtxdiResourceCapacityPolicy.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static bool Fits(const RtxdiResourceCapacities& counts, const RtxdiResourceCapacities& capacities)
+{
+    return counts.emissiveMeshes <= capacities.emissiveMeshes
+        && counts.emissiveTriangles <= capacities.emissiveTriangles
+        && counts.primitiveLights <= capacities.primitiveLights
+        && counts.geometryInstances <= capacities.geometryInstances;
+}
+
+static bool IsMultiple(const RtxdiResourceCapacities& capacities, const RtxdiResourceCapacities& quanta)
+{
+    return capacities.emissiveMeshes % quanta.emissiveMeshes == 0
+        && capacities.emissiveTriangles % quanta.emissiveTriangles == 0
+        && capacities.primitiveLights % quanta.primitiveLights == 0
+        && capacities.geometryInstances % quanta.geometryInstances == 0;
+}
+
+static void CheckRounding()
+{
+    Check("Rounding: zero rounds up to one quantum", RtxdiResourceCapacityPolicy::RoundUp(0, 128) == 128, RtxdiResourceCapacityPolicy::RoundUp(0, 128));
+    Check("Rounding: a multiple of the quantum is unchanged", RtxdiResourceCapacityPolicy::RoundUp(1024, 1024) == 1024, RtxdiResourceCapacityPolicy::RoundUp(1024, 1024));
+    Check("Rounding: one past a multiple rounds up", RtxdiResourceCapacityPolicy::RoundUp(129, 128) == 256, RtxdiResourceCapacityPolicy::RoundUp(129, 128));
+    Check("Rounding: non power of two quantum", RtxdiResourceCapacityPolicy::RoundUp(101, 100) == 200, RtxdiResourceCapacityPolicy::RoundUp(101, 100));
+
+    RtxdiResourceCapacityPolicy policy;
+    RtxdiResourceCapacities counts;
+    counts.emissiveMeshes = 3;
+    counts.emissiveTriangles = 5000;
+    counts.primitiveLights = 0;
+    counts.geometryInstances = 300;
+    policy.Reset(counts);
+
+    const RtxdiResourceCapacities& capacities = policy.GetCapacities();
+    const bool exact = capacities.emissiveMeshes == 128
+        && capacities.emissiveTriangles == 5120
+        && capacities.primitiveLights == 128
+        && capacities.geometryInstances == 384;
+    Check("Rounding: reset rounds the counts up to the quanta", exact, capacities.emissiveTriangles);
+    Check("Rounding: the counts of the reset need no resize", !policy.Update(counts), policy.GetGrowCount());
+}
+
+static void CheckGrowth()
+{
+    RtxdiResourceCapacityPolicy policy;
+    RtxdiResourceCapacities counts;
+    counts.emissiveTriangles = 1000;
+    policy.Reset(counts);
+
+    counts.emissiveTriangles = 1025;
+    const bool resized = policy.Update(counts);
+    Check("Growth: one triangle over the capacity doubles it", resized && policy.GetCapacities().emissiveTriangles == 2048,
+        policy.GetCapacities().emissiveTriangles);
+    Check("Growth: the other capacities are unchanged", policy.GetCapacities().emissiveMeshes == 128 && policy.GetCapacities().primitiveLights == 128,
+        policy.GetCapacities().emissiveMeshes);
+
+    counts.emissiveTriangles = 100000;
+    policy.Update(counts);
+    Check("Growth: a large jump grows to the rounded count", policy.GetCapacities().emissiveTriangles == 100352,
+        policy.GetCapacities().emissiveTriangles);
+    Check("Growth: two grows counted", policy.GetGrowCount() == 2 && policy.GetShrinkCount() == 0, policy.GetGrowCount());
+}
+
+static void CheckStreaming(uint32_t streamedTriangles, uint32_t frames)
+{
+    // Triangles, meshes and instances stream in at a constant rate, primitive lights in bursts
+    RtxdiResourceCapacityParameters params;
+    RtxdiResourceCapacityPolicy policy;
+    policy.SetParameters(params);
+    policy.Reset(RtxdiResourceCapacities());
+
+    bool alwaysFits = true;
+    bool alwaysMultiple = true;
+    bool alwaysAtLeastDoubled = true;
+    uint32_t resizes = 0;
+
+    for (uint32_t frame = 0; frame <= frames; frame++)
+    {
+        RtxdiResourceCapacities counts;
+        counts.emissiveTriangles = uint32_t(uint64_t(streamedTriangles) * frame / frames);
+        counts.emissiveMeshes = counts.emissiveTriangles / 500;
+        counts.geometryInstances = counts.emissiveTriangles / 100;
+        counts.primitiveLights = (frame / 100) * 50;
+
+        const RtxdiResourceCapacities previous = policy.GetCapacities();
+        if (policy.Update(counts))
+        {
+            resizes++;
+            const RtxdiResourceCapacities& capacities = policy.GetCapacities();
+            alwaysAtLeastDoubled = alwaysAtLeastDoubled
+                && (capacities.emissiveTriangles == previous.emissiveTriangles || capacities.emissiveTriangles >= previous.emissiveTriangles * 2)
+                && (capacities.primitiveLights == previous.primitiveLights || capacities.primitiveLights >= previous.primitiveLights * 2);
+        }
+
+        alwaysFits = alwaysFits && Fits(counts, policy.GetCapacities());
+        alwaysMultiple = alwaysMultiple && IsMultiple(policy.GetCapacities(), params.quanta);
+    }
+
+    // Each capacity doubles at most log2(final / quantum) + 1 times, and the capacities may grow on different frames
+    const auto maxGrows = [](uint32_t count, uint32_t quantum) {
+        return uint32_t(std::ceil(std::log2(std::max(double(count) / quantum, 1.0)))) + 1;
+    };
+    const uint32_t resizeLimit = maxGrows(streamedTriangles, params.quanta.emissiveTriangles)
+        + maxGrows(streamedTriangles / 500, params.quanta.emissiveMeshes)
+        + maxGrows(streamedTriangles / 100, params.quanta.geometryInstances)
+        + maxGrows((frames / 100) * 50, params.quanta.primitiveLights);
+
+    printf("  %u triangles streamed over %u frames: %u resizes, final triangle capacity %u\n",
+        streamedTriangles, frames, resizes, policy.GetCapacities().emissiveTriangles);
+
+    Check("Streaming: the capacities always fit the counts", alwaysFits, 0);
+    Check("Streaming: the capacities are multiples of the quanta", alwaysMultiple, 0);
+    Check("Streaming: every growth at least doubles the capacity", alwaysAtLeastDoubled, 0);
+    Check("Streaming: the number of resizes is logarithmic", resizes <= resizeLimit, resizes);
+    Check("Streaming: nothing shrinks while streaming in", policy.GetShrinkCount() == 0, policy.GetShrinkCount());
+}
+
+static void CheckShrinking(uint32_t shrinkDelay)
+{
+    RtxdiResourceCapacityParameters params;
+    params.shrinkDelayFrames = shrinkDelay;
+
+    RtxdiResourceCapacityPolicy policy;
+    policy.SetParameters(params);
+
+    RtxdiResourceCapacities counts;
+    counts.emissiveTriangles = 64 * 1024;
+    policy.Reset(counts);
+
+    // Going below the threshold for fewer frames than the delay, then back up, doesn't shrink
+    counts.emissiveTriangles = 1000;
+    bool resizedWithinDelay = false;
+    for (uint32_t frame = 0; frame + 1 < shrinkDelay; frame++)
+        resizedWithinDelay = policy.Update(counts) || resizedWithinDelay;
+
+    counts.emissiveTriangles = 32 * 1024;
+    resizedWithinDelay = policy.Update(counts) || resizedWithinDelay;
+    counts.emissiveTriangles = 1000;
+    for (uint32_t frame = 0; frame + 1 < shrinkDelay; frame++)
+        resizedWithinDelay = policy.Update(counts) || resizedWithinDelay;
+
+    Check("Shrinking: no resize within the delay", !resizedWithinDelay && policy.GetCapacities().emissiveTriangles == 64 * 1024,
+        policy.GetCapacities().emissiveTriangles);
+
+    const bool shrunk = policy.Update(counts);
+    Check("Shrinking: the capacity halves after the delay", shrunk && policy.GetCapacities().emissiveTriangles == 32 * 1024,
+        policy.GetCapacities().emissiveTriangles);
+
+    // Keep the count low until the capacity stops changing
+    uint32_t frames = 0;
+    while (frames < shrinkDelay * 20)
+    {
+        policy.Update(counts);
+        frames++;
+    }
+    // 1000 triangles are above a quarter of 2048
+    Check("Shrinking: the capacity stops above the threshold", policy.GetCapacities().emissiveTriangles == 2048,
+        policy.GetCapacities().emissiveTriangles);
+    Check("Shrinking: one resize per halving", policy.GetShrinkCount() == 5, policy.GetShrinkCount());
+
+    // A count just below the threshold never shrinks the capacity below the count
+    counts.emissiveTriangles = 16 * 1024;
+    policy.Update(counts);
+    counts.emissiveTriangles = 4 * 1024 - 1;
+    for (uint32_t frame = 0; frame < shrinkDelay * 4; frame++)
+        policy.Update(counts);
+    Check("Shrinking: the capacity still fits the count", Fits(counts, policy.GetCapacities()), policy.GetCapacities().emissiveTriangles);
+
+    params.shrinkThreshold = 0.f;
+    RtxdiResourceCapacityPolicy fixedPolicy;
+    fixedPolicy.SetParameters(params);
+    counts.emissiveTriangles = 64 * 1024;
+    fixedPolicy.Reset(counts);
+    counts.emissiveTriangles = 0;
+    for (uint32_t frame = 0; frame < shrinkDelay * 4; frame++)
+        fixedPolicy.Update(counts);
+    Check("Shrinking: a zero threshold disables shrinking", fixedPolicy.GetShrinkCount() == 0, fixedPolicy.GetCapacities().emissiveTriangles);
+}
+
+int RunResourceCapacityCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the light buffer capacity policy of the RTXDI sample");
+
+    uint32_t triangles = 2000000;
+    uint32_t frames = 1000;
+    uint32_t shrinkDelay = 600;
+    bool help = false;
+
+    options.add_options()
+        ("triangles", "Number of emissive triangles streamed in, default is 2000000", value(triangles))
+        ("frames", "Number of frames over which the triangles stream in, default is 1000", value(frames))
+        ("shrink-delay", "Number of frames below the shrink threshold before shrinking, default is 600", value(shrinkDelay))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (triangles == 0 || frames == 0 || shrinkDelay < 2)
+    {
+        fprintf(stderr, "Invalid arguments: the triangle and frame counts must be positive, and the shrink delay at least 2\n");
+        return 2;
+    }
+
+    CheckRounding();
+    CheckGrowth();
+    CheckStreaming(triangles, frames);
+    CheckShrinking(shrinkDelay);
+
+    return FinishChecks();
+}
@@ -0,0 +1,218 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the skinned BLAS scheduler used by SampleScene::UpdateSkinnedMeshBLASes: the refit and rebuild sequence
+// of the two BLASes of a mesh, the update intervals of distant and off-screen meshes, and the per-frame budget
+// on a crowd of animated meshes, which must not starve any mesh.
+// Also prints the update cost of the crowd relative to rebuilding every mesh on every frame.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "SkinnedBlasScheduler.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+static void CheckSequence()
+{
+    SkinnedBlasSchedulerParameters parameters;
+    parameters.triangleBudget = 0;
+    parameters.refitsBetweenRebuilds = 5;
+
+    SkinnedBlasScheduler scheduler;
+    scheduler.SetParameters(parameters);
+    scheduler.Resize(1);
+
+    const uint32_t frames = 100;
+    bool firstIsRebuild = false;
+    bool updatedEveryFrame = true;
+    uint32_t maxConsecutiveRefits[2] = {};
+    uint32_t consecutiveRefits[2] = {};
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        scheduler.SetMesh(0, 1000, 1.f, true, true);
+        scheduler.Schedule();
+
+        const SkinnedBlasUpdate update = scheduler.GetUpdate(0);
+        const uint32_t blas = scheduler.GetMesh(0).currentBlas;
+
+        if (frame == 0)
+            firstIsRebuild = update == SkinnedBlasUpdate::Rebuild && blas == 1;
+
+        updatedEveryFrame &= update != SkinnedBlasUpdate::None;
+
+        if (update == SkinnedBlasUpdate::Refit)
+            consecutiveRefits[blas]++;
+        else
+            consecutiveRefits[blas] = 0;
+        maxConsecutiveRefits[blas] = std::max(maxConsecutiveRefits[blas], consecutiveRefits[blas]);
+    }
+
+    const SkinnedBlasMeshState& mesh = scheduler.GetMesh(0);
+    Check("First update rebuilds the second BLAS", firstIsRebuild, 0.0);
+    Check("Near visible mesh updated on every frame", updatedEveryFrame, double(mesh.refitCount + mesh.rebuildCount));
+    Check("BLASes alternate, refits per rebuild not exceeded", maxConsecutiveRefits[0] == parameters.refitsBetweenRebuilds
+        && maxConsecutiveRefits[1] == parameters.refitsBetweenRebuilds, double(maxConsecutiveRefits[0]));
+    Check("Refits dominate the updates", mesh.refitCount > mesh.rebuildCount * (parameters.refitsBetweenRebuilds - 1), double(mesh.refitCount));
+
+    // A static mesh is never updated
+    scheduler.Resize(2);
+    uint32_t staticUpdates = 0;
+    for (uint32_t frame = 0; frame < 10; frame++)
+    {
+        scheduler.SetMesh(0, 1000, 1.f, true, true);
+        scheduler.SetMesh(1, 1000, 1.f, true, false);
+        scheduler.Schedule();
+        staticUpdates += scheduler.GetUpdate(1) != SkinnedBlasUpdate::None;
+    }
+    Check("Static mesh not updated", staticUpdates == 0, double(staticUpdates));
+}
+
+static uint32_t CountUpdates(float distance, bool visible, uint32_t frames, const SkinnedBlasSchedulerParameters& parameters)
+{
+    SkinnedBlasScheduler scheduler;
+    scheduler.SetParameters(parameters);
+    scheduler.Resize(1);
+
+    uint32_t updates = 0;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        scheduler.SetMesh(0, 1000, distance, visible, true);
+        scheduler.Schedule();
+        updates += scheduler.GetUpdate(0) != SkinnedBlasUpdate::None;
+    }
+
+    return updates;
+}
+
+static void CheckIntervals()
+{
+    SkinnedBlasSchedulerParameters parameters;
+    parameters.triangleBudget = 0;
+    parameters.fullRateDistance = 10.f;
+    parameters.maxDistantInterval = 8;
+    parameters.offscreenInterval = 16;
+
+    const uint32_t frames = 160;
+    uint32_t updates = CountUpdates(35.f, true, frames, parameters);
+    Check("Mesh at 3.5x the full rate distance updated every 4 frames", updates == frames / 4, double(updates));
+
+    updates = CountUpdates(1000.f, true, frames, parameters);
+    Check("Interval of distant meshes limited", updates == frames / parameters.maxDistantInterval, double(updates));
+
+    updates = CountUpdates(1.f, false, frames, parameters);
+    Check("Off-screen mesh updated every 16 frames", updates == frames / parameters.offscreenInterval, double(updates));
+}
+
+static void CheckCrowd(uint32_t meshCount, uint32_t frames, uint32_t budget)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    std::vector<uint32_t> triangles(meshCount);
+    std::vector<float> distances(meshCount);
+    std::vector<bool> visible(meshCount);
+    uint32_t maxTriangles = 0;
+    for (uint32_t index = 0; index < meshCount; index++)
+    {
+        triangles[index] = 5000 + uint32_t(uniform(rng) * 20000.f);
+        distances[index] = uniform(rng) * 100.f;
+        visible[index] = uniform(rng) < 0.5f;
+        maxTriangles = std::max(maxTriangles, triangles[index]);
+    }
+
+    SkinnedBlasSchedulerParameters parameters;
+    parameters.triangleBudget = budget;
+
+    SkinnedBlasScheduler scheduler;
+    scheduler.SetParameters(parameters);
+    scheduler.Resize(meshCount);
+
+    double totalCost = 0.0;
+    double naiveCost = 0.0;
+    float maxFrameCost = 0.f;
+    uint32_t maxFramesSinceUpdate = 0;
+    uint32_t deferred = 0;
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        for (uint32_t index = 0; index < meshCount; index++)
+        {
+            scheduler.SetMesh(index, triangles[index], distances[index], visible[index], true);
+            naiveCost += triangles[index];
+        }
+
+        scheduler.Schedule();
+        totalCost += scheduler.GetScheduledCost();
+        maxFrameCost = std::max(maxFrameCost, scheduler.GetScheduledCost());
+        deferred += scheduler.GetDeferredCount();
+
+        // Skip the first frames, where all meshes are due at once
+        if (frame >= frames / 2)
+        {
+            for (uint32_t index = 0; index < meshCount; index++)
+                maxFramesSinceUpdate = std::max(maxFramesSinceUpdate, scheduler.GetMesh(index).framesSinceUpdate);
+        }
+    }
+
+    Check("Crowd: frame cost within the budget", maxFrameCost <= float(std::max(budget, maxTriangles)), maxFrameCost);
+    Check("Crowd: cost relative to rebuilding every frame", totalCost < naiveCost, totalCost / naiveCost);
+    Report("Crowd: deferred updates per frame", double(deferred) / frames);
+    Check("Crowd: no mesh starves, longest wait in frames", maxFramesSinceUpdate < frames / 2, double(maxFramesSinceUpdate));
+
+    // After the animation stops, the deferred updates drain
+    uint32_t drainFrames = 0;
+    while (scheduler.HasPendingUpdates() && drainFrames < frames)
+    {
+        for (uint32_t index = 0; index < meshCount; index++)
+            scheduler.SetMesh(index, triangles[index], distances[index], visible[index], false);
+        scheduler.Schedule();
+        drainFrames++;
+    }
+    Check("Crowd: pending updates applied after the animation stops", !scheduler.HasPendingUpdates(), double(drainFrames));
+}
+
+int RunSkinnedBlasCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the skinned BLAS update scheduler of the RTXDI sample");
+
+    uint32_t meshes = 500;
+    uint32_t frames = 200;
+    uint32_t budget = 1000000;
+    bool help = false;
+
+    options.add_options()
+        ("meshes", "Number of skinned meshes in the crowd, default is 500", value(meshes))
+        ("frames", "Number of simulated frames, default is 200", value(frames))
+        ("budget", "Triangle budget per frame, default is 1000000", value(budget))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (meshes == 0 || frames < 20)
+    {
+        fprintf(stderr, "Invalid arguments: at least 1 mesh and 20 frames are needed\n");
+        return 2;
+    }
+
+    CheckSequence();
+    CheckIntervals();
+    CheckCrowd(meshes, frames, budget);
+
+    return FinishChecks();
+}
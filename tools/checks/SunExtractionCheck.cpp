@@ -0,0 +1,219 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the sun extraction of EnvironmentSunExtraction.cpp on synthetic equirectangular maps.
+// For every map with a sun, the radiance integral of the residual map plus the extracted sun irradiance must match
+// the integral of the original map, the sun must be found in the right direction with the energy that was put into it,
+// and the residual map must no longer have a dominant peak. Maps without a sun must be left unchanged.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "EnvironmentSunExtraction.h"
+
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+#include "../common/EquirectMapping.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace donut::math;
+
+static float calcLuminance(float3 color)
+{
+    return dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+}
+
+static float3 equirectUVToDirection(float2 uv)
+{
+    double direction[3];
+    EquirectUVToDirection(uv.x, uv.y, direction);
+    return float3(float(direction[0]), float(direction[1]), float(direction[2]));
+}
+
+struct SyntheticSun
+{
+    // Position of the sun center, in UV space of the map
+    float2 uv = 0.f;
+
+    // Radiance of the sun disk and its angular radius in degrees
+    float3 radiance = 0.f;
+    float angularRadius = 0.f;
+};
+
+struct SyntheticMap
+{
+    std::vector<float4> pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // Energy of the sun above the sky behind it, integrated over the sun pixels
+    double3 sunExcess = 0.0;
+};
+
+// Builds a sky that gets brighter towards the zenith over a dim ground, with an optional sun disk on top
+static SyntheticMap CreateMap(uint32_t width, const SyntheticSun* sun)
+{
+    SyntheticMap map;
+    map.width = width;
+    map.height = width / 2;
+    map.pixels.resize(size_t(map.width) * map.height);
+
+    const float3 skyColor = float3(0.4f, 0.6f, 1.f);
+    const float3 groundColor = float3(0.1f, 0.08f, 0.05f);
+    const float3 sunDirection = sun ? equirectUVToDirection(sun->uv) : float3(0.f);
+    const float cosSunRadius = sun ? cosf(radians(sun->angularRadius)) : 1.f;
+
+    for (uint32_t y = 0; y < map.height; y++)
+    {
+        const float solidAngle = float(EquirectTexelSolidAngle(y, map.width, map.height));
+
+        for (uint32_t x = 0; x < map.width; x++)
+        {
+            const float3 direction = equirectUVToDirection(float2((float(x) + 0.5f) / float(map.width), (float(y) + 0.5f) / float(map.height)));
+
+            float3 color = (direction.y >= 0.f) ? skyColor * (0.3f + 0.7f * direction.y) : groundColor;
+
+            if (sun && dot(direction, sunDirection) >= cosSunRadius)
+            {
+                map.sunExcess += double3(sun->radiance) * double(solidAngle);
+                color = color + sun->radiance;
+            }
+
+            map.pixels[size_t(y) * map.width + x] = float4(color, 1.f);
+        }
+    }
+
+    return map;
+}
+
+static void CheckSunMap(const char* name, uint32_t width, const SyntheticSun& syntheticSun)
+{
+    SyntheticMap map = CreateMap(width, &syntheticSun);
+    const std::string prefix = std::string(name) + ": ";
+
+    const double3 originalIntegral = ComputeEnvironmentMapRadianceIntegral(map.pixels, map.width, map.height);
+
+    ExtractedSun sun;
+    const bool extracted = ExtractSunFromEnvironmentMap(map.pixels, map.width, map.height, SunExtractionParameters(), sun);
+    Check((prefix + "sun extracted").c_str(), extracted, extracted ? 1.0 : 0.0);
+    if (!extracted)
+        return;
+
+    // Energy conservation: residual + sun must match the original map in every channel
+    const double3 residualIntegral = ComputeEnvironmentMapRadianceIntegral(map.pixels, map.width, map.height);
+    const double3 sunIrradiance = double3(sun.color * sun.irradiance);
+    double maxEnergyError = 0.0;
+    for (int channel = 0; channel < 3; channel++)
+    {
+        const double conserved = residualIntegral[channel] + sunIrradiance[channel];
+        maxEnergyError = std::max(maxEnergyError, std::abs(conserved - originalIntegral[channel]) / originalIntegral[channel]);
+    }
+    Check((prefix + "relative energy error of residual + sun").c_str(), maxEnergyError <= 1e-4, maxEnergyError);
+
+    // The sun must carry the energy that was added above the sky, up to the sky gradient under the disk
+    const double expectedLuminance = dot(map.sunExcess, double3(0.2126, 0.7152, 0.0722));
+    const double sunEnergyRatio = double(sun.irradiance) / expectedLuminance;
+    Check((prefix + "extracted vs. synthetic sun irradiance").c_str(), std::abs(sunEnergyRatio - 1.0) <= 0.01, sunEnergyRatio);
+
+    // The direction must be within one pixel of the synthetic sun center
+    const float3 expectedDirection = equirectUVToDirection(syntheticSun.uv);
+    const float3 direction = GetExtractedSunDirection(sun, 0.f);
+    const float angularError = degrees(acosf(clamp(dot(direction, expectedDirection), -1.f, 1.f)));
+    const float pixelAngle = 360.f / float(map.width);
+    Check((prefix + "sun direction error, degrees").c_str(), angularError <= pixelAngle, angularError);
+
+    // The residual map must not have a dominant peak anymore
+    float peakLuminance = 0.f;
+    for (const float4& pixel : map.pixels)
+        peakLuminance = std::max(peakLuminance, calcLuminance(pixel.xyz()));
+    const float averageLuminance = float(dot(residualIntegral, double3(0.2126, 0.7152, 0.0722)) / (4.0 * PI_d));
+    const float peakToAverage = peakLuminance / averageLuminance;
+    Check((prefix + "residual peak to average luminance").c_str(),
+        peakToAverage < SunExtractionParameters().minPeakToAverageRatio, peakToAverage);
+}
+
+static void CheckOvercastMap(uint32_t width)
+{
+    SyntheticMap map = CreateMap(width, nullptr);
+    const std::vector<float4> original = map.pixels;
+
+    ExtractedSun sun;
+    const bool extracted = ExtractSunFromEnvironmentMap(map.pixels, map.width, map.height, SunExtractionParameters(), sun);
+    Check("Overcast: no sun extracted", !extracted, extracted ? 1.0 : 0.0);
+
+    const bool unchanged = memcmp(original.data(), map.pixels.data(), original.size() * sizeof(float4)) == 0;
+    Check("Overcast: map unchanged", unchanged, unchanged ? 1.0 : 0.0);
+}
+
+static void CheckUnpacking()
+{
+    // 1.0, 2.0, 0.5, 65504 (largest half), -1.0, the smallest subnormal, 0 and -2.0
+    const uint16_t halfPixels[8] = { 0x3c00, 0x4000, 0x3800, 0x7bff, 0xbc00, 0x0001, 0x0000, 0xc000 };
+    const float expected[8] = { 1.f, 2.f, 0.5f, 65504.f, -1.f, ldexpf(1.f, -24), 0.f, -2.f };
+
+    std::vector<float4> pixels;
+    const bool unpacked = UnpackEnvironmentMapPixels(halfPixels, sizeof(halfPixels), nvrhi::Format::RGBA16_FLOAT, 2, 1, pixels);
+
+    bool exact = unpacked && pixels.size() == 2;
+    for (uint32_t i = 0; exact && i < 8; i++)
+        exact = pixels[i / 4][i % 4] == expected[i];
+    Check("RGBA16_FLOAT pixels unpacked exactly", exact, exact ? 1.0 : 0.0);
+
+    const bool rejected = !UnpackEnvironmentMapPixels(halfPixels, sizeof(halfPixels), nvrhi::Format::UNKNOWN, 2, 1, pixels) && pixels.empty();
+    Check("Unsupported format rejected", rejected, rejected ? 1.0 : 0.0);
+}
+
+int RunSunExtractionCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks that the environment map sun extraction conserves energy");
+
+    uint32_t width = 1024;
+    bool help = false;
+
+    options.add_options()
+        ("width", "Width of the synthetic environment maps, default is 1024", value(width))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (width < 256 || (width % 2) != 0)
+    {
+        fprintf(stderr, "Invalid arguments: the width must be even and at least 256\n");
+        return 2;
+    }
+
+    SyntheticSun sun;
+    sun.uv = float2(0.3f, 1.f / 3.f);
+    sun.radiance = float3(50000.f, 45000.f, 35000.f);
+    sun.angularRadius = 1.5f;
+    CheckSunMap("Sun in the sky", width, sun);
+
+    // The sun disk wraps around the left and right edges of the map
+    sun.uv = float2(0.f, 0.4f);
+    CheckSunMap("Sun across the seam", width, sun);
+
+    // The sun disk covers a wide range of azimuths near the pole
+    sun.uv = float2(0.7f, 0.02f);
+    CheckSunMap("Sun near the zenith", width, sun);
+
+    CheckOvercastMap(width);
+    CheckUnpacking();
+
+    return FinishChecks();
+}
@@ -0,0 +1,460 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Checks the TLAS instance cache used by SampleScene::BuildTopLevelAccelStruct on a mock scene with static and
+// animated instances. Every frame, the cached instance buffer after the uploads of the dirty ranges must be identical
+// to the instance buffer rebuilt from scratch, and only the changed instances may be uploaded.
+// Also prints the CPU time of the full rebuild and the cached update.
+// The TLAS rebuild policy is checked on instances drifting away from their positions at the last build.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments.
+
+#include "TlasInstanceCache.h"
+#include "TlasRebuildPolicy.h"
+#include "../common/CheckOptions.h"
+#include "../common/CheckReport.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+// Stand-in for the scene graph: a mesh instance with a few geometries, some of them animated
+struct MockInstance
+{
+    float position[3] = {};
+    float angle = 0.f;
+    bool animated = false;
+    bool opaque = true;
+    bool alphaTested = false;
+    uint32_t firstMaterial = 0;
+    uint64_t blasDeviceAddress = 0;
+};
+
+struct MockScene
+{
+    std::vector<MockInstance> instances;
+    std::vector<bool> materialDoubleSided;
+    uint32_t geometriesPerInstance = 4;
+    bool structureChanged = true;
+    bool transformsChanged = true;
+};
+
+static MockScene CreateScene(size_t instanceCount, double animatedFraction, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    MockScene scene;
+    scene.materialDoubleSided.resize(64);
+    for (size_t material = 0; material < scene.materialDoubleSided.size(); material++)
+        scene.materialDoubleSided[material] = (material % 7) == 0;
+
+    scene.instances.resize(instanceCount);
+    for (size_t index = 0; index < instanceCount; index++)
+    {
+        MockInstance& instance = scene.instances[index];
+        instance.position[0] = uniform(rng) * 100.f;
+        instance.position[1] = uniform(rng) * 10.f;
+        instance.position[2] = uniform(rng) * 100.f;
+        instance.angle = uniform(rng) * 6.28f;
+        instance.animated = uniform(rng) < animatedFraction;
+        instance.opaque = uniform(rng) < 0.9f;
+        instance.alphaTested = !instance.opaque || uniform(rng) < 0.1f;
+        instance.firstMaterial = uint32_t(index % scene.materialDoubleSided.size());
+        instance.blasDeviceAddress = 0x10000 + (index % 1000) * 0x1000;
+    }
+
+    return scene;
+}
+
+static void GetTransform(const MockInstance& instance, float transform[12])
+{
+    // Rotation around Y and translation, in the row-major 3x4 layout of the instance descriptions
+    const float c = std::cos(instance.angle);
+    const float s = std::sin(instance.angle);
+    const float rows[12] = {
+        c, 0.f, s, instance.position[0],
+        0.f, 1.f, 0.f, instance.position[1],
+        -s, 0.f, c, instance.position[2] };
+    memcpy(transform, rows, sizeof(rows));
+}
+
+// Same work as the full loop in SampleScene::BuildTopLevelAccelStruct
+static nvrhi::rt::InstanceDesc CreateInstanceDesc(const MockScene& scene, size_t index)
+{
+    const MockInstance& instance = scene.instances[index];
+
+    nvrhi::rt::InstanceDesc desc;
+    desc.instanceMask = (instance.opaque ? 1 : 0) | (instance.alphaTested ? 2 : 0);
+
+    for (uint32_t geometry = 0; geometry < scene.geometriesPerInstance; geometry++)
+    {
+        if (scene.materialDoubleSided[(instance.firstMaterial + geometry) % scene.materialDoubleSided.size()])
+            desc.flags = nvrhi::rt::InstanceFlags::TriangleCullDisable;
+    }
+
+    GetTransform(instance, desc.transform);
+    desc.instanceID = uint32_t(index);
+    desc.blasDeviceAddress = instance.blasDeviceAddress;
+    return desc;
+}
+
+static void BuildAllInstances(const MockScene& scene, std::vector<nvrhi::rt::InstanceDesc>& instances)
+{
+    instances.resize(scene.instances.size());
+    for (size_t index = 0; index < scene.instances.size(); index++)
+        instances[index] = CreateInstanceDesc(scene, index);
+}
+
+// Same work as the cached path in SampleScene::BuildTopLevelAccelStruct, returns the number of uploaded instances
+static size_t UpdateCachedInstances(const MockScene& scene, bool materialsChanged, TlasInstanceCache& cache,
+    std::vector<nvrhi::rt::InstanceDesc>& gpuInstances, size_t maxGap)
+{
+    const bool refreshAll = scene.structureChanged || materialsChanged || cache.GetInstanceCount() != scene.instances.size();
+    cache.Resize(scene.instances.size());
+
+    if (refreshAll || scene.transformsChanged)
+    {
+        for (size_t index = 0; index < scene.instances.size(); index++)
+        {
+            if (refreshAll)
+            {
+                cache.SetInstance(index, CreateInstanceDesc(scene, index));
+                continue;
+            }
+
+            float transform[12];
+            GetTransform(scene.instances[index], transform);
+            cache.SetTransform(index, transform, scene.instances[index].blasDeviceAddress);
+        }
+    }
+
+    // The uploads, the GPU buffer is a copy of the cache after the writes
+    gpuInstances.resize(cache.GetInstanceCount());
+    size_t uploadedInstances = 0;
+    for (const TlasInstanceRange& range : cache.GetDirtyRanges(maxGap))
+    {
+        memcpy(&gpuInstances[range.first], &cache.GetInstance(range.first), range.count * sizeof(nvrhi::rt::InstanceDesc));
+        uploadedInstances += range.count;
+    }
+
+    cache.ClearDirty();
+    return uploadedInstances;
+}
+
+static void Animate(MockScene& scene, float time)
+{
+    for (MockInstance& instance : scene.instances)
+    {
+        if (instance.animated)
+        {
+            instance.angle += 0.01f;
+            instance.position[1] = std::sin(time + instance.position[0]);
+        }
+    }
+}
+
+static bool AreEqual(const std::vector<nvrhi::rt::InstanceDesc>& a, const std::vector<nvrhi::rt::InstanceDesc>& b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(nvrhi::rt::InstanceDesc)) == 0;
+}
+
+static void CheckRanges()
+{
+    TlasInstanceCache cache;
+    cache.Resize(20);
+    Check("Ranges: all instances are dirty after a resize", cache.GetDirtyCount() == 20, double(cache.GetDirtyCount()));
+    cache.ClearDirty();
+
+    float transform[12] = { 1.f, 0.f, 0.f, 5.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f };
+    for (size_t index : { 2, 3, 4, 8, 15 })
+        cache.SetTransform(index, transform, 0);
+
+    const auto ranges = cache.GetDirtyRanges(0);
+    const bool exact = ranges.size() == 3
+        && ranges[0].first == 2 && ranges[0].count == 3
+        && ranges[1].first == 8 && ranges[1].count == 1
+        && ranges[2].first == 15 && ranges[2].count == 1;
+    Check("Ranges: exact ranges without merging", exact, double(ranges.size()));
+
+    // The gaps are 3 and 6 clean instances
+    const auto merged = cache.GetDirtyRanges(3);
+    const bool mergedCorrectly = merged.size() == 2
+        && merged[0].first == 2 && merged[0].count == 7
+        && merged[1].first == 15 && merged[1].count == 1;
+    Check("Ranges: gaps of up to 3 instances are merged", mergedCorrectly, double(merged.size()));
+
+    Check("Ranges: setting the same transform again is not a change", !cache.SetTransform(2, transform, 0), 0);
+    Check("Ranges: a new BLAS address is a change", cache.SetTransform(2, transform, 0x1000), 1);
+    Check("Ranges: dirty count", cache.GetDirtyCount() == 5, double(cache.GetDirtyCount()));
+}
+
+static void CheckScene(size_t instanceCount, double animatedFraction, uint32_t frames, size_t maxGap)
+{
+    MockScene scene = CreateScene(instanceCount, animatedFraction, 7);
+
+    size_t animatedCount = 0;
+    for (const MockInstance& instance : scene.instances)
+        animatedCount += instance.animated ? 1 : 0;
+
+    TlasInstanceCache cache;
+    std::vector<nvrhi::rt::InstanceDesc> reference;
+    std::vector<nvrhi::rt::InstanceDesc> gpuInstances;
+
+    bool allFramesMatch = true;
+    bool uploadsMatchChanges = true;
+    bool staticFramesUploadNothing = true;
+    size_t firstFrameUploads = 0;
+    size_t uploadedInstances = 0;
+    double fullTime = 0.0;
+    double cachedTime = 0.0;
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        // Every 10th frame is static, like a paused animation
+        const bool staticFrame = frame > 0 && (frame % 10) == 0;
+        scene.transformsChanged = !staticFrame;
+        if (!staticFrame)
+            Animate(scene, float(frame) * 0.1f);
+
+        auto start = std::chrono::steady_clock::now();
+        BuildAllInstances(scene, reference);
+        fullTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        const size_t uploads = UpdateCachedInstances(scene, false, cache, gpuInstances, 0);
+        cachedTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        allFramesMatch = allFramesMatch && AreEqual(reference, gpuInstances);
+
+        if (frame == 0)
+            firstFrameUploads = uploads;
+        else if (staticFrame)
+            staticFramesUploadNothing = staticFramesUploadNothing && uploads == 0;
+        else
+        {
+            uploadsMatchChanges = uploadsMatchChanges && uploads == animatedCount;
+            uploadedInstances += uploads;
+        }
+
+        scene.structureChanged = false;
+    }
+
+    printf("  %zu instances, %zu animated: full rebuild %.3f ms/frame, cached update %.3f ms/frame\n",
+        instanceCount, animatedCount, fullTime / frames, cachedTime / frames);
+
+    Check("Scene: the first frame uploads all instances", firstFrameUploads == instanceCount, double(firstFrameUploads));
+    Check("Scene: the cached buffer matches the rebuild on every frame", allFramesMatch, frames);
+    Check("Scene: animated frames upload only the animated instances", uploadsMatchChanges, double(uploadedInstances));
+    Check("Scene: static frames upload nothing", staticFramesUploadNothing, 0);
+
+    // A material change refreshes the flags of all instances, but only the instances using the material change
+    scene.materialDoubleSided[0] = !scene.materialDoubleSided[0];
+    scene.transformsChanged = false;
+    size_t affectedCount = 0;
+    for (size_t index = 0; index < scene.instances.size(); index++)
+    {
+        const nvrhi::rt::InstanceDesc desc = CreateInstanceDesc(scene, index);
+        if (memcmp(&desc, &gpuInstances[index], sizeof(desc)) != 0)
+            affectedCount++;
+    }
+
+    const size_t materialUploads = UpdateCachedInstances(scene, true, cache, gpuInstances, 0);
+    BuildAllInstances(scene, reference);
+    Check("Scene: a material change uploads the affected instances", materialUploads == affectedCount && affectedCount != 0, double(materialUploads));
+    Check("Scene: the cached buffer matches the rebuild after the material change", AreEqual(reference, gpuInstances), 0);
+
+    // Merged ranges may upload unchanged instances, the result must be the same
+    scene.transformsChanged = true;
+    Animate(scene, 100.f);
+    const size_t mergedUploads = UpdateCachedInstances(scene, false, cache, gpuInstances, maxGap);
+    BuildAllInstances(scene, reference);
+    Check("Scene: merged ranges produce the same buffer", AreEqual(reference, gpuInstances) && mergedUploads >= animatedCount, double(mergedUploads));
+
+    // Removing instances changes the structure and refreshes everything
+    scene.instances.resize(instanceCount / 2);
+    const size_t resizeUploads = UpdateCachedInstances(scene, false, cache, gpuInstances, 0);
+    BuildAllInstances(scene, reference);
+    Check("Scene: a new instance count uploads all instances", resizeUploads == scene.instances.size() && AreEqual(reference, gpuInstances), double(resizeUploads));
+}
+
+static bool AreBoundsNear(const float a[3], const float b[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (std::abs(a[axis] - b[axis]) > 1e-5f)
+            return false;
+    }
+    return true;
+}
+
+static void CheckBounds()
+{
+    const float localMin[3] = { -1.f, -2.f, -3.f };
+    const float localMax[3] = { 1.f, 2.f, 3.f };
+
+    // 90 degrees around Y: x' = z, z' = -x, then translated by (10, 20, 30)
+    const float rotation[12] = {
+        0.f, 0.f, 1.f, 10.f,
+        0.f, 1.f, 0.f, 20.f,
+        -1.f, 0.f, 0.f, 30.f };
+
+    float worldMin[3];
+    float worldMax[3];
+    TlasRebuildPolicy::TransformBounds(localMin, localMax, rotation, worldMin, worldMax);
+
+    const float expectedMin[3] = { 7.f, 18.f, 29.f };
+    const float expectedMax[3] = { 13.f, 22.f, 31.f };
+    Check("Bounds: rotated and translated box", AreBoundsNear(worldMin, expectedMin) && AreBoundsNear(worldMax, expectedMax), worldMax[0]);
+
+    const double area = TlasRebuildPolicy::GetSurfaceArea(localMin, localMax);
+    Check("Bounds: surface area of a 2x4x6 box", area == 2.0 * (8.0 + 24.0 + 12.0), area);
+}
+
+static void GetTranslation(float x, float transform[12])
+{
+    const float translation[12] = {
+        1.f, 0.f, 0.f, x,
+        0.f, 1.f, 0.f, 0.f,
+        0.f, 0.f, 1.f, 0.f };
+    memcpy(transform, translation, sizeof(translation));
+}
+
+static void CheckRebuildPolicy(size_t instanceCount)
+{
+    const float localMin[3] = { -0.5f, -0.5f, -0.5f };
+    const float localMax[3] = { 0.5f, 0.5f, 0.5f };
+
+    TlasRebuildPolicyParameters params;
+    params.degradationThreshold = 1.5f;
+    params.minFramesBetweenRebuilds = 10;
+
+    TlasRebuildPolicy policy;
+    policy.SetParameters(params);
+    policy.Resize(instanceCount);
+
+    float transform[12];
+    for (size_t index = 0; index < instanceCount; index++)
+    {
+        GetTranslation(float(index) * 2.f, transform);
+        policy.SetInstanceBounds(index, localMin, localMax, transform);
+    }
+
+    Check("Policy: the first build is a rebuild", policy.ShouldRebuild(), 1);
+    policy.OnBuild(true);
+
+    // Static frames never degrade the tree
+    bool staticRebuilds = false;
+    for (uint32_t frame = 0; frame < 100; frame++)
+    {
+        staticRebuilds = staticRebuilds || policy.ShouldRebuild();
+        policy.OnBuild(false);
+    }
+    Check("Policy: static instances are never rebuilt", !staticRebuilds && policy.GetDegradation() == 1.0, policy.GetDegradation());
+
+    // A quarter of the instances drifts away at one box size per frame
+    policy.OnBuild(true);
+    const size_t movingCount = std::max<size_t>(instanceCount / 4, 1);
+    bool degradationGrows = true;
+    bool resetAfterRebuild = true;
+    uint32_t minInterval = ~0u;
+    uint32_t rebuilds = 0;
+    uint32_t framesSinceRebuild = 0;
+    double previousDegradation = 1.0;
+
+    for (uint32_t frame = 1; frame <= 200; frame++)
+    {
+        for (size_t index = 0; index < movingCount; index++)
+        {
+            GetTranslation(float(index) * 2.f + float(frame), transform);
+            policy.SetInstanceBounds(index, localMin, localMax, transform);
+        }
+
+        const double degradation = policy.GetDegradation();
+        degradationGrows = degradationGrows && degradation > previousDegradation;
+
+        const bool rebuild = policy.ShouldRebuild();
+        policy.OnBuild(rebuild);
+        framesSinceRebuild++;
+
+        if (rebuild)
+        {
+            rebuilds++;
+            minInterval = std::min(minInterval, framesSinceRebuild);
+            framesSinceRebuild = 0;
+            resetAfterRebuild = resetAfterRebuild && policy.GetDegradation() == 1.0;
+        }
+
+        previousDegradation = policy.GetDegradation();
+    }
+
+    Check("Policy: degradation grows with the motion", degradationGrows, previousDegradation);
+    Check("Policy: moving instances trigger rebuilds", rebuilds > 0, rebuilds);
+    Check("Policy: rebuilds respect the minimum interval", minInterval >= params.minFramesBetweenRebuilds, minInterval);
+    Check("Policy: degradation is 1 after a rebuild", resetAfterRebuild, 1);
+
+    // A unit box moved by d has a union area of 6 + 4d, so with a quarter of the boxes moving the degradation is 1 + d / 6,
+    // which crosses the threshold after 3 frames. The rebuilds happen as soon as the minimum number of refits is done.
+    Check("Policy: fast motion rebuilds at the minimum interval", minInterval == params.minFramesBetweenRebuilds + 1, minInterval);
+
+    params.degradationThreshold = 1000.f;
+    params.maxRefitFrames = 50;
+    policy.SetParameters(params);
+    uint32_t refitsBeforeRebuild = 0;
+    while (!policy.ShouldRebuild() && refitsBeforeRebuild < 1000)
+    {
+        policy.OnBuild(false);
+        refitsBeforeRebuild++;
+    }
+    Check("Policy: the refit limit forces a rebuild", policy.GetFramesSinceRebuild() == params.maxRefitFrames, policy.GetFramesSinceRebuild());
+
+    policy.OnBuild(true);
+    policy.Resize(instanceCount + 1);
+    Check("Policy: a new instance count forces a rebuild", policy.ShouldRebuild(), 1);
+}
+
+int RunTlasInstanceCheck(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Checks the TLAS instance cache of the RTXDI sample on a mock scene");
+
+    size_t instances = 100000;
+    double animated = 0.02;
+    uint32_t frames = 50;
+    size_t mergeGap = 16;
+    bool help = false;
+
+    options.add_options()
+        ("instances", "Number of instances in the mock scene, default is 100000", value(instances))
+        ("animated", "Fraction of the instances that are animated, default is 0.02", value(animated))
+        ("frames", "Number of simulated frames, default is 50", value(frames))
+        ("merge-gap", "Largest number of unchanged instances between merged upload ranges, default is 16", value(mergeGap))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    int exitCode = 0;
+    if (!ParseCheckOptions(options, argc, argv, help, exitCode))
+        return exitCode;
+
+    if (instances < 2 || frames < 11 || animated <= 0.0 || animated > 1.0)
+    {
+        fprintf(stderr, "Invalid arguments: at least 2 instances and 11 frames are needed, and the animated fraction must be in (0, 1]\n");
+        return 2;
+    }
+
+    CheckRanges();
+    CheckScene(instances, animated, frames, mergeGap);
+    CheckBounds();
+    CheckRebuildPolicy(std::min<size_t>(instances, 1000));
+
+    return FinishChecks();
+}
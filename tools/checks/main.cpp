@@ -0,0 +1,70 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// CPU checks of the RTXDI sample and SDK code that don't need a device: 'rtxdi-checks <check> [options]'.
+// Every check is registered with ctest by rtxdi_add_check in CMakeLists.txt, under the name rtxdi-<check>-check.
+// Exit codes: 0 - all checks passed, 1 - at least one check failed, 2 - invalid arguments or files.
+
+#include <cstdio>
+#include <cstring>
+
+int RunBenchmarkCompareCheck(int argc, char** argv);
+int RunEnvironmentPresamplingCheck(int argc, char** argv);
+int RunFrameTimeCheck(int argc, char** argv);
+int RunGpuMemoryCheck(int argc, char** argv);
+int RunImageMetricsCheck(int argc, char** argv);
+int RunLightStreamingCheck(int argc, char** argv);
+int RunLightTypeSelectionCheck(int argc, char** argv);
+int RunResourceCapacityCheck(int argc, char** argv);
+int RunSkinnedBlasCheck(int argc, char** argv);
+int RunSunExtractionCheck(int argc, char** argv);
+int RunTlasInstanceCheck(int argc, char** argv);
+
+struct CheckEntry
+{
+    const char* name;
+    int (*run)(int argc, char** argv);
+};
+
+// The names must match the rtxdi_add_check calls in CMakeLists.txt
+static const CheckEntry c_Checks[] = {
+    { "benchmark-compare", RunBenchmarkCompareCheck },
+    { "environment-presampling", RunEnvironmentPresamplingCheck },
+    { "frame-time", RunFrameTimeCheck },
+    { "gpu-memory", RunGpuMemoryCheck },
+    { "image-metrics", RunImageMetricsCheck },
+    { "light-streaming", RunLightStreamingCheck },
+    { "light-type-selection", RunLightTypeSelectionCheck },
+    { "resource-capacity", RunResourceCapacityCheck },
+    { "skinned-blas", RunSkinnedBlasCheck },
+    { "sun-extraction", RunSunExtractionCheck },
+    { "tlas-instance", RunTlasInstanceCheck },
+};
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2)
+    {
+        for (const CheckEntry& check : c_Checks)
+        {
+            // The check sees its own name as the program name, followed by the remaining arguments
+            if (strcmp(argv[1], check.name) == 0)
+                return check.run(argc - 1, argv + 1);
+        }
+
+        fprintf(stderr, "Unknown check '%s'\n", argv[1]);
+    }
+
+    fprintf(stderr, "Usage: %s <check> [options], '<check> --help' lists the options of a check. Checks:\n", argv[0]);
+    for (const CheckEntry& check : c_Checks)
+        fprintf(stderr, "  %s\n", check.name);
+
+    return 2;
+}
@@ -0,0 +1,39 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cxxopts.hpp>
+#include <cstdio>
+
+// Parses the command line of a check. Returns false when the check should exit right away with outExitCode,
+// which is 0 after printing the help message and 2 for invalid arguments.
+inline bool ParseCheckOptions(cxxopts::Options& options, int argc, char** argv, const bool& help, int& outExitCode)
+{
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        outExitCode = 2;
+        return false;
+    }
+
+    if (help)
+    {
+        printf("%s", options.help().c_str());
+        outExitCode = 0;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,58 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Result reporting shared by the CPU check tools. Every check prints one line, and the exit code of the tool
+// tells ctest whether all checks have passed: 0 if they did, 1 if any has failed. Invalid arguments exit with 2.
+
+inline uint32_t& GetFailedCheckCount()
+{
+    static uint32_t failedChecks = 0;
+    return failedChecks;
+}
+
+inline void Check(const char* name, bool passed, double value)
+{
+    printf("%-60s %14.6g  %s\n", name, value, passed ? "OK" : "FAILED");
+    if (!passed)
+        GetFailedCheckCount()++;
+}
+
+// Checks that a size or a count matches exactly, printing both values
+inline void CheckEqual(const char* name, uint64_t actual, uint64_t expected)
+{
+    const bool passed = actual == expected;
+    printf("%-60s %14llu %14llu  %s\n", name, (unsigned long long)actual, (unsigned long long)expected, passed ? "OK" : "FAILED");
+    if (!passed)
+        GetFailedCheckCount()++;
+}
+
+// Prints a measurement that is not checked, such as a time
+inline void Report(const char* name, double value)
+{
+    printf("%-60s %14.6g\n", name, value);
+}
+
+// Prints the number of failed checks and returns the exit code of the tool
+inline int FinishChecks()
+{
+    const uint32_t failedChecks = GetFailedCheckCount();
+    if (failedChecks != 0)
+    {
+        printf("%u checks failed\n", failedChecks);
+        return 1;
+    }
+
+    return 0;
+}
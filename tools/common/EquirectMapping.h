@@ -0,0 +1,43 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Equirectangular environment map mapping shared by the checks that build synthetic environment maps.
+
+constexpr double c_EquirectPi = 3.14159265358979323846;
+
+// Same mapping as equirectUVToDirection in HelperFunctions.hlsli, y is up
+inline void EquirectUVToDirection(double u, double v, double outDirection[3])
+{
+    const double azimuth = (u + 0.25) * (2.0 * c_EquirectPi);
+    const double elevation = (0.5 - v) * c_EquirectPi;
+    const double cosElevation = std::cos(elevation);
+
+    outDirection[0] = std::cos(azimuth) * cosElevation;
+    outDirection[1] = std::sin(elevation);
+    outDirection[2] = std::sin(azimuth) * cosElevation;
+}
+
+// Direction of the center of a texel
+inline void EquirectTexelDirection(uint32_t x, uint32_t y, uint32_t width, uint32_t height, double outDirection[3])
+{
+    EquirectUVToDirection((double(x) + 0.5) / double(width), (double(y) + 0.5) / double(height), outDirection);
+}
+
+// Solid angle of the texels in row y, they add up to 4 pi over the map
+inline double EquirectTexelSolidAngle(uint32_t y, uint32_t width, uint32_t height)
+{
+    const double elevation = (0.5 - (double(y) + 0.5) / double(height)) * c_EquirectPi;
+    return (2.0 * c_EquirectPi / double(width)) * (c_EquirectPi / double(height)) * std::cos(elevation);
+}
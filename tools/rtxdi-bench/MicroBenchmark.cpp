@@ -0,0 +1,209 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "MicroBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+BenchmarkRegistry& BenchmarkRegistry::Get()
+{
+    static BenchmarkRegistry registry;
+    return registry;
+}
+
+bool BenchmarkRegistry::Register(const char* name, BenchmarkFunction function, std::vector<int64_t> arguments)
+{
+    BenchmarkDefinition definition;
+    definition.name = name;
+    definition.function = std::move(function);
+    definition.arguments = std::move(arguments);
+    m_Benchmarks.push_back(std::move(definition));
+    return true;
+}
+
+static MicroBenchmarkResult RunBenchmark(const BenchmarkDefinition& definition, const std::string& name, int64_t argument, double minTimeSeconds)
+{
+    constexpr uint64_t maxIterations = 1'000'000'000;
+
+    MicroBenchmarkResult result;
+    result.name = name;
+
+    // Same strategy as Google Benchmark: grow the iteration count until the run is long enough,
+    // extrapolating from the previous run with some margin
+    uint64_t iterations = 1;
+    while (true)
+    {
+        BenchmarkState state(iterations, argument);
+
+        const std::clock_t cpuStart = std::clock();
+        const auto realStart = std::chrono::steady_clock::now();
+
+        definition.function(state);
+
+        const auto realEnd = std::chrono::steady_clock::now();
+        const std::clock_t cpuEnd = std::clock();
+
+        const double realSeconds = std::chrono::duration<double>(realEnd - realStart).count();
+        const double cpuSeconds = double(cpuEnd - cpuStart) / CLOCKS_PER_SEC;
+
+        if (realSeconds >= minTimeSeconds || iterations >= maxIterations)
+        {
+            result.label = state.GetLabel();
+            result.iterations = iterations;
+            result.realTimeNs = realSeconds * 1e9 / double(iterations);
+            result.cpuTimeNs = cpuSeconds * 1e9 / double(iterations);
+            if (state.GetItemsProcessed() > 0 && realSeconds > 0.0)
+                result.itemsPerSecond = double(state.GetItemsProcessed()) / realSeconds;
+            return result;
+        }
+
+        const double multiplier = (realSeconds > 0.0) ? std::min(10.0, minTimeSeconds * 1.4 / realSeconds) : 10.0;
+        iterations = std::min(maxIterations, std::max(iterations + 1, uint64_t(double(iterations) * multiplier)));
+    }
+}
+
+std::vector<MicroBenchmarkResult> RunBenchmarks(const std::string& filter, double minTimeSeconds, bool printProgress)
+{
+    std::vector<MicroBenchmarkResult> results;
+
+    auto run = [&](const BenchmarkDefinition& definition, const std::string& name, int64_t argument)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos)
+            return;
+
+        if (printProgress)
+        {
+            fprintf(stderr, "Running %s...\n", name.c_str());
+            fflush(stderr);
+        }
+
+        results.push_back(RunBenchmark(definition, name, argument, minTimeSeconds));
+    };
+
+    for (const BenchmarkDefinition& definition : BenchmarkRegistry::Get().GetBenchmarks())
+    {
+        if (definition.arguments.empty())
+            run(definition, definition.name, 0);
+
+        for (int64_t argument : definition.arguments)
+            run(definition, definition.name + "/" + std::to_string(argument), argument);
+    }
+
+    return results;
+}
+
+std::string FormatBenchmarkResultsText(const std::vector<MicroBenchmarkResult>& results)
+{
+    size_t nameWidth = 9;
+    for (const auto& result : results)
+        nameWidth = std::max(nameWidth, result.name.size());
+
+    std::stringstream ss;
+    char line[512];
+
+    snprintf(line, sizeof(line), "%-*s %15s %15s %12s %15s\n", int(nameWidth), "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Items/s");
+    ss << line;
+    ss << std::string(nameWidth + 61, '-') << "\n";
+
+    for (const auto& result : results)
+    {
+        snprintf(line, sizeof(line), "%-*s %15.1f %15.1f %12llu ", int(nameWidth), result.name.c_str(),
+            result.realTimeNs, result.cpuTimeNs, (unsigned long long)result.iterations);
+        ss << line;
+
+        if (result.itemsPerSecond > 0.0)
+        {
+            snprintf(line, sizeof(line), "%15.4g", result.itemsPerSecond);
+            ss << line;
+        }
+        else
+            ss << std::string(15, ' ');
+
+        if (!result.label.empty())
+            ss << " " << result.label;
+
+        ss << "\n";
+    }
+
+    return ss.str();
+}
+
+static std::string EscapeJsonString(const std::string& s)
+{
+    std::string escaped;
+    escaped.reserve(s.size());
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            escaped.push_back('\\');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+bool SaveBenchmarkResultsJson(const std::string& fileName, const std::vector<MicroBenchmarkResult>& results)
+{
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        fprintf(stderr, "Cannot open file '%s' for writing\n", fileName.c_str());
+        return false;
+    }
+
+    char date[64] = {};
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+
+    // Field names follow the Google Benchmark JSON output
+    file << "{" << std::endl;
+    file << "  \"context\": {" << std::endl;
+    file << "    \"date\": \"" << date << "\"," << std::endl;
+    file << "    \"executable\": \"rtxdi-bench\"," << std::endl;
+    file << "    \"num_cpus\": " << std::thread::hardware_concurrency() << "," << std::endl;
+    file << "    \"library_build_type\": \"" << buildType << "\"" << std::endl;
+    file << "  }," << std::endl;
+
+    file.precision(6);
+    file << "  \"benchmarks\": [" << std::endl;
+    for (size_t index = 0; index < results.size(); index++)
+    {
+        const MicroBenchmarkResult& result = results[index];
+
+        file << "    {" << std::endl;
+        file << "      \"name\": \"" << EscapeJsonString(result.name) << "\"," << std::endl;
+        file << "      \"run_name\": \"" << EscapeJsonString(result.name) << "\"," << std::endl;
+        file << "      \"run_type\": \"iteration\"," << std::endl;
+        file << "      \"iterations\": " << result.iterations << "," << std::endl;
+        file << "      \"real_time\": " << std::fixed << result.realTimeNs << "," << std::endl;
+        file << "      \"cpu_time\": " << std::fixed << result.cpuTimeNs << "," << std::endl;
+        if (result.itemsPerSecond > 0.0)
+            file << "      \"items_per_second\": " << std::scientific << result.itemsPerSecond << "," << std::endl;
+        if (!result.label.empty())
+            file << "      \"label\": \"" << EscapeJsonString(result.label) << "\"," << std::endl;
+        file << "      \"time_unit\": \"ns\"" << std::endl;
+        file << "    }" << (index + 1 < results.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl;
+    file << "}" << std::endl;
+
+    return file.good();
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A minimal micro-benchmark harness modeled after Google Benchmark.
+// Benchmarks are registered with RTXDI_BENCHMARK and measure the body of a 'while (state.KeepRunning())' loop.
+// The number of iterations is scaled until the loop runs for at least the minimum time.
+// Results are written in the Google Benchmark JSON format so that the existing tools and dashboards can read them.
+
+class BenchmarkState
+{
+private:
+    uint64_t m_Iterations;
+    uint64_t m_RemainingIterations;
+    int64_t m_Argument;
+    int64_t m_ItemsProcessed = 0;
+    std::string m_Label;
+
+public:
+    BenchmarkState(uint64_t iterations, int64_t argument)
+        : m_Iterations(iterations)
+        , m_RemainingIterations(iterations)
+        , m_Argument(argument)
+    { }
+
+    bool KeepRunning()
+    {
+        if (m_RemainingIterations == 0)
+            return false;
+        --m_RemainingIterations;
+        return true;
+    }
+
+    [[nodiscard]] uint64_t GetIterations() const { return m_Iterations; }
+    [[nodiscard]] int64_t GetArgument() const { return m_Argument; }
+    [[nodiscard]] int64_t GetItemsProcessed() const { return m_ItemsProcessed; }
+    [[nodiscard]] const std::string& GetLabel() const { return m_Label; }
+
+    // Items per second are reported when this is set, usually to iterations * items per iteration
+    void SetItemsProcessed(int64_t items) { m_ItemsProcessed = items; }
+    void SetLabel(const std::string& label) { m_Label = label; }
+};
+
+typedef std::function<void(BenchmarkState&)> BenchmarkFunction;
+
+struct BenchmarkDefinition
+{
+    std::string name;
+    BenchmarkFunction function;
+
+    // The benchmark runs once per argument, with the argument appended to its name: "name/argument".
+    // No arguments means a single run without the suffix.
+    std::vector<int64_t> arguments;
+};
+
+struct MicroBenchmarkResult
+{
+    std::string name;
+    std::string label;
+    uint64_t iterations = 0;
+    double realTimeNs = 0.0; // per iteration
+    double cpuTimeNs = 0.0;  // per iteration
+    double itemsPerSecond = 0.0;
+};
+
+class BenchmarkRegistry
+{
+private:
+    std::deque<BenchmarkDefinition> m_Benchmarks;
+
+public:
+    static BenchmarkRegistry& Get();
+
+    bool Register(const char* name, BenchmarkFunction function, std::vector<int64_t> arguments = {});
+
+    [[nodiscard]] const std::deque<BenchmarkDefinition>& GetBenchmarks() const { return m_Benchmarks; }
+};
+
+// Makes the compiler assume that the value is used, so that the computation producing it is not optimized away
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+// Runs all benchmarks whose full name contains the filter string, or all benchmarks if the filter is empty
+std::vector<MicroBenchmarkResult> RunBenchmarks(const std::string& filter, double minTimeSeconds, bool printProgress);
+
+std::string FormatBenchmarkResultsText(const std::vector<MicroBenchmarkResult>& results);
+bool SaveBenchmarkResultsJson(const std::string& fileName, const std::vector<MicroBenchmarkResult>& results);
+
+#define RTXDI_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define RTXDI_BENCHMARK_CONCAT(a, b) RTXDI_BENCHMARK_CONCAT_IMPL(a, b)
+
+// Registers a benchmark function at static initialization time
+#define RTXDI_BENCHMARK(function) \
+    static const bool RTXDI_BENCHMARK_CONCAT(g_Benchmark_, __LINE__) = BenchmarkRegistry::Get().Register(#function, function)
+
+// Registers a benchmark function that runs once per argument: RTXDI_BENCHMARK_ARGS(MyFunction, 16, 256)
+#define RTXDI_BENCHMARK_ARGS(function, ...) \
+    static const bool RTXDI_BENCHMARK_CONCAT(g_Benchmark_, __LINE__) = BenchmarkRegistry::Get().Register(#function, function, { __VA_ARGS__ })
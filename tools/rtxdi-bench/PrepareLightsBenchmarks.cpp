@@ -0,0 +1,213 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Benchmarks for the CPU side of PrepareLightsPass, running on a synthetic scene graph.
+// The scene graph only holds the CPU-side descriptions of meshes and materials, no device is created.
+
+#include "MicroBenchmark.h"
+#include "StressScene.h"
+
+#include "PrepareLightsPass.h"
+#include "SampleScene.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <iterator>
+
+using namespace donut::math;
+#include "../../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+
+static std::shared_ptr<SceneGraph> CreateSingleLightScene(const std::shared_ptr<Light>& light)
+{
+    auto sceneGraph = std::make_shared<SceneGraph>();
+    sceneGraph->SetRootNode(std::make_shared<SceneGraphNode>());
+    AttachSyntheticLight(*sceneGraph, light, double3(1.0, 2.0, 3.0));
+    sceneGraph->Refresh(0);
+    return sceneGraph;
+}
+
+// Creates a grid of mesh instances and primitive lights. Every mesh has one emissive and one non-emissive
+// geometry, and the instances cycle through a few meshes with different triangle counts, like a typical
+// level with many copies of the same props. The primitive lights cycle through the local light types.
+static std::shared_ptr<SceneGraph> CreateSyntheticScene(uint32_t numInstances, uint32_t numPrimitiveLights,
+    std::vector<std::shared_ptr<Light>>& outLights)
+{
+    auto sceneGraph = std::make_shared<SceneGraph>();
+    sceneGraph->SetRootNode(std::make_shared<SceneGraphNode>());
+
+    auto emissiveMaterial = std::make_shared<Material>();
+    emissiveMaterial->name = "Emissive";
+    emissiveMaterial->emissiveColor = float3(1.f, 0.8f, 0.6f);
+    emissiveMaterial->emissiveIntensity = 5.f;
+
+    auto opaqueMaterial = std::make_shared<Material>();
+    opaqueMaterial->name = "Opaque";
+
+    constexpr uint32_t numMeshes = 8;
+    std::vector<std::shared_ptr<MeshInfo>> meshes;
+    for (uint32_t meshIndex = 0; meshIndex < numMeshes; meshIndex++)
+    {
+        auto mesh = std::make_shared<SampleMesh>();
+        mesh->name = "Mesh" + std::to_string(meshIndex);
+        mesh->objectSpaceBounds = box3(float3(-1.f), float3(1.f));
+
+        for (const auto& material : { emissiveMaterial, opaqueMaterial })
+        {
+            auto geometry = std::make_shared<MeshGeometry>();
+            geometry->material = material;
+            geometry->numIndices = 3 * (16u << meshIndex);
+            geometry->numVertices = geometry->numIndices;
+            geometry->indexOffsetInMesh = mesh->totalIndices;
+            geometry->vertexOffsetInMesh = mesh->totalVertices;
+            geometry->objectSpaceBounds = mesh->objectSpaceBounds;
+            mesh->totalIndices += geometry->numIndices;
+            mesh->totalVertices += geometry->numVertices;
+            mesh->geometries.push_back(geometry);
+        }
+
+        meshes.push_back(mesh);
+    }
+
+    const uint32_t gridSize = uint32_t(ceilf(sqrtf(float(numInstances))));
+
+    for (uint32_t instanceIndex = 0; instanceIndex < numInstances; instanceIndex++)
+    {
+        auto node = std::make_shared<SceneGraphNode>();
+        node->SetTranslation(double3(double(instanceIndex % gridSize) * 4.0, 0.0, double(instanceIndex / gridSize) * 4.0));
+        sceneGraph->Attach(sceneGraph->GetRootNode(), node);
+        sceneGraph->AttachLeafNode(node, std::make_shared<MeshInstance>(meshes[instanceIndex % numMeshes]));
+    }
+
+    // Skip the infinite lights, there is at most one of each in a scene
+    constexpr uint32_t localLightTypes[] = {
+        SyntheticLightType_Point, SyntheticLightType_Sphere, SyntheticLightType_Spot, SyntheticLightType_SpotProfile,
+        SyntheticLightType_Cylinder, SyntheticLightType_Disk, SyntheticLightType_Rect
+    };
+
+    outLights.clear();
+    for (uint32_t lightIndex = 0; lightIndex < numPrimitiveLights; lightIndex++)
+    {
+        auto light = CreateSyntheticLight(localLightTypes[lightIndex % std::size(localLightTypes)]);
+        AttachSyntheticLight(*sceneGraph, light, double3(double(lightIndex % gridSize) * 4.0, 3.0, double(lightIndex / gridSize) * 4.0));
+        outLights.push_back(light);
+    }
+
+    for (uint32_t type : { SyntheticLightType_Directional, SyntheticLightType_Environment })
+    {
+        auto light = CreateSyntheticLight(type);
+        AttachSyntheticLight(*sceneGraph, light, double3(0.0));
+        outLights.push_back(light);
+    }
+
+    sceneGraph->Refresh(0);
+
+    return sceneGraph;
+}
+
+// Argument is the light type, see SyntheticLightType
+static void PrepareLights_ConvertLight(BenchmarkState& state)
+{
+    const uint32_t type = uint32_t(state.GetArgument());
+    const auto light = CreateSyntheticLight(type);
+    const auto sceneGraph = CreateSingleLightScene(light);
+
+    while (state.KeepRunning())
+    {
+        PolymorphicLightInfo polymorphic = {};
+        ConvertLight(*light, polymorphic, true);
+        DoNotOptimize(polymorphic);
+    }
+
+    state.SetLabel(g_SyntheticLightTypeNames[type]);
+}
+
+static void PrepareLights_GetLightPower(BenchmarkState& state)
+{
+    auto sceneGraph = std::make_shared<SceneGraph>();
+    sceneGraph->SetRootNode(std::make_shared<SceneGraphNode>());
+
+    std::vector<std::shared_ptr<Light>> lights;
+    for (uint32_t type = 0; type < SyntheticLightType_Count; type++)
+    {
+        lights.push_back(CreateSyntheticLight(type));
+        AttachSyntheticLight(*sceneGraph, lights.back(), double3(double(type), 0.0, 0.0));
+    }
+    sceneGraph->Refresh(0);
+
+    while (state.KeepRunning())
+    {
+        for (const auto& light : lights)
+        {
+            float power = GetLightPower(*light, 100.f, 3.f);
+            DoNotOptimize(power);
+        }
+    }
+
+    state.SetItemsProcessed(int64_t(state.GetIterations() * lights.size()));
+}
+
+// Argument is the number of mesh instances, with one primitive light per 10 instances
+static void PrepareLights_BuildTasks(BenchmarkState& state)
+{
+    const uint32_t numInstances = uint32_t(state.GetArgument());
+
+    std::vector<std::shared_ptr<Light>> lights;
+    const auto sceneGraph = CreateSyntheticScene(numInstances, numInstances / 10, lights);
+
+    PrepareLightsTaskBuilder taskBuilder;
+    std::vector<PrepareLightsTask> tasks;
+    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    std::vector<uint32_t> geometryInstanceToLight;
+    rtxdi::FrameParameters frameParameters;
+
+    // The first frame fills the offset maps, measure the steady state like in the sample
+    uint32_t numLights = taskBuilder.BuildTasks(*sceneGraph, lights, true, 3.f,
+        tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+
+    while (state.KeepRunning())
+    {
+        numLights = taskBuilder.BuildTasks(*sceneGraph, lights, true, 3.f,
+            tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+        DoNotOptimize(tasks.data());
+        DoNotOptimize(primitiveLightInfos.data());
+        DoNotOptimize(geometryInstanceToLight.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.GetIterations() * tasks.size()));
+    state.SetLabel(std::to_string(tasks.size()) + " tasks, " + std::to_string(numLights) + " lights");
+}
+
+// Argument is the number of mesh instances, like in PrepareLights_BuildTasks.
+// This is the cost of the light preparation on frames where the scene has changed but the lighting hasn't,
+// e.g. when only opaque geometry moves. Frames without scene changes don't hash the scene at all.
+static void PrepareLights_UpdateLightingEpoch(BenchmarkState& state)
+{
+    const uint32_t numInstances = uint32_t(state.GetArgument());
+
+    std::vector<std::shared_ptr<Light>> lights;
+    const auto sceneGraph = CreateSyntheticScene(numInstances, numInstances / 10, lights);
+
+    PrepareLightsTaskBuilder taskBuilder;
+    taskBuilder.UpdateLightingEpoch(*sceneGraph, lights, true, 3.f, true, false);
+
+    while (state.KeepRunning())
+    {
+        bool changed = taskBuilder.UpdateLightingEpoch(*sceneGraph, lights, true, 3.f, true, false);
+        DoNotOptimize(changed);
+    }
+
+    state.SetItemsProcessed(int64_t(state.GetIterations() * sceneGraph->GetMeshInstances().size()));
+}
+
+RTXDI_BENCHMARK_ARGS(PrepareLights_ConvertLight, 0, 1, 2, 3, 4, 5, 6, 7, 8);
+RTXDI_BENCHMARK(PrepareLights_GetLightPower);
+RTXDI_BENCHMARK_ARGS(PrepareLights_BuildTasks, 1000, 10000, 100000);
+RTXDI_BENCHMARK_ARGS(PrepareLights_UpdateLightingEpoch, 1000, 10000, 100000);
@@ -0,0 +1,116 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Benchmarks for the host side of the RTXDI SDK, see rtxdi-sdk/src/RTXDI.cpp
+
+#include "MicroBenchmark.h"
+
+#include <rtxdi/RTXDI.h>
+
+#include <string>
+#include <vector>
+
+static rtxdi::ContextParameters GetContextParameters(rtxdi::ReGIRMode regirMode)
+{
+    // Same defaults as the sample at 1080p
+    rtxdi::ContextParameters params;
+    params.RenderWidth = 1920;
+    params.RenderHeight = 1080;
+    params.ReGIR.Mode = regirMode;
+    return params;
+}
+
+static void ContextConstruction(BenchmarkState& state, rtxdi::ReGIRMode regirMode)
+{
+    const rtxdi::ContextParameters params = GetContextParameters(regirMode);
+
+    while (state.KeepRunning())
+    {
+        rtxdi::Context context(params);
+        DoNotOptimize(context.GetReGIRLightSlotCount());
+    }
+}
+
+static void Context_Construction_ReGIRDisabled(BenchmarkState& state)
+{
+    ContextConstruction(state, rtxdi::ReGIRMode::Disabled);
+}
+
+static void Context_Construction_ReGIRGrid(BenchmarkState& state)
+{
+    ContextConstruction(state, rtxdi::ReGIRMode::Grid);
+}
+
+static void Context_Construction_ReGIROnion(BenchmarkState& state)
+{
+    ContextConstruction(state, rtxdi::ReGIRMode::Onion);
+}
+
+static void Context_FillRuntimeParameters(BenchmarkState& state)
+{
+    const rtxdi::Context context(GetContextParameters(rtxdi::ReGIRMode::Onion));
+
+    rtxdi::FrameParameters frame;
+    frame.numLocalLights = 100000;
+    frame.numInfiniteLights = 2;
+    frame.firstInfiniteLight = frame.numLocalLights;
+    frame.environmentLightPresent = true;
+    frame.environmentLightIndex = frame.firstInfiniteLight + frame.numInfiniteLights;
+    frame.enableLocalLightImportanceSampling = true;
+
+    RTXDI_ResamplingRuntimeParameters runtimeParams = {};
+
+    while (state.KeepRunning())
+    {
+        context.FillRuntimeParameters(runtimeParams, frame);
+        DoNotOptimize(runtimeParams);
+        frame.frameIndex++;
+    }
+}
+
+static void Context_FillNeighborOffsetBuffer(BenchmarkState& state)
+{
+    rtxdi::ContextParameters params = GetContextParameters(rtxdi::ReGIRMode::Disabled);
+    params.NeighborOffsetCount = uint32_t(state.GetArgument());
+    const rtxdi::Context context(params);
+
+    std::vector<uint8_t> offsets(params.NeighborOffsetCount * 2);
+
+    while (state.KeepRunning())
+    {
+        context.FillNeighborOffsetBuffer(offsets.data());
+        DoNotOptimize(offsets.data());
+    }
+
+    state.SetItemsProcessed(int64_t(state.GetIterations()) * params.NeighborOffsetCount);
+}
+
+static void PdfTextureSize(BenchmarkState& state)
+{
+    uint32_t maxItems = uint32_t(state.GetArgument());
+    uint32_t width = 0, height = 0, mipLevels = 0;
+
+    while (state.KeepRunning())
+    {
+        rtxdi::ComputePdfTextureSize(maxItems, width, height, mipLevels);
+        DoNotOptimize(width);
+        DoNotOptimize(height);
+        DoNotOptimize(mipLevels);
+    }
+
+    state.SetLabel(std::to_string(width) + "x" + std::to_string(height) + ", " + std::to_string(mipLevels) + " mips");
+}
+
+RTXDI_BENCHMARK(Context_Construction_ReGIRDisabled);
+RTXDI_BENCHMARK(Context_Construction_ReGIRGrid);
+RTXDI_BENCHMARK(Context_Construction_ReGIROnion);
+RTXDI_BENCHMARK(Context_FillRuntimeParameters);
+RTXDI_BENCHMARK_ARGS(Context_FillNeighborOffsetBuffer, 1024, 8192, 65536);
+RTXDI_BENCHMARK_ARGS(PdfTextureSize, 1000, 100000, 1000000, 10000000);
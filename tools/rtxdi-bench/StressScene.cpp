@@ -0,0 +1,538 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "StressScene.h"
+
+#include "PrepareLightsPass.h"
+#include "RtxdiResourceCapacityPolicy.h"
+#include "SampleScene.h"
+#include "../common/CheckReport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+using namespace donut::math;
+#include "../../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+
+const char* g_SyntheticLightTypeNames[SyntheticLightType_Count] = {
+    "Point", "Sphere", "Spot", "SpotProfile", "Directional", "Environment", "Cylinder", "Disk", "Rect"
+};
+
+// Names accepted by ParseStressLightCounts, in the same order
+static const char* g_StressLightTypeNames[SyntheticLightType_Count] = {
+    "point", "sphere", "spot", "spot-profile", "directional", "environment", "cylinder", "disk", "rect"
+};
+
+std::shared_ptr<Light> CreateSyntheticLight(uint32_t type)
+{
+    switch (type)
+    {
+    case SyntheticLightType_Point: {
+        auto point = std::make_shared<PointLight>();
+        point->intensity = 10.f;
+        return point;
+    }
+    case SyntheticLightType_Sphere: {
+        auto sphere = std::make_shared<PointLight>();
+        sphere->intensity = 10.f;
+        sphere->radius = 0.1f;
+        return sphere;
+    }
+    case SyntheticLightType_Spot: {
+        auto spot = std::make_shared<SpotLight>();
+        spot->intensity = 10.f;
+        spot->radius = 0.05f;
+        spot->innerAngle = 20.f;
+        spot->outerAngle = 30.f;
+        return spot;
+    }
+    case SyntheticLightType_SpotProfile: {
+        auto spot = std::make_shared<SpotLightWithProfile>();
+        spot->intensity = 10.f;
+        spot->innerAngle = 20.f;
+        spot->outerAngle = 30.f;
+        spot->profileTextureIndex = 0;
+        return spot;
+    }
+    case SyntheticLightType_Directional: {
+        auto directional = std::make_shared<DirectionalLight>();
+        directional->irradiance = 2.f;
+        directional->angularSize = 0.53f;
+        return directional;
+    }
+    case SyntheticLightType_Environment: {
+        auto environment = std::make_shared<EnvironmentLight>();
+        environment->textureIndex = 0;
+        environment->textureSize = uint2(2048, 1024);
+        return environment;
+    }
+    case SyntheticLightType_Cylinder:
+        return std::make_shared<CylinderLight>();
+    case SyntheticLightType_Disk:
+        return std::make_shared<DiskLight>();
+    default:
+        return std::make_shared<RectLight>();
+    }
+}
+
+std::shared_ptr<SceneGraphNode> AttachSyntheticLight(SceneGraph& sceneGraph, const std::shared_ptr<Light>& light, const double3& position)
+{
+    auto node = std::make_shared<SceneGraphNode>();
+    node->SetTranslation(position);
+    sceneGraph.Attach(sceneGraph.GetRootNode(), node);
+    sceneGraph.AttachLeafNode(node, light);
+    return node;
+}
+
+bool ParseStressLightCounts(const std::string& text, StressSceneParameters& parameters, std::string& error)
+{
+    std::fill(std::begin(parameters.lightCounts), std::end(parameters.lightCounts), 0u);
+
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        const size_t separator = item.find('=');
+        const std::string name = item.substr(0, separator);
+        const auto found = std::find_if(std::begin(g_StressLightTypeNames), std::end(g_StressLightTypeNames),
+            [&name](const char* typeName) { return name == typeName; });
+
+        if (separator == std::string::npos || found == std::end(g_StressLightTypeNames))
+        {
+            error = "Invalid light count '" + item + "', expected type=count with the type one of: point, sphere, "
+                "spot, spot-profile, directional, environment, cylinder, disk, rect";
+            return false;
+        }
+
+        char* end = nullptr;
+        const unsigned long count = strtoul(item.c_str() + separator + 1, &end, 10);
+        if (*end != 0 || end == item.c_str() + separator + 1)
+        {
+            error = "Invalid light count '" + item + "'";
+            return false;
+        }
+
+        parameters.lightCounts[found - std::begin(g_StressLightTypeNames)] = uint32_t(count);
+    }
+
+    if (parameters.lightCounts[SyntheticLightType_Environment] > 1)
+    {
+        error = "At most one environment light is supported";
+        return false;
+    }
+
+    return true;
+}
+
+StressScene CreateStressScene(const StressSceneParameters& parameters)
+{
+    std::mt19937 rng(parameters.seed);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    StressScene scene;
+    scene.sceneGraph = std::make_shared<SceneGraph>();
+    scene.sceneGraph->SetRootNode(std::make_shared<SceneGraphNode>());
+
+    auto randomPosition = [&](double height)
+    {
+        return double3(double(uniform(rng) * parameters.extent), height, double(uniform(rng) * parameters.extent));
+    };
+
+    constexpr uint32_t numMaterials = 4;
+    std::vector<std::shared_ptr<Material>> emissiveMaterials;
+    for (uint32_t materialIndex = 0; materialIndex < numMaterials; materialIndex++)
+    {
+        auto material = std::make_shared<Material>();
+        material->name = "Emissive" + std::to_string(materialIndex);
+        material->emissiveColor = float3(1.f, 0.5f + 0.1f * float(materialIndex), 0.3f);
+        material->emissiveIntensity = 1.f + float(materialIndex);
+        emissiveMaterials.push_back(material);
+    }
+
+    auto opaqueMaterial = std::make_shared<Material>();
+    opaqueMaterial->name = "Opaque";
+
+    // A few meshes with different emissive triangle counts, shared by the instances like props in a level
+    constexpr uint32_t numMeshes = 8;
+    std::vector<std::shared_ptr<MeshInfo>> emissiveMeshes;
+    std::vector<std::shared_ptr<MeshInfo>> opaqueMeshes;
+    for (uint32_t meshIndex = 0; meshIndex < numMeshes; meshIndex++)
+    {
+        for (bool emissive : { true, false })
+        {
+            auto mesh = std::make_shared<SampleMesh>();
+            mesh->name = (emissive ? "Emissive" : "Opaque") + std::to_string(meshIndex);
+            mesh->objectSpaceBounds = box3(float3(-1.f), float3(1.f));
+
+            auto geometry = std::make_shared<MeshGeometry>();
+            geometry->material = emissive ? emissiveMaterials[meshIndex % numMaterials] : opaqueMaterial;
+            const uint32_t triangles = std::max(1u, parameters.emissiveTrianglesPerInstance * (numMeshes / 2 + meshIndex) / numMeshes);
+            geometry->numIndices = 3 * triangles;
+            geometry->numVertices = geometry->numIndices;
+            geometry->objectSpaceBounds = mesh->objectSpaceBounds;
+            mesh->totalIndices = geometry->numIndices;
+            mesh->totalVertices = geometry->numVertices;
+            mesh->geometries.push_back(geometry);
+
+            (emissive ? emissiveMeshes : opaqueMeshes).push_back(mesh);
+        }
+    }
+
+    auto addInstance = [&](const std::shared_ptr<MeshInfo>& mesh)
+    {
+        auto node = std::make_shared<SceneGraphNode>();
+        node->SetTranslation(randomPosition(0.0));
+        scene.sceneGraph->Attach(scene.sceneGraph->GetRootNode(), node);
+        scene.sceneGraph->AttachLeafNode(node, std::make_shared<MeshInstance>(mesh));
+
+        if (uniform(rng) < parameters.animatedFraction)
+            scene.animatedNodes.push_back(node);
+    };
+
+    for (uint32_t instanceIndex = 0; instanceIndex < parameters.emissiveInstances; instanceIndex++)
+    {
+        const auto& mesh = emissiveMeshes[instanceIndex % numMeshes];
+        addInstance(mesh);
+        scene.emissiveMeshes++;
+        scene.emissiveTriangles += mesh->geometries[0]->numIndices / 3;
+    }
+
+    for (uint32_t instanceIndex = 0; instanceIndex < parameters.opaqueInstances; instanceIndex++)
+        addInstance(opaqueMeshes[instanceIndex % numMeshes]);
+
+    for (uint32_t type = 0; type < SyntheticLightType_Count; type++)
+    {
+        for (uint32_t lightIndex = 0; lightIndex < parameters.lightCounts[type]; lightIndex++)
+        {
+            auto light = CreateSyntheticLight(type);
+            auto node = AttachSyntheticLight(*scene.sceneGraph, light, randomPosition(3.0));
+            scene.lights.push_back(light);
+
+            const bool infinite = type == SyntheticLightType_Directional || type == SyntheticLightType_Environment;
+            if (!infinite && uniform(rng) < parameters.animatedFraction)
+                scene.animatedNodes.push_back(node);
+        }
+    }
+
+    scene.sceneGraph->Refresh(0);
+
+    return scene;
+}
+
+void AnimateStressScene(StressScene& scene, uint32_t frameIndex)
+{
+    const double angle = double(frameIndex) * 0.05;
+    const double3 offset = double3(cos(angle), 0.0, sin(angle)) * 0.1;
+
+    for (const auto& node : scene.animatedNodes)
+        node->SetTranslation(node->GetTranslation() + offset);
+
+    scene.sceneGraph->Refresh(frameIndex);
+}
+
+static double GetMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Moves the view towards a single emissive instance and back, so that the solid angle of its bounds crosses
+// the proxy threshold and the hysteresis band, and checks when the instance is replaced by a proxy
+static void CheckEmissiveLodHysteresis(const StressSceneParameters& parameters)
+{
+    StressSceneParameters singleParameters;
+    singleParameters.emissiveInstances = 1;
+    singleParameters.emissiveTrianglesPerInstance = 64; // above EmissiveLodParameters::minTriangles for every mesh
+    singleParameters.extent = parameters.extent;
+    singleParameters.seed = parameters.seed;
+    StressScene scene = CreateStressScene(singleParameters);
+
+    const auto& instance = scene.sceneGraph->GetMeshInstances()[0];
+    const box3 worldBounds = instance->GetMesh()->geometries[0]->objectSpaceBounds * instance->GetNode()->GetLocalToWorldTransformFloat();
+    const float radius = length(worldBounds.diagonal()) * 0.5f;
+
+    EmissiveLodParameters lodParameters;
+    lodParameters.enable = true;
+    PrepareLightsTaskBuilder taskBuilder;
+    taskBuilder.SetEmissiveLodParameters(lodParameters);
+
+    // The view is placed on the side of the instance where its bounding sphere covers the given solid angle
+    const auto isProxyAt = [&](float solidAngle)
+    {
+        // sin^2(theta) = (1 - cos(theta)) (1 + cos(theta)), written to stay accurate when small
+        const float oneMinusCos = solidAngle / (2.f * dm::PI_f);
+        const float distance = radius / sqrtf(oneMinusCos * (2.f - oneMinusCos));
+        taskBuilder.UpdateEmissiveLod(*scene.sceneGraph, worldBounds.center() + float3(distance, 0.f, 0.f));
+        return taskBuilder.GetEmissiveLodProxyCount() == 1;
+    };
+
+    // Inside the band between the threshold and the threshold times the hysteresis, the previous state is kept
+    const float threshold = lodParameters.proxySolidAngle;
+    const float bandSolidAngle = threshold * sqrtf(lodParameters.hysteresis);
+    Check("Emissive LOD proxy below the threshold", isProxyAt(threshold * 0.5f), threshold * 0.5f);
+    Check("Emissive LOD proxy kept inside the hysteresis band", isProxyAt(bandSolidAngle), bandSolidAngle);
+    Check("Emissive LOD proxy dropped above the hysteresis band", !isProxyAt(threshold * lodParameters.hysteresis * 1.5f),
+        threshold * lodParameters.hysteresis * 1.5f);
+    Check("Emissive LOD triangles kept inside the hysteresis band", !isProxyAt(bandSolidAngle), bandSolidAngle);
+    Check("Emissive LOD proxy below the threshold again", isProxyAt(threshold * 0.5f), threshold * 0.5f);
+}
+
+void RunStressTest(const StressSceneParameters& parameters, uint32_t frames)
+{
+    auto start = std::chrono::steady_clock::now();
+    StressScene scene = CreateStressScene(parameters);
+    Report("Scene creation time, ms", GetMilliseconds(start));
+    Report("Lights", double(scene.lights.size()));
+    Report("Animated nodes", double(scene.animatedNodes.size()));
+
+    uint32_t numEmissiveMeshes = 0;
+    uint32_t numEmissiveTriangles = 0;
+    start = std::chrono::steady_clock::now();
+    CountEmissiveGeometry(*scene.sceneGraph, numEmissiveMeshes, numEmissiveTriangles);
+    Report("CountEmissiveGeometry time, ms", GetMilliseconds(start));
+    Check("Emissive meshes counted", numEmissiveMeshes == scene.emissiveMeshes, double(numEmissiveMeshes));
+    Check("Emissive triangles counted", numEmissiveTriangles == scene.emissiveTriangles, double(numEmissiveTriangles));
+
+    const uint32_t numPrimitiveLights = uint32_t(scene.sceneGraph->GetLights().size());
+
+    // Resource capacities from the same counts and policy as SetupRenderPasses in the sample
+    PrepareLightsTaskBuilder taskBuilder;
+    RtxdiResourceCapacityPolicy capacityPolicy;
+    capacityPolicy.Reset(taskBuilder.GetLightBufferCounts(*scene.sceneGraph));
+    const RtxdiResourceCapacities& capacities = capacityPolicy.GetCapacities();
+
+    // The buffer sizes of RtxdiResources for the current capacities
+    const auto getMaxTasks = [&capacities]() { return size_t(capacities.emissiveMeshes) + capacities.primitiveLights; };
+    const auto getMaxLocalLights = [&capacities]() { return capacities.emissiveTriangles + capacities.primitiveLights; };
+
+    std::vector<PrepareLightsTask> tasks;
+    std::vector<PolymorphicLightInfo> primitiveLightInfos;
+    std::vector<uint32_t> geometryInstanceToLight;
+    rtxdi::FrameParameters frameParameters;
+
+    start = std::chrono::steady_clock::now();
+    const uint32_t numLights = taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+        tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+    Report("First BuildTasks time, ms", GetMilliseconds(start));
+
+    Check("Tasks fit into the task buffer", tasks.size() <= getMaxTasks(), double(tasks.size()));
+    Check("Primitive lights fit into the primitive light buffer", primitiveLightInfos.size() <= getMaxTasks(), double(primitiveLightInfos.size()));
+    Check("Lights fit into one half of the light buffer", numLights <= getMaxLocalLights(), double(numLights));
+    Check("Local lights are emissive triangles and finite primitive lights",
+        frameParameters.numLocalLights == numEmissiveTriangles + numPrimitiveLights - frameParameters.numInfiniteLights - frameParameters.environmentLightPresent,
+        double(frameParameters.numLocalLights));
+    Check("Geometry instance mapping covers all instances",
+        geometryInstanceToLight.size() == scene.sceneGraph->GetGeometryInstancesCount(), double(geometryInstanceToLight.size()));
+    Check("Geometry instance mapping fits into its buffer", geometryInstanceToLight.size() <= capacities.geometryInstances,
+        double(geometryInstanceToLight.size()));
+
+    // The tasks pack the instance index into 19 bits and the geometry index into 12 bits
+    Check("Instance indices fit into the task encoding", scene.sceneGraph->GetMeshInstances().size() <= (1u << 19),
+        double(scene.sceneGraph->GetMeshInstances().size()));
+
+    uint32_t pdfWidth = 0;
+    uint32_t pdfHeight = 0;
+    uint32_t pdfMips = 0;
+    rtxdi::ComputePdfTextureSize(getMaxLocalLights(), pdfWidth, pdfHeight, pdfMips);
+    Check("PDF texture holds all local lights", uint64_t(pdfWidth) * pdfHeight >= frameParameters.numLocalLights, double(pdfWidth) * pdfHeight);
+    Check("PDF texture mips reach 1x1", (std::max(pdfWidth, pdfHeight) >> (pdfMips - 1)) == 1, double(pdfMips));
+
+    double buildTime = 0.0;
+    double animationTime = 0.0;
+    bool offsetsReused = true;
+    for (uint32_t frame = 1; frame <= frames; frame++)
+    {
+        start = std::chrono::steady_clock::now();
+        AnimateStressScene(scene, frame);
+        animationTime += GetMilliseconds(start);
+
+        start = std::chrono::steady_clock::now();
+        taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+            tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+        buildTime += GetMilliseconds(start);
+
+        // The light set doesn't change, so every task must find its light from the previous frame
+        for (const PrepareLightsTask& task : tasks)
+            offsetsReused &= task.previousLightBufferOffset >= 0;
+    }
+
+    Report("Scene animation and refresh time per frame, ms", animationTime / frames);
+    Report("BuildTasks time per frame, ms", buildTime / frames);
+    Check("Previous light offsets found for all tasks", offsetsReused, double(tasks.size()));
+
+    // Static frames must keep the lighting epoch, so that the sample skips the light preparation on them.
+    // Without a scene change event the scene is not hashed, with one the hash must still match.
+    taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, true, false);
+    const uint32_t staticEpoch = taskBuilder.GetLightingEpoch();
+    bool staticEpochChanged = false;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++)
+        staticEpochChanged |= taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, false, false);
+    Report("UpdateLightingEpoch time per static frame, ms", GetMilliseconds(start) / frames);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++)
+        staticEpochChanged |= taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, true, false);
+    Report("UpdateLightingEpoch time per scene change event, ms", GetMilliseconds(start) / frames);
+    Check("Lighting epoch kept on static frames", !staticEpochChanged && taskBuilder.GetLightingEpoch() == staticEpoch, double(staticEpoch));
+
+    // A light edit is only picked up on a frame with a scene change event. The environment light has no color.
+    const auto editedLight = std::find_if(scene.lights.begin(), scene.lights.end(),
+        [](const auto& light) { return light->GetLightType() != LightType_Environment; });
+    if (editedLight != scene.lights.end())
+    {
+        const float3 originalColor = (*editedLight)->color;
+        (*editedLight)->color = originalColor * 2.f;
+        const bool advancedWithoutEvent = taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, false, false);
+        const bool advancedWithEvent = taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, true, false);
+        (*editedLight)->color = originalColor;
+        taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, true, false);
+        Check("Lighting epoch advanced by a light change event", !advancedWithoutEvent && advancedWithEvent,
+            double(taskBuilder.GetLightingEpoch()));
+    }
+
+    if (!scene.animatedNodes.empty())
+    {
+        AnimateStressScene(scene, frames + 1);
+        const bool advanced = taskBuilder.UpdateLightingEpoch(*scene.sceneGraph, scene.lights, true, 3.f, true, false);
+        Check("Lighting epoch advanced by the animation", advanced, double(taskBuilder.GetLightingEpoch()));
+    }
+
+    // Emissive LOD seen from a corner of the scene, the distant emissive geometry becomes proxy lights
+    const uint32_t localLightsWithoutLod = frameParameters.numLocalLights;
+    const float3 viewPosition = float3(0.f, 2.f, 0.f);
+    EmissiveLodParameters lodParameters;
+    lodParameters.enable = true;
+    taskBuilder.SetEmissiveLodParameters(lodParameters);
+
+    start = std::chrono::steady_clock::now();
+    taskBuilder.UpdateEmissiveLod(*scene.sceneGraph, viewPosition);
+    Report("UpdateEmissiveLod time, ms", GetMilliseconds(start));
+
+    taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+        tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+    Check("Emissive LOD proxies", taskBuilder.GetEmissiveLodProxyCount() != 0 || numEmissiveMeshes == 0,
+        double(taskBuilder.GetEmissiveLodProxyCount()));
+    Check("Emissive LOD removes the replaced triangles from the local lights",
+        frameParameters.numLocalLights + taskBuilder.GetEmissiveLodReplacedTriangles() == localLightsWithoutLod, double(frameParameters.numLocalLights));
+    Check("Tasks with proxies fit into the task buffer", tasks.size() <= getMaxTasks(), double(tasks.size()));
+    Check("Proxies fit into the primitive light buffer", primitiveLightInfos.size() <= getMaxTasks(), double(primitiveLightInfos.size()));
+    Check("Proxies fit into the primitive light capacity",
+        primitiveLightInfos.size() <= taskBuilder.GetLightBufferCounts(*scene.sceneGraph).primitiveLights, double(primitiveLightInfos.size()));
+
+    const bool selectionChanged = taskBuilder.UpdateEmissiveLod(*scene.sceneGraph, viewPosition);
+    Check("Emissive LOD selection kept for a static view", !selectionChanged, double(taskBuilder.GetEmissiveLodProxyCount()));
+
+    // A smaller budget merges the proxies of more geometries
+    lodParameters.maxProxyLights = 4;
+    taskBuilder.SetEmissiveLodParameters(lodParameters);
+    taskBuilder.UpdateEmissiveLod(*scene.sceneGraph, viewPosition);
+    taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+        tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+    Check("Emissive LOD proxy lights within the budget", taskBuilder.GetEmissiveLodProxyLights() <= lodParameters.maxProxyLights,
+        double(taskBuilder.GetEmissiveLodProxyLights()));
+    Check("Emissive LOD merged proxies counted in the local lights",
+        frameParameters.numLocalLights + taskBuilder.GetEmissiveLodReplacedTriangles() == localLightsWithoutLod, double(frameParameters.numLocalLights));
+
+    CheckEmissiveLodHysteresis(parameters);
+
+    // Light streaming with the view moving diagonally across the scene
+    lodParameters.enable = false;
+    taskBuilder.SetEmissiveLodParameters(lodParameters);
+    taskBuilder.UpdateEmissiveLod(*scene.sceneGraph, viewPosition);
+    taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+        tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+
+    LightStreamingParameters streamingParameters;
+    streamingParameters.enable = true;
+    streamingParameters.cellSize = parameters.extent / 16.f;
+    streamingParameters.loadDistance = streamingParameters.cellSize * 3.f;
+    streamingParameters.evictDistance = streamingParameters.cellSize * 4.f;
+    taskBuilder.SetLightStreamingParameters(streamingParameters);
+
+    // instanceAndGeometryIndex -> lightBufferOffset of the emissive geometry tasks on the previous frame
+    std::unordered_map<uint32_t, uint32_t> previousGeometryOffsets;
+    const auto recordGeometryOffsets = [&]()
+    {
+        previousGeometryOffsets.clear();
+        for (const PrepareLightsTask& task : tasks)
+        {
+            if ((task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT) == 0)
+                previousGeometryOffsets[task.instanceAndGeometryIndex] = task.lightBufferOffset;
+        }
+    };
+    recordGeometryOffsets();
+
+    const uint32_t streamingFrames = std::max(frames, 64u);
+    bool tasksCoverLocalLights = true;
+    bool previousOffsetsMatch = true;
+    bool streamingTasksFit = true;
+    uint32_t maxResidentLights = 0;
+    double streamingTime = 0.0;
+
+    for (uint32_t frame = 0; frame < streamingFrames; frame++)
+    {
+        const float t = float(frame) / float(streamingFrames - 1);
+        const float3 streamingView = float3(t * parameters.extent, 2.f, t * parameters.extent);
+
+        start = std::chrono::steady_clock::now();
+        // The scene doesn't move during the walk, so only the first update groups the items into cells
+        taskBuilder.UpdateLightStreaming(*scene.sceneGraph, scene.lights, streamingView, false);
+        capacityPolicy.Update(taskBuilder.GetLightBufferCounts(*scene.sceneGraph));
+        taskBuilder.BuildTasks(*scene.sceneGraph, scene.lights, true, 3.f,
+            tasks, primitiveLightInfos, geometryInstanceToLight, frameParameters);
+        streamingTime += GetMilliseconds(start);
+
+        const LightStreamingManager& streaming = taskBuilder.GetLightStreaming();
+        maxResidentLights = std::max(maxResidentLights, streaming.GetResidentLightCount());
+
+        // The shader searches the tasks by offset, and every local light must be written on every frame
+        uint32_t lightOffset = 0;
+        for (const PrepareLightsTask& task : tasks)
+        {
+            if (task.lightBufferOffset >= frameParameters.numLocalLights)
+                break;
+
+            tasksCoverLocalLights &= task.lightBufferOffset == lightOffset;
+            lightOffset = task.lightBufferOffset + task.triangleCount;
+        }
+        tasksCoverLocalLights &= lightOffset == frameParameters.numLocalLights
+            && frameParameters.numLocalLights == streaming.GetLocalLightCapacity();
+
+        for (const PrepareLightsTask& task : tasks)
+        {
+            if ((task.instanceAndGeometryIndex & TASK_PRIMITIVE_LIGHT_BIT) != 0 || task.previousLightBufferOffset < 0)
+                continue;
+
+            auto pOffset = previousGeometryOffsets.find(task.instanceAndGeometryIndex);
+            previousOffsetsMatch &= pOffset != previousGeometryOffsets.end() && int(pOffset->second) == task.previousLightBufferOffset;
+        }
+        recordGeometryOffsets();
+
+        streamingTasksFit &= tasks.size() <= getMaxTasks() && primitiveLightInfos.size() <= getMaxTasks()
+            && frameParameters.numLocalLights <= getMaxLocalLights();
+    }
+
+    const LightStreamingManager& streaming = taskBuilder.GetLightStreaming();
+    Report("Light streaming time per frame, ms", streamingTime / streamingFrames);
+    Report("Light streaming cells", double(streaming.GetCellCount()));
+    Check("Light streaming resident lights, max", maxResidentLights != 0 || numLights == 0, double(maxResidentLights));
+    Check("Light streaming loads", streaming.GetLoadCount() != 0 || numLights == 0, double(streaming.GetLoadCount()));
+    Report("Light streaming evictions", double(streaming.GetEvictionCount()));
+    Check("Light streaming tasks cover the local lights in order", tasksCoverLocalLights, double(frameParameters.numLocalLights));
+    Check("Light streaming previous offsets match the previous frame", previousOffsetsMatch, double(tasks.size()));
+    Check("Light streaming tasks and lights fit into the buffers", streamingTasksFit, double(tasks.size()));
+}
@@ -0,0 +1,89 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/engine/SceneGraph.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Light types created by CreateSyntheticLight, also used as the arguments of the light benchmarks
+enum SyntheticLightType : uint32_t
+{
+    SyntheticLightType_Point,
+    SyntheticLightType_Sphere,
+    SyntheticLightType_Spot,
+    SyntheticLightType_SpotProfile,
+    SyntheticLightType_Directional,
+    SyntheticLightType_Environment,
+    SyntheticLightType_Cylinder,
+    SyntheticLightType_Disk,
+    SyntheticLightType_Rect,
+
+    SyntheticLightType_Count
+};
+
+extern const char* g_SyntheticLightTypeNames[SyntheticLightType_Count];
+
+std::shared_ptr<donut::engine::Light> CreateSyntheticLight(uint32_t type);
+
+// Attaches the light to a new node under the root and returns the node,
+// lights need a node to have a position and direction
+std::shared_ptr<donut::engine::SceneGraphNode> AttachSyntheticLight(donut::engine::SceneGraph& sceneGraph, const std::shared_ptr<donut::engine::Light>& light,
+    const dm::double3& position);
+
+struct StressSceneParameters
+{
+    // Number of lights of every type. The directional and environment lights are infinite, the sample supports
+    // at most one environment light.
+    uint32_t lightCounts[SyntheticLightType_Count] = {};
+
+    // Mesh instances with one emissive geometry, and with only non-emissive geometry
+    uint32_t emissiveInstances = 0;
+    uint32_t opaqueInstances = 0;
+
+    // Triangle count of the emissive geometries, the meshes vary between half and 1.4 times this
+    uint32_t emissiveTrianglesPerInstance = 256;
+
+    // Fraction of the lights and instances that move in AnimateStressScene
+    float animatedFraction = 0.f;
+
+    // The lights and instances are spread over a square of this size
+    float extent = 1000.f;
+
+    uint32_t seed = 1;
+};
+
+// Parses a list like "point=1000,rect=500" into the light counts, type names as in g_SyntheticLightTypeNames
+// in lower case with dashes, e.g. "spot-profile". Returns false and sets the error message on invalid input.
+bool ParseStressLightCounts(const std::string& text, StressSceneParameters& parameters, std::string& error);
+
+struct StressScene
+{
+    std::shared_ptr<donut::engine::SceneGraph> sceneGraph;
+    std::vector<std::shared_ptr<donut::engine::Light>> lights;
+    std::vector<std::shared_ptr<donut::engine::SceneGraphNode>> animatedNodes;
+
+    // Expected results of the emissive geometry count
+    uint32_t emissiveMeshes = 0;
+    uint32_t emissiveTriangles = 0;
+};
+
+// Builds a scene graph with the requested lights and instances in memory. Like the synthetic benchmark scene,
+// it only holds the CPU-side descriptions of meshes and materials and doesn't need a device.
+StressScene CreateStressScene(const StressSceneParameters& parameters);
+
+// Moves the animated nodes along circles and refreshes the scene graph
+void AnimateStressScene(StressScene& scene, uint32_t frameIndex);
+
+// Runs the CPU side of the light preparation on a generated scene and checks the resource sizes derived from it,
+// printing the timings. The failed checks are counted by the shared check report, see tools/common/CheckReport.h.
+void RunStressTest(const StressSceneParameters& parameters, uint32_t frames);
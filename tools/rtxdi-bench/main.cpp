@@ -0,0 +1,115 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Runs the host code micro-benchmarks, see MicroBenchmark.h.
+// With --stress, runs the light preparation on a generated many-light scene instead, see StressScene.h.
+// Exit codes: 0 - success, 1 - the results could not be saved or a stress test check failed, 2 - invalid arguments.
+
+#include "MicroBenchmark.h"
+#include "StressScene.h"
+#include "../common/CheckReport.h"
+
+#include <cxxopts.hpp>
+#include <cstdio>
+
+int main(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], "Runs the RTXDI host code micro-benchmarks");
+
+    std::string filter;
+    std::string jsonFileName;
+    double minTime = 0.5;
+    bool list = false;
+    bool quiet = false;
+    bool stress = false;
+    std::string stressLights = "point=30000,sphere=20000,spot=20000,spot-profile=5000,cylinder=5000,disk=10000,rect=10000,"
+        "directional=2,environment=1";
+    StressSceneParameters stressParameters;
+    stressParameters.emissiveInstances = 4000;
+    stressParameters.opaqueInstances = 20000;
+    stressParameters.animatedFraction = 0.1f;
+    uint32_t stressFrames = 100;
+    bool help = false;
+
+    options.add_options()
+        ("filter", "Only run the benchmarks whose name contains this string", value(filter))
+        ("json", "Save the results into a file in the Google Benchmark JSON format", value(jsonFileName))
+        ("min-time", "Minimum running time of each benchmark in seconds, default is 0.5", value(minTime))
+        ("list", "List the benchmarks without running them", value(list))
+        ("q,quiet", "Don't print the benchmark names while running", value(quiet))
+        ("stress", "Run the stress test on a generated many-light scene instead of the benchmarks", value(stress))
+        ("stress-lights", "Primitive lights of the stress scene as type=count pairs, default is " + stressLights, value(stressLights))
+        ("stress-emissive-instances", "Mesh instances with emissive geometry in the stress scene, default is 4000", value(stressParameters.emissiveInstances))
+        ("stress-emissive-triangles", "Average emissive triangles per instance in the stress scene, default is 256", value(stressParameters.emissiveTrianglesPerInstance))
+        ("stress-opaque-instances", "Mesh instances without emissive geometry in the stress scene, default is 20000", value(stressParameters.opaqueInstances))
+        ("stress-animated", "Fraction of the lights and instances that move in the stress scene, default is 0.1", value(stressParameters.animatedFraction))
+        ("stress-frames", "Number of animated frames in the stress test, default is 100", value(stressFrames))
+        ("h,help", "Display this help message", value(help))
+    ;
+
+    try
+    {
+        options.parse(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    if (help)
+    {
+        printf("%s", options.help().c_str());
+        return 0;
+    }
+
+    if (stress)
+    {
+        std::string error;
+        if (!ParseStressLightCounts(stressLights, stressParameters, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+
+        if (stressFrames == 0)
+        {
+            fprintf(stderr, "Invalid arguments: at least 1 stress frame is needed\n");
+            return 2;
+        }
+
+        RunStressTest(stressParameters, stressFrames);
+        return FinishChecks();
+    }
+
+    if (list)
+    {
+        for (const BenchmarkDefinition& definition : BenchmarkRegistry::Get().GetBenchmarks())
+        {
+            if (definition.arguments.empty())
+                printf("%s\n", definition.name.c_str());
+
+            for (int64_t argument : definition.arguments)
+                printf("%s/%lld\n", definition.name.c_str(), (long long)argument);
+        }
+        return 0;
+    }
+
+    const auto results = RunBenchmarks(filter, minTime, !quiet);
+
+    printf("%s", FormatBenchmarkResultsText(results).c_str());
+
+    if (!jsonFileName.empty() && !SaveBenchmarkResultsJson(jsonFileName, results))
+        return 1;
+
+    return 0;
+}